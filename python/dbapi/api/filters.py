@@ -1,3 +1,5 @@
+import math
+import re
 
 def tagsQueryFilter(tagsQuery, table):
     query = ""
@@ -19,3 +21,74 @@ def tagsQueryFilter(tagsQuery, table):
 
 def hashtagQueryFilter(hashtag, table):
     return "'{0}' = ANY (hashtags)".format(hashtag)
+
+# The spatial cell keys stored with each feature, these must match
+# src/utils/quadkey.cc
+QUADKEY_MAXZOOM = 16
+# The most tiles on each side used to cover an area
+QUADKEY_SPAN = 8
+
+def quadkeyTile(lon, lat):
+    size = 1 << QUADKEY_MAXZOOM
+    lat = max(-85.0511287798, min(85.0511287798, lat))
+    sinlat = math.sin(math.radians(lat))
+    x = math.floor((lon + 180.0) / 360.0 * size)
+    y = math.floor((0.5 - math.log((1.0 + sinlat) / (1.0 - sinlat)) / (4.0 * math.pi)) * size)
+    return max(0, min(size - 1, x)), max(0, min(size - 1, y))
+
+def quadkeyOf(x, y, zoom):
+    key = 0
+    for bit in range(zoom - 1, -1, -1):
+        key = (key << 2) | ((x >> bit) & 1) | (((y >> bit) & 1) << 1)
+    return key << (2 * (QUADKEY_MAXZOOM - zoom))
+
+def quadkeyQueryFilter(area, table):
+    # A feature is stored with the key of the smallest tile containing
+    # it, so it can only intersect the area if that tile is inside one
+    # of the tiles covering the area, or is one of their parents. This
+    # is only a cheap first pass for the index, ST_Intersects() still
+    # does the exact test. Rows loaded without a key are always kept.
+    # The area is the inside of MULTIPOLYGON(((...))), so it may have
+    # several rings or polygons, separated by parentheses.
+    try:
+        coords = [list(map(float, point.split())) for point in re.split(r"[(),]", area) if point.strip()]
+        lons = [point[0] for point in coords]
+        lats = [point[1] for point in coords]
+        if not coords or any(len(point) != 2 for point in coords):
+            raise ValueError(area)
+    except ValueError:
+        # Let ST_Intersects() report it, without a prefilter
+        return "TRUE"
+    x0, y0 = quadkeyTile(min(lons), max(lats))
+    x1, y1 = quadkeyTile(max(lons), min(lats))
+
+    zoom = QUADKEY_MAXZOOM
+    while (x1 - x0) >= QUADKEY_SPAN or (y1 - y0) >= QUADKEY_SPAN:
+        x0, y0, x1, y1 = x0 >> 1, y0 >> 1, x1 >> 1, y1 >> 1
+        zoom -= 1
+
+    step = 1 << (2 * (QUADKEY_MAXZOOM - zoom))
+    ranges = []
+    parents = set()
+    for x in range(x0, x1 + 1):
+        for y in range(y0, y1 + 1):
+            key = quadkeyOf(x, y, zoom)
+            ranges.append([key, key + step])
+            for level in range(zoom):
+                parents.add(quadkeyOf(x >> (zoom - level), y >> (zoom - level), level))
+
+    # Neighbouring tiles are often next to each other in key order
+    ranges.sort()
+    merged = [ranges[0]]
+    for lo, hi in ranges[1:]:
+        if lo <= merged[-1][1]:
+            merged[-1][1] = max(merged[-1][1], hi)
+        else:
+            merged.append([lo, hi])
+
+    query = "{0}.quadkey IS NULL".format(table)
+    if parents:
+        query += " OR {0}.quadkey IN ({1})".format(table, ",".join(map(str, sorted(parents))))
+    for lo, hi in merged:
+        query += " OR ({0}.quadkey >= {1} AND {0}.quadkey < {2})".format(table, lo, hi)
+    return "(" + query + ")"
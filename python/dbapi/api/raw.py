@@ -17,7 +17,7 @@
 #     You should have received a copy of the GNU General Public License
 #     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
 
-from .filters import tagsQueryFilter, hashtagQueryFilter
+from .filters import tagsQueryFilter, hashtagQueryFilter, quadkeyQueryFilter
 
 RESULTS_PER_PAGE = 500
 RESULTS_PER_PAGE_LIST = 10
@@ -46,13 +46,13 @@ def geoFeaturesQuery(
 
         geoType = getGeoType(table)
         query = "with t_data AS ( \
-            SELECT '" + geoType + "' as type, " + table + ".osm_id as id, " + table + ".timestamp, geom as geometry, tags, status, hashtags, editor, created_at FROM " + table + " \
+            SELECT '" + geoType + "' as type, " + table + ".osm_id as id, " + table + ".timestamp, geom as geometry, " + table + ".quadkey, tags, status, hashtags, editor, created_at FROM " + table + " \
             LEFT JOIN validation ON validation.osm_id = " + table + ".osm_id \
             LEFT JOIN changesets c ON c.id = " + table + ".changeset"
         
         if table != "nodes":
             query += " UNION \
-            SELECT '" + getRelationsGeoType(table) + "' as type, relations.osm_id as id, relations.timestamp, geom as geometry, tags, status, hashtags, editor, created_at FROM relations \
+            SELECT '" + getRelationsGeoType(table) + "' as type, relations.osm_id as id, relations.timestamp, geom as geometry, relations.quadkey, tags, status, hashtags, editor, created_at FROM relations \
             LEFT JOIN validation ON validation.osm_id = relations.osm_id \
             LEFT JOIN changesets c ON c.id = relations.changeset \
             WHERE (tags->>'type' = '"  + getRelationsGeoType(table).lower() + "')"
@@ -62,10 +62,10 @@ def geoFeaturesQuery(
         ), \
         t_features AS (  \
             SELECT jsonb_build_object( 'type', 'Feature', 'id', id, 'properties', to_jsonb(t_results) \
-            - 'geometry' , 'geometry', ST_AsGeoJSON(geometry)::jsonb ) AS feature FROM t_results  \
+            - 'geometry' - 'quadkey' , 'geometry', ST_AsGeoJSON(geometry)::jsonb ) AS feature FROM t_results  \
         ) SELECT jsonb_build_object( 'type', 'FeatureCollection', 'features', jsonb_agg(t_features.feature) ) \
         as result FROM t_features;".format(
-            "ST_Intersects(\"geometry\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "1=1 ",
+            quadkeyQueryFilter(area, "t_data") + " AND ST_Intersects(\"geometry\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "1=1 ",
             "AND (" + tagsQueryFilter(tags, "t_data") + ")" if tags else "",
             "AND " + hashtagQueryFilter(hashtag, "t_data") if hashtag else "",
             "AND created_at >= {0} AND created_at <= {1}".format(dateFrom, dateTo) if dateFrom and dateTo else "",
@@ -94,13 +94,13 @@ def listAllFeaturesQuery(
             osmType = "way"
 
         query = "with t_data AS ( \
-            SELECT '" + osmType + "' as type, '" + geoType + "' as geotype, " + table + ".osm_id as id, ST_X(ST_Centroid(geom)) as lat, ST_Y(ST_Centroid(geom)) as lon, " + table + ".timestamp, tags, " + table + ".changeset, c.created_at, v.status FROM " + table + " \
+            SELECT '" + osmType + "' as type, '" + geoType + "' as geotype, " + table + ".osm_id as id, ST_X(ST_Centroid(geom)) as lat, ST_Y(ST_Centroid(geom)) as lon, " + table + ".timestamp, " + table + ".quadkey, tags, " + table + ".changeset, c.created_at, v.status FROM " + table + " \
             LEFT JOIN changesets c ON c.id = " + table + ".changeset \
             LEFT JOIN validation v ON v.osm_id = " + table + ".osm_id"
             
         if table != "nodes":
             query += " UNION \
-            SELECT '" + osmType + "' as type, '" + relationsGeoType + "' as geotype, relations.osm_id as id, ST_X(ST_Centroid(geom)) as lat, ST_Y(ST_Centroid(geom)) as lon, relations.timestamp, tags, relations.changeset, c.created_at, v.status FROM relations \
+            SELECT '" + osmType + "' as type, '" + relationsGeoType + "' as geotype, relations.osm_id as id, ST_X(ST_Centroid(geom)) as lat, ST_Y(ST_Centroid(geom)) as lon, relations.timestamp, relations.quadkey, tags, relations.changeset, c.created_at, v.status FROM relations \
             LEFT JOIN validation v ON v.osm_id = relations.osm_id \
             LEFT JOIN changesets c ON c.id = relations.changeset \
             WHERE (tags->>'type' = '"  + getRelationsGeoType(table).lower() + "')"
@@ -112,7 +112,7 @@ def listAllFeaturesQuery(
             "AND created_at <= '{0}'".format(dateTo) if (dateTo) else "",
             "AND status = '{0}'".format(status) if (status) else "",
             "AND " + hashtagQueryFilter(hashtag, "t_data") if hashtag else "",
-            "AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
+            "AND " + quadkeyQueryFilter(area, "t_data") + " AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
             "AND (" + tagsQueryFilter(tags, "t_data") + ")" if tags else "",
             "AND " + orderBy + " IS NOT NULL ORDER BY " + orderBy + " DESC LIMIT " + str(RESULTS_PER_PAGE_LIST) + (" OFFSET {0}" \
                 .format(page * RESULTS_PER_PAGE_LIST) if page else ""),
@@ -17,7 +17,7 @@
 #     You should have received a copy of the GNU General Public License
 #     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
 
-from .filters import tagsQueryFilter, hashtagQueryFilter
+from .filters import tagsQueryFilter, hashtagQueryFilter, quadkeyQueryFilter
 
 class Stats:
     def __init__(self, db):
@@ -49,7 +49,7 @@ class Stats:
                 table,
                 "created_at >= '{0}'".format(dateFrom) if (dateFrom) else "1=1",
                 "AND created_at <= '{0}'".format(dateTo) if (dateTo) else "",
-                "AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
+                "AND " + quadkeyQueryFilter(area, table) + " AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
                 "AND (" + tagsQueryFilter(tags, table) + ")" if tags else "",
                 "AND " + hashtagQueryFilter(hashtag, table) if hashtag else "",
             )
@@ -61,7 +61,7 @@ class Stats:
             ".format(
                 "created_at >= '{0}'".format(dateFrom) if (dateFrom) else "1=1",
                 "AND created_at <= '{0}'".format(dateTo) if (dateTo) else "",
-                "AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
+                "AND " + quadkeyQueryFilter(area, "relations") + " AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
                 "AND (" + tagsQueryFilter(tags, "relations") + ")" if tags else "",
                 "AND " + hashtagQueryFilter(hashtag, "relations") if hashtag else "",
             )
@@ -83,7 +83,7 @@ class Stats:
                 table,
                 "created_at >= '{0}'".format(dateFrom) if (dateFrom) else "1=1",
                 "AND created_at <= '{0}'".format(dateTo) if (dateTo) else "",
-                "AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
+                "AND " + quadkeyQueryFilter(area, table) + " AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
                 "AND (" + tagsQueryFilter(tags, table) + ")" if tags else "",
                 "AND " + hashtagQueryFilter(hashtag, table) if hashtag else ""
             )
@@ -93,7 +93,7 @@ class Stats:
             where {0} {1} {2} {3} {4}".format(
                 "created_at >= '{0}'".format(dateFrom) if (dateFrom) else "1=1",
                 "AND created_at <= '{0}'".format(dateTo) if (dateTo) else "",
-                "AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
+                "AND " + quadkeyQueryFilter(area, "relations") + " AND ST_Intersects(\"geom\", ST_GeomFromText('MULTIPOLYGON((({0})))', 4326) )".format(area) if area else "",
                 "AND (" + tagsQueryFilter(tags, "relations") + ")" if tags else "",
                 "AND " + hashtagQueryFilter(hashtag, "relations") if hashtag else ""
             )
@@ -12,6 +12,14 @@ CREATE INDEX nodes_timestamp_idx ON public.nodes(timestamp DESC);
 CREATE INDEX ways_poly_timestamp_idx ON public.ways_poly(timestamp DESC);
 CREATE INDEX ways_line_timestamp_idx ON public.ways_line(timestamp DESC);
 
+CREATE INDEX nodes_quadkey_idx ON public.nodes (quadkey);
+CREATE INDEX ways_poly_quadkey_idx ON public.ways_poly (quadkey);
+CREATE INDEX ways_line_quadkey_idx ON public.ways_line (quadkey);
+CREATE INDEX relations_quadkey_idx ON public.relations (quadkey);
+CREATE INDEX validation_quadkey_idx ON public.validation (quadkey);
+
 CREATE INDEX idx_changesets_hashtags ON public.changesets USING gin(hashtags);
+CREATE INDEX idx_changesets_regions ON public.changesets USING gin(regions);
+CREATE INDEX idx_validation_regions ON public.validation USING gin(regions);
 CREATE INDEX idx_osm_id_status ON public.validation (osm_id)
 
@@ -24,6 +24,41 @@
 -- Set projection to 4326 
 local srid = 4326
 
+-- The spatial cell keys, these must match src/utils/quadkey.cc
+local maxzoom = 16
+
+local function tile(lon, lat)
+    local size = 2 ^ maxzoom
+    lat = math.max(-85.0511287798, math.min(85.0511287798, lat))
+    local sinlat = math.sin(lat * math.pi / 180)
+    local x = math.floor((lon + 180) / 360 * size)
+    local y = math.floor((0.5 - math.log((1 + sinlat) / (1 - sinlat)) / (4 * math.pi)) * size)
+    return math.max(0, math.min(size - 1, x)), math.max(0, math.min(size - 1, y))
+end
+
+-- The key of the smallest tile containing the bounding box of an object
+local function quadkey(object)
+    local minlon, minlat, maxlon, maxlat = object:get_bbox()
+    if minlon == nil then
+        return nil
+    end
+    local x0, y0 = tile(minlon, maxlat)
+    local x1, y1 = tile(maxlon, minlat)
+    local zoom = maxzoom
+    while x0 ~= x1 or y0 ~= y1 do
+        x0, y0 = math.floor(x0 / 2), math.floor(y0 / 2)
+        x1, y1 = math.floor(x1 / 2), math.floor(y1 / 2)
+        zoom = zoom - 1
+    end
+    local key = 0
+    for bit = zoom - 1, 0, -1 do
+        local step = 2 ^ bit
+        local digit = math.floor(x0 / step) % 2 + 2 * (math.floor(y0 / step) % 2)
+        key = key * 4 + digit
+    end
+    return key * 4 ^ (maxzoom - zoom)
+end
+
 local tables = {}
 
 tables.nodes = osm2pgsql.define_table{
@@ -38,6 +73,7 @@ tables.nodes = osm2pgsql.define_table{
         { column = 'timestamp', sql_type = 'timestamp' },
         { column = 'tags', type = 'jsonb' },
         { column = 'geom', type = 'point', projection = srid },
+        { column = 'quadkey', type = 'int8' },
     }
 }
 
@@ -54,6 +90,7 @@ tables.ways_line = osm2pgsql.define_table{
         { column = 'tags', type = 'jsonb' },
         { column = 'refs', type= 'text', sql_type = 'bigint[]'},
         { column = 'geom', type = 'linestring', projection = srid },
+        { column = 'quadkey', type = 'int8' },
         { column = 'country', sql_type= 'int[]', create_only = true },
     }
 
@@ -72,6 +109,7 @@ tables.ways_poly = osm2pgsql.define_table{
         { column = 'tags', type = 'jsonb' },
         { column = 'refs', type= 'text', sql_type = 'bigint[]'},
         { column = 'geom', type = 'polygon', projection = srid },
+        { column = 'quadkey', type = 'int8' },
         { column = 'grid', type = 'int', create_only = true },
         { column = 'country', sql_type= 'int[]', create_only = true },
     }
@@ -93,6 +131,7 @@ tables.rels = osm2pgsql.define_table{
         { column = 'tags', type = 'jsonb' },
         { column = 'refs', type = 'jsonb'},
         { column = 'geom', type = 'geometry', projection = srid },
+        { column = 'quadkey', type = 'int8', create_only = true },
         { column = 'country',sql_type= 'int[]', create_only = true },
     }
 }
@@ -106,7 +145,8 @@ function osm2pgsql.process_node(object)
         changeset = object.changeset,
         timestamp = os.date('!%Y-%m-%dT%H:%M:%SZ', object.timestamp),
         tags = object.tags,
-        geom = { create = 'point' }
+        geom = { create = 'point' },
+        quadkey = quadkey(object)
     })
 end
 
@@ -122,7 +162,7 @@ function osm2pgsql.process_way(object)
             tags = object.tags,
             refs = '{' .. table.concat(object.nodes, ',') .. '}',
             geom = { create = 'area' },
-            
+            quadkey = quadkey(object)
         })
     else
         tables.ways_line:add_row({
@@ -134,7 +174,7 @@ function osm2pgsql.process_way(object)
             tags = object.tags,
             refs = '{' .. table.concat(object.nodes, ',') .. '}',
             geom = { create = 'line' },
-            
+            quadkey = quadkey(object)
         })
     end
 end
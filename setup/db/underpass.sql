@@ -34,7 +34,8 @@ CREATE TABLE IF NOT EXISTS public.changesets (
     source text,
     validated boolean,
     quality integer,
-    bbox public.geometry(MultiPolygon,4326)
+    bbox public.geometry(MultiPolygon,4326),
+    regions text[]
 );
 ALTER TABLE ONLY public.changesets
     ADD CONSTRAINT changesets_pkey PRIMARY KEY (id);
@@ -54,7 +55,9 @@ CREATE TABLE IF NOT EXISTS public.validation (
     source text,
     version bigint,
     timestamp timestamp with time zone,
-    location public.geometry(Geometry,4326)
+    location public.geometry(Geometry,4326),
+    regions text[],
+    quadkey int8
 );
 ALTER TABLE ONLY public.validation
     ADD CONSTRAINT validation_pkey PRIMARY KEY (osm_id, status, source);
@@ -68,7 +71,8 @@ CREATE TABLE IF NOT EXISTS public.ways_poly (
     timestamp timestamp with time zone,
     version int,
     "user" text,
-    uid int8
+    uid int8,
+    quadkey int8
 );
 
 CREATE TABLE IF NOT EXISTS public.ways_line (
@@ -80,7 +84,8 @@ CREATE TABLE IF NOT EXISTS public.ways_line (
     timestamp timestamp with time zone,
     version int,
     "user" text,
-    uid int8
+    uid int8,
+    quadkey int8
 );
 
 CREATE TABLE IF NOT EXISTS public.nodes (
@@ -91,7 +96,8 @@ CREATE TABLE IF NOT EXISTS public.nodes (
     timestamp timestamp with time zone,
     version int,
     "user" text,
-    uid int8
+    uid int8,
+    quadkey int8
 );
 
 CREATE TABLE IF NOT EXISTS public.relations (
@@ -103,7 +109,8 @@ CREATE TABLE IF NOT EXISTS public.relations (
     timestamp timestamp with time zone,
     version int,
     "user" text,
-    uid int8
+    uid int8,
+    quadkey int8
 );
 
 ALTER TABLE ONLY public.relations
@@ -119,6 +126,15 @@ CREATE TABLE IF NOT EXISTS public.rel_refs (
     way_id int8
 );
 
+-- Add the columns newer versions write to tables created by an older one
+ALTER TABLE public.changesets ADD COLUMN IF NOT EXISTS regions text[];
+ALTER TABLE public.validation ADD COLUMN IF NOT EXISTS regions text[];
+ALTER TABLE public.nodes ADD COLUMN IF NOT EXISTS quadkey int8;
+ALTER TABLE public.ways_poly ADD COLUMN IF NOT EXISTS quadkey int8;
+ALTER TABLE public.ways_line ADD COLUMN IF NOT EXISTS quadkey int8;
+ALTER TABLE public.relations ADD COLUMN IF NOT EXISTS quadkey int8;
+ALTER TABLE public.validation ADD COLUMN IF NOT EXISTS quadkey int8;
+
 CREATE UNIQUE INDEX nodes_id_idx ON public.nodes (osm_id DESC);
 CREATE UNIQUE INDEX ways_poly_id_idx ON public.ways_poly (osm_id DESC);
 CREATE UNIQUE INDEX ways_line_id_idx ON public.ways_line(osm_id DESC);
@@ -137,6 +153,14 @@ CREATE INDEX nodes_timestamp_idx ON public.nodes(timestamp DESC);
 CREATE INDEX ways_poly_timestamp_idx ON public.ways_poly(timestamp DESC);
 CREATE INDEX ways_line_timestamp_idx ON public.ways_line(timestamp DESC);
 
+CREATE INDEX IF NOT EXISTS nodes_quadkey_idx ON public.nodes (quadkey);
+CREATE INDEX IF NOT EXISTS ways_poly_quadkey_idx ON public.ways_poly (quadkey);
+CREATE INDEX IF NOT EXISTS ways_line_quadkey_idx ON public.ways_line (quadkey);
+CREATE INDEX IF NOT EXISTS relations_quadkey_idx ON public.relations (quadkey);
+CREATE INDEX IF NOT EXISTS validation_quadkey_idx ON public.validation (quadkey);
+
 CREATE INDEX idx_changesets_hashtags ON public.changesets USING gin(hashtags);
+CREATE INDEX IF NOT EXISTS idx_changesets_regions ON public.changesets USING gin(regions);
+CREATE INDEX IF NOT EXISTS idx_validation_regions ON public.validation USING gin(regions);
 CREATE INDEX idx_osm_id_status ON public.validation (osm_id)
 
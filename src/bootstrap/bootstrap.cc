@@ -43,8 +43,6 @@ using namespace queryraw;
 using namespace underpassconfig;
 using namespace logger;
 
-typedef boost::geometry::model::d2::point_xy<double> point_t;
-
 namespace bootstrap {
 
 Bootstrap::Bootstrap(void) {}
@@ -58,11 +56,24 @@ Bootstrap::allTasksQueries(std::shared_ptr<std::vector<BootstrapTask>> tasks) {
     return queries;
 }
 
+void
+Bootstrap::writeTasks(std::shared_ptr<std::vector<BootstrapTask>> tasks) {
+    if (!copy) {
+        db->query(allTasksQueries(tasks));
+        return;
+    }
+    std::vector<const CopyWriter *> writers;
+    for (auto it = tasks->begin(); it != tasks->end(); ++it) {
+        writers.push_back(&it->copy);
+    }
+    CopyWriter::flush(*db, writers);
+}
+
 void
 Bootstrap::start(const underpassconfig::UnderpassConfig &config) {
     std::cout << "Connecting to the database ... " << std::endl;
     db = std::make_shared<Pq>();
-    if (!db->connect(config.underpass_db_url)) {
+    if (!db->connect(config.underpass_db_url, config.dbPoolSize())) {
         std::cout << "Could not connect to Underpass DB, aborting bootstrapping thread!" << std::endl;
         return;
     }
@@ -90,6 +101,25 @@ Bootstrap::start(const underpassconfig::UnderpassConfig &config) {
     page_size = config.bootstrap_page_size;
     concurrency = config.concurrency;
     norefs = config.norefs;
+    copy = config.copy;
+
+    // Seed the node index, so replication doesn't have to query the
+    // nodes table to build way geometries
+    if (!config.node_index.empty()) {
+        nodeindex = std::make_shared<NodeIndex>();
+        if (!nodeindex->open(config.node_index, config.node_index_sparse ? NodeIndex::sparse : NodeIndex::dense)) {
+            nodeindex.reset();
+        } else if (!config.node_index_pbf.empty()) {
+            std::cout << "Importing node locations from " << config.node_index_pbf << " ... " << std::endl;
+            nodeindex_seeded = nodeindex->importFile(config.node_index_pbf);
+        }
+    }
+
+    // Every building gets checked against the ones around it
+    if (config.building_index) {
+        std::cout << "Loading buildings ... " << std::endl;
+        validator->buildings = queryraw->loadBuildings(100000);
+    }
 
     processWays();
     processNodes();
@@ -144,7 +174,7 @@ Bootstrap::processWays() {
 
             pool.join();
 
-            db->query(allTasksQueries(tasks));
+            writeTasks(tasks);
             lastid = ways->back().id;
             for (auto it = tasks->begin(); it != tasks->end(); ++it) {
                 count += it->processed;
@@ -177,6 +207,12 @@ Bootstrap::processNodes() {
 
         auto nodes = std::make_shared<std::vector<OsmNode>>();
         nodes = queryraw->getNodesFromDB(lastid, concurrency * page_size);
+        // Without an OSM file to import, the index is filled from the database
+        if (nodeindex && !nodeindex_seeded) {
+            for (auto it = nodes->begin(); it != nodes->end(); ++it) {
+                nodeindex->load(it->id, it->point, it->version);
+            }
+        }
 
         auto tasks = std::make_shared<std::vector<BootstrapTask>>(concurrentTasks);
         boost::asio::thread_pool pool(concurrentTasks);
@@ -193,7 +229,7 @@ Bootstrap::processNodes() {
 
         pool.join();
 
-        db->query(allTasksQueries(tasks));
+        writeTasks(tasks);
         lastid = nodes->back().id;
         for (auto it = tasks->begin(); it != tasks->end(); ++it) {
             count += it->processed;
@@ -202,6 +238,10 @@ Bootstrap::processNodes() {
     percentage = (count * 100) / total;
     std::cout << "\r" << "Processing nodes: " << count << "/" << total << " (" << percentage << "%)";
     std::cout << std::endl;
+    if (nodeindex) {
+        nodeindex->seal();
+        nodeindex->sync();
+    }
 
 }
 
@@ -241,7 +281,7 @@ Bootstrap::processRelations() {
 
         pool.join();
 
-        db->query(allTasksQueries(tasks));
+        writeTasks(tasks);
         lastid = relations->back().id;
         for (auto it = tasks->begin(); it != tasks->end(); ++it) {
             count += it->processed;
@@ -284,7 +324,11 @@ Bootstrap::threadBootstrapWayTask(WayTask wayTask)
             ++processed;
         }
     }
-    queryvalidate->ways(wayval, task.query);
+    queryvalidate->ways(wayval, task.query, copy ? &task.copy : nullptr);
+    if (copy) {
+        task.copy.statement(task.query);
+        task.query.clear();
+    }
     task.processed = processed;
     const std::lock_guard<std::mutex> lock(tasks_change_mutex);
     (*tasks)[taskIndex] = task;
@@ -320,7 +364,11 @@ Bootstrap::threadBootstrapNodeTask(NodeTask nodeTask)
             ++processed;
         }
     }
-    queryvalidate->nodes(nodeval, task.query);
+    queryvalidate->nodes(nodeval, task.query, copy ? &task.copy : nullptr);
+    if (copy) {
+        task.copy.statement(task.query);
+        task.query.clear();
+    }
     task.processed = processed;
     const std::lock_guard<std::mutex> lock(tasks_change_mutex);
     (*tasks)[taskIndex] = task;
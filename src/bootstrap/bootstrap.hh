@@ -34,6 +34,7 @@ namespace bootstrap {
 /// \brief Represents a bootstrap task
 struct BootstrapTask {
     std::string query = "";
+    pq::CopyWriter copy;       ///< The staged rows, when writing with COPY
     int processed = 0;
 };
 
@@ -73,12 +74,17 @@ class Bootstrap {
     void threadBootstrapNodeTask(NodeTask nodeTask);
     void threadBootstrapRelationTask(RelationTask relationTask);
     std::string allTasksQueries(std::shared_ptr<std::vector<BootstrapTask>> tasks);
+    /// Write the results of all the tasks in order
+    void writeTasks(std::shared_ptr<std::vector<BootstrapTask>> tasks);
     
     std::shared_ptr<Validate> validator;
     std::shared_ptr<QueryValidate> queryvalidate;
     std::shared_ptr<QueryRaw> queryraw;
     std::shared_ptr<Pq> db;
+    std::shared_ptr<NodeIndex> nodeindex;  ///< Node locations for replication, may be null
+    bool nodeindex_seeded = false;         ///< The node index was filled from an OSM file
     bool norefs;
+    bool copy = false;                     ///< Write the results with COPY through staging tables
     unsigned int concurrency;
     unsigned int page_size;
 };
@@ -0,0 +1,176 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <string>
+#include <vector>
+
+#include "data/copywriter.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace pq
+namespace pq {
+
+void
+CopyWriter::stage(const std::string &table, const std::string &columns,
+                  const std::vector<std::string> &merge)
+{
+    if (tables.count(table)) {
+        return;
+    }
+    order.push_back(table);
+    tables[table] = {columns, merge, {}};
+}
+
+void
+CopyWriter::add(const std::string &table, const row_t &row)
+{
+    auto &staging = tables.at(table);
+    std::string line;
+    for (const auto &value: row) {
+        if (value) {
+            line += escape(*value);
+        } else {
+            line += "\\N";
+        }
+        line += '\t';
+    }
+    // The sequence number keeps the last row for an object
+    line += std::to_string(staging.lines.size());
+    staging.lines.push_back(std::move(line));
+    rows++;
+}
+
+void
+CopyWriter::statement(const std::string &query)
+{
+    statements += query;
+}
+
+void
+CopyWriter::clear(void)
+{
+    for (auto &table: tables) {
+        table.second.lines.clear();
+    }
+    statements.clear();
+    rows = 0;
+}
+
+void
+CopyWriter::flush(Pq &db, const std::vector<const CopyWriter *> &writers)
+{
+    bool empty = true;
+    for (const auto writer: writers) {
+        empty &= writer->empty();
+    }
+    if (empty) {
+        return;
+    }
+    auto conn = db.checkout();
+    pqxx::work worker(*conn);
+    for (const auto writer: writers) {
+        writer->apply(worker);
+    }
+    worker.commit();
+}
+
+void
+CopyWriter::apply(pqxx::transaction_base &worker) const
+{
+    for (const auto &table: order) {
+        const auto &staging = tables.at(table);
+        if (staging.lines.empty()) {
+            continue;
+        }
+        // Temporary tables belong to the connection, so they're only
+        // created the first time a pooled connection sees them
+        worker.exec("CREATE TEMP TABLE IF NOT EXISTS " + table + " (" + staging.columns + ", seq int8)");
+        {
+            pqxx::stream_to stream(worker, table);
+            for (const auto &line: staging.lines) {
+                stream.write_raw_line(line);
+            }
+            stream.complete();
+        }
+        for (const auto &merge: staging.merge) {
+            worker.exec(merge);
+        }
+        worker.exec("TRUNCATE " + table);
+    }
+    if (!statements.empty()) {
+        worker.exec(statements);
+    }
+}
+
+std::string
+CopyWriter::latest(const std::string &table, const std::string &key)
+{
+    return "(SELECT DISTINCT ON (" + key + ") * FROM " + table + " ORDER BY " + key + ", seq DESC) AS s";
+}
+
+std::string
+CopyWriter::escape(const std::string &value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (auto c: value) {
+        switch (c) {
+        case '\\': escaped += "\\\\"; break;
+        case '\t': escaped += "\\t"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string
+CopyWriter::array(const std::vector<std::string> &values)
+{
+    std::string result = "{";
+    for (const auto &value: values) {
+        result += '"';
+        for (auto c: value) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+            }
+            result += c;
+        }
+        result += "\",";
+    }
+    if (result.size() > 1) {
+        result.pop_back();
+    }
+    return result + "}";
+}
+
+} // namespace pq
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __COPYWRITER_HH__
+#define __COPYWRITER_HH__
+
+/// \file copywriter.hh
+/// \brief Bulk upserts with COPY through staging tables
+///
+/// Writing each object as its own INSERT ... ON CONFLICT makes the
+/// database parse and plan one statement per row. When catching up,
+/// the rows can instead be streamed with COPY into temporary staging
+/// tables, and then merged into the real tables with one set based
+/// statement per table. Each row gets a sequence number, so when an
+/// object is in a staging table more than once the merge can keep the
+/// last one, like the statements would have done.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "data/pq.hh"
+
+/// \namespace pq
+namespace pq {
+
+/// \class CopyWriter
+/// \brief Collect rows for staging tables, and merge them in one go
+///
+/// The producers declare their staging tables with the statements
+/// that merge them into the real tables, then add rows in the COPY
+/// text format. Statements that can't be staged, like deletes keyed on
+/// something else, are run after the merges. Several writers can be
+/// flushed in a single transaction, in order, which keeps the order of
+/// the replication files they come from.
+class CopyWriter {
+  public:
+    CopyWriter(void) {};
+
+    /// The values of a row, std::nullopt is written as NULL
+    typedef std::vector<std::optional<std::string>> row_t;
+
+    /// Declare a staging table with its columns, and the statements that
+    /// merge it. Only the first call for a table does anything.
+    void stage(const std::string &table, const std::string &columns,
+               const std::vector<std::string> &merge);
+    /// Add a row to a staging table, in the order of its columns
+    void add(const std::string &table, const row_t &row);
+    /// Add statements run after the staged rows are merged
+    void statement(const std::string &query);
+
+    /// True if there is nothing to write
+    bool empty(void) const { return rows == 0 && statements.empty(); };
+    /// The number of staged rows
+    size_t size(void) const { return rows; };
+    /// Drop all the rows and statements
+    void clear(void);
+
+    /// Write several writers in order, in a single transaction
+    static void flush(Pq &db, const std::vector<const CopyWriter *> &writers);
+    /// Write the rows and statements of this writer
+    void flush(Pq &db) const { flush(db, {this}); };
+
+    /// The last row for each key of a staging table, aliased as s
+    static std::string latest(const std::string &table, const std::string &key);
+    /// Escape a value for the COPY text format
+    static std::string escape(const std::string &value);
+    /// Format values as a PostgreSQL array
+    static std::string array(const std::vector<std::string> &values);
+
+  private:
+    /// Copy and merge the staged rows, then run the statements
+    void apply(pqxx::transaction_base &worker) const;
+
+    struct Staging {
+        std::string columns;             ///< The column definitions
+        std::vector<std::string> merge;  ///< The statements that merge the rows
+        std::vector<std::string> lines;  ///< The rows in the COPY text format
+    };
+    std::vector<std::string> order;          ///< The staging tables in the order they were declared
+    std::map<std::string, Staging> tables;   ///< The staging tables by name
+    std::string statements;                  ///< Run after the merges
+    size_t rows = 0;                         ///< The number of staged rows
+};
+
+} // namespace pq
+
+#endif // EOF __COPYWRITER_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
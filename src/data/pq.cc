@@ -25,6 +25,7 @@
 #include "data/pq.hh"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -52,7 +53,17 @@ Pq::dump(void)
 bool
 Pq::isOpen() const
 {
-    return static_cast<bool>(sdb) && sdb->is_open();
+    std::scoped_lock lock{pool_mutex};
+    // Connections that are checked out were open when they were
+    if (opened > idle.size()) {
+        return true;
+    }
+    for (auto it = std::begin(idle); it != std::end(idle); ++it) {
+        if (it->first->is_open()) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool
@@ -121,21 +132,30 @@ Pq::parseURL(const std::string &dburl)
 
 
 bool
-Pq::connect(const std::string &dburl)
+Pq::connect(const std::string &dburl, size_t size)
 {
-    std::string args;
-
-    if (parseURL(dburl)) {
-        args = host + " " + port + " " + dbname + " " + user + " " + passwd;
-    } else {
+    if (!parseURL(dburl)) {
         return false;
     }
 
+    std::scoped_lock lock{pool_mutex};
+    args = host + " " + port + " " + dbname + " " + user + " " + passwd;
+    poolsize = std::max<size_t>(size, 1);
+    idle.clear();
+    prepared.clear();
+    opened = 0;
+
     // log_debug(args);
     try {
-        sdb = std::make_unique<pqxx::connection>(args);
-        if (sdb->is_open()) {
+        auto conn = open();
+        if (conn->is_open()) {
             log_debug("Opened database connection to %1%", args);
+            idle.emplace_back(conn, std::chrono::steady_clock::now());
+            opened = 1;
+            // Escaping uses the connection's encoding, so it gets its
+            // own that is never checked out
+            std::scoped_lock escape{escape_mutex};
+            sdb = open();
             return true;
         } else {
             return false;
@@ -147,14 +167,133 @@ Pq::connect(const std::string &dburl)
     }
 }
 
+std::shared_ptr<pqxx::connection>
+Pq::open(void) const
+{
+    return std::make_shared<pqxx::connection>(args);
+}
+
+Pq::Connection
+Pq::checkout(void)
+{
+    std::unique_lock lock{pool_mutex};
+    if (opened == 0 && args.empty()) {
+        throw pqxx::broken_connection("Not connected to a database");
+    }
+    pool_ready.wait(lock, [this] { return !idle.empty() || opened < poolsize; });
+
+    std::shared_ptr<pqxx::connection> conn;
+    bool check = false;
+    if (!idle.empty()) {
+        conn = idle.back().first;
+        check = std::chrono::steady_clock::now() - idle.back().second > healthcheck;
+        idle.pop_back();
+    } else {
+        opened++;
+    }
+    lock.unlock();
+
+    // A connection that has been idle for a while may have been dropped
+    // by the server or by a firewall, and is_open() only notices that
+    // after a query failed
+    if (conn && check && conn->is_open()) {
+        try {
+            pqxx::nontransaction ping(*conn);
+            ping.exec("SELECT 1");
+        } catch (const std::exception &e) {
+            log_debug("Idle database connection failed the health check: %1%", e.what());
+            forget(conn);
+        }
+    } else if (conn && !conn->is_open()) {
+        forget(conn);
+    }
+
+    if (!conn) {
+        try {
+            conn = open();
+        } catch (const std::exception &e) {
+            log_error("Couldn't open database connection to %1% %2%", args, e.what());
+            release(nullptr, false);
+            throw;
+        }
+    }
+    return Connection(*this, conn);
+}
+
+void
+Pq::release(std::shared_ptr<pqxx::connection> conn, bool healthy)
+{
+    {
+        std::scoped_lock lock{pool_mutex};
+        if (conn && healthy && conn->is_open()) {
+            idle.emplace_back(conn, std::chrono::steady_clock::now());
+        } else {
+            if (conn) {
+                prepared.erase(conn.get());
+            }
+            opened--;
+        }
+    }
+    pool_ready.notify_one();
+}
+
+void
+Pq::forget(std::shared_ptr<pqxx::connection> &conn)
+{
+    {
+        std::scoped_lock lock{pool_mutex};
+        prepared.erase(conn.get());
+    }
+    conn.reset();
+}
+
+void
+Pq::prepare(pqxx::connection &conn, const std::string &name,
+            const std::string &sql)
+{
+    // libpqxx 7 prepares on the server right away, and fails if the
+    // connection already has a statement with that name
+    {
+        std::scoped_lock lock{pool_mutex};
+        if (!prepared[&conn].insert(name).second) {
+            return;
+        }
+    }
+    try {
+        conn.prepare(name, sql);
+    } catch (...) {
+        std::scoped_lock lock{pool_mutex};
+        prepared[&conn].erase(name);
+        throw;
+    }
+}
+
+size_t
+Pq::idleConnections(void)
+{
+    std::scoped_lock lock{pool_mutex};
+    return idle.size();
+}
+
 pqxx::result
 Pq::query(const std::string &query)
 {
-    std::scoped_lock write_lock{pqxx_mutex};
-    pqxx::work worker(*sdb);
-    auto result = worker.exec(query);
-    worker.commit();
-    return result;
+    // If the server dropped the connection, try once more with a new one
+    for (int attempt = 0;; attempt++) {
+        auto conn = checkout();
+        try {
+            pqxx::work worker(*conn);
+            auto result = worker.exec(query);
+            worker.commit();
+            return result;
+        } catch (const pqxx::broken_connection &e) {
+            conn.discard();
+            if (attempt > 0) {
+                throw;
+            }
+            log_error("Lost the database connection, reconnecting: %1%", e.what());
+        }
+    }
 }
 
 std::string
@@ -174,6 +313,7 @@ Pq::escapedString(const std::string &s)
         }
         i++;
     }
+    std::scoped_lock lock{escape_mutex};
     return sdb->esc(newstr);
 }
 
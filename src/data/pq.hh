@@ -32,9 +32,14 @@
 #include "unconfig.h"
 #endif
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <map>
 #include <pqxx/pqxx>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 #include <mutex>
 
@@ -43,16 +48,66 @@ namespace pq {
 
 /// \class Pq
 /// \brief This is a higher level class wrapped around libpqxx
+///
+/// A Pq is shared by all the threads of a monitor, so it keeps a small
+/// pool of connections instead of a single one. Each query checks out
+/// a connection, and gives it back when done, so queries from different
+/// threads run in parallel up to the size of the pool. Connections are
+/// only opened when all the others are busy, connections that were idle
+/// for a while are checked before being used again, and broken ones are
+/// replaced.
 class Pq {
   public:
     Pq();
 
+    /// \class Connection
+    /// \brief A connection checked out of the pool
+    ///
+    /// The connection goes back to the pool when this is destroyed,
+    /// unless it was discarded or it broke while in use.
+    class Connection {
+      public:
+        Connection(Pq &pq, std::shared_ptr<pqxx::connection> conn)
+            : pool(&pq), conn(std::move(conn)) {};
+        Connection(Connection &&other)
+            : pool(other.pool), conn(std::move(other.conn)), broken(other.broken) {};
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+        ~Connection() {
+            if (conn) {
+                pool->release(conn, !broken);
+            }
+        };
+
+        pqxx::connection &operator*() const { return *conn; };
+        pqxx::connection *operator->() const { return conn.get(); };
+        /// Close this connection instead of returning it to the pool
+        void discard(void) { broken = true; };
+        /// Prepare a statement, unless this connection already has it
+        void prepare(const std::string &name, const std::string &sql) {
+            pool->prepare(*conn, name, sql);
+        };
+
+      private:
+        Pq *pool;
+        std::shared_ptr<pqxx::connection> conn;
+        bool broken = false;
+    };
+
     /// Connect to the Pq database
     Pq(const std::string &dbname);
-    bool connect(const std::string &args);
+    /// Connect to the database, keeping up to poolsize connections open
+    bool connect(const std::string &args, size_t poolsize = 1);
+
+    /// Check out a connection, waiting if they are all in use
+    Connection checkout(void);
+    /// The most connections this keeps open
+    size_t poolSize(void) const { return poolsize; };
+    /// The connections that are open but not in use
+    size_t idleConnections(void);
 
     /// \brief isOpen, checks if the DB is open.
-    /// \return TRUE if the DB is open.
+    /// \return TRUE if any connection in the pool is open.
     bool isOpen() const;
 
     /// Run query into the database
@@ -69,7 +124,7 @@ class Pq {
     // Escape JSON
     std::string escapedJSON(const std::string &s);
 
-    // Database connection
+    // Database connection for escaping strings, never in the pool
     std::shared_ptr<pqxx::connection> sdb;
 
     //protected:
@@ -79,8 +134,31 @@ class Pq {
     std::string user;  ///< The database user
     std::string passwd;  ///< The database password
     std::string dbname;  ///< The database name
-    std::mutex pqxx_mutex;
 
+    /// Idle connections are checked before being used again after this
+    static constexpr std::chrono::seconds healthcheck{30};
+
+  private:
+    /// Open a new connection with the parsed URL
+    std::shared_ptr<pqxx::connection> open(void) const;
+    /// Return a connection to the pool, or close it if it's unhealthy
+    void release(std::shared_ptr<pqxx::connection> conn, bool healthy);
+    /// Prepare a statement on a connection the first time it's used there
+    void prepare(pqxx::connection &conn, const std::string &name,
+                 const std::string &sql);
+    /// Close a connection, and drop what was prepared on it
+    void forget(std::shared_ptr<pqxx::connection> &conn);
+
+    typedef std::pair<std::shared_ptr<pqxx::connection>, std::chrono::steady_clock::time_point> idle_t;
+    std::string args;            ///< The connection string
+    size_t poolsize = 0;         ///< The most connections to keep open
+    size_t opened = 0;           ///< The connections open, idle or in use
+    std::vector<idle_t> idle;    ///< The open connections not in use
+    /// The statements already prepared on each open connection
+    std::map<const pqxx::connection *, std::set<std::string>> prepared;
+    mutable std::mutex pool_mutex;
+    std::condition_variable pool_ready;
+    std::mutex escape_mutex;     ///< Held while using sdb
 };
 
 } // namespace pq
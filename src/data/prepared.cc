@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "data/prepared.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace pq
+namespace pq {
+
+void
+PreparedBatch::prepare(const std::string &name, const std::string &sql,
+                       const std::vector<int> &binary)
+{
+    if (statements.count(name)) {
+        return;
+    }
+    Statement statement{sql, {}};
+    for (auto number: binary) {
+        if (statement.binary.size() < size_t(number)) {
+            statement.binary.resize(number, false);
+        }
+        statement.binary[number - 1] = true;
+    }
+    statements[name] = statement;
+}
+
+void
+PreparedBatch::add(const std::string &name, const params_t &params)
+{
+    if (!statements.count(name)) {
+        log_error("Prepared statement %1% wasn't declared", name);
+        return;
+    }
+    entries.push_back({name, params});
+}
+
+void
+PreparedBatch::statement(const std::string &query)
+{
+    if (query.empty()) {
+        return;
+    }
+    entries.push_back({"", {query}});
+}
+
+void
+PreparedBatch::clear(void)
+{
+    entries.clear();
+}
+
+void
+PreparedBatch::flush(Pq &db, const std::vector<const PreparedBatch *> &batches)
+{
+    bool empty = true;
+    for (const auto batch: batches) {
+        empty &= batch->empty();
+    }
+    if (empty) {
+        return;
+    }
+    auto conn = db.checkout();
+    // Prepare before the transaction starts, a statement prepared
+    // inside a transaction that fails stays prepared anyway
+    for (const auto batch: batches) {
+        batch->define(conn);
+    }
+    pqxx::work worker(*conn);
+    for (const auto batch: batches) {
+        batch->apply(worker);
+    }
+    worker.commit();
+}
+
+void
+PreparedBatch::define(Pq::Connection &conn) const
+{
+    // Prepared statements belong to the connection, which remembers
+    // the ones it already has
+    for (const auto &statement: statements) {
+        conn.prepare(statement.first, statement.second.sql);
+    }
+}
+
+void
+PreparedBatch::apply(pqxx::transaction_base &worker) const
+{
+    for (const auto &entry: entries) {
+        if (entry.name.empty()) {
+            worker.exec(*entry.params.front());
+            continue;
+        }
+        const auto &binary = statements.at(entry.name).binary;
+        pqxx::params params;
+        params.reserve(entry.params.size());
+        for (size_t i = 0; i < entry.params.size(); i++) {
+            const auto &value = entry.params[i];
+            if (!value) {
+                params.append();
+            } else if (i < binary.size() && binary[i]) {
+                params.append(pqxx::bytes_view(
+                    reinterpret_cast<const std::byte *>(value->data()), value->size()));
+            } else {
+                params.append(*value);
+            }
+        }
+        worker.exec_prepared(entry.name, params);
+    }
+}
+
+std::string
+PreparedBatch::jsonb(const std::string &json)
+{
+    // The binary format of jsonb is a version number and the text
+    return "\x01" + json;
+}
+
+} // namespace pq
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __PREPARED_HH__
+#define __PREPARED_HH__
+
+/// \file prepared.hh
+/// \brief Write objects with server side prepared statements
+///
+/// Building each upsert as SQL text means escaping every value by
+/// hand, and the database parsing and planning every statement again.
+/// A prepared statement is parsed and planned once per connection,
+/// the values are sent separately so they never need escaping, and
+/// geometries and tags can be sent in the binary format of their type.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "data/pq.hh"
+
+/// \namespace pq
+namespace pq {
+
+/// \class PreparedBatch
+/// \brief Collect executions of prepared statements, and run them in order
+///
+/// The producers declare their statements once, then add the values
+/// for each execution. Plain SQL can be added between them, and runs
+/// in the same order. Several batches can be flushed in a single
+/// transaction, in order, which keeps the order of the replication
+/// files they come from.
+class PreparedBatch {
+  public:
+    PreparedBatch(void) {};
+
+    /// The values of the parameters, std::nullopt is sent as NULL
+    typedef std::vector<std::optional<std::string>> params_t;
+
+    /// Declare a prepared statement. The binary parameters are the
+    /// numbers of the parameters sent in the binary format of their
+    /// type, like 3 for $3. Only the first call for a name does anything.
+    void prepare(const std::string &name, const std::string &sql,
+                 const std::vector<int> &binary = {});
+    /// Add an execution of a prepared statement
+    void add(const std::string &name, const params_t &params);
+    /// Add plain SQL, run in order with the prepared statements
+    void statement(const std::string &query);
+
+    /// True if there is nothing to write
+    bool empty(void) const { return entries.empty(); };
+    /// The number of executions and statements
+    size_t size(void) const { return entries.size(); };
+    /// Drop all the executions and statements
+    void clear(void);
+
+    /// Write several batches in order, in a single transaction
+    static void flush(Pq &db, const std::vector<const PreparedBatch *> &batches);
+    /// Write the executions and statements of this batch
+    void flush(Pq &db) const { flush(db, {this}); };
+
+    /// Format a value as a JSONB binary parameter
+    static std::string jsonb(const std::string &json);
+
+  private:
+    /// Prepare the statements a connection doesn't have yet
+    void define(Pq::Connection &conn) const;
+    /// Run the executions and statements in a transaction
+    void apply(pqxx::transaction_base &worker) const;
+
+    struct Statement {
+        std::string sql;             ///< The SQL with $1 style parameters
+        std::vector<bool> binary;    ///< Which parameters are binary
+    };
+    struct Entry {
+        std::string name;            ///< The statement, empty for plain SQL
+        params_t params;             ///< The values, or the SQL text
+    };
+    std::map<std::string, Statement> statements; ///< The declared statements by name
+    std::vector<Entry> entries;                  ///< The executions in order
+};
+
+} // namespace pq
+
+#endif // EOF __PREPARED_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -63,12 +63,6 @@
 using namespace boost::posix_time;
 using namespace boost::gregorian;
 #include <boost/filesystem.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/device/array.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/tokenizer.hpp>
@@ -82,6 +76,7 @@ using namespace boost::gregorian;
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS 1
 
 #include "utils/log.hh"
+#include "utils/gzip.hh"
 using namespace logger;
 
 /// \namespace changesets
@@ -106,15 +101,9 @@ ChangeSetFile::readChanges(const std::string &file)
     log_debug("Reading changeset file %1% ", file);
     std::string suffix = boost::filesystem::extension(file);
     // It's a gzipped file, common for files downloaded from planet
-    std::ifstream ifile(file, std::ios_base::in | std::ios_base::binary);
     if (suffix == ".gz") { // it's a compressed file
-                           //    if (file[0] == 0x1f) {
-        change.open(file, std::ifstream::in | std::ifstream::binary);
         try {
-            boost::iostreams::filtering_streambuf<boost::iostreams::input>inbuf;
-            inbuf.push(boost::iostreams::gzip_decompressor());
-            inbuf.push(ifile);
-            std::istream instream(&inbuf);
+            std::istringstream instream(gzip::inflateFile(file));
             // log_debug(instream.rdbuf());
             readXML(instream);
         } catch (std::exception &e) {
@@ -130,42 +119,44 @@ ChangeSetFile::readChanges(const std::string &file)
 }
 
 void
-ChangeSetFile::areaFilter(const multipolygon_t &poly)
+ChangeSetFile::areaFilter(const geoutil::BoundaryIndex &poly)
 {
 #ifdef TIMING_DEBUG_X
     boost::timer::auto_cpu_timer timer("ChangeSetFile::areaFilter: took %w seconds\n");
 #endif
     // log_debug("Pre filtering changeset size is %1%", changes.size());
-    for (auto it = std::begin(changes); it != std::end(changes); it++) {
-        ChangeSet *change = it->get();
-        if (poly.empty()) {
-            // log_debug("Accepting changeset %1% as in priority area because area information is missing",
-            // change->id);
-            change->priority = true;
-            continue;
-        }
-        boost::geometry::append(change->bbox, point_t(change->max_lon, change->max_lat));
-        boost::geometry::append(change->bbox, point_t(change->max_lon, change->min_lat));
-        boost::geometry::append(change->bbox, point_t(change->min_lon, change->min_lat));
-        boost::geometry::append(change->bbox, point_t(change->min_lon, change->max_lat));
-        boost::geometry::append(change->bbox, point_t(change->max_lon, change->max_lat));
-        // point_t pt;
-        // boost::geometry::centroid(change->bbox, pt);
-        if (!boost::geometry::intersects(change->bbox, poly)) {
-            // log_debug("Validating changeset %1% is not in a priority area", change->id);
-
-            change->priority = false;
-
-            changes.erase(it--);
+    auto it = std::begin(changes);
+    while (it != std::end(changes)) {
+        if (inArea(*it->get(), poly)) {
+            ++it;
         } else {
-            // log_debug("Validating changeset %1% is in a priority area", change->id);
-            change->priority = true;
+            // log_debug("Validating changeset %1% is not in a priority area", change->id);
+            it = changes.erase(it);
         }
     }
     // log_debug("Post filtering changeset size is %1%",
     // changeset->changes.size());
 }
 
+bool
+ChangeSetFile::inArea(ChangeSet &change, const geoutil::BoundaryIndex &poly)
+{
+    if (poly.empty()) {
+        // log_debug("Accepting changeset %1% as in priority area because area information is missing",
+        // change.id);
+        change.priority = true;
+        return true;
+    }
+    boost::geometry::clear(change.bbox);
+    boost::geometry::append(change.bbox, point_t(change.max_lon, change.max_lat));
+    boost::geometry::append(change.bbox, point_t(change.max_lon, change.min_lat));
+    boost::geometry::append(change.bbox, point_t(change.min_lon, change.min_lat));
+    boost::geometry::append(change.bbox, point_t(change.min_lon, change.max_lat));
+    boost::geometry::append(change.bbox, point_t(change.max_lon, change.max_lat));
+    change.priority = poly.intersects(change.bbox);
+    return change.priority;
+}
+
 void
 ChangeSet::dump(void)
 {
@@ -341,6 +332,18 @@ void
 ChangeSetFile::on_end_element(const Glib::ustring &name)
 {
     // log_debug("Element \'%1%\' ending", name);
+    // When streaming, hand each changeset over as soon as all its
+    // tags are in, instead of keeping the whole file in memory.
+    if (name == "changeset" && consumer && changes.size() > 0) {
+        auto change = changes.back();
+        changes.pop_back();
+        if (boundary) {
+            inArea(*change, *boundary);
+        } else {
+            change->priority = true;
+        }
+        consumer(*change);
+    }
 }
 
 void
@@ -354,6 +357,9 @@ ChangeSetFile::on_start_element(const Glib::ustring &name,
         if (change->closed_at != not_a_date_time && (last_closed_at == not_a_date_time || change->closed_at > last_closed_at)) {
             last_closed_at = change->closed_at;
         }
+        if (change->created_at != not_a_date_time) {
+            last_created_at = change->created_at;
+        }
         // changes.back().dump();
     } else if (name == "tag") {
         // We ignore most of the attributes, as they're not used for OSM stats.
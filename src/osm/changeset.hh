@@ -36,6 +36,7 @@
 #endif
 
 #include <array>
+#include <functional>
 #include <iostream>
 #include <list>
 #include <map>
@@ -54,6 +55,7 @@ using namespace boost::gregorian;
 
 #include "osm/osmobjects.hh"
 #include "stats/querystats.hh"
+#include "utils/boundaryindex.hh"
 
 
 // Forward declaration
@@ -144,8 +146,25 @@ class ChangeSetFile
   public:
     ChangeSetFile(void){};
 
+    /// Called with each changeset as soon as it has been parsed
+    typedef std::function<void(ChangeSet &)> consumer_t;
+
     /// Delete features not in the boundary
-    void areaFilter(const multipolygon_t &poly);
+    void areaFilter(const geoutil::BoundaryIndex &poly);
+
+    /// Set the priority of a changeset from its bounding box
+    static bool inArea(ChangeSet &change, const geoutil::BoundaryIndex &poly);
+
+    /// Stream changesets to a consumer while parsing. Each changeset
+    /// gets its priority set, is passed to the consumer when its
+    /// element ends, and is then dropped, so the changes list never
+    /// holds more than the changeset being parsed.
+    void setConsumer(const geoutil::BoundaryIndex &poly, consumer_t func) {
+        boundary = &poly;
+        consumer = func;
+    };
+    /// The boundary is used until parsing ends, so it can't be a temporary
+    void setConsumer(const geoutil::BoundaryIndex &&poly, consumer_t func) = delete;
 
     /// Read a changeset file from disk or memory into internal storage
     bool readChanges(const std::string &file);
@@ -178,6 +197,11 @@ class ChangeSetFile
     bool parse_error = false;
 
     ptime last_closed_at = not_a_date_time;
+    ptime last_created_at = not_a_date_time; ///< Creation time of the last changeset parsed
+
+  private:
+    consumer_t consumer;                       ///< Where to send parsed changesets
+    const geoutil::BoundaryIndex *boundary = nullptr;  ///< The area used by the consumer
 };
 } // namespace changesets
 
@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __FIXEDPOINT_HH__
+#define __FIXEDPOINT_HH__
+
+/// \file fixedpoint.hh
+/// \brief A compact point type storing coordinates as fixed point
+///
+/// OSM coordinates only have 7 decimal places, so they fit exactly in
+/// a 32 bit integer in units of 1e-7 degrees. A FixedPoint is half the
+/// size of a point of doubles, which halves the memory used by the
+/// linestrings and polygons of a change file, and packs twice as many
+/// coordinates in each cache line. It's registered with
+/// boost::geometry, so the algorithms work on it directly, and the
+/// coordinates are converted to doubles as they're read.
+///
+/// This is used for point_t when configured with --enable-fixed-point.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/register/point.hpp>
+
+/// \namespace osmobjects
+namespace osmobjects {
+
+/// \class FixedPoint
+/// \brief A longitude and latitude in units of 1e-7 degrees
+///
+/// This has the same interface as boost's point_xy, so it can be used
+/// in its place.
+class FixedPoint {
+  public:
+    FixedPoint(void) {};
+    FixedPoint(double x, double y) : lon(encode(x)), lat(encode(y)) {};
+
+    static constexpr double scale = 1e7; ///< Units per degree
+
+    /// Convert degrees to fixed point. Values past 180 degrees either
+    /// way are clamped, which keeps them in range of the integer, and
+    /// NaN becomes 0.
+    static int32_t encode(double degrees) {
+        if (std::isnan(degrees)) {
+            return 0;
+        }
+        return static_cast<int32_t>(std::lround(std::clamp(degrees, -180.0, 180.0) * scale));
+    };
+    /// Convert fixed point to degrees. Dividing instead of multiplying
+    /// by 1e-7 returns exactly the double a 7 decimal string parses to.
+    static double decode(int32_t fixed) {
+        return fixed / scale;
+    };
+
+    template <std::size_t K> double get(void) const {
+        static_assert(K < 2, "FixedPoint only has 2 dimensions");
+        return decode(K == 0 ? lon : lat);
+    };
+    template <std::size_t K> void set(double value) {
+        static_assert(K < 2, "FixedPoint only has 2 dimensions");
+        (K == 0 ? lon : lat) = encode(value);
+    };
+
+    double x(void) const { return decode(lon); };
+    double y(void) const { return decode(lat); };
+    void x(double value) { lon = encode(value); };
+    void y(double value) { lat = encode(value); };
+
+    /// The raw fixed point coordinates
+    int32_t fixedX(void) const { return lon; };
+    int32_t fixedY(void) const { return lat; };
+
+  private:
+    int32_t lon = 0;
+    int32_t lat = 0;
+};
+
+} // namespace osmobjects
+
+BOOST_GEOMETRY_REGISTER_POINT_2D_GET_SET(osmobjects::FixedPoint, double, boost::geometry::cs::cartesian, x, y, x, y)
+
+#endif // EOF __FIXEDPOINT_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
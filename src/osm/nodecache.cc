@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+
+#include "osm/nodecache.hh"
+
+/// \namespace osmobjects
+namespace osmobjects {
+
+void
+NodeCache::reserve(size_t count)
+{
+    // Keep the load factor under 70%
+    size_t needed = std::max<size_t>(count * 10 / 7 + 1, min_slots);
+    if (needed > slots.size()) {
+        rehash(needed);
+    }
+}
+
+void
+NodeCache::clear(void)
+{
+    if (entries > 0) {
+        std::fill(std::begin(slots), std::end(slots), Slot{empty_id, 0, 0});
+        entries = 0;
+    }
+}
+
+void
+NodeCache::rehash(size_t count)
+{
+    size_t size = min_slots;
+    int bits = 10;
+    while (size < count) {
+        size <<= 1;
+        bits++;
+    }
+    std::vector<Slot> old(size, Slot{empty_id, 0, 0});
+    old.swap(slots);
+    shift = 64 - bits;
+    entries = 0;
+    for (auto it = std::begin(old); it != std::end(old); ++it) {
+        if (it->id != empty_id) {
+            Slot *slot = probe(it->id);
+            *slot = *it;
+            entries++;
+        }
+    }
+}
+
+} // namespace osmobjects
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __NODECACHE_HH__
+#define __NODECACHE_HH__
+
+/// \file nodecache.hh
+/// \brief A compact cache of node locations
+///
+/// Building way geometries needs the location of every node a way
+/// references, so node lookups are done once per ref. This is a flat
+/// open addressing hash table keyed by the node ID, with the location
+/// stored as fixed point integers in units of 1e-7 degrees, which is
+/// the precision OSM uses. Each entry is 16 bytes, and a lookup is a
+/// single probe sequence through one contiguous array.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "osm/fixedpoint.hh"
+
+/// \namespace osmobjects
+namespace osmobjects {
+
+/// \class NodeCache
+/// \brief Map node IDs to their location
+class NodeCache {
+  public:
+    NodeCache(void) {};
+
+    /// Make room for at least this many nodes without growing
+    void reserve(size_t count);
+
+    /// Add a node location, replacing any existing one
+    void insert(int64_t id, const point_t &point) {
+        if ((entries + 1) * 10 > slots.size() * 7) {
+            rehash(std::max<size_t>(slots.size() * 2, min_slots));
+        }
+        Slot *slot = probe(id);
+        if (slot->id == empty_id) {
+            slot->id = id;
+            entries++;
+        }
+        slot->x = encode(point.get<0>());
+        slot->y = encode(point.get<1>());
+    };
+
+    /// Look up a node location, returns false if it's not cached
+    bool get(int64_t id, point_t &point) const {
+        const Slot *slot = find(id);
+        if (slot == nullptr) {
+            return false;
+        }
+        point = point_t(decode(slot->x), decode(slot->y));
+        return true;
+    };
+
+    /// Return 1 if the node is cached, 0 otherwise
+    size_t count(int64_t id) const { return find(id) != nullptr; };
+
+    /// The number of cached nodes
+    size_t size(void) const { return entries; };
+    bool empty(void) const { return entries == 0; };
+
+    /// Drop all the cached nodes, but keep the allocated space
+    void clear(void);
+
+    /// Call a function with the ID and location of every cached node
+    template <typename F> void forEach(F func) const {
+        for (auto it = std::begin(slots); it != std::end(slots); ++it) {
+            if (it->id != empty_id) {
+                func(it->id, point_t(decode(it->x), decode(it->y)));
+            }
+        }
+    };
+
+    /// Convert degrees to fixed point
+    static int32_t encode(double degrees) {
+        return FixedPoint::encode(degrees);
+    };
+    /// Convert fixed point to degrees
+    static double decode(int32_t fixed) {
+        return FixedPoint::decode(fixed);
+    };
+
+  private:
+    struct Slot {
+        int64_t id;
+        int32_t x;
+        int32_t y;
+    };
+
+    static constexpr int64_t empty_id = INT64_MIN;  ///< Not a valid node ID
+    static constexpr size_t min_slots = 1024;
+
+    size_t index(int64_t id) const {
+        // Fibonacci hashing, node IDs are mostly sequential so they need
+        // to be spread out before masking
+        return (static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> shift;
+    };
+
+    /// Return the slot holding this ID, or the empty slot it would go in
+    Slot *probe(int64_t id) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = index(id);; i = (i + 1) & mask) {
+            if (slots[i].id == id || slots[i].id == empty_id) {
+                return &slots[i];
+            }
+        }
+    };
+
+    const Slot *find(int64_t id) const {
+        if (entries == 0) {
+            return nullptr;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = index(id);; i = (i + 1) & mask) {
+            if (slots[i].id == id) {
+                return &slots[i];
+            }
+            if (slots[i].id == empty_id) {
+                return nullptr;
+            }
+        }
+    };
+
+    void rehash(size_t count);
+
+    std::vector<Slot> slots;  ///< The table, always a power of 2 in size
+    size_t entries = 0;       ///< The number of used slots
+    int shift = 64;           ///< 64 - log2(slots.size())
+};
+
+} // namespace osmobjects
+
+#endif // EOF __NODECACHE_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
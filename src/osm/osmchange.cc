@@ -31,6 +31,7 @@
 #include <pqxx/pqxx>
 #include <list>
 #include <locale>
+#include <sstream>
 
 #ifdef LIBXML
 #include <libxml++/libxml++.h>
@@ -46,8 +47,6 @@ using namespace boost::gregorian;
 #include <boost/filesystem.hpp>
 #include <ogrsf_frmts.h>
 #include <boost/units/systems/si/length.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
 #include <boost/timer/timer.hpp>
 // #include <boost/multi_index_container.hpp>
 // #include <boost/multi_index/member.hpp>
@@ -67,6 +66,7 @@ using namespace osmobjects;
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS 1
 
 #include "utils/log.hh"
+#include "utils/gzip.hh"
 using namespace logger;
 
 namespace osmchange {
@@ -96,15 +96,9 @@ OsmChangeFile::readChanges(const std::string &file)
     log_debug("Reading OsmChange file %1%", file);
     std::string suffix = boost::filesystem::extension(file);
     // It's a gzipped file, common for files downloaded from planet
-    std::ifstream ifile(file, std::ios_base::in | std::ios_base::binary);
     if (suffix == ".gz") { // it's a compressed file
-        change.open(file, std::ifstream::in | std::ifstream::binary);
         try {
-            boost::iostreams::filtering_streambuf<boost::iostreams::input>
-                inbuf;
-            inbuf.push(boost::iostreams::gzip_decompressor());
-            inbuf.push(ifile);
-            std::istream instream(&inbuf);
+            std::istringstream instream(gzip::inflateFile(file));
             // log_debug(instream.rdbuf());
             readXML(instream);
         } catch (std::exception &e) {
@@ -133,13 +127,7 @@ OsmChangeFile::buildGeometriesFromNodeCache() {
     for (auto it = std::begin(changes); it != std::end(changes); ++it) {
         osmchange::OsmChange *change = it->get();
         for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
-            osmobjects::OsmWay *way = wit->get();
-            for (auto lit = std::begin(way->refs); lit != std::end(way->refs); ++lit) {
-                boost::geometry::append(way->linestring, nodecache[*lit]);
-            }
-            if (way->isClosed()) {
-                way->polygon = { {std::begin(way->linestring), std::end(way->linestring)} };
-            }
+            wit->get()->buildGeometry(nodecache);
         }
     }
 }
@@ -292,7 +280,7 @@ OsmChangeFile::on_start_element(const Glib::ustring &name,
     } else if (name == "tag") {
         // A tag element has only has 1 attribute, and numbers are stored as
         // strings
-        change->obj->tags[attributes[0].value] = attributes[1].value;
+        change->obj->tags.append(attributes[0].value, attributes[1].value);
         return;
     } else if (name == "way") {
         change->obj.reset();
@@ -378,11 +366,22 @@ OsmChangeFile::on_start_element(const Glib::ustring &name,
         } else if (attr_pair.name == "lat") {
             auto lat = reinterpret_cast<OsmNode *>(change->obj.get());
             lat->setLatitude(std::stod(attr_pair.value));
-            nodecache[lat->id] = lat->point;
+            nodecache.insert(lat->id, lat->point);
         } else if (attr_pair.name == "lon") {
             auto lon = reinterpret_cast<OsmNode *>(change->obj.get());
             lon->setLongitude(std::stod(attr_pair.value));
-            nodecache[lon->id] = lon->point;
+            nodecache.insert(lon->id, lon->point);
+        }
+    }
+
+    // The node is still the current object, so any tags that follow
+    // go to it, but it's no longer part of the change.
+    if (name == "node" && boundary != nullptr && !boundary->empty()) {
+        OsmNode *node = change->nodes.back().get();
+        node->priority = boundary->within(node->point);
+        if (!node->priority) {
+            change->dropped.push_back({node->id, node->version, node->point, node->action});
+            change->nodes.pop_back();
         }
     }
 }
@@ -445,49 +444,70 @@ OsmChangeFile::dump(void)
     }
 #if 0
     std::cerr << "\tDumping nodecache:" << std::endl;
-    for (auto it = std::begin(nodecache); it != std::end(nodecache); ++it) {
-        std::cerr << "\t\t: " << it->first << ": " << boost::geometry::wkt(it->second) << std::endl;
-    }
+    nodecache.forEach([](int64_t id, const point_t &point) {
+        std::cerr << "\t\t: " << id << ": " << boost::geometry::wkt(point) << std::endl;
+    });
 #endif
 }
 
 
 void
-OsmChangeFile::areaFilter(const multipolygon_t &poly)
+OsmChangeFile::areaFilter(const geoutil::BoundaryIndex &poly)
 {
 #ifdef TIMING_DEBUG_X
     boost::timer::auto_cpu_timer timer("OsmChangeFile::areaFilter: took %w seconds\n");
 #endif
-    std::map<long, bool> priority;
+    // Test all the nodes in one batch
+    std::vector<point_t> points;
+    if (!poly.empty()) {
+        for (auto it = std::begin(changes); it != std::end(changes); it++) {
+            for (auto nit = std::begin(it->get()->nodes); nit != std::end(it->get()->nodes); ++nit) {
+                points.push_back(nit->get()->point);
+            }
+        }
+    }
+    std::vector<bool> inside = poly.within(points);
+    size_t next = 0;
     for (auto it = std::begin(changes); it != std::end(changes); it++) {
-
         OsmChange *change = it->get();
-
-        // Filter nodes
         for (auto nit = std::begin(change->nodes); nit != std::end(change->nodes); ++nit) {
             OsmNode *node = nit->get();
-            if (poly.empty() || boost::geometry::within(node->point, poly)) {
-                node->priority = true;
-                nodecache[node->id] = node->point;
-            } if (!boost::geometry::within(node->point, poly)) {
-                node->priority = false;
+            node->priority = poly.empty() || inside[next++];
+            if (node->priority) {
+                nodecache.insert(node->id, node->point);
             }
         }
+    }
 
-        // Filter ways
-        for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
+    // Then the nodes of all the ways, a way is in the area if any of
+    // its nodes are
+    points.clear();
+    std::vector<size_t> ends;
+    for (auto it = std::begin(changes); it != std::end(changes); it++) {
+        for (auto wit = std::begin(it->get()->ways); wit != std::end(it->get()->ways); ++wit) {
             OsmWay *way = wit->get();
-            if (poly.empty()) {
-                way->priority = true;
-            } else {
-                way->priority = false;
-                for (auto rit = std::begin(way->refs); rit != std::end(way->refs); ++rit) {
-                    if (nodecache.count(*rit) && boost::geometry::within(nodecache[*rit], poly)) {
-                        way->priority = true;
-                        continue;
-                    }
+            point_t point;
+            for (auto rit = std::begin(way->refs); !poly.empty() && rit != std::end(way->refs); ++rit) {
+                if (nodecache.get(*rit, point)) {
+                    points.push_back(point);
                 }
             }
+            ends.push_back(points.size());
+        }
+    }
+    inside = poly.within(points);
+    next = 0;
+    size_t start = 0;
+    for (auto it = std::begin(changes); it != std::end(changes); it++) {
+        OsmChange *change = it->get();
+
+        // Filter ways
+        for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
+            OsmWay *way = wit->get();
+            size_t end = ends[next++];
+            way->priority = poly.empty() ||
+                std::find(inside.begin() + start, inside.begin() + end, true) != inside.begin() + end;
+            start = end;
         }
 
         // Filter relations
@@ -542,6 +562,7 @@ OsmChangeFile::collectStats(const multipolygon_t &poly)
                 ostats->closed_at = node->timestamp;
                 (*mstats)[node->changeset] = ostats;
             }
+            addRegions(*ostats, node->point);
             auto hits = scanTags(node->tags, osmchange::node);
             for (auto hit = std::begin(*hits); hit != std::end(*hits); ++hit) {
                 if (node->action == osmobjects::create) {
@@ -581,6 +602,12 @@ OsmChangeFile::collectStats(const multipolygon_t &poly)
                 (*mstats)[way->changeset] = ostats;
             }
 
+            if (regions && !regions->empty()) {
+                point_t point;
+                if (location(*way, point)) {
+                    addRegions(*ostats, point);
+                }
+            }
             auto hits = scanTags(way->tags, osmchange::way);
             for (auto hit = std::begin(*hits); hit != std::end(*hits); ++hit) {
 
@@ -592,15 +619,11 @@ OsmChangeFile::collectStats(const multipolygon_t &poly)
 
                 // Calculate length
                 if ( (*hit == "highway" || *hit == "waterway") && way->action == osmobjects::create) {
-                    // Get the geometry behind each reference
-                    boost::geometry::model::linestring<sphere_t> globe;
-                    for (auto lit = std::begin(way->refs); lit != std::end(way->refs); ++lit) {
-                        double x = nodecache[*lit].get<0>();
-                        double y = nodecache[*lit].get<1>();
-                        if (x != 0 && y != 0) {
-                            globe.push_back(sphere_t(x,y));
-                            boost::geometry::append(way->linestring, nodecache[*lit]);
-                        }
+                    // The linestring is usually built already by the raw
+                    // data, so only build it when it's still empty. The
+                    // length is cached by the way, so it's only computed once.
+                    if (way->linestring().empty()) {
+                        way->buildGeometry(nodecache);
                     }
                     std::string tag;
                     if (*hit == "highway") {
@@ -609,10 +632,8 @@ OsmChangeFile::collectStats(const multipolygon_t &poly)
                     if (*hit == "waterway") {
                         tag = "waterway_km";
                     }
-                    double length = boost::geometry::length(globe,
-                            boost::geometry::strategy::distance::haversine<float>(6371.0));
                     // log_debug("LENGTH: %1% %2%", std::to_string(length), way->changeset);
-                    ostats->added[tag] += length;
+                    ostats->added[tag] += way->length();
                 }
             }
         }
@@ -649,6 +670,30 @@ OsmChangeFile::collectStats(const multipolygon_t &poly)
     return mstats;
 }
 
+void
+OsmChangeFile::addRegions(ChangeStats &stats, const point_t &point) const
+{
+    if (regions == nullptr || regions->empty()) {
+        return;
+    }
+    auto found = regions->find(point);
+    for (auto it = std::begin(found); it != std::end(found); ++it) {
+        stats.regions.insert(regions->name(*it));
+    }
+}
+
+bool
+OsmChangeFile::location(const osmobjects::OsmWay &way, point_t &point) const
+{
+    // The centroid is cached by the way, and the validation uses it too
+    if (!way.linestring().empty()) {
+        point = way.centroid();
+        return true;
+    }
+    // Without the raw data the geometry may not be built
+    return !way.refs.empty() && nodecache.get(way.refs.front(), point);
+}
+
 std::shared_ptr<std::vector<std::string>>
 OsmChangeFile::scanTags(std::map<std::string, std::string> tags, osmchange::osmtype_t type)
 {
@@ -680,6 +725,9 @@ ChangeStats::dump(void)
     std::cerr << "Dumping ChangeStats for: \t " << changeset << std::endl;
     std::cerr << "\tUser ID: \t\t " << uid << std::endl;
     std::cerr << "\tUser Name: \t\t " << username << std::endl;
+    for (auto it = std::begin(regions); it != std::end(regions); ++it) {
+        std::cerr << "\tRegion: \t\t " << *it << std::endl;
+    }
     std::cerr << "\tAdded features: " << added.size() << std::endl;
     for (auto it = std::begin(added); it != std::end(added); ++it) {
         std::cerr << "\t\t" << it->first << " = " << it->second << std::endl;
@@ -714,6 +762,9 @@ OsmChangeFile::validateNodes(const multipolygon_t &poly, std::shared_ptr<Validat
             for (auto test_it = std::begin(node_tests); test_it != std::end(node_tests); ++test_it) {
                 if (node->containsKey(*test_it)) {
                     auto status = plugin->checkNode(*node, *test_it);
+                    if (regions && !regions->empty()) {
+                        status->regions = regions->names(node->point);
+                    }
                     totals->push_back(status);
                 }
             }
@@ -728,6 +779,20 @@ OsmChangeFile::validateWays(const multipolygon_t &poly, std::shared_ptr<Validate
 #ifdef TIMING_DEBUG_X
     boost::timer::auto_cpu_timer timer("OsmChangeFile::validateWays: took %w seconds\n");
 #endif
+    // Update the buildings first, so the ones in this file are checked
+    // against each other too. Deleted ways have no geometry, so they
+    // may not be in the priority area.
+    if (plugin->buildings) {
+        for (auto it = std::begin(changes); it != std::end(changes); ++it) {
+            OsmChange *change = it->get();
+            for (auto nit = std::begin(change->ways); nit != std::end(change->ways); ++nit) {
+                OsmWay *way = nit->get();
+                if (way->priority || way->action == osmobjects::remove) {
+                    plugin->buildings->update(*way);
+                }
+            }
+        }
+    }
     auto totals = std::make_shared<std::vector<std::shared_ptr<ValidateStatus>>>();
     for (auto it = std::begin(changes); it != std::end(changes); ++it) {
         OsmChange *change = it->get();
@@ -737,6 +802,12 @@ OsmChangeFile::validateWays(const multipolygon_t &poly, std::shared_ptr<Validate
                 continue;
             }
             auto status = plugin->checkWay(*way, "building");
+            if (regions && !regions->empty()) {
+                point_t point;
+                if (location(*way, point)) {
+                    status->regions = regions->names(point);
+                }
+            }
             totals->push_back(status);
         }
     }
@@ -38,6 +38,7 @@
 #include <memory>
 #include <iostream>
 #include <list>
+#include <set>
 
 //#include <pqxx/pqxx>
 #ifdef LIBXML
@@ -52,6 +53,9 @@ using namespace boost::gregorian;
 #include "validate/validate.hh"
 #include "osm/osmobjects.hh"
 #include "osm/osmchange.hh"
+#include "osm/nodecache.hh"
+#include "utils/boundaryindex.hh"
+#include "utils/regionindex.hh"
 #include <ogr_geometry.h>
 
 /// \namespace osmchange
@@ -76,6 +80,7 @@ class ChangeStats {
     std::map<std::string, int> added; ///< Array of added features
     std::map<std::string, int> modified; ///< Array of modified features
     std::map<std::string, int> deleted; ///< Array of deleted features
+    std::set<std::string> regions; ///< The named regions the changes are in
     /// Dump internal data to the terminal, only for debugging
     void dump(void);
 };
@@ -218,6 +223,17 @@ class OsmChange {
     std::list<std::shared_ptr<osmobjects::OsmWay>> ways; ///< The ways in this change
     std::list<std::shared_ptr<osmobjects::OsmRelation>> relations; ///< The relations in this change
     std::shared_ptr<osmobjects::OsmObject> obj;
+
+    /// A node dropped by the parse filter. It isn't written anywhere,
+    /// but the node locations shared between files still need to see
+    /// it move or get deleted.
+    struct DroppedNode {
+        long id;
+        int version;
+        point_t point;
+        osmobjects::action_t action;
+    };
+    std::vector<DroppedNode> dropped; ///< The nodes dropped by the parse filter
 };
 
 /// \class OsmChangeFile
@@ -243,7 +259,22 @@ class OsmChangeFile
     bool readChanges(const std::string &osc);
 
     /// Delete any data not in the boundary polygon
-    void areaFilter(const multipolygon_t &poly);
+    void areaFilter(const geoutil::BoundaryIndex &poly);
+
+    /// Test nodes against the boundary while parsing. Nodes outside of
+    /// it are dropped as soon as their position is known, and only their
+    /// coordinates are kept in the node cache for way geometries.
+    void setParseFilter(const geoutil::BoundaryIndex &poly) { boundary = &poly; };
+    /// The boundary is used until parsing ends, so it can't be a temporary
+    void setParseFilter(const geoutil::BoundaryIndex &&poly) = delete;
+    /// Keep all nodes while parsing
+    void clearParseFilter(void) { boundary = nullptr; };
+
+    /// Tag the statistics and validation results with the named regions
+    /// the objects are in
+    void setRegions(const geoutil::RegionIndex &index) { regions = &index; };
+    /// The regions are used after this returns, so they can't be a temporary
+    void setRegions(const geoutil::RegionIndex &&index) = delete;
 
     void buildGeometriesFromNodeCache();
 
@@ -260,7 +291,7 @@ class OsmChangeFile
 
     std::list<std::shared_ptr<OsmChange>> changes;      ///< All the changes in this file
 
-    std::map<double, point_t> nodecache;                ///< Cache nodes across multiple changesets
+    osmobjects::NodeCache nodecache;                    ///< Cache nodes across multiple changesets
     
     std::map<long, std::shared_ptr<osmobjects::OsmWay>> waycache; ///< Cache ways across multiple changesets
 
@@ -284,6 +315,14 @@ class OsmChangeFile
     /// dump internal data, for debugging only
     void dump(void);
 
+  private:
+    /// Add the named regions a location is in to the statistics
+    void addRegions(ChangeStats &stats, const point_t &point) const;
+    /// Find a location for a way to look up its regions
+    bool location(const osmobjects::OsmWay &way, point_t &point) const;
+
+    const geoutil::BoundaryIndex *boundary = nullptr; ///< Filter nodes while parsing
+    const geoutil::RegionIndex *regions = nullptr;    ///< Named regions for the results
 };
 
 } // namespace osmchange
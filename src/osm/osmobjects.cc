@@ -37,6 +37,8 @@ using namespace boost::gregorian;
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS 1
 
 #include "osm/osmobjects.hh"
+#include "osm/nodecache.hh"
+#include "utils/haversine.hh"
 
 #include "utils/log.hh"
 using namespace logger;
@@ -98,7 +100,7 @@ OsmWay::dump(void) const
         tmp.pop_back();
         std::cerr << "\t" << tmp << std::endl;
     }
-    std::cerr << boost::geometry::wkt(linestring) << std::endl;
+    std::cerr << boost::geometry::wkt(line) << std::endl;
     std::cerr << boost::geometry::wkt(polygon) << std::endl;
     if (tags.size() > 0) {
         std::cerr << "\tTags: " << tags.size() << std::endl;
@@ -115,6 +117,100 @@ OsmWay::dump(void) const
     }
 };
 
+bool
+OsmWay::buildGeometry(const NodeCache &cache)
+{
+    line.clear();
+    polygon.clear();
+    metrics.computed.store(0, std::memory_order_release);
+    point_t point;
+    for (auto it = std::begin(refs); it != std::end(refs); ++it) {
+        if (cache.get(*it, point)) {
+            line.push_back(point);
+        }
+    }
+    if (isClosed()) {
+        polygon = { {std::begin(line), std::end(line)} };
+    }
+    return line.size() == refs.size();
+}
+
+void
+OsmWay::setLinestring(const linestring_t &points)
+{
+    line = points;
+    metrics.computed.store(0, std::memory_order_release);
+}
+
+const OsmWay::box_t &
+OsmWay::bbox(void) const
+{
+    compute(bbox_metric, [this] {
+        if (line.empty()) {
+            metrics.bounds = box_t(point_t(0, 0), point_t(0, 0));
+        } else {
+            boost::geometry::envelope(line, metrics.bounds);
+        }
+    });
+    return metrics.bounds;
+}
+
+const point_t &
+OsmWay::centroid(void) const
+{
+    compute(centroid_metric, [this] {
+        if (line.empty()) {
+            metrics.middle = point_t(0, 0);
+        } else {
+            boost::geometry::centroid(line, metrics.middle);
+        }
+    });
+    return metrics.middle;
+}
+
+double
+OsmWay::length(void) const
+{
+    compute(length_metric, [this] {
+        metrics.distance = geoutil::haversine::length(line);
+    });
+    return metrics.distance;
+}
+
+double
+OsmWay::area(void) const
+{
+    compute(area_metric, [this] {
+        metrics.surface = 0.0;
+        if (closedRing()) {
+            typedef boost::geometry::model::polygon<sphere_t> spherical_t;
+            spherical_t shape;
+            for (auto it = std::begin(line); it != std::end(line); ++it) {
+                shape.outer().push_back(sphere_t(it->get<0>(), it->get<1>()));
+            }
+            boost::geometry::strategy::area::spherical<double> strategy(geoutil::haversine::earth_radius);
+            // The winding of the ring isn't known, so the sign isn't either
+            metrics.surface = std::abs(boost::geometry::area(shape, strategy));
+        }
+    });
+    return metrics.surface;
+}
+
+bool
+OsmWay::ring(void) const
+{
+    compute(ring_metric, [this] {
+        metrics.closed = closedRing();
+    });
+    return metrics.closed;
+}
+
+bool
+OsmWay::closedRing(void) const
+{
+    return line.size() > 3 && boost::geometry::equals(line.front(), line.back());
+}
+
 void
 OsmRelation::dump() const
 {
@@ -25,8 +25,16 @@
 #include "unconfig.h"
 #endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <map>
 #include <iostream>
 #include <boost/geometry.hpp>
 #include <boost/date_time.hpp>
@@ -38,7 +46,12 @@ using namespace boost::gregorian;
 #include "utils/log.hh"
 using namespace logger;
 
+#ifdef FIXED_POINT
+#include "osm/fixedpoint.hh"
+typedef osmobjects::FixedPoint point_t;
+#else
 typedef boost::geometry::model::d2::point_xy<double> point_t;
+#endif
 typedef boost::geometry::model::polygon<point_t> polygon_t;
 typedef boost::geometry::model::multi_polygon<polygon_t> multipolygon_t;
 typedef boost::geometry::model::linestring<point_t> linestring_t;
@@ -62,13 +75,168 @@ namespace osmobjects {
 typedef enum { none, create, modify, remove } action_t; // delete is a reserved word
 typedef enum { empty, node, way, relation, member } osmtype_t;
 
+/// Decoding tags and computing the metrics of a way are rare and
+/// short, so all the objects share a few locks instead of each having one
+inline std::mutex &
+objectLock(const void *object)
+{
+    static std::array<std::mutex, 64> locks;
+    return locks[(reinterpret_cast<uintptr_t>(object) / alignof(std::max_align_t)) % locks.size()];
+}
+
+/// \class Tags
+/// \brief The metadata tags of an OSM object, decoded on first use
+///
+/// While parsing, keys and values are appended to one packed buffer,
+/// which is a single allocation per object instead of several per
+/// tag. The std::map is only built the first time the tags are looked
+/// at, so objects that get dropped by the area filter never pay for
+/// it. Otherwise this behaves like the std::map it wraps, so several
+/// threads can read the same Tags at once, but not while one of them
+/// changes it.
+class Tags {
+  public:
+    typedef std::map<std::string, std::string> map_t;
+    typedef map_t::iterator iterator;
+    typedef map_t::const_iterator const_iterator;
+
+    Tags(void) {};
+    Tags(const Tags &other) { copy(other); };
+    Tags &operator=(const Tags &other) {
+        if (this != &other) {
+            copy(other);
+        }
+        return *this;
+    };
+    Tags(Tags &&other) : tags(std::move(other.tags)), packed(std::move(other.packed)),
+                         pending(other.pending.exchange(false)) {};
+    Tags &operator=(Tags &&other) {
+        tags = std::move(other.tags);
+        packed = std::move(other.packed);
+        pending.store(other.pending.exchange(false), std::memory_order_release);
+        return *this;
+    };
+
+    /// Add a tag without decoding it. A later value for the same
+    /// key replaces an earlier one, like assigning to the map does.
+    void append(const std::string &key, const std::string &value) {
+        packed.append(key);
+        packed.push_back('\0');
+        packed.append(value);
+        packed.push_back('\0');
+        pending.store(true, std::memory_order_release);
+    };
+
+    /// Call a function once with each key and its value. Tags that
+    /// were only appended, each key once, are visited in the order
+    /// they were added without decoding them, otherwise they are
+    /// decoded and visited in the order of their keys.
+    template <typename F> void visit(F func) const {
+        if (pending.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(objectLock(this));
+            if (pending.load(std::memory_order_relaxed) && tags.empty() && distinct()) {
+                unpack(func);
+                return;
+            }
+        }
+        const map_t &all = decode();
+        for (auto it = std::begin(all); it != std::end(all); ++it) {
+            func(it->first, it->second);
+        }
+    };
+
+    bool empty(void) const { return !pending.load(std::memory_order_acquire) && tags.empty(); };
+    size_t size(void) const { return decode().size(); };
+    size_t count(const std::string &key) const { return decode().count(key); };
+    std::string &operator[](const std::string &key) { return decode()[key]; };
+    std::string &at(const std::string &key) { return decode().at(key); };
+    const std::string &at(const std::string &key) const { return decode().at(key); };
+    iterator find(const std::string &key) { return decode().find(key); };
+    const_iterator find(const std::string &key) const { return decode().find(key); };
+    iterator begin(void) { return decode().begin(); };
+    iterator end(void) { return decode().end(); };
+    const_iterator begin(void) const { return decode().begin(); };
+    const_iterator end(void) const { return decode().end(); };
+    void clear(void) {
+        tags.clear();
+        packed.clear();
+        pending.store(false, std::memory_order_release);
+    };
+
+    operator const map_t &(void) const { return decode(); };
+    bool operator==(const Tags &other) const { return decode() == other.decode(); };
+    bool operator!=(const Tags &other) const { return decode() != other.decode(); };
+
+  private:
+    /// Build the map from the packed tags. The first reader to get
+    /// here decodes them while holding a lock, so the const methods
+    /// can be called from several threads.
+    map_t &decode(void) const {
+        if (pending.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(objectLock(this));
+            if (pending.load(std::memory_order_relaxed)) {
+                unpack([this](const std::string &key, const std::string &value) {
+                    tags[key] = value;
+                });
+                std::string().swap(packed);
+                pending.store(false, std::memory_order_release);
+            }
+        }
+        return tags;
+    };
+
+    template <typename F> void unpack(F func) const {
+        std::string key, value;
+        size_t pos = 0;
+        while (pos < packed.size()) {
+            size_t end = packed.find('\0', pos);
+            key.assign(packed, pos, end - pos);
+            pos = end + 1;
+            end = packed.find('\0', pos);
+            value.assign(packed, pos, end - pos);
+            pos = end + 1;
+            func(key, value);
+        }
+    };
+
+    /// True if no key was appended more than once
+    bool distinct(void) const {
+        std::vector<std::string_view> keys;
+        size_t pos = 0;
+        while (pos < packed.size()) {
+            size_t end = packed.find('\0', pos);
+            keys.emplace_back(packed.data() + pos, end - pos);
+            pos = packed.find('\0', end + 1) + 1;
+        }
+        std::sort(keys.begin(), keys.end());
+        return std::adjacent_find(keys.begin(), keys.end()) == keys.end();
+    };
+
+    void copy(const Tags &other) {
+        if (other.pending.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(objectLock(&other));
+            tags = other.tags;
+            packed = other.packed;
+            pending.store(other.pending.load(std::memory_order_relaxed), std::memory_order_release);
+        } else {
+            tags = other.tags;
+            packed.clear();
+            pending.store(false, std::memory_order_release);
+        }
+    };
+
+    mutable map_t tags;          ///< The decoded tags
+    mutable std::string packed;  ///< Tags not decoded yet, as key\0value\0 pairs
+    mutable std::atomic<bool> pending{false};  ///< Whether packed has any tags
+};
+
 /// \class OsmObject
 /// \brief This is the base class for the common data fields used by all OSM objects
 class OsmObject {
   public:
     /// Add a metadata tag to an OSM object
     void addTag(const std::string &key, const std::string &value) {
-        tags[key] = value;
+        tags.append(key, value);
     };
 
     void setAction(action_t act) { action = act; };
@@ -83,7 +251,7 @@ class OsmObject {
     long uid = 0;                            ///< The User ID of the mapper of this object
     std::string user;                        ///< The User name  of the mapper of this object
     long changeset = 0;                      ///< The changeset ID this object is contained in
-    std::map<std::string, std::string> tags; ///< OSM metadata tags
+    Tags tags;                               ///< OSM metadata tags
 
     bool priority = false; ///< Whether it's in the priority area
     /// Dump internal data to the terminal, only for debugging
@@ -144,11 +312,21 @@ class OsmNode : public OsmObject {
     int z_order = 0;
 };
 
+class NodeCache;
+
 /// \class OsmWay
 /// \brief This represents an OSM way.
 ///
 /// A way has multiple nodes, and should always have standard OSM tags
 /// or it's bad data.
+///
+/// The statistics, the validation and the raw data all want a few
+/// values derived from the geometry, like the length or the centroid.
+/// These are computed the first time they're asked for, and then kept
+/// with the way until the geometry changes, so each one is only
+/// computed once per way no matter how many consumers there are. The
+/// linestring can only be changed through the methods that also forget
+/// the derived values, and several threads can ask for them at once.
 class OsmWay : public OsmObject {
   public:
     OsmWay(long wid) { id = wid; };
@@ -158,8 +336,9 @@ class OsmWay : public OsmObject {
         refs.clear();
     };
 
+    typedef boost::geometry::model::box<point_t> box_t;
+
     std::vector<long> refs;  ///< Store all the nodes by reference ID
-    linestring_t linestring; ///< Store the node as a linestring
     polygon_t polygon;       ///< Store the nodes as a polygon
     point_t center;          ///< Store the centroid of the way
 
@@ -168,21 +347,74 @@ class OsmWay : public OsmObject {
 
     /// Polygons are closed objects, like a building, while a highway
     /// is a linestring
-    bool isClosed(void)
+    bool isClosed(void) const
     {
         return (refs.size() > 3 && refs.front() == refs.back());
     };
     /// Return the number of nodes in this way
-    int numPoints(void) { return boost::geometry::num_points(linestring); };
+    int numPoints(void) const { return boost::geometry::num_points(line); };
 
     /// Calculate the length of the linestring in Kilometers
-    double getLength(void)
-    {
-        return boost::geometry::length(linestring, boost::geometry::strategy::distance::haversine<float>(6371.0));
-    };
+    double getLength(void) const { return length(); };
+
+    /// Replace the linestring, and the polygon for closed ways, with the
+    /// node locations in the cache. Returns false if any of the nodes
+    /// couldn't be found, in which case the geometry is incomplete.
+    bool buildGeometry(const NodeCache &cache);
+    /// The nodes as a linestring
+    const linestring_t &linestring(void) const { return line; };
+    /// Replace the linestring, which forgets the derived values
+    void setLinestring(const linestring_t &points);
+
+    /// The bounding box of the linestring
+    const box_t &bbox(void) const;
+    /// The centroid of the linestring
+    const point_t &centroid(void) const;
+    /// The great circle length of the linestring in Kilometers
+    double length(void) const;
+    /// The area of the polygon in square Kilometers, 0 if it's not a ring
+    double area(void) const;
+    /// Whether the linestring is a closed ring of at least 4 points
+    bool ring(void) const;
 
     /// Dump internal data to the terminal, only for debugging
     void dump(void) const;
+
+  private:
+    enum { bbox_metric = 1, centroid_metric = 2, length_metric = 4, area_metric = 8, ring_metric = 16 };
+
+    /// The derived values. A copy starts with none of them, so copying
+    /// a way never reads them while another thread fills them in.
+    struct Metrics {
+        Metrics(void) {};
+        Metrics(const Metrics &) {};
+        Metrics &operator=(const Metrics &) {
+            computed.store(0, std::memory_order_release);
+            return *this;
+        };
+        std::atomic<unsigned char> computed{0}; ///< Which of the values are current
+        box_t bounds;                           ///< The bounding box
+        point_t middle;                         ///< The centroid
+        double distance = 0.0;                  ///< The length
+        double surface = 0.0;                   ///< The area
+        bool closed = false;                    ///< The ring flag
+    };
+
+    /// Fill in a derived value the first time it's asked for
+    template <typename F> void compute(unsigned char metric, F func) const {
+        if (!(metrics.computed.load(std::memory_order_acquire) & metric)) {
+            std::lock_guard<std::mutex> guard(objectLock(this));
+            if (!(metrics.computed.load(std::memory_order_relaxed) & metric)) {
+                func();
+                metrics.computed.fetch_or(metric, std::memory_order_release);
+            }
+        }
+    };
+    /// Whether the linestring is a closed ring, without the cache
+    bool closedRing(void) const;
+
+    linestring_t line;          ///< Store the node as a linestring
+    mutable Metrics metrics;    ///< The derived values, filled on first use
 };
 
 /// class OsmRelationMember
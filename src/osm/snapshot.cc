@@ -0,0 +1,485 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <zlib.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/timer/timer.hpp>
+
+#include "osm/snapshot.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace snapshot
+namespace snapshot {
+
+// Times are stored as microseconds since the epoch, with a reserved
+// value for not_a_date_time
+static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+static const int64_t notime = std::numeric_limits<int64_t>::min();
+
+// Way refs are copied as a block
+static_assert(sizeof(long) == sizeof(int64_t), "node refs must be 64 bits");
+
+template <typename T>
+void
+Snapshot::put(const T &val)
+{
+    payload.append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+void
+Snapshot::putString(const std::string &str)
+{
+    put<uint32_t>(str.size());
+    payload.append(str);
+}
+
+void
+Snapshot::putTime(const ptime &time)
+{
+    if (time.is_special()) {
+        put<int64_t>(notime);
+    } else {
+        put<int64_t>((time - epoch).total_microseconds());
+    }
+}
+
+void
+Snapshot::putObject(const osmobjects::OsmObject &obj)
+{
+    put<int64_t>(obj.id);
+    put<int32_t>(obj.version);
+    putTime(obj.timestamp);
+    put<int64_t>(obj.uid);
+    putString(obj.user);
+    put<int64_t>(obj.changeset);
+    put<uint8_t>(obj.action);
+    // Tags are written as they are, so undecoded ones stay that way
+    uint32_t count = 0;
+    obj.tags.visit([&count](const std::string &key, const std::string &value) {
+        count++;
+    });
+    put<uint32_t>(count);
+    obj.tags.visit([this](const std::string &key, const std::string &value) {
+        putString(key);
+        putString(value);
+    });
+}
+
+template <typename T>
+bool
+Snapshot::get(T &val)
+{
+    if (offset + sizeof(T) > payload.size()) {
+        return false;
+    }
+    std::memcpy(&val, payload.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+bool
+Snapshot::getString(std::string &str)
+{
+    uint32_t len;
+    if (!get(len) || offset + len > payload.size()) {
+        return false;
+    }
+    str.assign(payload.data() + offset, len);
+    offset += len;
+    return true;
+}
+
+bool
+Snapshot::getTime(ptime &time)
+{
+    int64_t usecs;
+    if (!get(usecs)) {
+        return false;
+    }
+    if (usecs == notime) {
+        time = not_a_date_time;
+    } else {
+        time = epoch + boost::posix_time::microseconds(usecs);
+    }
+    return true;
+}
+
+bool
+Snapshot::getObject(osmobjects::OsmObject &obj)
+{
+    int64_t id, uid, changeset;
+    int32_t version;
+    uint8_t action;
+    uint32_t count;
+    if (!get(id) || !get(version) || !getTime(obj.timestamp) || !get(uid)
+        || !getString(obj.user) || !get(changeset) || !get(action) || !get(count)) {
+        return false;
+    }
+    obj.id = id;
+    obj.version = version;
+    obj.uid = uid;
+    obj.changeset = changeset;
+    obj.action = static_cast<osmobjects::action_t>(action);
+    std::string key, value;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!getString(key) || !getString(value)) {
+            return false;
+        }
+        obj.tags.append(key, value);
+    }
+    return true;
+}
+
+bool
+Snapshot::setKind(snapshot_t val)
+{
+    if (kind != empty_snapshot && kind != val) {
+        log_error("Can't mix different types of data in a snapshot!");
+        return false;
+    }
+    kind = val;
+    return true;
+}
+
+void
+Snapshot::clear(void)
+{
+    kind = empty_snapshot;
+    payload.clear();
+    offset = 0;
+}
+
+void
+Snapshot::add(const osmchange::OsmChangeFile &osmchanges)
+{
+#ifdef TIMING_DEBUG_X
+    boost::timer::auto_cpu_timer timer("Snapshot::add(OsmChangeFile): took %w seconds\n");
+#endif
+    if (!setKind(osmchange_snapshot)) {
+        return;
+    }
+    put<uint32_t>(osmchanges.changes.size());
+    for (auto it = std::begin(osmchanges.changes); it != std::end(osmchanges.changes); ++it) {
+        osmchange::OsmChange *change = it->get();
+        put<uint8_t>(change->action);
+        putTime(change->final_entry);
+
+        put<uint32_t>(change->nodes.size());
+        for (auto nit = std::begin(change->nodes); nit != std::end(change->nodes); ++nit) {
+            osmobjects::OsmNode *node = nit->get();
+            putObject(*node);
+            put<double>(node->point.get<0>());
+            put<double>(node->point.get<1>());
+        }
+
+        put<uint32_t>(change->ways.size());
+        for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
+            osmobjects::OsmWay *way = wit->get();
+            putObject(*way);
+            put<uint32_t>(way->refs.size());
+            payload.append(reinterpret_cast<const char *>(way->refs.data()), way->refs.size() * sizeof(long));
+        }
+
+        put<uint32_t>(change->relations.size());
+        for (auto rit = std::begin(change->relations); rit != std::end(change->relations); ++rit) {
+            osmobjects::OsmRelation *relation = rit->get();
+            putObject(*relation);
+            put<uint32_t>(relation->members.size());
+            for (auto mit = std::begin(relation->members); mit != std::end(relation->members); ++mit) {
+                put<int64_t>(mit->ref);
+                put<uint8_t>(mit->type);
+                putString(mit->role);
+            }
+        }
+    }
+}
+
+void
+Snapshot::add(const changesets::ChangeSetFile &changesets)
+{
+    for (auto it = std::begin(changesets.changes); it != std::end(changesets.changes); ++it) {
+        add(*it->get());
+    }
+}
+
+// Changesets are stored as a plain sequence of records, so a
+// changeset file can be serialized while it's being parsed
+void
+Snapshot::add(const changesets::ChangeSet &change)
+{
+    if (!setKind(changeset_snapshot)) {
+        return;
+    }
+    put<int64_t>(change.id);
+    putTime(change.created_at);
+    putTime(change.closed_at);
+    put<uint8_t>(change.open);
+    putString(change.user);
+    put<int64_t>(change.uid);
+    put<double>(change.min_lat);
+    put<double>(change.min_lon);
+    put<double>(change.max_lat);
+    put<double>(change.max_lon);
+    put<int32_t>(change.num_changes);
+    put<int32_t>(change.comments_count);
+    put<uint32_t>(change.hashtags.size());
+    for (auto it = std::begin(change.hashtags); it != std::end(change.hashtags); ++it) {
+        putString(*it);
+    }
+    putString(change.comment);
+    putString(change.editor);
+    putString(change.source);
+}
+
+bool
+Snapshot::write(const std::string &filespec) const
+{
+#ifdef TIMING_DEBUG_X
+    boost::timer::auto_cpu_timer timer("Snapshot::write: took %w seconds\n");
+#endif
+    SnapshotHeader header;
+    std::memcpy(header.magic, "UPSN", sizeof(header.magic));
+    header.version = version;
+    header.kind = kind;
+    header.crc = crc32(0L, reinterpret_cast<const Bytef *>(payload.data()), payload.size());
+    header.reserved = 0;
+    header.size = payload.size();
+
+    // Write to a temporary file first, so another thread never sees
+    // a partially written snapshot
+    std::string tmpfile = filespec + ".tmp";
+    try {
+        boost::filesystem::path dir = boost::filesystem::path(filespec).parent_path();
+        if (!dir.empty() && !boost::filesystem::exists(dir)) {
+            boost::filesystem::create_directories(dir);
+        }
+        std::ofstream out(tmpfile, std::ofstream::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(payload.data(), payload.size());
+        out.close();
+        if (!out) {
+            log_error("Couldn't write snapshot %1%", filespec);
+            boost::filesystem::remove(tmpfile);
+            return false;
+        }
+        boost::filesystem::rename(tmpfile, filespec);
+    } catch (const std::exception &e) {
+        log_error("Couldn't write snapshot %1%: %2%", filespec, e.what());
+        return false;
+    }
+    log_debug("Wrote snapshot %1% (%2% bytes)", filespec, payload.size());
+    return true;
+}
+
+bool
+Snapshot::read(const std::string &filespec)
+{
+#ifdef TIMING_DEBUG_X
+    boost::timer::auto_cpu_timer timer("Snapshot::read: took %w seconds\n");
+#endif
+    clear();
+    std::ifstream in(filespec, std::ifstream::in | std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    SnapshotHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        log_error("Snapshot %1% is truncated!", filespec);
+        return false;
+    }
+    if (std::memcmp(header.magic, "UPSN", sizeof(header.magic)) != 0) {
+        log_error("%1% is not a snapshot!", filespec);
+        return false;
+    }
+    if (header.version != version) {
+        log_debug("Snapshot %1% has version %2%, expected %3%", filespec, header.version, version);
+        return false;
+    }
+    // Check the size against the file, so a corrupted header can't make
+    // the buffer huge
+    std::streampos start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(start);
+    if (start < 0 || end < start || header.size > static_cast<uint64_t>(end - start)) {
+        log_error("Snapshot %1% is truncated!", filespec);
+        return false;
+    }
+    payload.resize(header.size);
+    if (!in.read(&payload[0], header.size)) {
+        log_error("Snapshot %1% is truncated!", filespec);
+        payload.clear();
+        return false;
+    }
+    if (crc32(0L, reinterpret_cast<const Bytef *>(payload.data()), payload.size()) != header.crc) {
+        log_error("Snapshot %1% is corrupted!", filespec);
+        payload.clear();
+        return false;
+    }
+    kind = static_cast<snapshot_t>(header.kind);
+    return true;
+}
+
+bool
+Snapshot::restore(osmchange::OsmChangeFile &osmchanges)
+{
+#ifdef TIMING_DEBUG_X
+    boost::timer::auto_cpu_timer timer("Snapshot::restore(OsmChangeFile): took %w seconds\n");
+#endif
+    if (kind != osmchange_snapshot) {
+        return false;
+    }
+    offset = 0;
+    uint32_t nchanges;
+    if (!get(nchanges)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < nchanges; i++) {
+        uint8_t action;
+        if (!get(action)) {
+            return false;
+        }
+        auto change = std::make_shared<osmchange::OsmChange>(static_cast<osmobjects::action_t>(action));
+        if (!getTime(change->final_entry)) {
+            return false;
+        }
+        osmchanges.changes.push_back(change);
+
+        uint32_t count;
+        if (!get(count)) {
+            return false;
+        }
+        osmchanges.nodecache.reserve(osmchanges.nodecache.size() + count);
+        for (uint32_t j = 0; j < count; j++) {
+            auto node = change->newNode();
+            double x, y;
+            if (!getObject(*node) || !get(x) || !get(y)) {
+                return false;
+            }
+            node->point.set<0>(x);
+            node->point.set<1>(y);
+            osmchanges.nodecache.insert(node->id, node->point);
+        }
+
+        if (!get(count)) {
+            return false;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+            auto way = change->newWay();
+            uint32_t nrefs;
+            if (!getObject(*way) || !get(nrefs)) {
+                return false;
+            }
+            if (offset + nrefs * sizeof(int64_t) > payload.size()) {
+                return false;
+            }
+            way->refs.resize(nrefs);
+            std::memcpy(way->refs.data(), payload.data() + offset, nrefs * sizeof(int64_t));
+            offset += nrefs * sizeof(int64_t);
+        }
+
+        if (!get(count)) {
+            return false;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+            auto relation = change->newRelation();
+            uint32_t nmembers;
+            if (!getObject(*relation) || !get(nmembers)) {
+                return false;
+            }
+            for (uint32_t k = 0; k < nmembers; k++) {
+                int64_t ref;
+                uint8_t type;
+                std::string role;
+                if (!get(ref) || !get(type) || !getString(role)) {
+                    return false;
+                }
+                relation->addMember(ref, static_cast<osmobjects::osmtype_t>(type), role);
+            }
+        }
+    }
+    return offset == payload.size();
+}
+
+bool
+Snapshot::restore(changesets::ChangeSetFile &changesets)
+{
+#ifdef TIMING_DEBUG_X
+    boost::timer::auto_cpu_timer timer("Snapshot::restore(ChangeSetFile): took %w seconds\n");
+#endif
+    if (kind != changeset_snapshot) {
+        return false;
+    }
+    offset = 0;
+    while (offset < payload.size()) {
+        auto change = std::make_shared<changesets::ChangeSet>();
+        int64_t id, uid;
+        uint8_t open;
+        int32_t num_changes, comments_count;
+        uint32_t nhashtags;
+        if (!get(id) || !getTime(change->created_at) || !getTime(change->closed_at)
+            || !get(open) || !getString(change->user) || !get(uid)
+            || !get(change->min_lat) || !get(change->min_lon)
+            || !get(change->max_lat) || !get(change->max_lon)
+            || !get(num_changes) || !get(comments_count) || !get(nhashtags)) {
+            return false;
+        }
+        change->id = id;
+        change->uid = uid;
+        change->open = open;
+        change->num_changes = num_changes;
+        change->comments_count = comments_count;
+        std::string hashtag;
+        for (uint32_t i = 0; i < nhashtags; i++) {
+            if (!getString(hashtag)) {
+                return false;
+            }
+            change->addHashtags(hashtag);
+        }
+        if (!getString(change->comment) || !getString(change->editor) || !getString(change->source)) {
+            return false;
+        }
+        // Same as when parsing the XML
+        if (change->closed_at != not_a_date_time && (changesets.last_closed_at == not_a_date_time
+            || change->closed_at > changesets.last_closed_at)) {
+            changesets.last_closed_at = change->closed_at;
+        }
+        changesets.changes.push_back(change);
+    }
+    return true;
+}
+
+} // namespace snapshot
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __SNAPSHOT_HH__
+#define __SNAPSHOT_HH__
+
+/// \file snapshot.hh
+/// \brief Binary snapshots of parsed replication files
+///
+/// Replication files never change once published, so when a range is
+/// reprocessed there is no need to inflate and parse the XML again. A
+/// snapshot is a compact binary dump of a parsed OsmChangeFile or
+/// ChangeSetFile, stored next to the cached file under destdir_base.
+/// Each snapshot has a small header with a magic number, a format
+/// version and a CRC32 of the payload, so stale or damaged files are
+/// ignored and simply get rebuilt from the XML.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstdint>
+#include <string>
+
+#include "boost/date_time/posix_time/posix_time.hpp"
+using namespace boost::posix_time;
+
+#include "osm/osmobjects.hh"
+#include "osm/osmchange.hh"
+#include "osm/changeset.hh"
+
+/// \namespace snapshot
+namespace snapshot {
+
+/// The type of data stored in a snapshot
+typedef enum { empty_snapshot, osmchange_snapshot, changeset_snapshot } snapshot_t;
+
+/// \struct SnapshotHeader
+/// \brief The fixed size header at the start of every snapshot file
+struct SnapshotHeader {
+    char magic[4];         ///< Always "UPSN"
+    uint16_t version;      ///< The format version of the payload
+    uint16_t kind;         ///< The snapshot_t of the payload
+    uint32_t crc;          ///< CRC32 of the payload
+    uint32_t reserved;     ///< Unused, keeps the header 8 byte aligned
+    uint64_t size;         ///< Size of the payload in bytes
+};
+
+/// \class Snapshot
+/// \brief Serialize parsed replication files to and from disk
+///
+/// Data is appended to an in-memory payload, which is then written
+/// with a single call. Reading loads the whole file at once, checks
+/// the header and checksum, and then restores the objects with plain
+/// copies out of the buffer.
+class Snapshot {
+  public:
+    Snapshot(void) {};
+
+    static constexpr uint16_t version = 1; ///< Bump when the payload format changes
+
+    /// Return the snapshot filespec for a cached replication file
+    static std::string path(const std::string &filespec) {
+        return filespec + ".snap";
+    };
+
+    /// Serialize all the changes of a parsed OsmChange file
+    void add(const osmchange::OsmChangeFile &osmchanges);
+    /// Serialize all the changes of a parsed changeset file
+    void add(const changesets::ChangeSetFile &changesets);
+    /// Serialize a single changeset
+    void add(const changesets::ChangeSet &change);
+
+    /// Write the snapshot to disk
+    bool write(const std::string &filespec) const;
+    /// Read a snapshot from disk, verifying the header and checksum
+    bool read(const std::string &filespec);
+
+    /// Restore the parsed data of an OsmChange file
+    bool restore(osmchange::OsmChangeFile &osmchanges);
+    /// Restore the parsed data of a changeset file
+    bool restore(changesets::ChangeSetFile &changesets);
+
+    /// Drop all the serialized data
+    void clear(void);
+    /// The size of the serialized data in bytes
+    size_t size(void) const { return payload.size(); };
+    /// The type of data in this snapshot
+    snapshot_t getKind(void) const { return kind; };
+
+  private:
+    bool setKind(snapshot_t val);
+
+    template <typename T> void put(const T &val);
+    void putString(const std::string &str);
+    void putTime(const ptime &time);
+    void putObject(const osmobjects::OsmObject &obj);
+
+    template <typename T> bool get(T &val);
+    bool getString(std::string &str);
+    bool getTime(ptime &time);
+    bool getObject(osmobjects::OsmObject &obj);
+
+    snapshot_t kind = empty_snapshot;  ///< The type of data in the payload
+    std::string payload;      ///< The serialized data
+    size_t offset = 0;        ///< The read position in the payload
+};
+
+} // namespace snapshot
+
+#endif // EOF __SNAPSHOT_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
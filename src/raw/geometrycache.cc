@@ -0,0 +1,183 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <boost/geometry.hpp>
+
+#include "raw/geometrycache.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace queryraw
+namespace queryraw {
+
+size_t
+GeometryCache::weight(const Entry &entry)
+{
+    // An invalidated way still costs something, so tombstones age out
+    if (!entry.polygon) {
+        return 1;
+    }
+    return boost::geometry::num_points(*entry.polygon);
+}
+
+void
+GeometryCache::touch(lru_t::iterator entry)
+{
+    lru.splice(lru.begin(), lru, entry);
+}
+
+void
+GeometryCache::evict(void)
+{
+    while (used_points > max_points && !lru.empty()) {
+        Entry &last = lru.back();
+        used_points -= weight(last);
+        index.erase(last.id);
+        lru.pop_back();
+    }
+}
+
+void
+GeometryCache::store(int64_t id, const polygon_t &polygon, int version, bool replace)
+{
+    // A way bigger than the whole cache would evict everything else
+    if (boost::geometry::num_points(polygon) > max_points) {
+        if (replace) {
+            erase(id);
+        }
+        return;
+    }
+    // Copy the polygon before taking the lock
+    auto copy = std::make_shared<const polygon_t>(polygon);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(id);
+    if (found != index.end()) {
+        Entry &entry = *found->second;
+        if (replace && version >= entry.version) {
+            used_points -= weight(entry);
+            entry.polygon = copy;
+            entry.version = version;
+            used_points += weight(entry);
+            touch(found->second);
+            evict();
+        }
+        return;
+    }
+    lru.push_front(Entry{id, version, copy});
+    index[id] = lru.begin();
+    used_points += weight(lru.front());
+    evict();
+}
+
+void
+GeometryCache::insert(int64_t id, const polygon_t &polygon, int version)
+{
+    store(id, polygon, version, true);
+}
+
+void
+GeometryCache::insertIfAbsent(int64_t id, const polygon_t &polygon, int version)
+{
+    store(id, polygon, version, false);
+}
+
+void
+GeometryCache::erase(int64_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(id);
+    if (found != index.end()) {
+        used_points -= weight(*found->second);
+        found->second->polygon.reset();
+        used_points += 1;
+        touch(found->second);
+    } else {
+        lru.push_front(Entry{id, 0, nullptr});
+        index[id] = lru.begin();
+        used_points += 1;
+    }
+    evict();
+}
+
+bool
+GeometryCache::get(int64_t id, polygon_t &polygon)
+{
+    std::shared_ptr<const polygon_t> found_polygon;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(id);
+        if (found != index.end() && found->second->polygon) {
+            found_polygon = found->second->polygon;
+            touch(found->second);
+        }
+    }
+    if (!found_polygon) {
+        miss_count++;
+        return false;
+    }
+    polygon = *found_polygon;
+    hit_count++;
+    return true;
+}
+
+size_t
+GeometryCache::size(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.size();
+}
+
+size_t
+GeometryCache::points(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_points;
+}
+
+double
+GeometryCache::hitRate(void) const
+{
+    uint64_t hits = hit_count;
+    uint64_t total = hits + miss_count;
+    if (total == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(hits) / total;
+}
+
+void
+GeometryCache::logStats(void)
+{
+    log_debug("Way geometry cache: %1% ways, %2% of %3% points, %4%%% hit rate (%5% hits, %6% misses)",
+              size(), points(), capacity(), static_cast<int>(hitRate() * 100), hits(), misses());
+}
+
+} // namespace queryraw
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
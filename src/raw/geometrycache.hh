@@ -0,0 +1,122 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __GEOMETRYCACHE_HH__
+#define __GEOMETRYCACHE_HH__
+
+/// \file geometrycache.hh
+/// \brief Way geometries shared by all the replication threads
+///
+/// Building a relation geometry needs the polygon of every member
+/// way, and the ones that aren't in the change file are read from the
+/// ways_poly table and parsed from WKT. Large relations like coastlines
+/// and admin boundaries are touched by file after file, so this keeps
+/// the member way polygons for the life of the process. The size is
+/// bounded by the total number of points, as a few coastline ways can
+/// be bigger than thousands of buildings. The least recently used
+/// ways are evicted first.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace queryraw
+namespace queryraw {
+
+/// \class GeometryCache
+/// \brief A thread safe, size bounded LRU cache of way polygons
+class GeometryCache {
+  public:
+    /// Create a cache holding at most this many points
+    GeometryCache(size_t capacity) : max_points(capacity) {};
+
+    /// Add or update a way built from a change file. A way is never
+    /// replaced by an older version, as files may be processed out
+    /// of order.
+    void insert(int64_t id, const polygon_t &polygon, int version);
+    /// Add a way read from the database, unless it's already cached
+    /// or was invalidated, as a change file may have updated it since
+    /// the query ran
+    void insertIfAbsent(int64_t id, const polygon_t &polygon, int version);
+    /// Forget a way whose geometry changed but couldn't be rebuilt,
+    /// or that was deleted
+    void erase(int64_t id);
+
+    /// Look up a way polygon, returns false if it's not cached
+    bool get(int64_t id, polygon_t &polygon);
+
+    /// The number of cached ways
+    size_t size(void);
+    /// The number of points in all the cached ways
+    size_t points(void);
+    /// The maximum number of points
+    size_t capacity(void) const { return max_points; };
+
+    uint64_t hits(void) const { return hit_count; };
+    uint64_t misses(void) const { return miss_count; };
+    /// The fraction of lookups that were found in the cache
+    double hitRate(void) const;
+    /// Log the size and hit rate of the cache
+    void logStats(void);
+
+  private:
+    struct Entry {
+        int64_t id;
+        int version;
+        /// Null when the way was invalidated, so a database result
+        /// read before the change can't put the old geometry back
+        std::shared_ptr<const polygon_t> polygon;
+    };
+    typedef std::list<Entry> lru_t;
+
+    void store(int64_t id, const polygon_t &polygon, int version, bool replace);
+    /// Move an entry to the front of the list
+    void touch(lru_t::iterator entry);
+    /// Drop the least recently used ways until there is room
+    void evict(void);
+    static size_t weight(const Entry &entry);
+
+    std::mutex mutex;
+    lru_t lru;  ///< Most recently used first
+    std::unordered_map<int64_t, lru_t::iterator> index;
+    size_t max_points;
+    size_t used_points = 0;
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+};
+
+} // namespace queryraw
+
+#endif // EOF __GEOMETRYCACHE_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
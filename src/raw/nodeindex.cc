@@ -0,0 +1,393 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <osmium/handler.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/visitor.hpp>
+
+#include "osm/nodecache.hh"
+#include "raw/nodeindex.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace queryraw
+namespace queryraw {
+
+// Grow the file in steps of 16M entries so it isn't remapped often
+static const size_t grow_step = 1 << 24;
+
+bool
+NodeIndex::open(const std::string &file, index_t kind)
+{
+    close();
+    filespec = file;
+    fd = ::open(filespec.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        log_error("Couldn't open node index %1%: %2%", filespec, std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    bool existing = st.st_size >= static_cast<off_t>(data_offset);
+    if (!existing && ftruncate(fd, data_offset + grow_step * sizeof(Slot)) != 0) {
+        log_error("Couldn't size node index %1%: %2%", filespec, std::strerror(errno));
+        close();
+        return false;
+    }
+    fstat(fd, &st);
+    mapsize = st.st_size;
+    void *addr = mmap(nullptr, mapsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        log_error("Couldn't map node index %1%: %2%", filespec, std::strerror(errno));
+        map = nullptr;
+        close();
+        return false;
+    }
+    map = static_cast<char *>(addr);
+
+    Header *head = header();
+    if (!existing) {
+        std::memcpy(head->magic, "UPNI", 4);
+        head->version = format;
+        head->layout = kind;
+        head->count = 0;
+        head->sorted = 0;
+    } else if (std::memcmp(head->magic, "UPNI", 4) != 0 || head->version != format) {
+        log_error("%1% is not a node index, or is an old format", filespec);
+        close();
+        return false;
+    }
+    layout = static_cast<index_t>(head->layout);
+    if (layout == dense) {
+        // Nodes are looked up in ID order, but scattered over the file
+        madvise(map, mapsize, MADV_RANDOM);
+    }
+    log_debug("Opened %1% node index %2% with room for %3% entries",
+              (layout == dense) ? "dense" : "sparse", filespec, capacity());
+    return true;
+}
+
+void
+NodeIndex::close(void)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (map != nullptr) {
+        msync(map, mapsize, MS_SYNC);
+        munmap(map, mapsize);
+        map = nullptr;
+        mapsize = 0;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void
+NodeIndex::sync(void)
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    if (map != nullptr) {
+        msync(map, mapsize, MS_ASYNC);
+    }
+}
+
+size_t
+NodeIndex::capacity(void) const
+{
+    size_t bytes = mapsize - data_offset;
+    return (layout == dense) ? bytes / sizeof(Slot) : bytes / sizeof(Entry);
+}
+
+uint64_t
+NodeIndex::pack(const point_t &point)
+{
+    // Flipping the sign bit maps INT32_MIN to zero, which is never a
+    // valid coordinate, so zero can mean the entry is unused
+    uint32_t x = static_cast<uint32_t>(osmobjects::NodeCache::encode(point.get<0>())) ^ 0x80000000u;
+    uint32_t y = static_cast<uint32_t>(osmobjects::NodeCache::encode(point.get<1>())) ^ 0x80000000u;
+    return (static_cast<uint64_t>(x) << 32) | y;
+}
+
+bool
+NodeIndex::unpack(uint64_t location, point_t &point)
+{
+    if (location == 0) {
+        return false;
+    }
+    int32_t x = static_cast<int32_t>(static_cast<uint32_t>(location >> 32) ^ 0x80000000u);
+    int32_t y = static_cast<int32_t>(static_cast<uint32_t>(location) ^ 0x80000000u);
+    point = point_t(osmobjects::NodeCache::decode(x), osmobjects::NodeCache::decode(y));
+    return true;
+}
+
+bool
+NodeIndex::resize(size_t entries)
+{
+    size_t width = (layout == dense) ? sizeof(Slot) : sizeof(Entry);
+    size_t wanted = std::max(entries, capacity() + capacity() / 2);
+    wanted = (wanted + grow_step - 1) / grow_step * grow_step;
+    size_t bytes = data_offset + wanted * width;
+    if (ftruncate(fd, bytes) != 0) {
+        log_error("Couldn't grow node index %1%: %2%", filespec, std::strerror(errno));
+        return false;
+    }
+    void *addr = mremap(map, mapsize, bytes, MREMAP_MAYMOVE);
+    if (addr == MAP_FAILED) {
+        log_error("Couldn't remap node index %1%: %2%", filespec, std::strerror(errno));
+        return false;
+    }
+    map = static_cast<char *>(addr);
+    mapsize = bytes;
+    if (layout == dense) {
+        madvise(map, mapsize, MADV_RANDOM);
+    }
+    return true;
+}
+
+NodeIndex::Entry *
+NodeIndex::lowerBound(int64_t id) const
+{
+    Entry *first = sparseData();
+    Entry *last = first + header()->sorted;
+    return std::lower_bound(first, last, id,
+                            [](const Entry &entry, int64_t val) { return entry.id < val; });
+}
+
+bool
+NodeIndex::get(int64_t id, point_t &point) const
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    if (map == nullptr || id < 0) {
+        return false;
+    }
+    if (layout == dense) {
+        if (static_cast<size_t>(id) >= capacity()) {
+            return false;
+        }
+        return unpack(__atomic_load_n(&denseData()[id].location, __ATOMIC_RELAXED), point);
+    }
+    Entry *entry = lowerBound(id);
+    if (entry == sparseData() + header()->sorted || entry->id != id) {
+        return false;
+    }
+    return unpack(entry->location, point);
+}
+
+bool
+NodeIndex::set(int64_t id, const point_t &point, int version)
+{
+    return store(id, pack(point), version);
+}
+
+void
+NodeIndex::erase(int64_t id, int version)
+{
+    // Keep the deleted node with no location
+    store(id, 0, version);
+}
+
+bool
+NodeIndex::store(int64_t id, uint64_t location, int version)
+{
+    if (id < 0) {
+        return false;
+    }
+    if (layout == dense) {
+        {
+            std::shared_lock<std::shared_mutex> guard(lock);
+            if (map == nullptr) {
+                return false;
+            }
+            if (static_cast<size_t>(id) < capacity()) {
+                std::lock_guard<std::mutex> stripe(stripes[id % stripes.size()]);
+                Slot &slot = denseData()[id];
+                if (version < slot.version) {
+                    return false;
+                }
+                __atomic_store_n(&slot.location, location, __ATOMIC_RELAXED);
+                slot.version = version;
+                return true;
+            }
+        }
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (static_cast<size_t>(id) >= capacity() && !resize(id + 1)) {
+            return false;
+        }
+        Slot &slot = denseData()[id];
+        if (version < slot.version) {
+            return false;
+        }
+        slot.location = location;
+        slot.version = version;
+        return true;
+    }
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (map == nullptr) {
+        return false;
+    }
+    Header *head = header();
+    if (head->sorted != head->count) {
+        merge();
+    }
+    Entry *entry = lowerBound(id);
+    if (entry != sparseData() + head->count && entry->id == id) {
+        if (version < entry->version) {
+            return false;
+        }
+        entry->location = location;
+        entry->version = version;
+        return true;
+    }
+    size_t pos = entry - sparseData();
+    if (head->count + 1 > capacity()) {
+        if (!resize(head->count + 1)) {
+            return false;
+        }
+        head = header();
+    }
+    // New nodes have the highest IDs, so this is usually an append
+    Entry *data = sparseData();
+    if (pos < head->count) {
+        std::memmove(data + pos + 1, data + pos, (head->count - pos) * sizeof(Entry));
+    }
+    data[pos] = Entry{id, location, version};
+    head->count++;
+    head->sorted++;
+    return true;
+}
+
+bool
+NodeIndex::load(int64_t id, const point_t &point, int version)
+{
+    if (layout == dense) {
+        return store(id, pack(point), version);
+    }
+    if (id < 0) {
+        return false;
+    }
+    // Appending and sorting once avoids moving the array for every
+    // node when they don't arrive in ID order
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (map == nullptr) {
+        return false;
+    }
+    Header *head = header();
+    if (head->count + 1 > capacity()) {
+        if (!resize(head->count + 1)) {
+            return false;
+        }
+        head = header();
+    }
+    sparseData()[head->count] = Entry{id, pack(point), version};
+    head->count++;
+    return true;
+}
+
+void
+NodeIndex::seal(void)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (map != nullptr && layout == sparse && header()->sorted != header()->count) {
+        merge();
+    }
+}
+
+void
+NodeIndex::merge(void)
+{
+    Header *head = header();
+    Entry *first = sparseData();
+    Entry *last = first + head->count;
+    std::sort(first, last, [](const Entry &a, const Entry &b) {
+        return (a.id != b.id) ? a.id < b.id : a.version < b.version;
+    });
+    // Keep the newest version of each node
+    Entry *out = first;
+    for (Entry *it = first; it != last; ++it) {
+        if (it + 1 != last && (it + 1)->id == it->id) {
+            continue;
+        }
+        *out++ = *it;
+    }
+    head->count = out - first;
+    head->sorted = head->count;
+    log_debug("Sorted %1% entries in node index %2%", head->count, filespec);
+}
+
+/// \class IndexHandler
+/// \brief Add the location of each node osmium reads to the index
+class IndexHandler : public osmium::handler::Handler {
+  public:
+    IndexHandler(NodeIndex &index) : index(index) {};
+    void node(const osmium::Node &node) {
+        const osmium::Location &loc = node.location();
+        if (loc.valid()) {
+            index.load(node.id(), point_t(loc.lon(), loc.lat()), node.version());
+            count++;
+        }
+    };
+    NodeIndex &index;
+    size_t count = 0;
+};
+
+bool
+NodeIndex::importFile(const std::string &file)
+{
+    if (!isOpen()) {
+        return false;
+    }
+    log_info("Importing node locations from %1%", file);
+    try {
+        osmium::io::Reader reader{file, osmium::osm_entity_bits::node};
+        IndexHandler handler(*this);
+        osmium::apply(reader, handler);
+        reader.close();
+        seal();
+        log_info("Imported %1% node locations into %2%", handler.count, filespec);
+    } catch (const std::exception &e) {
+        log_error("Couldn't import %1%: %2%", file, e.what());
+        return false;
+    }
+    sync();
+    return true;
+}
+
+} // namespace queryraw
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
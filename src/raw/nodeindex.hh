@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __NODEINDEX_HH__
+#define __NODEINDEX_HH__
+
+/// \file nodeindex.hh
+/// \brief A memory mapped index of node locations on disk
+///
+/// For large deployments most of the time building way geometries is
+/// spent querying the nodes table. This keeps the location of every
+/// node in a file that is memory mapped, so a lookup is a memory read
+/// that the kernel pages in as needed. There are two layouts, like
+/// the osmium location indexes. A dense index is an array indexed by
+/// the node ID, which suits the planet or a large country. A sparse
+/// index is an array of ID and location pairs sorted by ID, which
+/// suits small extracts. Locations are stored as fixed point integers
+/// in 1e-7 degrees, the same as NodeCache, with the version of the
+/// node so replication files processed out of order can't replace a
+/// location with an older one.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace queryraw
+namespace queryraw {
+
+/// \class NodeIndex
+/// \brief Map node IDs to their location, stored in a file
+///
+/// Lookups can run in parallel. Updating a dense index only blocks
+/// when the file has to grow. Updating a sparse index blocks lookups
+/// while it runs.
+class NodeIndex {
+  public:
+    typedef enum { dense, sparse } index_t;
+
+    NodeIndex(void) {};
+    ~NodeIndex(void) { close(); };
+    NodeIndex(const NodeIndex &) = delete;
+    NodeIndex &operator=(const NodeIndex &) = delete;
+
+    /// Open an index file, creating it with this layout if it doesn't
+    /// exist. An existing file keeps the layout it was created with.
+    bool open(const std::string &filespec, index_t layout = dense);
+    /// Flush and unmap the file
+    void close(void);
+    bool isOpen(void) const { return fd >= 0; };
+    index_t getLayout(void) const { return layout; };
+
+    /// Look up a node location, returns false if it's not in the index
+    bool get(int64_t id, point_t &point) const;
+    /// Add or update a node location. A location is never replaced by
+    /// an older version, as files may be processed out of order.
+    bool set(int64_t id, const point_t &point, int version);
+    /// Remove a deleted node. The version is kept, so an older
+    /// location can't bring it back.
+    void erase(int64_t id, int version);
+
+    /// Queue a node location when filling the index in bulk, in any
+    /// order. Queued nodes can be looked up once seal() is called.
+    bool load(int64_t id, const point_t &point, int version);
+    /// Sort everything queued by load() into a sparse index
+    void seal(void);
+
+    /// Add the locations of all the nodes in an OSM file, usually a PBF
+    bool importFile(const std::string &filespec);
+
+    /// Write changes back to disk
+    void sync(void);
+
+    static constexpr uint16_t format = 2; ///< Bump when the file format changes
+
+  private:
+    /// The header at the start of the file
+    struct Header {
+        char magic[4];     ///< Always "UPNI"
+        uint16_t version;  ///< The format version
+        uint16_t layout;   ///< The index_t of the data
+        uint64_t count;    ///< Used entries in a sparse index
+        uint64_t sorted;   ///< Entries before the ones queued by load()
+    };
+    /// An entry in a dense index
+    struct Slot {
+        uint64_t location;
+        int64_t version;
+    };
+    /// An entry in a sparse index
+    struct Entry {
+        int64_t id;
+        uint64_t location;
+        int64_t version;
+    };
+    static constexpr size_t data_offset = 4096;  ///< Data starts on a page boundary
+
+    /// Pack a location so that an all zero entry means no location,
+    /// which lets the file have holes where there are no nodes
+    static uint64_t pack(const point_t &point);
+    static bool unpack(uint64_t location, point_t &point);
+
+    /// Grow the file so it can hold this many entries
+    bool resize(size_t entries);
+    size_t capacity(void) const;
+
+    Header *header(void) const { return reinterpret_cast<Header *>(map); };
+    Slot *denseData(void) const { return reinterpret_cast<Slot *>(map + data_offset); };
+    Entry *sparseData(void) const { return reinterpret_cast<Entry *>(map + data_offset); };
+    /// Find the first sorted sparse entry with an ID not less than this one
+    Entry *lowerBound(int64_t id) const;
+    /// Store a location, or a deleted node when the location is zero
+    bool store(int64_t id, uint64_t location, int version);
+    /// Sort and merge the queued sparse entries, with the lock held
+    void merge(void);
+
+    mutable std::shared_mutex lock;  ///< Held exclusively to remap the file
+    /// Dense writers to the same slot are serialized by one of these,
+    /// so the version check and the store happen together
+    std::array<std::mutex, 64> stripes;
+    std::string filespec;
+    index_t layout = dense;
+    int fd = -1;
+    char *map = nullptr;
+    size_t mapsize = 0;
+};
+
+} // namespace queryraw
+
+#endif // EOF __NODEINDEX_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
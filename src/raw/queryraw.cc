@@ -36,11 +36,16 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
+#include <algorithm>
 #include <map>
 #include <string>
+#include <vector>
 #include "utils/log.hh"
 #include "data/pq.hh"
 #include "raw/queryraw.hh"
+#include "raw/ringassembler.hh"
+#include "utils/ewkb.hh"
+#include "utils/quadkey.hh"
 #include "osm/osmobjects.hh"
 #include "osm/osmchange.hh"
 
@@ -86,6 +91,16 @@ QueryRaw::buildTagsQuery(std::map<std::string, std::string> tags) const {
     }
 }
 
+std::string
+QueryRaw::buildTagsJSON(const std::map<std::string, std::string> &tags) const {
+    std::string json = "{";
+    for (auto it = std::begin(tags); it != std::end(tags); ++it) {
+        json += "\"" + dbconn->escapedJSON(it->first) + "\": \"" + dbconn->escapedJSON(it->second) + "\",";
+    }
+    json.back() = '}';
+    return json;
+}
+
 std::string
 buildMembersQuery(std::list<OsmRelationMember> members) {
     if (members.size() > 0) {
@@ -114,6 +129,19 @@ buildMembersQuery(std::list<OsmRelationMember> members) {
     }
 }
 
+std::string
+QueryRaw::buildMembersJSON(const std::list<OsmRelationMember> &members) const {
+    std::string json = "[";
+    for (auto mit = std::begin(members); mit != std::end(members); ++mit) {
+        json += "{\"role\": \"" + dbconn->escapedJSON(mit->role) + "\", \"type\": \"" +
+            std::to_string(mit->type) + "\", \"ref\": \"" + std::to_string(mit->ref) + "\"},";
+    }
+    if (json.size() > 1) {
+        json.pop_back();
+    }
+    return json + "]";
+}
+
 std::map<std::string, std::string> parseJSONObjectStr(std::string input) {
     std::map<std::string, std::string> obj;
     boost::property_tree::ptree pt;
@@ -152,24 +180,44 @@ std::vector<std::map<std::string, std::string>> parseJSONArrayStr(std::string in
     return arr;
 }
 
+// osm2pgsql writes "w" as the type of way members, and the writers
+// here write the osmtype_t value, so accept both
+bool
+isWayMember(const std::map<std::string, std::string> &member)
+{
+    auto type = member.find("type");
+    return type != member.end() && (type->second == "w" || type->second == std::to_string(osmobjects::way));
+}
+
+std::vector<long>
+QueryRaw::memberWays(const std::string &refs)
+{
+    std::vector<long> ways;
+    auto members = parseJSONArrayStr(refs);
+    for (auto mit = members.begin(); mit != members.end(); ++mit) {
+        if (isWayMember(*mit) && mit->count("ref")) {
+            ways.push_back(std::stol(mit->at("ref")));
+        }
+    }
+    return ways;
+}
+
 std::string
 QueryRaw::applyChange(const OsmNode &node) const
 {
     std::string query;
     if (node.action == osmobjects::create || node.action == osmobjects::modify) {
-        query = "INSERT INTO nodes as r (osm_id, geom, tags, timestamp, version, \"user\", uid, changeset) VALUES(";
-        std::string format = "%d, ST_GeomFromText(\'%s\', 4326), %s, \'%s\', %d, \'%s\', %d, %d \
-        ) ON CONFLICT (osm_id) DO UPDATE SET  geom = ST_GeomFromText(\'%s\', \
-        4326), tags = %s, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version < %d;";
+        query = "INSERT INTO nodes as r (osm_id, geom, tags, timestamp, version, \"user\", uid, changeset, quadkey) VALUES(";
+        std::string format = "%d, %s, %s, \'%s\', %d, \'%s\', %d, %d, %d \
+        ) ON CONFLICT (osm_id) DO UPDATE SET  geom = %s, quadkey = %d, \
+        tags = %s, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version < %d;";
         boost::format fmt(format);
 
         // osm_id
         fmt % node.id;
 
         // geometry
-        std::stringstream ss;
-        ss << std::setprecision(12) << boost::geometry::wkt(node.point);
-        std::string geometry = ss.str();
+        std::string geometry = ewkb::geometry(node.point);
         fmt % geometry;
 
         // tags
@@ -186,9 +234,13 @@ QueryRaw::applyChange(const OsmNode &node) const
         fmt % node.uid;
         // changeset
         fmt % node.changeset;
+        // quadkey
+        auto quadkey = geoutil::quadkey::key(node.point);
+        fmt % quadkey;
 
         // ON CONFLICT
         fmt % geometry;
+        fmt % quadkey;
         fmt % tags;
         fmt % timestamp;
         fmt % node.version;
@@ -216,25 +268,21 @@ QueryRaw::applyChange(const OsmWay &way) const
     std::string query = "";
     const std::string* tableName;
 
-    std::stringstream ss;
     if (way.refs.size() > 3 && (way.refs.front() == way.refs.back())) {
         tableName = &QueryRaw::polyTable;
-        ss << std::setprecision(12) << boost::geometry::wkt(way.polygon);
     } else {
         tableName = &QueryRaw::lineTable;
-        ss << std::setprecision(12) << boost::geometry::wkt(way.linestring);
     }
-    std::string geostring = ss.str();
 
     if (way.refs.size() > 2
         && (way.action == osmobjects::create || way.action == osmobjects::modify)) {
-        if ((way.refs.front() != way.refs.back() && way.refs.size() == boost::geometry::num_points(way.linestring)) ||
+        if ((way.refs.front() != way.refs.back() && way.refs.size() == boost::geometry::num_points(way.linestring())) ||
             (way.refs.front() == way.refs.back() && way.refs.size() == boost::geometry::num_points(way.polygon))
          ) {
 
-            query = "INSERT INTO " + *tableName + " as r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset) VALUES(";
-            std::string format = "%d, %s, %s, %s, \'%s\', %d, \'%s\', %d, %d) \
-            ON CONFLICT (osm_id) DO UPDATE SET tags = %s, refs = %s, geom = %s, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version <= %d;";
+            query = "INSERT INTO " + *tableName + " as r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey) VALUES(";
+            std::string format = "%d, %s, %s, %s, \'%s\', %d, \'%s\', %d, %d, %d) \
+            ON CONFLICT (osm_id) DO UPDATE SET tags = %s, refs = %s, geom = %s, quadkey = %d, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version <= %d;";
             boost::format fmt(format);
 
             // osm_id
@@ -255,7 +303,11 @@ QueryRaw::applyChange(const OsmWay &way) const
 
             // geometry
             std::string geometry;
-            geometry = "ST_GeomFromText(\'" + geostring + "\', 4326)";
+            if (tableName == &QueryRaw::polyTable) {
+                geometry = ewkb::geometry(way.polygon);
+            } else {
+                geometry = ewkb::geometry(way.linestring());
+            }
             fmt % geometry;
 
             // timestamp
@@ -269,11 +321,15 @@ QueryRaw::applyChange(const OsmWay &way) const
             fmt % way.uid;
             // changeset
             fmt % way.changeset;
+            // quadkey
+            auto quadkey = geoutil::quadkey::key(way.bbox());
+            fmt % quadkey;
 
             // ON CONFLICT
             fmt % tags;
             fmt % refs;
             fmt % geometry;
+            fmt % quadkey;
             fmt % timestamp;
             fmt % way.version;
             fmt % dbconn->escapedString(way.user);
@@ -301,20 +357,12 @@ std::string
 QueryRaw::applyChange(const OsmRelation &relation) const
 {
     std::string query = "";
-    std::stringstream ss;
-    if (relation.isMultiPolygon()) {
-        ss << std::setprecision(12) << boost::geometry::wkt(relation.multipolygon);
-    } else {
-        ss << std::setprecision(12) << boost::geometry::wkt(relation.multilinestring);
-    }
-    
-    std::string geostring = ss.str();
 
     if (relation.action == osmobjects::create || relation.action == osmobjects::modify) {
 
-        query = "INSERT INTO relations as r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset) VALUES(";
-        std::string format = "%d, %s, %s, %s, \'%s\', %d, \'%s\', %d, %d) \
-        ON CONFLICT (osm_id) DO UPDATE SET tags = %s, refs = %s, geom = %s, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version <= %d;";
+        query = "INSERT INTO relations as r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey) VALUES(";
+        std::string format = "%d, %s, %s, %s, \'%s\', %d, \'%s\', %d, %d, %s) \
+        ON CONFLICT (osm_id) DO UPDATE SET tags = %s, refs = %s, geom = %s, quadkey = %s, timestamp = \'%s\', version = %d, \"user\" = \'%s\', uid = %d, changeset = %d WHERE r.version <= %d;";
         boost::format fmt(format);
 
         // osm_id
@@ -330,7 +378,22 @@ QueryRaw::applyChange(const OsmRelation &relation) const
 
         // geometry
         std::string geometry;
-        geometry = "ST_GeomFromText(\'" + geostring + "\', 4326)";
+        // A relation without any geometry has no cell
+        std::string quadkey = "NULL";
+        boost::geometry::model::box<point_t> bbox;
+        if (relation.isMultiPolygon()) {
+            geometry = ewkb::geometry(relation.multipolygon);
+            if (!boost::geometry::is_empty(relation.multipolygon)) {
+                boost::geometry::envelope(relation.multipolygon, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        } else {
+            geometry = ewkb::geometry(relation.multilinestring);
+            if (!boost::geometry::is_empty(relation.multilinestring)) {
+                boost::geometry::envelope(relation.multilinestring, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        }
         fmt % geometry;
 
         // timestamp
@@ -344,11 +407,14 @@ QueryRaw::applyChange(const OsmRelation &relation) const
         fmt % relation.uid;
         // changeset
         fmt % relation.changeset;
+        // quadkey
+        fmt % quadkey;
 
         // ON CONFLICT
         fmt % tags;
         fmt % refs;
         fmt % geometry;
+        fmt % quadkey;
         fmt % timestamp;
         fmt % relation.version;
         fmt % dbconn->escapedString(relation.user);
@@ -368,6 +434,342 @@ QueryRaw::applyChange(const OsmRelation &relation) const
 
     return query;}
 
+// The staging tables for the COPY writer. The rows of an object that
+// was deleted only have the ID. The raw tables are written in quadkey
+// order, which keeps the rows written together close on disk.
+namespace {
+
+const std::string nodeStaging = "copy_nodes";
+const std::string nodeColumns = "osm_id int8, removed bool, geom geometry, tags jsonb, \
+timestamp timestamptz, version int, \"user\" text, uid int8, changeset int8, quadkey int8";
+const std::vector<std::string> nodeMerge = {
+    "DELETE FROM nodes USING " + CopyWriter::latest(nodeStaging, "osm_id") +
+        " WHERE nodes.osm_id = s.osm_id AND s.removed",
+    "INSERT INTO nodes AS r (osm_id, geom, tags, timestamp, version, \"user\", uid, changeset, quadkey) \
+SELECT osm_id, geom, tags, timestamp, version, \"user\", uid, changeset, quadkey FROM " +
+        CopyWriter::latest(nodeStaging, "osm_id") + " WHERE NOT s.removed ORDER BY s.quadkey \
+ON CONFLICT (osm_id) DO UPDATE SET geom = EXCLUDED.geom, tags = EXCLUDED.tags, \
+timestamp = EXCLUDED.timestamp, version = EXCLUDED.version, \"user\" = EXCLUDED.\"user\", \
+uid = EXCLUDED.uid, changeset = EXCLUDED.changeset, quadkey = EXCLUDED.quadkey WHERE r.version < EXCLUDED.version"
+};
+
+const std::string wayStaging = "copy_ways";
+const std::string wayColumns = "osm_id int8, removed bool, poly bool, tags jsonb, refs int8[], geom geometry, \
+timestamp timestamptz, version int, \"user\" text, uid int8, changeset int8, quadkey int8";
+
+// Insert the last version of the staged ways that go in a table
+std::string
+mergeWays(const std::string &table, const std::string &where)
+{
+    return "INSERT INTO " + table + " AS r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey) \
+SELECT osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey FROM " +
+        CopyWriter::latest(wayStaging, "osm_id") + " WHERE NOT s.removed AND " + where + " ORDER BY s.quadkey \
+ON CONFLICT (osm_id) DO UPDATE SET tags = EXCLUDED.tags, refs = EXCLUDED.refs, geom = EXCLUDED.geom, \
+quadkey = EXCLUDED.quadkey, timestamp = EXCLUDED.timestamp, version = EXCLUDED.version, \
+\"user\" = EXCLUDED.\"user\", uid = EXCLUDED.uid, changeset = EXCLUDED.changeset WHERE r.version <= EXCLUDED.version";
+}
+
+const std::vector<std::string> wayMerge = {
+    "DELETE FROM way_refs USING (SELECT DISTINCT osm_id FROM " + wayStaging + ") AS s WHERE way_refs.way_id = s.osm_id",
+    "DELETE FROM " + QueryRaw::polyTable + " USING " + CopyWriter::latest(wayStaging, "osm_id") +
+        " WHERE " + QueryRaw::polyTable + ".osm_id = s.osm_id AND s.removed",
+    "DELETE FROM " + QueryRaw::lineTable + " USING " + CopyWriter::latest(wayStaging, "osm_id") +
+        " WHERE " + QueryRaw::lineTable + ".osm_id = s.osm_id AND s.removed",
+    mergeWays(QueryRaw::polyTable, "s.poly"),
+    mergeWays(QueryRaw::lineTable, "NOT s.poly"),
+    "INSERT INTO way_refs (way_id, node_id) SELECT osm_id, unnest(refs) FROM " +
+        CopyWriter::latest(wayStaging, "osm_id") + " WHERE NOT s.removed"
+};
+
+const std::string relationStaging = "copy_relations";
+const std::string relationColumns = "osm_id int8, removed bool, tags jsonb, refs jsonb, geom geometry, \
+timestamp timestamptz, version int, \"user\" text, uid int8, changeset int8, quadkey int8";
+const std::vector<std::string> relationMerge = {
+    "DELETE FROM relations USING " + CopyWriter::latest(relationStaging, "osm_id") +
+        " WHERE relations.osm_id = s.osm_id AND s.removed",
+    "INSERT INTO relations AS r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey) \
+SELECT osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey FROM " +
+        CopyWriter::latest(relationStaging, "osm_id") + " WHERE NOT s.removed ORDER BY s.quadkey \
+ON CONFLICT (osm_id) DO UPDATE SET tags = EXCLUDED.tags, refs = EXCLUDED.refs, geom = EXCLUDED.geom, \
+quadkey = EXCLUDED.quadkey, timestamp = EXCLUDED.timestamp, version = EXCLUDED.version, \
+\"user\" = EXCLUDED.\"user\", uid = EXCLUDED.uid, changeset = EXCLUDED.changeset WHERE r.version <= EXCLUDED.version",
+    "DELETE FROM rel_refs USING (SELECT DISTINCT osm_id FROM " + relationStaging + ") AS s WHERE rel_refs.rel_id = s.osm_id",
+    "INSERT INTO rel_refs (rel_id, way_id) SELECT osm_id, (jsonb_array_elements(refs)->>'ref')::int8 FROM " +
+        CopyWriter::latest(relationStaging, "osm_id") + " WHERE NOT s.removed"
+};
+
+} // namespace
+
+void
+QueryRaw::applyChange(const OsmNode &node, CopyWriter &copy) const
+{
+    copy.stage(nodeStaging, nodeColumns, nodeMerge);
+    if (node.action == osmobjects::create || node.action == osmobjects::modify) {
+        std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+        copy.add(nodeStaging, {
+            std::to_string(node.id),
+            "f",
+            ewkb::hex(node.point),
+            node.tags.size() > 0 ? std::optional<std::string>(buildTagsJSON(node.tags)) : std::nullopt,
+            timestamp,
+            std::to_string(node.version),
+            node.user,
+            std::to_string(node.uid),
+            std::to_string(node.changeset),
+            std::to_string(geoutil::quadkey::key(node.point))
+        });
+    } else if (node.action == osmobjects::remove) {
+        copy.add(nodeStaging, {std::to_string(node.id), "t", std::nullopt, std::nullopt, std::nullopt,
+            std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt});
+    }
+}
+
+void
+QueryRaw::applyChange(const OsmWay &way, CopyWriter &copy) const
+{
+    copy.stage(wayStaging, wayColumns, wayMerge);
+    bool poly = way.refs.size() > 3 && (way.refs.front() == way.refs.back());
+
+    if (way.refs.size() > 2
+        && (way.action == osmobjects::create || way.action == osmobjects::modify)) {
+        if ((way.refs.front() != way.refs.back() && way.refs.size() == boost::geometry::num_points(way.linestring())) ||
+            (way.refs.front() == way.refs.back() && way.refs.size() == boost::geometry::num_points(way.polygon))
+         ) {
+            std::vector<std::string> refs;
+            for (auto it = std::begin(way.refs); it != std::end(way.refs); ++it) {
+                refs.push_back(std::to_string(*it));
+            }
+            std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+            copy.add(wayStaging, {
+                std::to_string(way.id),
+                "f",
+                poly ? "t" : "f",
+                way.tags.size() > 0 ? std::optional<std::string>(buildTagsJSON(way.tags)) : std::nullopt,
+                CopyWriter::array(refs),
+                poly ? ewkb::hex(way.polygon) : ewkb::hex(way.linestring()),
+                timestamp,
+                std::to_string(way.version),
+                way.user,
+                std::to_string(way.uid),
+                std::to_string(way.changeset),
+                std::to_string(geoutil::quadkey::key(way.bbox()))
+            });
+        }
+    } else if (way.action == osmobjects::remove) {
+        copy.add(wayStaging, {std::to_string(way.id), "t", "f", std::nullopt, std::nullopt, std::nullopt,
+            std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt});
+    }
+}
+
+void
+QueryRaw::applyChange(const OsmRelation &relation, CopyWriter &copy) const
+{
+    copy.stage(relationStaging, relationColumns, relationMerge);
+    if (relation.action == osmobjects::create || relation.action == osmobjects::modify) {
+        std::string geometry;
+        // A relation without any geometry has no cell
+        std::optional<std::string> quadkey;
+        boost::geometry::model::box<point_t> bbox;
+        if (relation.isMultiPolygon()) {
+            geometry = ewkb::hex(relation.multipolygon);
+            if (!boost::geometry::is_empty(relation.multipolygon)) {
+                boost::geometry::envelope(relation.multipolygon, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        } else {
+            geometry = ewkb::hex(relation.multilinestring);
+            if (!boost::geometry::is_empty(relation.multilinestring)) {
+                boost::geometry::envelope(relation.multilinestring, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        }
+        std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+        copy.add(relationStaging, {
+            std::to_string(relation.id),
+            "f",
+            relation.tags.size() > 0 ? std::optional<std::string>(buildTagsJSON(relation.tags)) : std::nullopt,
+            relation.members.size() > 0 ? std::optional<std::string>(buildMembersJSON(relation.members)) : std::nullopt,
+            geometry,
+            timestamp,
+            std::to_string(relation.version),
+            relation.user,
+            std::to_string(relation.uid),
+            std::to_string(relation.changeset),
+            quadkey
+        });
+    } else if (relation.action == osmobjects::remove) {
+        copy.add(relationStaging, {std::to_string(relation.id), "t", std::nullopt, std::nullopt, std::nullopt,
+            std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt});
+    }
+}
+
+// The prepared statements. Geometries are sent as binary EWKB and the
+// tags as binary JSONB, everything else as text.
+namespace {
+
+const std::string nodeUpsert = "raw_node";
+const std::string nodeUpsertSQL = "INSERT INTO nodes AS r (osm_id, geom, tags, timestamp, version, \"user\", uid, changeset, quadkey) \
+VALUES ($1, $2::geometry, $3::jsonb, $4, $5, $6, $7, $8, $9) \
+ON CONFLICT (osm_id) DO UPDATE SET geom = EXCLUDED.geom, quadkey = EXCLUDED.quadkey, tags = EXCLUDED.tags, \
+timestamp = EXCLUDED.timestamp, version = EXCLUDED.version, \"user\" = EXCLUDED.\"user\", uid = EXCLUDED.uid, \
+changeset = EXCLUDED.changeset WHERE r.version < EXCLUDED.version";
+const std::string nodeDelete = "raw_node_delete";
+const std::string nodeDeleteSQL = "DELETE FROM nodes WHERE osm_id = $1";
+
+// The upsert of a way or a relation into a table
+std::string
+upsertSQL(const std::string &table, const std::string &refs, const std::string &versions)
+{
+    return "INSERT INTO " + table + " AS r (osm_id, tags, refs, geom, timestamp, version, \"user\", uid, changeset, quadkey) \
+VALUES ($1, $2::jsonb, $3::" + refs + ", $4::geometry, $5, $6, $7, $8, $9, $10) \
+ON CONFLICT (osm_id) DO UPDATE SET tags = EXCLUDED.tags, refs = EXCLUDED.refs, geom = EXCLUDED.geom, \
+quadkey = EXCLUDED.quadkey, timestamp = EXCLUDED.timestamp, version = EXCLUDED.version, \"user\" = EXCLUDED.\"user\", \
+uid = EXCLUDED.uid, changeset = EXCLUDED.changeset WHERE r.version " + versions + " EXCLUDED.version";
+}
+
+const std::string polyUpsert = "raw_way_poly";
+const std::string lineUpsert = "raw_way_line";
+const std::string polyDelete = "raw_way_poly_delete";
+const std::string lineDelete = "raw_way_line_delete";
+const std::string wayRefsDelete = "raw_way_refs_delete";
+const std::string wayRefsDeleteSQL = "DELETE FROM way_refs WHERE way_id = $1";
+const std::string wayRefsInsert = "raw_way_refs";
+const std::string wayRefsInsertSQL = "INSERT INTO way_refs (way_id, node_id) SELECT $1, unnest($2::int8[])";
+
+const std::string relationUpsert = "raw_relation";
+const std::string relationDelete = "raw_relation_delete";
+const std::string relationDeleteSQL = "DELETE FROM relations WHERE osm_id = $1";
+const std::string relRefsInsert = "raw_rel_refs";
+const std::string relRefsInsertSQL = "INSERT INTO rel_refs (rel_id, way_id) SELECT $1, unnest($2::int8[])";
+
+// Format IDs as a PostgreSQL array
+template <typename T>
+std::string
+idArray(const T &ids)
+{
+    std::string result = "{";
+    for (auto it = std::begin(ids); it != std::end(ids); ++it) {
+        result += std::to_string(*it) + ",";
+    }
+    if (result.size() > 1) {
+        result.pop_back();
+    }
+    return result + "}";
+}
+
+} // namespace
+
+void
+QueryRaw::applyChange(const OsmNode &node, PreparedBatch &batch) const
+{
+    if (node.action == osmobjects::create || node.action == osmobjects::modify) {
+        batch.prepare(nodeUpsert, nodeUpsertSQL, {2, 3});
+        std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+        batch.add(nodeUpsert, {
+            std::to_string(node.id),
+            ewkb::binary(node.point),
+            node.tags.size() > 0 ? std::optional<std::string>(PreparedBatch::jsonb(buildTagsJSON(node.tags))) : std::nullopt,
+            timestamp,
+            std::to_string(node.version),
+            node.user,
+            std::to_string(node.uid),
+            std::to_string(node.changeset),
+            std::to_string(geoutil::quadkey::key(node.point))
+        });
+    } else if (node.action == osmobjects::remove) {
+        batch.prepare(nodeDelete, nodeDeleteSQL);
+        batch.add(nodeDelete, {std::to_string(node.id)});
+    }
+}
+
+void
+QueryRaw::applyChange(const OsmWay &way, PreparedBatch &batch) const
+{
+    bool poly = way.refs.size() > 3 && (way.refs.front() == way.refs.back());
+
+    if (way.refs.size() > 2
+        && (way.action == osmobjects::create || way.action == osmobjects::modify)) {
+        if ((way.refs.front() != way.refs.back() && way.refs.size() == boost::geometry::num_points(way.linestring())) ||
+            (way.refs.front() == way.refs.back() && way.refs.size() == boost::geometry::num_points(way.polygon))
+         ) {
+            const std::string &upsert = poly ? polyUpsert : lineUpsert;
+            batch.prepare(upsert, upsertSQL(poly ? QueryRaw::polyTable : QueryRaw::lineTable, "int8[]", "<="), {2, 4});
+            batch.prepare(wayRefsDelete, wayRefsDeleteSQL);
+            batch.prepare(wayRefsInsert, wayRefsInsertSQL);
+            std::string refs = idArray(way.refs);
+            std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+            batch.add(upsert, {
+                std::to_string(way.id),
+                way.tags.size() > 0 ? std::optional<std::string>(PreparedBatch::jsonb(buildTagsJSON(way.tags))) : std::nullopt,
+                refs,
+                poly ? ewkb::binary(way.polygon) : ewkb::binary(way.linestring()),
+                timestamp,
+                std::to_string(way.version),
+                way.user,
+                std::to_string(way.uid),
+                std::to_string(way.changeset),
+                std::to_string(geoutil::quadkey::key(way.bbox()))
+            });
+            batch.add(wayRefsDelete, {std::to_string(way.id)});
+            batch.add(wayRefsInsert, {std::to_string(way.id), refs});
+        }
+    } else if (way.action == osmobjects::remove) {
+        batch.prepare(wayRefsDelete, wayRefsDeleteSQL);
+        batch.prepare(polyDelete, "DELETE FROM " + QueryRaw::polyTable + " WHERE osm_id = $1");
+        batch.prepare(lineDelete, "DELETE FROM " + QueryRaw::lineTable + " WHERE osm_id = $1");
+        batch.add(wayRefsDelete, {std::to_string(way.id)});
+        batch.add(polyDelete, {std::to_string(way.id)});
+        batch.add(lineDelete, {std::to_string(way.id)});
+    }
+}
+
+void
+QueryRaw::applyChange(const OsmRelation &relation, PreparedBatch &batch) const
+{
+    if (relation.action == osmobjects::create || relation.action == osmobjects::modify) {
+        batch.prepare(relationUpsert, upsertSQL("relations", "jsonb", "<="), {2, 3, 4});
+        batch.prepare(relRefsInsert, relRefsInsertSQL);
+        std::string geometry;
+        // A relation without any geometry has no cell
+        std::optional<std::string> quadkey;
+        boost::geometry::model::box<point_t> bbox;
+        if (relation.isMultiPolygon()) {
+            geometry = ewkb::binary(relation.multipolygon);
+            if (!boost::geometry::is_empty(relation.multipolygon)) {
+                boost::geometry::envelope(relation.multipolygon, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        } else {
+            geometry = ewkb::binary(relation.multilinestring);
+            if (!boost::geometry::is_empty(relation.multilinestring)) {
+                boost::geometry::envelope(relation.multilinestring, bbox);
+                quadkey = std::to_string(geoutil::quadkey::key(bbox));
+            }
+        }
+        std::vector<long> refs;
+        for (auto it = std::begin(relation.members); it != std::end(relation.members); ++it) {
+            refs.push_back(it->ref);
+        }
+        std::string timestamp = to_simple_string(boost::posix_time::microsec_clock::universal_time());
+        batch.add(relationUpsert, {
+            std::to_string(relation.id),
+            relation.tags.size() > 0 ? std::optional<std::string>(PreparedBatch::jsonb(buildTagsJSON(relation.tags))) : std::nullopt,
+            relation.members.size() > 0 ? std::optional<std::string>(PreparedBatch::jsonb(buildMembersJSON(relation.members))) : std::nullopt,
+            geometry,
+            timestamp,
+            std::to_string(relation.version),
+            relation.user,
+            std::to_string(relation.uid),
+            std::to_string(relation.changeset),
+            quadkey
+        });
+        batch.add(relRefsInsert, {std::to_string(relation.id), idArray(refs)});
+    } else if (relation.action == osmobjects::remove) {
+        batch.prepare(relationDelete, relationDeleteSQL);
+        batch.add(relationDelete, {std::to_string(relation.id)});
+    }
+}
+
 std::vector<long> arrayStrToVector(std::string &refs_str) {
     refs_str.erase(0, 1);
     refs_str.erase(refs_str.size() - 1);
@@ -380,8 +782,35 @@ std::vector<long> arrayStrToVector(std::string &refs_str) {
     return refs;
 }
 
+// Join IDs with commas, for an SQL array
+std::string
+idsToString(const std::vector<long> &ids)
+{
+    std::string str;
+    for (auto it = std::begin(ids); it != std::end(ids); ++it) {
+        if (!str.empty()) {
+            str += ",";
+        }
+        str += std::to_string(*it);
+    }
+    return str;
+}
+
+// The IDs of the way members of a relation
+std::vector<long>
+wayMembers(const OsmRelation &relation)
+{
+    std::vector<long> ways;
+    for (auto it = std::begin(relation.members); it != std::end(relation.members); ++it) {
+        if (it->type == osmobjects::way) {
+            ways.push_back(it->ref);
+        }
+    }
+    return ways;
+}
+
 std::list<std::shared_ptr<OsmRelation>>
-QueryRaw::getRelationsByWaysRefs(std::string &wayIds) const
+QueryRaw::getRelationsByWaysRefs(std::vector<long> &wayIds) const
 {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("getRelationsByWaysRefs(wayIds): took %w seconds\n");
@@ -389,7 +818,17 @@ QueryRaw::getRelationsByWaysRefs(std::string &wayIds) const
     // Get all relations that have references to ways
     std::list<std::shared_ptr<osmobjects::OsmRelation>> rels;
 
-    std::string relsQuery = "SELECT distinct(osm_id), refs, version, tags, uid, changeset from rel_refs join relations r on r.osm_id = rel_id where way_id = any(ARRAY[" + wayIds + "])";
+    std::string relsQuery;
+    if (wayrelations) {
+        std::vector<long> relIds;
+        wayrelations->lookup(wayIds, relIds);
+        if (relIds.empty()) {
+            return rels;
+        }
+        relsQuery = "SELECT osm_id, refs, version, tags, uid, changeset from relations where osm_id = any(ARRAY[" + idsToString(relIds) + "])";
+    } else {
+        relsQuery = "SELECT distinct(osm_id), refs, version, tags, uid, changeset from rel_refs join relations r on r.osm_id = rel_id where way_id = any(ARRAY[" + idsToString(wayIds) + "])";
+    }
     auto rels_result = dbconn->query(relsQuery);
 
     // Fill vector of OsmRelation objects
@@ -424,32 +863,100 @@ QueryRaw::getRelationsByWaysRefs(std::string &wayIds) const
 }
 
 void
-QueryRaw::getWaysByIds(std::string &waysIds, std::map<long, std::shared_ptr<osmobjects::OsmWay>> &waycache) {
+QueryRaw::getWaysByIds(std::vector<long> &waysIds, std::map<long, std::shared_ptr<osmobjects::OsmWay>> &waycache) {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("getWaysByIds(waysIds, waycache): took %w seconds\n");
 #endif
-    // Get all ways that have references to nodes
-    std::string waysQuery = "SELECT distinct(osm_id), ST_AsText(geom, 4326) from ways_poly wp where osm_id = any(ARRAY[" + waysIds + "])";
-    auto ways_result = dbconn->query(waysQuery);
-
-    // Fill vector of OsmWay objects
-    for (auto way_it = ways_result.begin(); way_it != ways_result.end(); ++way_it) {
+    std::sort(waysIds.begin(), waysIds.end());
+    waysIds.erase(std::unique(waysIds.begin(), waysIds.end()), waysIds.end());
+
+    // Only query the database for ways no other file has needed lately
+    std::string missingIds;
+    for (auto it = std::begin(waysIds); it != std::end(waysIds); ++it) {
+        if (waycache.count(*it)) {
+            continue;
+        }
         auto way = std::make_shared<OsmWay>();
-        way->id = (*way_it)[0].as<long>();
-        boost::geometry::read_wkt((*way_it)[1].as<std::string>(), way->polygon);
-        waycache.insert(std::pair(way->id, std::make_shared<osmobjects::OsmWay>(*way)));
+        if (geometrycache && geometrycache->get(*it, way->polygon)) {
+            way->id = *it;
+            waycache.insert(std::pair(way->id, way));
+        } else {
+            missingIds += std::to_string(*it) + ",";
+        }
+    }
+
+    if (missingIds.size() > 1) {
+        missingIds.erase(missingIds.size() - 1);
+        std::string waysQuery = "SELECT distinct(osm_id), ST_AsText(geom, 4326), version from ways_poly wp where osm_id = any(ARRAY[" + missingIds + "])";
+        auto ways_result = dbconn->query(waysQuery);
+
+        // Fill vector of OsmWay objects
+        for (auto way_it = ways_result.begin(); way_it != ways_result.end(); ++way_it) {
+            auto way = std::make_shared<OsmWay>();
+            way->id = (*way_it)[0].as<long>();
+            boost::geometry::read_wkt((*way_it)[1].as<std::string>(), way->polygon);
+            if (geometrycache) {
+                geometrycache->insertIfAbsent(way->id, way->polygon, (*way_it)[2].as<int>(0));
+            }
+            waycache.insert(std::pair(way->id, way));
+        }
+
+        // A ring of a relation may be split across open ways
+        missingIds.clear();
+        for (auto it = std::begin(waysIds); it != std::end(waysIds); ++it) {
+            if (!waycache.count(*it)) {
+                missingIds += std::to_string(*it) + ",";
+            }
+        }
+        if (missingIds.size() > 1) {
+            missingIds.erase(missingIds.size() - 1);
+            waysQuery = "SELECT distinct(osm_id), ST_AsText(geom, 4326) from ways_line where osm_id = any(ARRAY[" + missingIds + "])";
+            ways_result = dbconn->query(waysQuery);
+            for (auto way_it = ways_result.begin(); way_it != ways_result.end(); ++way_it) {
+                auto way = std::make_shared<OsmWay>();
+                way->id = (*way_it)[0].as<long>();
+                linestring_t line;
+                boost::geometry::read_wkt((*way_it)[1].as<std::string>(), line);
+                way->setLinestring(line);
+                waycache.insert(std::pair(way->id, way));
+            }
+        }
+    }
+    if (geometrycache) {
+        geometrycache->logStats();
     }
 }
 
 // TODO: divide this function into multiple ones
-void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const multipolygon_t &poly)
+void
+QueryRaw::storeNode(long id, const point_t &point, int version, osmobjects::action_t action) const
+{
+    // Keep the shared cache and the index up to date with the new locations
+    if (nodeindex) {
+        if (action == osmobjects::remove) {
+            nodeindex->erase(id, version);
+        } else {
+            nodeindex->set(id, point, version);
+        }
+    }
+    if (sharedcache) {
+        if (action == osmobjects::remove) {
+            sharedcache->erase(id, version);
+        } else {
+            sharedcache->insert(id, point, version);
+        }
+    }
+}
+
+void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const geoutil::BoundaryIndex &poly)
 {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("buildGeometries(osmchanges, poly): took %w seconds\n");
 #endif
-    std::string referencedNodeIds;
-    std::string modifiedNodesIds;
-    std::string modifiedWaysIds;
+    std::vector<long> referencedNodeIds;
+    std::vector<long> modifiedNodesIds;
+    std::vector<OsmNode *> modifiedNodes;
+    std::vector<long> modifiedWaysIds;
     std::vector<long> removedWays;
     std::vector<long> removedRelations;
 
@@ -457,18 +964,25 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
         OsmChange *change = it->get();
         for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
             OsmWay *way = wit->get();
+            if (nodeways) {
+                if (way->action == osmobjects::remove) {
+                    nodeways->erase(way->id, way->version);
+                } else {
+                    nodeways->update(way->id, way->refs, way->version);
+                }
+            }
             if (way->action != osmobjects::remove) {
                 // Save referenced nodes ids for later use
                 for (auto rit = std::begin(way->refs); rit != std::end(way->refs); ++rit) {
                     if (!osmchanges->nodecache.count(*rit)) {
-                        referencedNodeIds += std::to_string(*rit) + ",";
+                        referencedNodeIds.push_back(*rit);
                     }
                 }
                 // Save ways for later use
                 if (way->isClosed()) {
                     // Save only ways with a geometry that are inside the priority area
                     // these are mostly created ways
-                    if (poly.empty() || boost::geometry::within(way->linestring, poly)) {
+                    if (poly.empty() || poly.within(way->linestring())) {
                         osmchanges->waycache.insert(std::make_pair(way->id, std::make_shared<osmobjects::OsmWay>(*way)));
                     }
                 }
@@ -480,23 +994,44 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
         // Save modified nodes for later use
         for (auto nit = std::begin(change->nodes); nit != std::end(change->nodes); ++nit) {
             OsmNode *node = nit->get();
+            storeNode(node->id, node->point, node->version, node->action);
             if (node->action == osmobjects::modify) {
-                // Get only modified nodes ids inside the priority area
-                if (poly.empty() || boost::geometry::within(node->point, poly)) {
-                    modifiedNodesIds += std::to_string(node->id) + ",";
-                }
+                modifiedNodes.push_back(node);
             }
         }
+        // Nodes outside the boundary dropped while parsing still move
+        for (auto dit = std::begin(change->dropped); dit != std::end(change->dropped); ++dit) {
+            storeNode(dit->id, dit->point, dit->version, dit->action);
+        }
 
         for (auto rel_it = std::begin(change->relations); rel_it != std::end(change->relations); ++rel_it) {
             OsmRelation *relation = rel_it->get();
+            if (wayrelations) {
+                if (relation->action == osmobjects::remove) {
+                    wayrelations->erase(relation->id, relation->version);
+                } else {
+                    wayrelations->update(relation->id, wayMembers(*relation), relation->version);
+                }
+            }
             removedRelations.push_back(relation->id);
         }
     }
 
+    // Get only modified nodes ids inside the priority area, testing
+    // them all in one batch
+    std::vector<point_t> points;
+    for (auto nit = std::begin(modifiedNodes); !poly.empty() && nit != std::end(modifiedNodes); ++nit) {
+        points.push_back((*nit)->point);
+    }
+    std::vector<bool> inside = poly.within(points);
+    for (size_t i = 0; i < modifiedNodes.size(); i++) {
+        if (poly.empty() || inside[i]) {
+            modifiedNodesIds.push_back(modifiedNodes[i]->id);
+        }
+    }
+
     // Add indirectly modified ways to osmchanges
-    if (modifiedNodesIds.size() > 1) {
-        modifiedNodesIds.erase(modifiedNodesIds.size() - 1);
+    if (!modifiedNodesIds.empty()) {
         auto modifiedWays = getWaysByNodesRefs(modifiedNodesIds);
         auto change = std::make_shared<OsmChange>(none);
         for (auto wit = modifiedWays.begin(); wit != modifiedWays.end(); ++wit) {
@@ -504,22 +1039,21 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
            // Save referenced nodes for later use
            for (auto rit = std::begin(way->refs); rit != std::end(way->refs); ++rit) {
                if (!osmchanges->nodecache.count(*rit)) {
-                   referencedNodeIds += std::to_string(*rit) + ",";
+                   referencedNodeIds.push_back(*rit);
                }
            }
            // If the way is not marked as removed, mark it as modified
            if (std::find(removedWays.begin(), removedWays.end(), way->id) == removedWays.end()) {
                 way->action = osmobjects::modify;
                 change->ways.push_back(way);
-                modifiedWaysIds += std::to_string(way->id) + ",";
+                modifiedWaysIds.push_back(way->id);
            }
         }
         osmchanges->changes.push_back(change);
     }
 
     // Add indirectly modified relations to osmchanges
-    if (modifiedWaysIds.size() > 1) {
-        modifiedWaysIds.erase(modifiedWaysIds.size() - 1);
+    if (!modifiedWaysIds.empty()) {
         auto modifiedRelations = getRelationsByWaysRefs(modifiedWaysIds);
         auto change = std::make_shared<OsmChange>(none);
         for (auto rel_it = modifiedRelations.begin(); rel_it != modifiedRelations.end(); ++rel_it) {
@@ -535,39 +1069,29 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
     }
 
     // Fill nodecache with referenced nodes
-    if (referencedNodeIds.size() > 1) {
-        referencedNodeIds.erase(referencedNodeIds.size() - 1);
-        // Get Nodes from DB
-        std::string nodesQuery = "SELECT osm_id, st_x(geom) as lat, st_y(geom) as lon FROM nodes where osm_id in (" + referencedNodeIds + ");";
-        auto result = dbconn->query(nodesQuery);
-        // Fill nodecache
-        for (auto node_it = result.begin(); node_it != result.end(); ++node_it) {
-            auto node_id = (*node_it)[0].as<long>();
-            auto node_lat = (*node_it)[2].as<double>();
-            auto node_lon = (*node_it)[1].as<double>();
-            OsmNode node(node_lat, node_lon);
-            osmchanges->nodecache[node_id] = node.point;
-        }
-    }
+    resolveNodes(osmchanges, referencedNodeIds);
 
     // Build ways geometries using nodecache
     for (auto it = std::begin(osmchanges->changes); it != std::end(osmchanges->changes); it++) {
         OsmChange *change = it->get();
         for (auto wit = std::begin(change->ways); wit != std::end(change->ways); ++wit) {
             OsmWay *way = wit->get();
-            way->linestring.clear();
-            for (auto rit = way->refs.begin(); rit != way->refs.end(); ++rit) {
-                if (osmchanges->nodecache.count(*rit)) {
-                    boost::geometry::append(way->linestring, osmchanges->nodecache.at(*rit));
+            bool complete = way->buildGeometry(osmchanges->nodecache);
+            // Keep the cached geometry in step with the stream. When some
+            // nodes couldn't be found the geometry is incomplete, so it's
+            // dropped instead.
+            if (geometrycache) {
+                if (way->action != osmobjects::remove && way->isClosed() && complete) {
+                    geometrycache->insert(way->id, way->polygon, way->version);
+                } else {
+                    geometrycache->erase(way->id);
                 }
             }
-            if (way->isClosed()) {
-                way->polygon = { {std::begin(way->linestring), std::end(way->linestring)} };
-            }
             // Save way pointer for later use
-            if (poly.empty() || boost::geometry::within(way->linestring, poly)) {
+            if (poly.empty() || poly.within(way->linestring())) {
                 if (osmchanges->waycache.count(way->id)) {
-                    osmchanges->waycache.at(way->id)->polygon = way->polygon;
+                    auto cached = osmchanges->waycache.at(way->id);
+                    cached->polygon = way->polygon;
                 } else {
                     osmchanges->waycache.insert(std::make_pair(way->id, std::make_shared<osmobjects::OsmWay>(*way)));
                 }
@@ -576,7 +1100,7 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
     }
 
     // Filter out all relations that doesn't have at least 1 way in cache
-    std::string relsForWayCacheIds;
+    std::vector<long> relsForWayCacheIds;
     for (auto it = std::begin(osmchanges->changes); it != std::end(osmchanges->changes); it++) {
         OsmChange *change = it->get();
         for (auto rel_it = std::begin(change->relations); rel_it != std::end(change->relations); ++rel_it) {
@@ -592,8 +1116,8 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
                 if (getWaysForRelation) {
                     relation->priority = true;
                     for (auto mit = relation->members.begin(); mit != relation->members.end(); ++mit) {
-                        if (!osmchanges->waycache.count(mit->ref)) {
-                           relsForWayCacheIds += std::to_string(mit->ref) + ",";
+                        if (mit->type == osmobjects::way && !osmchanges->waycache.count(mit->ref)) {
+                           relsForWayCacheIds.push_back(mit->ref);
                         }
                     }
                 } else {
@@ -603,8 +1127,7 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
         }
     }
     // Get all missing ways geometries for relations
-    if (relsForWayCacheIds != "") {
-        relsForWayCacheIds.erase(relsForWayCacheIds.size() - 1);
+    if (!relsForWayCacheIds.empty()) {
         getWaysByIds(relsForWayCacheIds, osmchanges->waycache);
     }
 
@@ -613,69 +1136,38 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
         OsmChange *change = it->get();
         for (auto rel_it = std::begin(change->relations); rel_it != std::end(change->relations); ++rel_it) {
             OsmRelation *relation = rel_it->get();
-            if (relation->priority) {
-                bool first = true;
-                bool isMultiPolygon = relation->isMultiPolygon();
-                bool isMultiLineString = relation->isMultiLineString();
-                if (isMultiPolygon || isMultiLineString) {
-                    std::string innerGeoStr;
-                    std::string geometry_str;
-                    if (isMultiPolygon) {
-                        geometry_str = "MULTIPOLYGON((";
-                    } else {
-                        geometry_str = "MULTILINESTRING((";
+            if (relation->priority && (relation->isMultiPolygon() || relation->isMultiLineString())) {
+                // Join the member ways, nodes and sub relations aren't
+                // part of the geometry
+                RingAssembler rings;
+                bool noWay = false;
+                for (auto mit = relation->members.begin(); mit != relation->members.end(); ++mit) {
+                    if (mit->type != osmobjects::way) {
+                        continue;
                     }
-                    bool noWay = false;
-                    for (auto mit = relation->members.begin(); mit != relation->members.end(); ++mit) {
-                        if (!osmchanges->waycache.count(mit->ref)) {
-                            noWay = true;
-                            break;
-                        }
-                        auto way = osmchanges->waycache.at(mit->ref);
-
-                        if ((!isMultiPolygon && boost::geometry::num_points(way->linestring) == 0) ||
-                            (isMultiPolygon && boost::geometry::num_points(way->polygon) == 0)
-                        ) {
-                            noWay = true;
-                            break;
-                        }
-                        std::stringstream ss;
-                        std::string geometry;
-
-                        if (isMultiPolygon) {
-                            ss << std::setprecision(12) << boost::geometry::wkt(way->polygon);
-                            geometry = ss.str();
-                            geometry.erase(0,8);
-                        } else {
-                            ss << std::setprecision(12) << boost::geometry::wkt(way->linestring);
-                            geometry = ss.str();
-                            geometry.erase(0,11);
-                        }
-                        
-                        geometry.erase(geometry.size() - 1);
-                        if (first && (mit->role == "outer")) {
-                            geometry_str += geometry + ",";
-                        } else {
-                            if (mit->role == "inner") {
-                                innerGeoStr += geometry + ",";
-                            } else {
-                                geometry_str += geometry + ",";
-                                geometry_str += innerGeoStr;
-                                innerGeoStr = "";
-                            }
-                        }
+                    if (!osmchanges->waycache.count(mit->ref)) {
+                        noWay = true;
+                        break;
                     }
-                    if (innerGeoStr.size() > 0) {
-                        geometry_str += innerGeoStr;
+                    auto way = osmchanges->waycache.at(mit->ref);
+                    // The polygon of a cached closed way is kept up to
+                    // date, open ways only have a linestring
+                    if (boost::geometry::num_points(way->polygon) > 0) {
+                        rings.add(way->polygon);
+                    } else if (boost::geometry::num_points(way->linestring()) > 0) {
+                        rings.add(way->linestring());
+                    } else {
+                        noWay = true;
+                        break;
                     }
-                    geometry_str.erase(geometry_str.size() - 1);
-                    geometry_str += "))";
-                    if (!noWay) {
-                        if (isMultiPolygon) {
-                            boost::geometry::read_wkt(geometry_str, relation->multipolygon);
-                        } else {
-                            boost::geometry::read_wkt(geometry_str, relation->multilinestring);
+                }
+                if (!noWay && rings.size() > 0) {
+                    if (relation->isMultiPolygon()) {
+                        if (!rings.multipolygon(relation->multipolygon)) {
+                            log_debug("Relation %1% has rings that aren't closed", relation->id);
                         }
+                    } else {
+                        rings.multilinestring(relation->multilinestring);
                     }
                 }
             }
@@ -684,7 +1176,56 @@ void QueryRaw::buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const
 }
 
 void
-QueryRaw::getNodeCacheFromWays(std::shared_ptr<std::vector<OsmWay>> ways, std::map<double, point_t> &nodecache) const
+QueryRaw::resolveNodes(std::shared_ptr<OsmChangeFile> osmchanges, std::vector<long> &nodeIds)
+{
+    std::sort(nodeIds.begin(), nodeIds.end());
+    nodeIds.erase(std::unique(nodeIds.begin(), nodeIds.end()), nodeIds.end());
+    osmchanges->nodecache.reserve(osmchanges->nodecache.size() + nodeIds.size());
+
+    // Only query the database for nodes no other file has needed lately
+    std::string missingIds;
+    point_t point;
+    for (auto it = std::begin(nodeIds); it != std::end(nodeIds); ++it) {
+        if (osmchanges->nodecache.count(*it)) {
+            continue;
+        }
+        if (nodeindex && nodeindex->get(*it, point)) {
+            osmchanges->nodecache.insert(*it, point);
+        } else if (sharedcache && sharedcache->get(*it, point)) {
+            osmchanges->nodecache.insert(*it, point);
+        } else {
+            missingIds += std::to_string(*it) + ",";
+        }
+    }
+
+    if (missingIds.size() > 1) {
+        missingIds.erase(missingIds.size() - 1);
+        // Get Nodes from DB
+        std::string nodesQuery = "SELECT osm_id, st_x(geom) as lat, st_y(geom) as lon, version FROM nodes where osm_id in (" + missingIds + ");";
+        auto result = dbconn->query(nodesQuery);
+        // Fill nodecache
+        for (auto node_it = result.begin(); node_it != result.end(); ++node_it) {
+            auto node_id = (*node_it)[0].as<long>();
+            auto node_lat = (*node_it)[2].as<double>();
+            auto node_lon = (*node_it)[1].as<double>();
+            OsmNode node(node_lat, node_lon);
+            int version = (*node_it)[3].as<int>(0);
+            osmchanges->nodecache.insert(node_id, node.point);
+            if (sharedcache) {
+                sharedcache->insertIfAbsent(node_id, node.point, version);
+            }
+            if (nodeindex) {
+                nodeindex->set(node_id, node.point, version);
+            }
+        }
+    }
+    if (sharedcache) {
+        sharedcache->logStats();
+    }
+}
+
+void
+QueryRaw::getNodeCacheFromWays(std::shared_ptr<std::vector<OsmWay>> ways, osmobjects::NodeCache &nodecache) const
 {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("getNodeCacheFromWays(ways, nodecache): took %w seconds\n");
@@ -710,13 +1251,13 @@ QueryRaw::getNodeCacheFromWays(std::shared_ptr<std::vector<OsmWay>> ways, std::m
             auto node_lat = (*node_it)[1].as<double>();
             auto node_lon = (*node_it)[2].as<double>();
             auto point = point_t(node_lat, node_lon);
-            nodecache.insert(std::make_pair(node_id, point));
+            nodecache.insert(node_id, point);
         }
     }
 }
 
 std::list<std::shared_ptr<OsmWay>>
-QueryRaw::getWaysByNodesRefs(std::string &nodeIds) const
+QueryRaw::getWaysByNodesRefs(std::vector<long> &nodeIds) const
 {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("getWaysByNodesRefs(nodeIds): took %w seconds\n");
@@ -724,8 +1265,22 @@ QueryRaw::getWaysByNodesRefs(std::string &nodeIds) const
     // Get all ways that have references to nodes
     std::list<std::shared_ptr<osmobjects::OsmWay>> ways;
 
-    std::string waysQuery = "SELECT distinct(osm_id), refs, version, tags, uid, changeset from way_refs join ways_poly wp on wp.osm_id = way_id where node_id = any(ARRAY[" + nodeIds + "])";
-    waysQuery += " UNION SELECT distinct(osm_id), refs, version, tags, uid, changeset from way_refs join ways_line wl on wl.osm_id = way_id where node_id = any(ARRAY[" + nodeIds + "]);";
+    std::string waysQuery;
+    if (nodeways) {
+        // The index has the way IDs, so only the primary keys are used
+        std::vector<long> wayIds;
+        nodeways->lookup(nodeIds, wayIds);
+        if (wayIds.empty()) {
+            return ways;
+        }
+        std::string ids = idsToString(wayIds);
+        waysQuery = "SELECT osm_id, refs, version, tags, uid, changeset from ways_poly where osm_id = any(ARRAY[" + ids + "])";
+        waysQuery += " UNION SELECT osm_id, refs, version, tags, uid, changeset from ways_line where osm_id = any(ARRAY[" + ids + "]);";
+    } else {
+        std::string ids = idsToString(nodeIds);
+        waysQuery = "SELECT distinct(osm_id), refs, version, tags, uid, changeset from way_refs join ways_poly wp on wp.osm_id = way_id where node_id = any(ARRAY[" + ids + "])";
+        waysQuery += " UNION SELECT distinct(osm_id), refs, version, tags, uid, changeset from way_refs join ways_line wl on wl.osm_id = way_id where node_id = any(ARRAY[" + ids + "]);";
+    }
     auto ways_result = dbconn->query(waysQuery);
 
     // Fill vector of OsmWay objects
@@ -758,6 +1313,87 @@ QueryRaw::getWaysByNodesRefs(std::string &nodeIds) const
     return ways;
 }
 
+void
+QueryRaw::loadRefIndexes(int pageSize)
+{
+#ifdef TIMING_DEBUG
+    boost::timer::auto_cpu_timer timer("loadRefIndexes(pageSize): took %w seconds\n");
+#endif
+    nodeways = std::make_shared<RefIndex>();
+    wayrelations = std::make_shared<RefIndex>();
+
+    // Page through each table by primary key, like the bootstrap does
+    const std::vector<std::string> tables = {QueryRaw::polyTable, QueryRaw::lineTable, "relations"};
+    for (auto table_it = tables.begin(); table_it != tables.end(); ++table_it) {
+        bool relations = (*table_it == "relations");
+        long lastid = 0;
+        while (true) {
+            std::string query = "SELECT osm_id, refs FROM " + *table_it;
+            if (lastid > 0) {
+                query += " where osm_id < " + std::to_string(lastid);
+            }
+            query += " order by osm_id desc limit " + std::to_string(pageSize) + ";";
+            auto result = dbconn->query(query);
+            if (result.empty()) {
+                break;
+            }
+            for (auto row_it = result.begin(); row_it != result.end(); ++row_it) {
+                lastid = (*row_it)[0].as<long>();
+                if ((*row_it)[1].is_null()) {
+                    continue;
+                }
+                std::string refs_str = (*row_it)[1].as<std::string>();
+                if (relations) {
+                    wayrelations->load(lastid, memberWays(refs_str));
+                } else if (refs_str.size() > 2) {
+                    nodeways->load(lastid, arrayStrToVector(refs_str));
+                }
+            }
+        }
+    }
+    nodeways->seal();
+    wayrelations->seal();
+    log_info("Loaded %1% way references and %2% relation references", nodeways->size(), wayrelations->size());
+}
+
+std::shared_ptr<buildingindex::BuildingIndex>
+QueryRaw::loadBuildings(int pageSize) const
+{
+#ifdef TIMING_DEBUG
+    boost::timer::auto_cpu_timer timer("loadBuildings(pageSize): took %w seconds\n");
+#endif
+    auto buildings = std::make_shared<buildingindex::BuildingIndex>();
+    long lastid = 0;
+    while (true) {
+        std::string query = "SELECT osm_id, version, ST_AsText(geom, 4326), tags->>'layer' FROM " + QueryRaw::polyTable;
+        query += " where tags ? 'building'";
+        if (lastid > 0) {
+            query += " and osm_id < " + std::to_string(lastid);
+        }
+        query += " order by osm_id desc limit " + std::to_string(pageSize) + ";";
+        auto result = dbconn->query(query);
+        if (result.empty()) {
+            break;
+        }
+        for (auto row_it = result.begin(); row_it != result.end(); ++row_it) {
+            lastid = (*row_it)[0].as<long>();
+            if ((*row_it)[2].is_null()) {
+                continue;
+            }
+            polygon_t polygon;
+            boost::geometry::read_wkt((*row_it)[2].as<std::string>(), polygon);
+            std::string layer;
+            if (!(*row_it)[3].is_null()) {
+                layer = (*row_it)[3].as<std::string>();
+            }
+            buildings->load(lastid, (*row_it)[1].is_null() ? 0 : (*row_it)[1].as<int>(), polygon, layer);
+        }
+    }
+    buildings->seal();
+    log_info("Loaded %1% buildings", buildings->size());
+    return buildings;
+}
+
 int QueryRaw::getCount(const std::string &tableName) {
     std::string query = "select count(osm_id) from " + tableName;
     auto result = dbconn->query(query);
@@ -784,7 +1420,7 @@ QueryRaw::getNodesFromDB(long lastid, int pageSize) {
         point_t point;
         std::string point_str = (*node_it)[1].as<std::string>();
         boost::geometry::read_wkt(point_str, point);
-        node.setPoint(boost::geometry::get<0>(point), boost::geometry::get<1>(point));
+        node.setPoint(boost::geometry::get<1>(point), boost::geometry::get<0>(point));
         node.version = (*node_it)[2].as<long>();
         auto tags = (*node_it)[3];
         if (!tags.is_null()) {
@@ -826,10 +1462,12 @@ QueryRaw::getWaysFromDB(long lastid, int pageSize, const std::string &tableName)
             way.refs = arrayStrToVector(refs_str);
 
             std::string poly = (*way_it)[2].as<std::string>();
-            boost::geometry::read_wkt(poly, way.linestring);
+            linestring_t line;
+            boost::geometry::read_wkt(poly, line);
+            way.setLinestring(line);
 
             if (tableName == QueryRaw::polyTable) {
-                way.polygon = { {std::begin(way.linestring), std::end(way.linestring)} };
+                way.polygon = { {std::begin(line), std::end(line)} };
             }
             way.version = (*way_it)[3].as<long>();
             auto tags = (*way_it)[4];
@@ -869,10 +1507,12 @@ QueryRaw::getWaysFromDBWithoutRefs(long lastid, int pageSize, const std::string
         way.id = (*way_it)[0].as<long>();
 
         std::string poly = (*way_it)[1].as<std::string>();
-        boost::geometry::read_wkt(poly, way.linestring);
+        linestring_t line;
+        boost::geometry::read_wkt(poly, line);
+        way.setLinestring(line);
 
         if (tableName == QueryRaw::polyTable) {
-            way.polygon = { {std::begin(way.linestring), std::end(way.linestring)} };
+            way.polygon = { {std::begin(line), std::end(line)} };
         }
         auto tags = (*way_it)[2];
         if (!tags.is_null()) {
@@ -908,7 +1548,7 @@ QueryRaw::getRelationsFromDB(long lastid, int pageSize) {
         if (!refs.is_null()) {
             auto refs = parseJSONArrayStr((*rel_it)[1].as<std::string>());
             for (auto ref_it = refs.begin(); ref_it != refs.end(); ++ref_it) {
-                if (ref_it->at("type") == "w" && (ref_it->at("role") == "inner" || ref_it->at("role") == "outer")) {
+                if (isWayMember(*ref_it) && (ref_it->at("role") == "inner" || ref_it->at("role") == "outer")) {
                     relation.addMember(
                         std::stoi(ref_it->at("ref")),
                         osmobjects::osmtype_t::way,
@@ -35,8 +35,15 @@
 #include <iostream>
 #include <map>
 #include "data/pq.hh"
+#include "data/copywriter.hh"
+#include "data/prepared.hh"
 #include "osm/osmobjects.hh"
 #include "osm/osmchange.hh"
+#include "raw/geometrycache.hh"
+#include "raw/nodeindex.hh"
+#include "raw/refindex.hh"
+#include "raw/sharednodecache.hh"
+#include "validate/buildingindex.hh"
 
 using namespace pq;
 using namespace osmobjects;
@@ -66,22 +73,61 @@ class QueryRaw {
     std::string applyChange(const OsmWay &way) const;
     /// Build query for processed Relation
     std::string applyChange(const OsmRelation &relation) const;
+    /// Stage a processed Node for a COPY writer
+    void applyChange(const OsmNode &node, pq::CopyWriter &copy) const;
+    /// Stage a processed Way for a COPY writer
+    void applyChange(const OsmWay &way, pq::CopyWriter &copy) const;
+    /// Stage a processed Relation for a COPY writer
+    void applyChange(const OsmRelation &relation, pq::CopyWriter &copy) const;
+    /// Add the prepared statements for a processed Node to a batch
+    void applyChange(const OsmNode &node, pq::PreparedBatch &batch) const;
+    /// Add the prepared statements for a processed Way to a batch
+    void applyChange(const OsmWay &way, pq::PreparedBatch &batch) const;
+    /// Add the prepared statements for a processed Relation to a batch
+    void applyChange(const OsmRelation &relation, pq::PreparedBatch &batch) const;
     /// Build all geometries for osmchanges
-    void buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const multipolygon_t &poly);
+    void buildGeometries(std::shared_ptr<OsmChangeFile> osmchanges, const geoutil::BoundaryIndex &poly);
+    /// Record a new location or a deletion in the node index and the
+    /// shared cache
+    void storeNode(long id, const point_t &point, int version, osmobjects::action_t action) const;
+    /// Fill the node cache of a change file with the locations of
+    /// these nodes, first from the node index and the shared cache,
+    /// then from the database
+    void resolveNodes(std::shared_ptr<OsmChangeFile> osmchanges, std::vector<long> &nodeIds);
     /// Get nodes for filling Node cache from ways refs
-    void getNodeCacheFromWays(std::shared_ptr<std::vector<OsmWay>> ways, std::map<double, point_t> &nodecache) const;
+    void getNodeCacheFromWays(std::shared_ptr<std::vector<OsmWay>> ways, osmobjects::NodeCache &nodecache) const;
     // Get ways by refs
-    std::list<std::shared_ptr<OsmWay>> getWaysByNodesRefs(std::string &nodeIds) const;
+    std::list<std::shared_ptr<OsmWay>> getWaysByNodesRefs(std::vector<long> &nodeIds) const;
     // Get ways by ids (used for getting relations geometries)
-    void getWaysByIds(std::string &relsForWayCacheIds, std::map<long, std::shared_ptr<osmobjects::OsmWay>> &waycache);
+    void getWaysByIds(std::vector<long> &relsForWayCacheIds, std::map<long, std::shared_ptr<osmobjects::OsmWay>> &waycache);
     // Get relations by referenced ways
-    std::list<std::shared_ptr<OsmRelation>> getRelationsByWaysRefs(std::string &wayIds) const;
+    std::list<std::shared_ptr<OsmRelation>> getRelationsByWaysRefs(std::vector<long> &wayIds) const;
+    // Get the way members from the refs of a relation, in the format
+    // written by osm2pgsql or by applyChange()
+    static std::vector<long> memberWays(const std::string &refs);
+    // Fill the reference indexes from the ways and relations tables
+    void loadRefIndexes(int pageSize);
+    // Read the buildings from the ways_poly table into a spatial index
+    std::shared_ptr<buildingindex::BuildingIndex> loadBuildings(int pageSize) const;
     // DB connection
     std::shared_ptr<Pq> dbconn;
+    // Node locations shared by all threads, may be null
+    std::shared_ptr<SharedNodeCache> sharedcache;
+    // Node locations on disk, may be null
+    std::shared_ptr<NodeIndex> nodeindex;
+    // Way polygons shared by all threads, may be null
+    std::shared_ptr<GeometryCache> geometrycache;
+    // Node to way and way to relation references, may be null
+    std::shared_ptr<RefIndex> nodeways;
+    std::shared_ptr<RefIndex> wayrelations;
     // Get ways count
     int getCount(const std::string &tableName);
     // Build tags query
     std::string buildTagsQuery(std::map<std::string, std::string> tags) const;
+    // Build tags as a JSON object, for the COPY writer
+    std::string buildTagsJSON(const std::map<std::string, std::string> &tags) const;
+    // Build relation members as a JSON array, for the COPY writer
+    std::string buildMembersJSON(const std::list<OsmRelationMember> &members) const;
     // Get ways by page
     std::shared_ptr<std::vector<OsmWay>> getWaysFromDB(long lastid, int pageSize, const std::string &tableName);
     std::shared_ptr<std::vector<OsmWay>> getWaysFromDBWithoutRefs(long lastid, int pageSize, const std::string &tableName);
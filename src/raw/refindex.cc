@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <mutex>
+
+#include "raw/refindex.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace queryraw
+namespace queryraw {
+
+// Merge the changes once there are this many, or one for every 8
+// references in the arrays, whichever is larger
+static const size_t min_compact = 100000;
+
+void
+RefIndex::load(int64_t parent, const std::vector<long> &children)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    for (auto it = std::begin(children); it != std::end(children); ++it) {
+        pending.push_back(std::make_pair(*it, parent));
+    }
+}
+
+void
+RefIndex::seal(void)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    compact();
+}
+
+void
+RefIndex::compact(void)
+{
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    edges.swap(pending);
+    edges.reserve(edges.size() + values.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        for (uint64_t j = offsets[i]; j < offsets[i + 1]; j++) {
+            if (!overrides.count(values[j])) {
+                edges.push_back(std::make_pair(keys[i], values[j]));
+            }
+        }
+    }
+    for (auto it = std::begin(overrides); it != std::end(overrides); ++it) {
+        for (auto cit = std::begin(it->second.children); cit != std::end(it->second.children); ++cit) {
+            edges.push_back(std::make_pair(*cit, it->first));
+        }
+    }
+    overrides.clear();
+    added.clear();
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    keys.clear();
+    offsets.clear();
+    values.clear();
+    values.reserve(edges.size());
+    for (auto it = std::begin(edges); it != std::end(edges); ++it) {
+        if (keys.empty() || keys.back() != it->first) {
+            keys.push_back(it->first);
+            offsets.push_back(values.size());
+        }
+        values.push_back(it->second);
+    }
+    offsets.push_back(values.size());
+    keys.shrink_to_fit();
+    offsets.shrink_to_fit();
+    log_debug("Reference index has %1% references to %2% objects", values.size(), keys.size());
+}
+
+void
+RefIndex::update(int64_t parent, const std::vector<long> &children, int version)
+{
+    std::vector<int64_t> sorted(children.begin(), children.end());
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    std::unique_lock<std::shared_mutex> guard(lock);
+    auto found = versions.find(parent);
+    if (found != versions.end() && found->second > version) {
+        return;
+    }
+    versions[parent] = version;
+    for (auto it = std::begin(sorted); it != std::end(sorted); ++it) {
+        auto &parents = added[*it];
+        if (std::find(parents.begin(), parents.end(), parent) == parents.end()) {
+            parents.push_back(parent);
+        }
+    }
+    overrides[parent] = Override{version, std::move(sorted)};
+    if (overrides.size() > std::max(min_compact, values.size() / 8)) {
+        compact();
+    }
+}
+
+void
+RefIndex::erase(int64_t parent, int version)
+{
+    update(parent, std::vector<long>(), version);
+}
+
+void
+RefIndex::lookup(const std::vector<long> &children, std::vector<long> &parents) const
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    size_t start = parents.size();
+    for (auto it = std::begin(children); it != std::end(children); ++it) {
+        int64_t child = *it;
+        auto key = std::lower_bound(keys.begin(), keys.end(), child);
+        if (key != keys.end() && *key == child) {
+            size_t i = key - keys.begin();
+            for (uint64_t j = offsets[i]; j < offsets[i + 1]; j++) {
+                if (overrides.empty() || !overrides.count(values[j])) {
+                    parents.push_back(values[j]);
+                }
+            }
+        }
+        auto found = added.find(child);
+        if (found == added.end()) {
+            continue;
+        }
+        for (auto pit = std::begin(found->second); pit != std::end(found->second); ++pit) {
+            const Override &current = overrides.at(*pit);
+            if (std::binary_search(current.children.begin(), current.children.end(), child)) {
+                parents.push_back(*pit);
+            }
+        }
+    }
+    std::sort(parents.begin() + start, parents.end());
+    parents.erase(std::unique(parents.begin() + start, parents.end()), parents.end());
+}
+
+size_t
+RefIndex::size(void) const
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return values.size();
+}
+
+size_t
+RefIndex::changes(void) const
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return overrides.size();
+}
+
+} // namespace queryraw
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
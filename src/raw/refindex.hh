@@ -0,0 +1,122 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __REFINDEX_HH__
+#define __REFINDEX_HH__
+
+/// \file refindex.hh
+/// \brief An in-memory reverse index of OSM references
+///
+/// When a node moves, every way that uses it has a new geometry, and
+/// when a way changes so does every relation it's a member of. Finding
+/// them used to be a join against the way_refs and rel_refs tables for
+/// every file. This keeps the same references in memory, as a child to
+/// parents map. The bulk of it is in compressed sparse row form, which
+/// is three flat arrays sorted by the child ID. Changes applied since
+/// are kept in a small table on the side, and merged back in once it
+/// gets large.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// \namespace queryraw
+namespace queryraw {
+
+/// \class RefIndex
+/// \brief Map child IDs to the IDs of the parents that reference them
+///
+/// The parents are ways and the children nodes, or the parents are
+/// relations and the children ways. Lookups can run in parallel.
+class RefIndex {
+  public:
+    RefIndex(void) {};
+
+    /// Queue the references of a parent read from the database. They
+    /// can be looked up once seal() is called.
+    void load(int64_t parent, const std::vector<long> &children);
+    /// Merge everything queued by load() and all the changes into the
+    /// sorted arrays
+    void seal(void);
+
+    /// Replace the references of a parent from a change file. A parent
+    /// is never replaced by an older version, as files may be processed
+    /// out of order.
+    void update(int64_t parent, const std::vector<long> &children, int version);
+    /// Drop the references of a deleted parent
+    void erase(int64_t parent, int version);
+
+    /// Append the parents of all these children, sorted with no
+    /// duplicates
+    void lookup(const std::vector<long> &children, std::vector<long> &parents) const;
+
+    /// The number of references in the sorted arrays
+    size_t size(void) const;
+    /// The number of parents changed since the last merge
+    size_t changes(void) const;
+
+  private:
+    /// The current references of a changed parent
+    struct Override {
+        int version;
+        std::vector<int64_t> children;  ///< Sorted, empty when deleted
+    };
+
+    /// Merge all the changes without taking the lock
+    void compact(void);
+
+    // The compressed sparse row arrays. The parents of keys[i] are
+    // values[offsets[i]] up to values[offsets[i + 1]].
+    std::vector<int64_t> keys;
+    std::vector<uint64_t> offsets;
+    std::vector<int64_t> values;
+
+    /// Parents changed since the arrays were built. Their entries in
+    /// the arrays are ignored.
+    std::unordered_map<int64_t, Override> overrides;
+    /// The newest version of every parent changed or deleted since
+    /// the start. Unlike the overrides this survives compact(), so an
+    /// older file processed late can't bring back a replaced list of
+    /// references or a deleted parent.
+    std::unordered_map<int64_t, int> versions;
+    /// Child to changed parents. This may have stale entries, which
+    /// are checked against the overrides.
+    std::unordered_map<int64_t, std::vector<int64_t>> added;
+    /// (child, parent) pairs queued by load()
+    std::vector<std::pair<int64_t, int64_t>> pending;
+
+    mutable std::shared_mutex lock;
+};
+
+} // namespace queryraw
+
+#endif // EOF __REFINDEX_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,209 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <boost/geometry.hpp>
+
+#include "raw/ringassembler.hh"
+
+/// \namespace queryraw
+namespace queryraw {
+
+namespace {
+
+typedef std::pair<double, double> endpoint_t;
+
+endpoint_t
+endpoint(const point_t &point)
+{
+    return std::make_pair(point.get<0>(), point.get<1>());
+}
+
+bool
+same(const point_t &a, const point_t &b)
+{
+    return a.get<0>() == b.get<0>() && a.get<1>() == b.get<1>();
+}
+
+/// Is ring A inside ring B. They may share vertices and edges, so the
+/// first vertex of A that's not on the edge of B decides.
+bool
+contains(const polygon_t::ring_type &b, const polygon_t::ring_type &a)
+{
+    for (auto it = std::begin(a); it != std::end(a); ++it) {
+        if (boost::geometry::within(*it, b)) {
+            return true;
+        }
+        if (!boost::geometry::covered_by(*it, b)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+void
+RingAssembler::add(const linestring_t &line)
+{
+    if (line.size() > 1) {
+        members.push_back(line);
+    }
+}
+
+void
+RingAssembler::add(const polygon_t &poly)
+{
+    if (poly.outer().size() > 1) {
+        members.push_back(linestring_t(std::begin(poly.outer()), std::end(poly.outer())));
+    }
+}
+
+bool
+RingAssembler::join(std::vector<linestring_t> &lines) const
+{
+    // Index the open members by both of their end points
+    std::map<endpoint_t, std::vector<size_t>> ends;
+    for (size_t i = 0; i < members.size(); i++) {
+        if (!same(members[i].front(), members[i].back())) {
+            ends[endpoint(members[i].front())].push_back(i);
+            ends[endpoint(members[i].back())].push_back(i);
+        }
+    }
+
+    bool complete = true;
+    std::vector<bool> used(members.size(), false);
+    for (size_t i = 0; i < members.size(); i++) {
+        if (used[i]) {
+            continue;
+        }
+        used[i] = true;
+        linestring_t chain = members[i];
+        // Add members to the end of the chain until it closes or there
+        // are no more. Then do the same at the start.
+        for (int pass = 0; pass < 2 && !same(chain.front(), chain.back()); pass++) {
+            if (pass == 1) {
+                std::reverse(chain.begin(), chain.end());
+            }
+            while (!same(chain.front(), chain.back())) {
+                auto found = ends.find(endpoint(chain.back()));
+                if (found == ends.end()) {
+                    break;
+                }
+                auto next = std::find_if(found->second.begin(), found->second.end(),
+                                         [&used](size_t index) { return !used[index]; });
+                if (next == found->second.end()) {
+                    break;
+                }
+                used[*next] = true;
+                const linestring_t &line = members[*next];
+                if (same(line.front(), chain.back())) {
+                    chain.insert(chain.end(), line.begin() + 1, line.end());
+                } else {
+                    chain.insert(chain.end(), line.rbegin() + 1, line.rend());
+                }
+            }
+            if (pass == 1) {
+                std::reverse(chain.begin(), chain.end());
+            }
+        }
+        if (!same(chain.front(), chain.back())) {
+            complete = false;
+        }
+        lines.push_back(std::move(chain));
+    }
+    return complete;
+}
+
+bool
+RingAssembler::multipolygon(multipolygon_t &result) const
+{
+    result.clear();
+    std::vector<linestring_t> lines;
+    bool complete = join(lines);
+
+    std::vector<polygon_t::ring_type> rings;
+    for (auto it = std::begin(lines); it != std::end(lines); ++it) {
+        if (it->size() > 3 && same(it->front(), it->back())) {
+            rings.push_back(polygon_t::ring_type(std::begin(*it), std::end(*it)));
+        } else {
+            complete = false;
+        }
+    }
+
+    // Place the biggest rings first, so a ring's container has already
+    // been placed, and the last one found is the smallest
+    std::vector<double> areas;
+    std::vector<boost::geometry::model::box<point_t>> boxes;
+    std::vector<size_t> order;
+    for (size_t i = 0; i < rings.size(); i++) {
+        areas.push_back(std::abs(boost::geometry::area(rings[i])));
+        boxes.push_back(boost::geometry::return_envelope<boost::geometry::model::box<point_t>>(rings[i]));
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&areas](size_t a, size_t b) { return areas[a] > areas[b]; });
+
+    std::vector<long> parent(rings.size(), -1);
+    std::vector<int> depth(rings.size(), 0);
+    std::vector<size_t> polygon(rings.size(), 0);
+    for (size_t k = 0; k < order.size(); k++) {
+        size_t ring = order[k];
+        for (size_t p = k; p-- > 0;) {
+            size_t other = order[p];
+            if (boost::geometry::covered_by(boxes[ring], boxes[other]) &&
+                contains(rings[other], rings[ring])) {
+                parent[ring] = other;
+                depth[ring] = depth[other] + 1;
+                break;
+            }
+        }
+        if (depth[ring] % 2 == 0) {
+            polygon[ring] = result.size();
+            result.resize(result.size() + 1);
+            result.back().outer() = rings[ring];
+        } else {
+            result[polygon[parent[ring]]].inners().push_back(rings[ring]);
+        }
+    }
+    return complete;
+}
+
+void
+RingAssembler::multilinestring(multilinestring_t &result) const
+{
+    result.clear();
+    std::vector<linestring_t> lines;
+    join(lines);
+    result.insert(result.end(), lines.begin(), lines.end());
+}
+
+} // namespace queryraw
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,88 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __RINGASSEMBLER_HH__
+#define __RINGASSEMBLER_HH__
+
+/// \file ringassembler.hh
+/// \brief Build relation geometries from the geometries of member ways
+///
+/// The members of a multipolygon relation are ways, and a ring of the
+/// final geometry is often split across several of them, as admin
+/// boundaries share their edges with the neighbouring areas. This
+/// joins the member ways by their shared end points into closed rings,
+/// and then works out which rings are holes by how they nest, as the
+/// member roles are often wrong. A ring inside an odd number of other
+/// rings is a hole in the smallest of them, and anything else is the
+/// outer ring of a new polygon, so islands in holes work too.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <vector>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace queryraw
+namespace queryraw {
+
+/// \class RingAssembler
+/// \brief Join the member ways of a relation into rings or lines
+class RingAssembler {
+  public:
+    RingAssembler(void) {};
+
+    /// Add the geometry of a member way
+    void add(const linestring_t &line);
+    /// Add a member way stored as a polygon
+    void add(const polygon_t &poly);
+
+    /// Join the members into rings and nest them. Members that can't
+    /// be closed into a ring are left out, and false is returned. The
+    /// rings keep the direction of the member ways, so a closed way is
+    /// written out exactly as it was, use boost::geometry::correct()
+    /// when the orientation matters.
+    bool multipolygon(multipolygon_t &result) const;
+    /// Join the members end to end into as few lines as possible
+    void multilinestring(multilinestring_t &result) const;
+
+    /// The number of members added
+    size_t size(void) const { return members.size(); };
+    /// Forget all the members
+    void clear(void) { members.clear(); };
+
+  private:
+    /// Join the members by their end points. Returns false if some
+    /// lines couldn't be closed.
+    bool join(std::vector<linestring_t> &lines) const;
+
+    std::vector<linestring_t> members;
+};
+
+} // namespace queryraw
+
+#endif // EOF __RINGASSEMBLER_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
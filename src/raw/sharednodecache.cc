@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+
+#include "raw/sharednodecache.hh"
+#include "osm/nodecache.hh"
+#include "utils/log.hh"
+
+using namespace logger;
+
+/// \namespace queryraw
+namespace queryraw {
+
+SharedNodeCache::SharedNodeCache(size_t capacity)
+{
+    per_shard = std::max<size_t>(capacity / shard_count, 1);
+    for (auto it = std::begin(shards); it != std::end(shards); ++it) {
+        it->index.reserve(per_shard);
+    }
+}
+
+uint32_t
+SharedNodeCache::allocate(Shard &shard)
+{
+    if (shard.entries.size() < per_shard) {
+        shard.entries.push_back(Entry{empty_id, 0, 0, 0, false, false});
+        return shard.entries.size() - 1;
+    }
+    // Give every recently used entry a second chance
+    while (true) {
+        Entry &entry = shard.entries[shard.hand];
+        uint32_t slot = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+        if (entry.referenced) {
+            entry.referenced = false;
+        } else {
+            if (entry.deleted) {
+                shard.deleted--;
+            }
+            shard.index.erase(entry.id);
+            return slot;
+        }
+    }
+}
+
+void
+SharedNodeCache::store(int64_t id, const point_t &point, int version, bool replace)
+{
+    Shard &shard = this->shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(id);
+    if (found != shard.index.end()) {
+        Entry &entry = shard.entries[found->second];
+        if (entry.deleted) {
+            // Only a newer version can bring back a deleted node
+            if (version > entry.version) {
+                entry.x = osmobjects::NodeCache::encode(point.get<0>());
+                entry.y = osmobjects::NodeCache::encode(point.get<1>());
+                entry.version = version;
+                entry.deleted = false;
+                shard.deleted--;
+            }
+        } else if (replace && version >= entry.version) {
+            entry.x = osmobjects::NodeCache::encode(point.get<0>());
+            entry.y = osmobjects::NodeCache::encode(point.get<1>());
+            entry.version = version;
+        }
+        return;
+    }
+    uint32_t slot = allocate(shard);
+    shard.entries[slot] = Entry{id, osmobjects::NodeCache::encode(point.get<0>()),
+                                osmobjects::NodeCache::encode(point.get<1>()), version, false, false};
+    shard.index[id] = slot;
+}
+
+void
+SharedNodeCache::insert(int64_t id, const point_t &point, int version)
+{
+    store(id, point, version, true);
+}
+
+void
+SharedNodeCache::insertIfAbsent(int64_t id, const point_t &point, int version)
+{
+    store(id, point, version, false);
+}
+
+void
+SharedNodeCache::erase(int64_t id, int version)
+{
+    Shard &shard = this->shard(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(id);
+    if (found == shard.index.end()) {
+        uint32_t slot = allocate(shard);
+        shard.entries[slot] = Entry{id, 0, 0, version, true, false};
+        shard.index[id] = slot;
+        shard.deleted++;
+        return;
+    }
+    Entry &entry = shard.entries[found->second];
+    if (version < entry.version) {
+        return;
+    }
+    if (!entry.deleted) {
+        shard.deleted++;
+    }
+    entry = Entry{id, 0, 0, version, true, entry.referenced};
+}
+
+bool
+SharedNodeCache::get(int64_t id, point_t &point)
+{
+    Shard &shard = this->shard(id);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(id);
+        if (found != shard.index.end() && !shard.entries[found->second].deleted) {
+            Entry &entry = shard.entries[found->second];
+            entry.referenced = true;
+            point = point_t(osmobjects::NodeCache::decode(entry.x), osmobjects::NodeCache::decode(entry.y));
+            hit_count++;
+            return true;
+        }
+    }
+    miss_count++;
+    return false;
+}
+
+size_t
+SharedNodeCache::size(void)
+{
+    size_t total = 0;
+    for (auto it = std::begin(shards); it != std::end(shards); ++it) {
+        std::lock_guard<std::mutex> lock(it->mutex);
+        total += it->index.size() - it->deleted;
+    }
+    return total;
+}
+
+double
+SharedNodeCache::hitRate(void) const
+{
+    uint64_t hits = hit_count;
+    uint64_t total = hits + miss_count;
+    if (total == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(hits) / total;
+}
+
+void
+SharedNodeCache::logStats(void)
+{
+    log_debug("Shared node cache: %1% of %2% nodes, %3%%% hit rate (%4% hits, %5% misses)",
+              size(), capacity(), static_cast<int>(hitRate() * 100), hits(), misses());
+}
+
+} // namespace queryraw
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __SHAREDNODECACHE_HH__
+#define __SHAREDNODECACHE_HH__
+
+/// \file sharednodecache.hh
+/// \brief Node locations shared by all the replication threads
+///
+/// Building way geometries needs the location of every node a way
+/// references, and the nodes that aren't in the change file have to
+/// be read from the database. The same nodes get referenced again and
+/// again, so this keeps their locations for the life of the process.
+/// It's split into shards, each with its own lock, so threads rarely
+/// wait on each other. Each shard has a fixed number of entries, and
+/// evicts with the CLOCK algorithm when full.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace queryraw
+namespace queryraw {
+
+/// \class SharedNodeCache
+/// \brief A thread safe, size bounded cache of node locations
+class SharedNodeCache {
+  public:
+    /// Create a cache holding at most this many nodes
+    SharedNodeCache(size_t capacity);
+
+    /// Add or update a node from a change file. A node is never
+    /// replaced by an older version, as files may be processed out
+    /// of order.
+    void insert(int64_t id, const point_t &point, int version);
+    /// Add a node read from the database, unless it's already cached,
+    /// as a change file may have updated it since the query ran
+    void insertIfAbsent(int64_t id, const point_t &point, int version);
+    /// Drop the location of a node deleted at this version. The version
+    /// is kept, so an older location from a file processed out of order
+    /// or from the database isn't cached again.
+    void erase(int64_t id, int version);
+
+    /// Look up a node location, returns false if it's not cached
+    bool get(int64_t id, point_t &point);
+
+    /// The number of cached nodes, not counting deleted ones
+    size_t size(void);
+    /// The maximum number of cached nodes
+    size_t capacity(void) const { return per_shard * shard_count; };
+
+    uint64_t hits(void) const { return hit_count; };
+    uint64_t misses(void) const { return miss_count; };
+    /// The fraction of lookups that were found in the cache
+    double hitRate(void) const;
+    /// Log the size and hit rate of the cache
+    void logStats(void);
+
+  private:
+    struct Entry {
+        int64_t id;
+        int32_t x;
+        int32_t y;
+        int32_t version;
+        bool deleted;     ///< Only the version the node was deleted at is kept
+        bool referenced;  ///< Set on every hit, cleared by the clock hand
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, uint32_t> index;  ///< Node ID to entry
+        std::vector<Entry> entries;
+        size_t deleted = 0;  ///< Entries for deleted nodes
+        size_t hand = 0;     ///< The clock hand
+    };
+
+    static constexpr int shard_bits = 6;
+    static constexpr size_t shard_count = 1 << shard_bits;
+    static constexpr int64_t empty_id = INT64_MIN;
+
+    Shard &shard(int64_t id) {
+        return shards[(static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> (64 - shard_bits)];
+    };
+
+    /// Find an entry for a new node, evicting one if the shard is full
+    uint32_t allocate(Shard &shard);
+    void store(int64_t id, const point_t &point, int version, bool replace);
+
+    std::array<Shard, shard_count> shards;
+    size_t per_shard;
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+};
+
+} // namespace queryraw
+
+#endif // EOF __SHAREDNODECACHE_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
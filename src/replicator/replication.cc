@@ -65,10 +65,6 @@ using namespace boost::gregorian;
 #include <boost/beast/http/parser.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/iostreams/device/array.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
 
 namespace beast = boost::beast;   // from <boost/beast.hpp>
 namespace net = boost::asio;      // from <boost/asio.hpp>
@@ -83,6 +79,7 @@ using tcp = net::ip::tcp;         // from <boost/asio/ip/tcp.hpp>
 std::mutex db_mutex;
 
 #include "utils/log.hh"
+#include "utils/gzip.hh"
 using namespace logger;
 
 namespace replication {
@@ -267,14 +264,7 @@ Planet::processData(const std::string &dest, std::vector<unsigned char> &data)
 {
     std::istringstream xml;
     try {
-        {   // Scope to deallocate buffers
-            boost::iostreams::filtering_streambuf<boost::iostreams::input> inbuf;
-            inbuf.push(boost::iostreams::gzip_decompressor());
-            boost::iostreams::array_source arrs{reinterpret_cast<char const *>(data.data()), data.size()};
-            inbuf.push(arrs);
-            std::istream instream(&inbuf);
-            xml.str(std::string{std::istreambuf_iterator<char>(instream), {}});
-        }
+        xml.str(gzip::inflate(data));
     } catch (std::exception &e) {
         log_error("%1% is corrupted!", dest);
         std::cerr << e.what() << std::endl;
@@ -30,6 +30,7 @@
 #include <range/v3/all.hpp>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <unistd.h>
 #include <vector>
 #include <sstream>
@@ -51,14 +52,10 @@
 #include <boost/dll/import.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
-#include <boost/iostreams/device/array.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/circular_buffer.hpp>
 
 using namespace boost::posix_time;
 using namespace boost::gregorian;
-#include <boost/iostreams/filter/gzip.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
 namespace beast = boost::beast;   // from <boost/beast.hpp>
 namespace net = boost::asio;      // from <boost/asio.hpp>
 namespace ssl = boost::asio::ssl; // from <boost/asio/ssl.hpp>
@@ -74,6 +71,7 @@ using tcp = net::ip::tcp;         // from <boost/asio/ip/tcp.hpp>
 #include "osm/osmobjects.hh"
 #include "replicator/threads.hh"
 #include "utils/log.hh"
+#include "utils/gzip.hh"
 #include "osm/changeset.hh"
 #include "osm/osmchange.hh"
 #include "stats/querystats.hh"
@@ -81,6 +79,8 @@ using tcp = net::ip::tcp;         // from <boost/asio/ip/tcp.hpp>
 #include "validate/validate.hh"
 #include "replicator/replication.hh"
 #include "raw/queryraw.hh"
+#include "osm/snapshot.hh"
+#include "utils/hilbert.hh"
 #include <jemalloc/jemalloc.h>
 #include "data/pq.hh"
 #include "underpassconfig.hh"
@@ -107,6 +107,41 @@ allTasksQueries(std::shared_ptr<std::vector<ReplicationTask>> tasks) {
     return queries;
 }
 
+// Write the results of all the tasks in order, either as one big
+// batch of statements, through the COPY staging tables, or with
+// prepared statements
+void
+writeTasks(Pq &db, std::shared_ptr<std::vector<ReplicationTask>> tasks, const UnderpassConfig &config) {
+    if (config.copy) {
+        std::vector<const CopyWriter *> writers;
+        for (auto it = tasks->begin(); it != tasks->end(); ++it) {
+            writers.push_back(&it->copy);
+        }
+        CopyWriter::flush(db, writers);
+    } else if (config.prepared) {
+        std::vector<const PreparedBatch *> batches;
+        for (auto it = tasks->begin(); it != tasks->end(); ++it) {
+            batches.push_back(&it->batch);
+        }
+        PreparedBatch::flush(db, batches);
+    } else {
+        db.query(allTasksQueries(tasks));
+    }
+}
+
+// Sort objects in Hilbert order the same way SortedBatch does, an
+// object that is in a file more than once keeps the first key
+template <typename T, typename F>
+void
+sortObjects(std::vector<T *> &objects, F location)
+{
+    std::unordered_map<int64_t, uint64_t> keys;
+    for (auto object: objects) {
+        keys.emplace(object->id, location(*object));
+    }
+    geoutil::hilbert::sort(objects, [&keys](T *object) { return keys.at(object->id); });
+}
+
 // Get closest change from a list of tasks
 std::shared_ptr<ReplicationTask>
 getClosest(std::shared_ptr<std::vector<ReplicationTask>> tasks, ptime now) {
@@ -139,7 +174,7 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
     assert(remote->frequency == frequency_t::changeset);
 
     auto db = std::make_shared<Pq>();
-    if (!db->connect(config.underpass_db_url)) {
+    if (!db->connect(config.underpass_db_url, config.dbPoolSize())) {
         log_error("Could not connect to Underpass DB, aborting monitoring thread!");
         return;
     } else {
@@ -147,6 +182,9 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
     }
     auto querystats = std::make_shared<QueryStats>(db);
 
+    // Prepare the boundary once for all the files
+    geoutil::BoundaryIndex boundary(poly);
+
     int cores = config.concurrency;
 
     // Support multiple OSM planet servers
@@ -191,9 +229,10 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
             auto task = boost::bind(threadChangeSet,
                 new_remote,
                 std::ref(planets.front()),
-                std::ref(poly),
+                std::ref(boundary),
                 std::ref(tasks),
-                std::ref(querystats)
+                std::ref(querystats),
+                std::ref(config)
             );
 
             boost::asio::post(pool, task);
@@ -201,7 +240,7 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
             remote->updateDomain(planets.front()->domain);
         }
         pool.join();
-        db->query(allTasksQueries(tasks));
+        writeTasks(*db, tasks, config);
 
         ptime now  = boost::posix_time::second_clock::universal_time();
         last_task = getClosest(tasks, now);
@@ -237,6 +276,7 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
 void
 startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
             const multipolygon_t &poly,
+            const std::vector<geoutil::Region> &regions,
             const UnderpassConfig &config)
 {
 #ifdef TIMING_DEBUG
@@ -268,7 +308,7 @@ startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
     size_t sz, active1, active2;
 #endif    // JEMALLOC memory debugging
     auto db = std::make_shared<Pq>();
-    if (!db->connect(config.underpass_db_url)) {
+    if (!db->connect(config.underpass_db_url, config.dbPoolSize())) {
         log_error("Could not connect to Underpass DB, aborting monitoring thread!");
         return;
     } else {
@@ -277,6 +317,31 @@ startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
     auto querystats = std::make_shared<QueryStats>(db);
     auto queryvalidate = std::make_shared<QueryValidate>(db);
     auto queryraw = std::make_shared<QueryRaw>(db);
+    // Prepare the boundary once for all the files
+    geoutil::BoundaryIndex boundary(poly);
+    geoutil::RegionIndex regionindex(regions);
+    if (!regionindex.empty()) {
+        log_debug("Tagging results with %1% named regions", regionindex.size());
+    }
+    if (config.node_cache_size > 0) {
+        queryraw->sharedcache = std::make_shared<SharedNodeCache>(config.node_cache_size);
+    }
+    if (config.ref_index) {
+        // Large pages, as this only reads the IDs and refs
+        queryraw->loadRefIndexes(100000);
+    }
+    if (config.building_index && !config.disable_validation) {
+        validator->buildings = queryraw->loadBuildings(100000);
+    }
+    if (config.way_cache_size > 0) {
+        queryraw->geometrycache = std::make_shared<GeometryCache>(config.way_cache_size);
+    }
+    if (!config.node_index.empty()) {
+        auto nodeindex = std::make_shared<NodeIndex>();
+        if (nodeindex->open(config.node_index, config.node_index_sparse ? NodeIndex::sparse : NodeIndex::dense)) {
+            queryraw->nodeindex = nodeindex;
+        }
+    }
 
     int cores = config.concurrency;
 
@@ -325,7 +390,8 @@ startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
             OsmChangeTask osmChangeTask {
                 new_remote,
                 std::ref(planets.front()),
-                std::ref(poly),
+                std::ref(boundary),
+                std::ref(regionindex),
                 std::ref(validator),
                 std::ref(tasks),
                 std::ref(querystats),
@@ -341,7 +407,7 @@ startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
             boost::asio::post(pool, task);
         } while (--i);
         pool.join();
-        db->query(allTasksQueries(tasks));
+        writeTasks(*db, tasks, config);
 
         ptime now  = boost::posix_time::second_clock::universal_time();
         last_task = getClosest(tasks, now);
@@ -377,34 +443,81 @@ startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
 void
 threadChangeSet(std::shared_ptr<replication::RemoteURL> &remote,
         std::shared_ptr<replication::Planet> &planet,
-        const multipolygon_t &poly,
+        const geoutil::BoundaryIndex &poly,
         std::shared_ptr<std::vector<ReplicationTask>> tasks,
-        std::shared_ptr<QueryStats> &querystats)
+        std::shared_ptr<QueryStats> &querystats,
+        const UnderpassConfig &config)
 {
 #ifdef TIMING_DEBUG
     boost::timer::auto_cpu_timer timer("threadChangeSet: took %w seconds\n");
 #endif
     ReplicationTask task;
     task.url = remote->subpath;
-    auto file = planet->downloadFile(*remote.get());
-    task.status = file.status;
-
-    if (file.status == reqfile_t::success) {
-        auto changeset = std::make_unique<changesets::ChangeSetFile>();
-        log_debug("Processing ChangeSet: %1%", remote->filespec);
-        auto xml = planet->processData(remote->filespec, *file.data);
-        std::istream& input(xml);
-        changeset->readXML(input);
+    auto changeset = std::make_unique<changesets::ChangeSetFile>();
+
+    // Build the SQL for each changeset as soon as it has been parsed,
+    // so the file is never held in memory as a whole.
+    snapshot::Snapshot snap;
+    bool replay = false;
+    auto emit = [&](changesets::ChangeSet &change) {
+        if (config.snapshots && !replay) {
+            snap.add(change);
+        }
+        if (change.priority) {
+            if (config.copy) {
+                querystats->applyChange(change, task.copy);
+            } else if (config.prepared) {
+                querystats->applyChange(change, task.batch);
+            } else {
+                task.query += querystats->applyChange(change);
+            }
+        }
+    };
+
+    // Replay a previously parsed file if there is a snapshot of it
+    std::string snapfile;
+    if (config.snapshots) {
+        snapfile = snapshot::Snapshot::path(remote->destdir_base + remote->filespec);
+        if (boost::filesystem::exists(snapfile) && snap.read(snapfile)) {
+            if (snap.restore(*changeset)) {
+                log_debug("Processing ChangeSet snapshot: %1%", snapfile);
+                task.status = reqfile_t::success;
+                replay = true;
+                for (auto cit = std::begin(changeset->changes); cit != std::end(changeset->changes); ++cit) {
+                    changesets::ChangeSetFile::inArea(*cit->get(), poly);
+                    emit(*cit->get());
+                }
+                if (changeset->changes.size()) {
+                    changeset->last_created_at = changeset->changes.back()->created_at;
+                }
+            } else {
+                changeset = std::make_unique<changesets::ChangeSetFile>();
+            }
+        }
+    }
+
+    if (task.status != reqfile_t::success) {
+        auto file = planet->downloadFile(*remote.get());
+        task.status = file.status;
+        if (file.status == reqfile_t::success) {
+            log_debug("Processing ChangeSet: %1%", remote->filespec);
+            auto xml = planet->processData(remote->filespec, *file.data);
+            std::istream& input(xml);
+            snap.clear();
+            changeset->setConsumer(poly, emit);
+            if (changeset->readXML(input) && config.snapshots) {
+                snap.write(snapfile);
+            }
+        }
+    }
+
+    if (task.status == reqfile_t::success) {
         if (changeset->last_closed_at != not_a_date_time) {
             task.timestamp = changeset->last_closed_at;
-        } else if (changeset->changes.size() && changeset->changes.back()->created_at != not_a_date_time) {
-            task.timestamp = changeset->changes.back()->created_at;
+        } else if (changeset->last_created_at != not_a_date_time) {
+            task.timestamp = changeset->last_created_at;
         }
         log_debug("ChangeSet last_closed_at: %1%", task.timestamp);
-        changeset->areaFilter(poly);
-        for (auto cit = std::begin(changeset->changes); cit != std::end(changeset->changes); ++cit) {
-            task.query += querystats->applyChange(*cit->get());
-        }
     }
     const std::lock_guard<std::mutex> lock(tasks_changeset_mutex);
     tasks->push_back(task);
@@ -417,7 +530,7 @@ threadOsmChange(OsmChangeTask osmChangeTask)
 
     auto remote = osmChangeTask.remote;
     auto planet = osmChangeTask.planet;
-    auto poly = osmChangeTask.poly;
+    const geoutil::BoundaryIndex &poly = osmChangeTask.poly;
     auto plugin = osmChangeTask.plugin;
     auto tasks = osmChangeTask.tasks;
     auto querystats = osmChangeTask.querystats;
@@ -433,43 +546,67 @@ threadOsmChange(OsmChangeTask osmChangeTask)
     log_debug("Processing OsmChange: %1%", remote->filespec);
     ReplicationTask task;
     task.url = remote->subpath;
-    auto file = planet->downloadFile(*remote.get());
-    task.status = file.status;
 
-    // Read OsmChange
-    if (file.status == replication::success) {
-        try {
-            std::istringstream changes_xml;
-            // Scope to deallocate buffers
-            {
-                boost::iostreams::filtering_streambuf<boost::iostreams::input> inbuf;
-                inbuf.push(boost::iostreams::gzip_decompressor());
-                boost::iostreams::array_source arrs{reinterpret_cast<char const *>(file.data->data()), file.data->size()};
-                inbuf.push(arrs);
-                std::istream instream(&inbuf);
-                changes_xml.str(std::string{std::istreambuf_iterator<char>(instream), {}});
+    // Replay a previously parsed file if there is a snapshot of it
+    snapshot::Snapshot snap;
+    std::string snapfile;
+    if (config->snapshots) {
+        snapfile = snapshot::Snapshot::path(remote->destdir_base + remote->filespec);
+        if (boost::filesystem::exists(snapfile) && snap.read(snapfile)) {
+            if (snap.restore(*osmchanges)) {
+                log_debug("Processing OsmChange snapshot: %1%", snapfile);
+                task.status = replication::success;
+            } else {
+                osmchanges = std::make_shared<osmchange::OsmChangeFile>();
             }
+            snap.clear();
+        }
+    }
 
+    // Read OsmChange
+    if (task.status != replication::success) {
+        auto file = planet->downloadFile(*remote.get());
+        task.status = file.status;
+        if (file.status == replication::success) {
             try {
-                osmchanges->nodecache.clear();
-                osmchanges->readXML(changes_xml);
-                if (osmchanges->changes.size() > 0) {
-                    task.timestamp = osmchanges->changes.back()->final_entry;
-                    log_debug("OsmChange final_entry: %1%", task.timestamp);
+                std::istringstream changes_xml(gzip::inflate(*file.data));
+
+                try {
+                    osmchanges->nodecache.clear();
+                    // Most of an OsmChange file is nodes, at well over
+                    // 100 bytes each, so this is enough to never grow
+                    osmchanges->nodecache.reserve(gzip::sizeHint(file.data->data(), file.data->size()) / 100);
+                    if (config->early_filter) {
+                        osmchanges->setParseFilter(poly);
+                    }
+                    osmchanges->readXML(changes_xml);
+                    // Snapshot the file as parsed, before any filtering.
+                    // An early filtered file is missing nodes, so it
+                    // can't be reused with another boundary.
+                    if (config->snapshots && !config->early_filter) {
+                        snap.add(*osmchanges);
+                        snap.write(snapfile);
+                        snap.clear();
+                    }
+                } catch (std::exception &e) {
+                    log_error("Couldn't parse: %1%", remote->filespec);
+                    boost::filesystem::remove(remote->filespec);
+                    std::cerr << e.what() << std::endl;
                 }
+
             } catch (std::exception &e) {
-                log_error("Couldn't parse: %1%", remote->filespec);
+                log_error("%1% is corrupted!", remote->filespec);
                 boost::filesystem::remove(remote->filespec);
                 std::cerr << e.what() << std::endl;
             }
-
-        } catch (std::exception &e) {
-            log_error("%1% is corrupted!", remote->filespec);
-            boost::filesystem::remove(remote->filespec);
-            std::cerr << e.what() << std::endl;
         }
     }
 
+    if (osmchanges->changes.size() > 0) {
+        task.timestamp = osmchanges->changes.back()->final_entry;
+        log_debug("OsmChange final_entry: %1%", task.timestamp);
+    }
+
     // - Fill node cache with nodes referenced in modified
     //   or created ways and also ways affected by modified nodes
     // - Add indirectly modified ways to osmchanges
@@ -481,15 +618,27 @@ threadOsmChange(OsmChangeTask osmChangeTask)
 
     // Filter data by priority polygon
     osmchanges->areaFilter(poly);
+    osmchanges->setRegions(osmChangeTask.regions);
+
+    // With COPY, the remaining statements run after the staged rows
+    // are merged. With prepared statements everything is in the batch.
+    CopyWriter *copy = config->copy ? &task.copy : nullptr;
+    PreparedBatch *batch = !copy && config->prepared ? &task.batch : nullptr;
 
     // Collect stats
     if (!config->disable_stats) {
-        auto stats = osmchanges->collectStats(poly);
+        auto stats = osmchanges->collectStats(poly.polygon());
         for (auto it = std::begin(*stats); it != std::end(*stats); ++it) {
             if (it->second->added.size() == 0 && it->second->modified.size() == 0) {
                 continue;
             }
-            task.query += querystats->applyChange(*it->second);
+            if (copy) {
+                querystats->applyChange(*it->second, *copy);
+            } else if (batch) {
+                querystats->applyChange(*it->second, *batch);
+            } else {
+                task.query += querystats->applyChange(*it->second);
+            }
         }
     }
 
@@ -498,7 +647,26 @@ threadOsmChange(OsmChangeTask osmChangeTask)
     auto removed_relations = std::make_shared<std::vector<long>>();
     auto validation_removals = std::make_shared<std::vector<long>>();
 
-    // Raw data and validation
+    // The location of objects along the Hilbert curve
+    auto nodeKey = [](const osmobjects::OsmNode &node) {
+        if (node.action == osmobjects::remove) {
+            return geoutil::hilbert::unknown;
+        }
+        return geoutil::hilbert::key(node.point);
+    };
+    auto wayKey = [](const osmobjects::OsmWay &way) {
+        if (way.linestring().empty()) {
+            return geoutil::hilbert::unknown;
+        }
+        return geoutil::hilbert::key(way.centroid());
+    };
+    std::vector<osmobjects::OsmNode *> sortednodes;
+    std::vector<osmobjects::OsmWay *> sortedways;
+
+    // Raw data and validation. With spatial sorting, the statements are
+    // collected first and written in Hilbert order.
+    geoutil::hilbert::SortedBatch nodebatch;
+    geoutil::hilbert::SortedBatch waybatch;
     if (!config->disable_validation || !config->disable_raw) {
         for (auto it = std::begin(osmchanges->changes); it != std::end(osmchanges->changes); ++it) {
             osmchange::OsmChange *change = it->get();
@@ -518,7 +686,17 @@ threadOsmChange(OsmChangeTask osmChangeTask)
 
                 //  Update nodes, ignore new ones outside priority area
                 if (!config->disable_raw) {
-                    task.query += queryraw->applyChange(*node);
+                    if (copy) {
+                        queryraw->applyChange(*node, *copy);
+                    } else if (batch && config->spatial_sort) {
+                        sortednodes.push_back(node);
+                    } else if (batch) {
+                        queryraw->applyChange(*node, *batch);
+                    } else if (config->spatial_sort) {
+                        nodebatch.add(node->id, nodeKey(*node), queryraw->applyChange(*node));
+                    } else {
+                        task.query += queryraw->applyChange(*node);
+                    }
                 }
             }
 
@@ -537,7 +715,17 @@ threadOsmChange(OsmChangeTask osmChangeTask)
 
                 //  Update ways, ignore new ones outside priority area
                 if (!config->disable_raw) {
-                    task.query += queryraw->applyChange(*way);
+                    if (copy) {
+                        queryraw->applyChange(*way, *copy);
+                    } else if (batch && config->spatial_sort) {
+                        sortedways.push_back(way);
+                    } else if (batch) {
+                        queryraw->applyChange(*way, *batch);
+                    } else if (config->spatial_sort) {
+                        waybatch.add(way->id, wayKey(*way), queryraw->applyChange(*way));
+                    } else {
+                        task.query += queryraw->applyChange(*way);
+                    }
                 }
             }
 
@@ -562,27 +750,58 @@ threadOsmChange(OsmChangeTask osmChangeTask)
 
         }
     }
+    nodebatch.flush(task.query);
+    waybatch.flush(task.query);
+    sortObjects(sortednodes, nodeKey);
+    for (auto it = std::begin(sortednodes); it != std::end(sortednodes); ++it) {
+        queryraw->applyChange(**it, *batch);
+    }
+    sortObjects(sortedways, wayKey);
+    for (auto it = std::begin(sortedways); it != std::end(sortedways); ++it) {
+        queryraw->applyChange(**it, *batch);
+    }
 
     // // Update validation table
     if (!config->disable_validation) {
+        auto location = [](const std::shared_ptr<ValidateStatus> &status) {
+            return geoutil::hilbert::key(status->center);
+        };
 
         // Validate ways
-        auto wayval = osmchanges->validateWays(poly, plugin);
-        queryvalidate->ways(wayval, task.query, validation_removals);
+        auto wayval = osmchanges->validateWays(poly.polygon(), plugin);
+        if (config->spatial_sort) {
+            geoutil::hilbert::sort(*wayval, location);
+        }
+        queryvalidate->ways(wayval, task.query, validation_removals, copy, batch);
 
         // Validate nodes
-        auto nodeval = osmchanges->validateNodes(poly, plugin);
-        queryvalidate->nodes(nodeval, task.query, validation_removals);
+        auto nodeval = osmchanges->validateNodes(poly.polygon(), plugin);
+        if (config->spatial_sort) {
+            geoutil::hilbert::sort(*nodeval, location);
+        }
+        queryvalidate->nodes(nodeval, task.query, validation_removals, copy, batch);
 
         // Validate relations
         // task.query += queryvalidate->rels(wayval, task.query, validation_removals);
 
         // Remove validation entries for removed objects
-        task.query += queryvalidate->updateValidation(validation_removals);
-        task.query += queryvalidate->updateValidation(removed_nodes);
-        task.query += queryvalidate->updateValidation(removed_ways);
-        task.query += queryvalidate->updateValidation(removed_relations);
+        if (batch) {
+            queryvalidate->updateValidation(validation_removals, *batch);
+            queryvalidate->updateValidation(removed_nodes, *batch);
+            queryvalidate->updateValidation(removed_ways, *batch);
+            queryvalidate->updateValidation(removed_relations, *batch);
+        } else {
+            task.query += queryvalidate->updateValidation(validation_removals);
+            task.query += queryvalidate->updateValidation(removed_nodes);
+            task.query += queryvalidate->updateValidation(removed_ways);
+            task.query += queryvalidate->updateValidation(removed_relations);
+        }
+
+    }
 
+    if (copy) {
+        task.copy.statement(task.query);
+        task.query.clear();
     }
 
     const std::lock_guard<std::mutex> lock(tasks_change_mutex);
@@ -72,6 +72,8 @@ using tcp = net::ip::tcp;
 #include "stats/querystats.hh"
 #include "validate/queryvalidate.hh"
 #include "raw/queryraw.hh"
+#include "utils/boundaryindex.hh"
+#include "utils/regionindex.hh"
 #include "validate/validate.hh"
 #include <ogr_geometry.h>
 
@@ -97,6 +99,8 @@ struct ReplicationTask {
     ptime timestamp = not_a_date_time;
     replication::reqfile_t status = replication::reqfile_t::none;
     std::string query = "";
+    pq::CopyWriter copy;       ///< The staged rows, when writing with COPY
+    pq::PreparedBatch batch;   ///< The prepared statements, when writing with them
 };
 
 /// This monitors the planet server for new changesets files.
@@ -113,9 +117,10 @@ startMonitorChangesets(std::shared_ptr<replication::RemoteURL> &remote,
 void
 threadChangeSet(std::shared_ptr<replication::RemoteURL> &remote,
     std::shared_ptr<replication::Planet> &planet,
-    const multipolygon_t &poly,
+    const geoutil::BoundaryIndex &poly,
     std::shared_ptr<std::vector<ReplicationTask>> tasks,
-    std::shared_ptr<QueryStats> &querystats
+    std::shared_ptr<QueryStats> &querystats,
+    const underpassconfig::UnderpassConfig &config
 );
 
 /// This monitors the planet server for new OSM changes files.
@@ -124,13 +129,15 @@ threadChangeSet(std::shared_ptr<replication::RemoteURL> &remote,
 extern void
 startMonitorChanges(std::shared_ptr<replication::RemoteURL> &remote,
     const multipolygon_t &poly,
+    const std::vector<geoutil::Region> &regions,
     const underpassconfig::UnderpassConfig &config
 );
 
 struct OsmChangeTask {
         std::shared_ptr<replication::RemoteURL> remote;
         std::shared_ptr<replication::Planet> planet;
-        const multipolygon_t poly;
+        const geoutil::BoundaryIndex &poly;
+        const geoutil::RegionIndex &regions;
         std::shared_ptr<Validate> plugin;
         std::shared_ptr<std::vector<ReplicationTask>> tasks;
         std::shared_ptr<QueryStats> querystats;
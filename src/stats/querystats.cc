@@ -31,7 +31,9 @@
 
 #include <array>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -53,12 +55,185 @@ using namespace boost::gregorian;
 #include "osm/changeset.hh"
 #include "stats/querystats.hh"
 #include "data/pq.hh"
+#include "data/copywriter.hh"
 using namespace pq;
 using namespace logger;
 
 /// \namespace querystats
 namespace querystats {
 
+namespace {
+
+// The bounding box of a changeset as EWKT
+std::string
+bboxEWKT(const changesets::ChangeSet &change)
+{
+    // Store the current values as they can get changed to expand very short
+    // lines or POIs so they have a bounding box big enough for Postgis to use.
+    double min_lat = change.min_lat;
+    double max_lat = change.max_lat;
+    double min_lon = change.min_lon;
+    double max_lon = change.max_lon;
+
+    const double fudge{0.0001};
+
+    // A changeset with a single node in it doesn't draw a line
+    if (change.max_lon < 0 && change.min_lat < 0) {
+        min_lat = change.min_lat + (fudge / 2);
+        max_lat = change.max_lat + (fudge / 2);
+        min_lon = change.min_lon - (fudge / 2);
+        max_lon = change.max_lon - (fudge / 2);
+    }
+
+    // Not a line
+    if (max_lon == min_lon || max_lat == min_lat) {
+        min_lat = change.min_lat + (fudge / 2);
+        max_lat = change.max_lat + (fudge / 2);
+        min_lon = change.min_lon - (fudge / 2);
+        max_lon = change.max_lon - (fudge / 2);
+    }
+
+    // Single point
+    if (max_lon < 0 && min_lat < 0) {
+        min_lat = change.min_lat + (fudge / 2);
+        max_lat = change.max_lat + (fudge / 2);
+        min_lon = change.min_lon - (fudge / 2);
+        max_lon = change.max_lon - (fudge / 2);
+    }
+
+    // Changeset bounding box
+    std::string bbox;
+    bbox += "SRID=4326;POLYGON((";
+    // Upper left
+    bbox += std::to_string(max_lon) + "  ";
+    bbox += std::to_string(max_lat) + ",";
+    // Upper right
+    bbox += std::to_string(min_lon) + "  ";
+    bbox += std::to_string(max_lat) + ",";
+    // Lower right
+    bbox += std::to_string(min_lon) + "  ";
+    bbox += std::to_string(min_lat) + ",";
+    // Lower left
+    bbox += std::to_string(max_lon) + "  ";
+    bbox += std::to_string(min_lat) + ",";
+    // Close the polygon
+    bbox += std::to_string(max_lon) + "  ";
+    bbox += std::to_string(max_lat) + "))";
+
+    return bbox;
+}
+
+// Format the positive counters as an hstore
+std::optional<std::string>
+hstore(const std::map<std::string, int> &counters)
+{
+    std::string value;
+    for (auto it = std::begin(counters); it != std::end(counters); ++it) {
+        if (it->second > 0) {
+            std::string key = it->first;
+            boost::algorithm::replace_all(key, "\\", "\\\\");
+            boost::algorithm::replace_all(key, "\"", "\\\"");
+            value += "\"" + key + "\"=>\"" + std::to_string(it->second) + "\",";
+        }
+    }
+    if (value.empty()) {
+        return std::nullopt;
+    }
+    value.pop_back();
+    return value;
+}
+
+// A changeset and its statistics come from different files, so each
+// only updates its own columns
+const std::string changesetInsert = "INSERT INTO changesets AS c \
+(id, editor, uid, created_at, closed_at, updated_at, hashtags, source, bbox) ";
+const std::string changesetConflict = " ON CONFLICT (id) DO UPDATE SET editor = EXCLUDED.editor, \
+created_at = EXCLUDED.created_at, updated_at = EXCLUDED.updated_at, hashtags = EXCLUDED.hashtags, bbox = EXCLUDED.bbox";
+
+const std::string statsInsert = "INSERT INTO changesets AS c \
+(id, uid, closed_at, updated_at, added, modified, regions) ";
+const std::string statsConflict = " ON CONFLICT (id) DO UPDATE SET closed_at = EXCLUDED.closed_at, \
+updated_at = EXCLUDED.updated_at, added = EXCLUDED.added, modified = EXCLUDED.modified, \
+regions = CASE WHEN EXCLUDED.regions IS NULL THEN c.regions \
+ELSE ARRAY(SELECT DISTINCT unnest(coalesce(c.regions, '{}') || EXCLUDED.regions)) END";
+
+// The staging tables for the COPY writer
+const std::string changesetStaging = "copy_changesets";
+const std::string changesetColumns = "id int8, editor text, uid int8, created_at timestamptz, \
+closed_at timestamptz, updated_at timestamptz, hashtags text[], source text, bbox text";
+const std::vector<std::string> changesetMerge = {
+    changesetInsert + "SELECT id, editor, uid, created_at, closed_at, updated_at, hashtags, source, \
+ST_Multi(ST_GeomFromEWKT(bbox)) FROM " + CopyWriter::latest(changesetStaging, "id") + changesetConflict
+};
+
+const std::string statsStaging = "copy_changestats";
+const std::string statsColumns = "id int8, uid int8, closed_at timestamptz, updated_at timestamptz, \
+added hstore, modified hstore, regions text[]";
+const std::vector<std::string> statsMerge = {
+    statsInsert + "SELECT id, uid, closed_at, updated_at, added, modified, regions FROM " +
+        CopyWriter::latest(statsStaging, "id") + statsConflict
+};
+
+// The prepared statements
+const std::string changesetUpsert = "stats_changeset";
+const std::string changesetUpsertSQL = changesetInsert +
+    "VALUES ($1, $2, $3, $4, $5, $6, $7::text[], $8, ST_Multi(ST_GeomFromEWKT($9)))" + changesetConflict;
+
+const std::string statsUpsert = "stats_changestats";
+const std::string statsUpsertSQL = statsInsert +
+    "VALUES ($1, $2, $3, $4, $5::hstore, $6::hstore, $7::text[])" + statsConflict;
+
+// The values for the columns of the statistics
+CopyWriter::row_t
+statsRow(const osmchange::ChangeStats &change)
+{
+    std::optional<std::string> regions;
+    if (change.regions.size() > 0) {
+        std::vector<std::string> values(std::begin(change.regions), std::end(change.regions));
+        regions = CopyWriter::array(values);
+    }
+    ptime now = boost::posix_time::microsec_clock::universal_time();
+    return {
+        std::to_string(change.changeset),
+        std::to_string(change.uid),
+        to_simple_string(change.closed_at),
+        to_simple_string(now),
+        hstore(change.added),
+        hstore(change.modified),
+        regions
+    };
+}
+
+// The values for the columns of a changeset
+CopyWriter::row_t
+changesetRow(const changesets::ChangeSet &change)
+{
+    std::optional<std::string> hashtags;
+    if (change.hashtags.size() > 0) {
+        std::vector<std::string> values;
+        for (const auto &hashtag: std::as_const(change.hashtags)) {
+            auto ht{hashtag};
+            boost::algorithm::replace_all(ht, "\"", "&quot;");
+            values.push_back(ht);
+        }
+        hashtags = CopyWriter::array(values);
+    }
+    ptime now = boost::posix_time::microsec_clock::universal_time();
+    return {
+        std::to_string(change.id),
+        change.editor,
+        std::to_string(change.uid),
+        to_simple_string(change.created_at),
+        to_simple_string(change.closed_at != not_a_date_time ? change.closed_at : change.created_at),
+        to_simple_string(now),
+        hashtags,
+        change.source.empty() ? std::nullopt : std::optional<std::string>(change.source),
+        bboxEWKT(change)
+    };
+}
+
+} // namespace
+
 QueryStats::QueryStats(void) {}
 
 QueryStats::QueryStats(std::shared_ptr<Pq> db) {
@@ -101,6 +276,16 @@ QueryStats::applyChange(const osmchange::ChangeStats &change) const
             mhstore += "])";
         }
 
+        std::string regions;
+        if (change.regions.size() > 0) {
+            regions = "ARRAY[";
+            for (const auto &region: std::as_const(change.regions)) {
+                regions += "'" + dbconn->escapedString(region) + "',";
+            }
+            regions.back() = ']';
+            regions += "::text[]";
+        }
+
         // Some of the data field in the changset come from a different file,
         // which may not be downloaded yet.
         ptime now = boost::posix_time::microsec_clock::universal_time();
@@ -112,6 +297,9 @@ QueryStats::applyChange(const osmchange::ChangeStats &change) const
         if (change.modified.size() > 0) {
             aquery += "modified, ";
         }
+        if (change.regions.size() > 0) {
+            aquery += "regions, ";
+        }
         aquery.erase(aquery.size() - 2);
         aquery += ")";
 
@@ -126,6 +314,9 @@ QueryStats::applyChange(const osmchange::ChangeStats &change) const
         if (change.modified.size() > 0) {
             aquery += mhstore + ", ";
         }
+        if (change.regions.size() > 0) {
+            aquery += regions + ", ";
+        }
 
         aquery.erase(aquery.size() - 2);
         aquery += ") ON CONFLICT (id) DO UPDATE SET";
@@ -142,6 +333,11 @@ QueryStats::applyChange(const osmchange::ChangeStats &change) const
         } else {
             aquery += "modified = null, ";
         }
+        // A changeset can span several files, so keep the regions
+        // found in the others
+        if (change.regions.size() > 0) {
+            aquery += "regions = ARRAY(SELECT DISTINCT unnest(coalesce(changesets.regions, '{}') || " + regions + ")), ";
+        }
         aquery.erase(aquery.size() - 2);
 
         return aquery + ";";
@@ -198,61 +394,9 @@ QueryStats::applyChange(const changesets::ChangeSet &change) const
         query += ",\'" + change.source += "\'";
     }
 
-    // Store the current values as they can get changed to expand very short
-    // lines or POIs so they have a bounding box big enough for Postgis to use.
-    double min_lat = change.min_lat;
-    double max_lat = change.max_lat;
-    double min_lon = change.min_lon;
-    double max_lon = change.max_lon;
-
-    const double fudge{0.0001};
-
-    // A changeset with a single node in it doesn't draw a line
-    if (change.max_lon < 0 && change.min_lat < 0) {
-        min_lat = change.min_lat + (fudge / 2);
-        max_lat = change.max_lat + (fudge / 2);
-        min_lon = change.min_lon - (fudge / 2);
-        max_lon = change.max_lon - (fudge / 2);
-    }
-
-    // Not a line
-    if (max_lon == min_lon || max_lat == min_lat) {
-        min_lat = change.min_lat + (fudge / 2);
-        max_lat = change.max_lat + (fudge / 2);
-        min_lon = change.min_lon - (fudge / 2);
-        max_lon = change.max_lon - (fudge / 2);
-    }
-
-    // Single point
-    if (max_lon < 0 && min_lat < 0) {
-        min_lat = change.min_lat + (fudge / 2);
-        max_lat = change.max_lat + (fudge / 2);
-        min_lon = change.min_lon - (fudge / 2);
-        max_lon = change.max_lon - (fudge / 2);
-    }
-
-    // Changeset bounding box
-    std::string bbox;
-    bbox += ", ST_MULTI(ST_GeomFromEWKT(\'SRID=4326;POLYGON((";
-    // Upper left
-    bbox += std::to_string(max_lon) + "  ";
-    bbox += std::to_string(max_lat) + ",";
-    // Upper right
-    bbox += std::to_string(min_lon) + "  ";
-    bbox += std::to_string(max_lat) + ",";
-    // Lower right
-    bbox += std::to_string(min_lon) + "  ";
-    bbox += std::to_string(min_lat) + ",";
-    // Lower left
-    bbox += std::to_string(max_lon) + "  ";
-    bbox += std::to_string(min_lat) + ",";
-    // Close the polygon
-    bbox += std::to_string(max_lon) + "  ";
-    bbox += std::to_string(max_lat) + ")";
-    query += bbox;
-
-    query += ")\')";
-    query += ")) ON CONFLICT (id) DO UPDATE SET editor='" + dbconn->escapedString(change.editor);
+    std::string bbox = bboxEWKT(change);
+    query += ", ST_MULTI(ST_GeomFromEWKT(\'" + bbox + "\')))";
+    query += " ON CONFLICT (id) DO UPDATE SET editor='" + dbconn->escapedString(change.editor);
     query += "', created_at=\'" + to_simple_string(change.created_at);
     query += "\', updated_at=\'" + to_simple_string(now) + "\'";
 
@@ -270,12 +414,46 @@ QueryStats::applyChange(const changesets::ChangeSet &change) const
         query += ", hashtags=null";
     }
 
-    query += ", bbox=" + bbox.substr(2) + ")'));";
+    query += ", bbox=ST_MULTI(ST_GeomFromEWKT('" + bbox + "'));";
 
     return query;
 
 }
 
+void
+QueryStats::applyChange(const osmchange::ChangeStats &change, CopyWriter &copy) const
+{
+    if (change.closed_at == not_a_date_time) {
+        return;
+    }
+    copy.stage(statsStaging, statsColumns, statsMerge);
+    copy.add(statsStaging, statsRow(change));
+}
+
+void
+QueryStats::applyChange(const changesets::ChangeSet &change, CopyWriter &copy) const
+{
+    copy.stage(changesetStaging, changesetColumns, changesetMerge);
+    copy.add(changesetStaging, changesetRow(change));
+}
+
+void
+QueryStats::applyChange(const osmchange::ChangeStats &change, PreparedBatch &batch) const
+{
+    if (change.closed_at == not_a_date_time) {
+        return;
+    }
+    batch.prepare(statsUpsert, statsUpsertSQL);
+    batch.add(statsUpsert, statsRow(change));
+}
+
+void
+QueryStats::applyChange(const changesets::ChangeSet &change, PreparedBatch &batch) const
+{
+    batch.prepare(changesetUpsert, changesetUpsertSQL);
+    batch.add(changesetUpsert, changesetRow(change));
+}
+
 } // namespace querystats
 
 // local Variables:
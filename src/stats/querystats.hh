@@ -47,6 +47,8 @@ using namespace boost::gregorian;
 #include "osm/changeset.hh"
 #include "osm/osmchange.hh"
 #include "data/pq.hh"
+#include "data/copywriter.hh"
+#include "data/prepared.hh"
 
 using namespace pq;
 
@@ -77,6 +79,14 @@ class QueryStats {
     std::string applyChange(const changesets::ChangeSet &change) const;
     /// Build query for processed OsmChange
     std::string applyChange(const osmchange::ChangeStats &change) const;
+    /// Stage a processed ChangeSet for the COPY writer
+    void applyChange(const changesets::ChangeSet &change, CopyWriter &copy) const;
+    /// Stage a processed OsmChange for the COPY writer
+    void applyChange(const osmchange::ChangeStats &change, CopyWriter &copy) const;
+    /// Add the prepared statement for a processed ChangeSet to a batch
+    void applyChange(const changesets::ChangeSet &change, PreparedBatch &batch) const;
+    /// Add the prepared statement for a processed OsmChange to a batch
+    void applyChange(const osmchange::ChangeStats &change, PreparedBatch &batch) const;
     // Database connection, used for escape strings
     std::shared_ptr<Pq> dbconn;
 };
@@ -90,7 +90,7 @@ main(int argc, char *argv[])
 
     // ChangeSet - Whole world
     changeset.readChanges(changesetFile);
-    changeset.areaFilter(polyWholeWorld);
+    changeset.areaFilter(geoutil::BoundaryIndex(polyWholeWorld));
     testChangeset = changeset.changes.front().get();
     if (testChangeset && testChangeset->priority) {
         runtest.pass("ChangeSet areaFilter - true (whole world)");
@@ -101,7 +101,7 @@ main(int argc, char *argv[])
 
     // ChangeSet - Small area in North Africa
     changeset.readChanges(changesetFile);
-    changeset.areaFilter(polySmallArea);
+    changeset.areaFilter(geoutil::BoundaryIndex(polySmallArea));
     testChangeset = changeset.changes.front().get();
     if (testChangeset && testChangeset->priority) {
         runtest.fail("ChangeSet areaFilter - false (small area)");
@@ -111,7 +111,7 @@ main(int argc, char *argv[])
 
     // ChangeSet - Empty polygon
     changeset.readChanges(changesetFile);
-    changeset.areaFilter(polyEmpty);
+    changeset.areaFilter(geoutil::BoundaryIndex(polyEmpty));
     testChangeset = changeset.changes.front().get();
     if (testChangeset && testChangeset->priority) {
         runtest.pass("ChangeSet areaFilter - true (empty)");
@@ -122,7 +122,7 @@ main(int argc, char *argv[])
 
     // ChangeSet - Half area
     changeset.readChanges(changesetFile);
-    changeset.areaFilter(polyHalf);
+    changeset.areaFilter(geoutil::BoundaryIndex(polyHalf));
     testChangeset = changeset.changes.front().get();
     if (testChangeset && testChangeset->priority) {
         runtest.pass("ChangeSet areaFilter - true (half area)");
@@ -131,6 +131,42 @@ main(int argc, char *argv[])
         return 1;
     }
 
+    // ChangeSet - Streaming to a consumer
+    TestChangeset streamed;
+    int inside = 0;
+    int outside = 0;
+    geoutil::BoundaryIndex wholeWorld(polyWholeWorld);
+    streamed.setConsumer(wholeWorld, [&](changesets::ChangeSet &change) {
+        if (change.priority) {
+            inside++;
+        } else {
+            outside++;
+        }
+    });
+    streamed.readChanges(changesetFile);
+    if (inside > 0 && outside == 0 && streamed.changes.size() == 0) {
+        runtest.pass("ChangeSet consumer - true (whole world)");
+    } else {
+        runtest.fail("ChangeSet consumer - true (whole world)");
+    }
+
+    inside = 0;
+    outside = 0;
+    geoutil::BoundaryIndex smallArea(polySmallArea);
+    streamed.setConsumer(smallArea, [&](changesets::ChangeSet &change) {
+        if (change.priority) {
+            inside++;
+        } else {
+            outside++;
+        }
+    });
+    streamed.readChanges(changesetFile);
+    if (inside == 0 && outside > 0) {
+        runtest.pass("ChangeSet consumer - false (small area)");
+    } else {
+        runtest.fail("ChangeSet consumer - false (small area)");
+    }
+
     // OsmChange - Small area in North Africa
     // FIXME
     // osmchange.readChanges(osmchangeFile);
@@ -144,7 +180,7 @@ main(int argc, char *argv[])
 
     // OsmChange - Whole world
     osmchange.readChanges(osmchangeFile);
-    osmchange.areaFilter(polyWholeWorld);
+    osmchange.areaFilter(geoutil::BoundaryIndex(polyWholeWorld));
     if (getPriority(osmchange) && countFeatures(osmchange) == 48) {
         runtest.pass("OsmChange areaFilter - true (whole world)");
     } else {
@@ -152,7 +188,7 @@ main(int argc, char *argv[])
         return 1;
     }
     // Delete all changes
-    osmchange.areaFilter(polySmallArea);
+    osmchange.areaFilter(geoutil::BoundaryIndex(polySmallArea));
 
     // OsmChange - Empty polygon
     // FIXME
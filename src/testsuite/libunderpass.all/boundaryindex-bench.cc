@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// Compare the point in polygon test boost::geometry does against the
+// whole priority boundary with BoundaryIndex. Pass a different boundary
+// file as the first argument. This isn't run by the testsuite, run it
+// by hand.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "utils/boundaryindex.hh"
+#include "utils/geoutil.hh"
+
+template <typename F>
+void
+run(const std::string &name, size_t count, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t inside = func();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << elapsed.count() * 1000 << " ms, "
+              << count / elapsed.count() << " points/s (" << inside << " inside)" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    std::string boundaryFile(DATADIR);
+    boundaryFile += "/../config/priority.geojson";
+    if (argc > 1) {
+        boundaryFile = argv[1];
+    }
+    geoutil::GeoUtil geou;
+    if (!geou.readFile(boundaryFile)) {
+        std::cerr << "Couldn't read " << boundaryFile << std::endl;
+        return 1;
+    }
+    const multipolygon_t &poly = geou.boundary;
+
+    auto start = std::chrono::steady_clock::now();
+    geoutil::BoundaryIndex index(poly);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Prepared " << boost::geometry::num_points(poly) << " points in "
+              << elapsed.count() * 1000 << " ms" << std::endl;
+
+    // Random points in the envelope of the boundary
+    boost::geometry::model::box<point_t> box;
+    boost::geometry::envelope(poly, box);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> lon(box.min_corner().get<0>(), box.max_corner().get<0>());
+    std::uniform_real_distribution<double> lat(box.min_corner().get<1>(), box.max_corner().get<1>());
+    std::vector<point_t> points;
+    for (int i = 0; i < 200000; i++) {
+        points.push_back(point_t(lon(rng), lat(rng)));
+    }
+
+    run("boost::geometry::within", points.size(), [&]() {
+        size_t inside = 0;
+        for (const auto &point : points) {
+            inside += boost::geometry::within(point, poly);
+        }
+        return inside;
+    });
+    run("BoundaryIndex::within", points.size(), [&]() {
+        size_t inside = 0;
+        for (const auto &point : points) {
+            inside += index.within(point);
+        }
+        return inside;
+    });
+    run("BoundaryIndex::within(batch)", points.size(), [&]() {
+        std::vector<bool> result = index.within(points);
+        return std::count(result.begin(), result.end(), true);
+    });
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <boost/geometry.hpp>
+
+#include "utils/boundaryindex.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+// A wobbly ring with many edges around the origin, with a square hole
+// and an island in the hole
+multipolygon_t
+makeBoundary(int edges)
+{
+    multipolygon_t poly;
+    poly.resize(2);
+    for (int i = 0; i <= edges; i++) {
+        double angle = -2 * M_PI * (i % edges) / edges;
+        double radius = 10 + 3 * std::sin(angle * 37) + 0.5 * std::sin(angle * 501);
+        poly[0].outer().push_back(point_t(radius * std::cos(angle), radius * std::sin(angle)));
+    }
+    boost::geometry::read_wkt("POLYGON((-2 -2,-2 2,2 2,2 -2,-2 -2))", poly[1]);
+    poly[0].inners().push_back(poly[1].outer());
+    boost::geometry::read_wkt("POLYGON((0.5 0.5,0.5 1,1 1,1 0.5,0.5 0.5))", poly[1]);
+    boost::geometry::correct(poly);
+    return poly;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("boundaryindex-test.log");
+    dbglogfile.setVerbosity(3);
+
+    multipolygon_t poly = makeBoundary(5000);
+    geoutil::BoundaryIndex index(poly);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(-15, 15);
+    std::uniform_real_distribution<double> offset(-0.3, 0.3);
+
+    // Random points, and points on and right next to the boundary
+    std::vector<point_t> points;
+    for (int i = 0; i < 20000; i++) {
+        points.push_back(point_t(coord(rng), coord(rng)));
+    }
+    const auto &ring = poly[0].outer();
+    for (size_t i = 0; i + 1 < ring.size(); i += 7) {
+        double x = (ring[i].get<0>() + ring[i + 1].get<0>()) / 2;
+        double y = (ring[i].get<1>() + ring[i + 1].get<1>()) / 2;
+        points.push_back(ring[i]);
+        points.push_back(point_t(x, y));
+        points.push_back(point_t(std::nextafter(x, 0.0), y));
+    }
+    points.push_back(point_t(-2, 0));
+    points.push_back(point_t(0.75, 0.75));
+
+    int wrong = 0;
+    for (auto it = std::begin(points); it != std::end(points); ++it) {
+        if (index.within(*it) != boost::geometry::within(*it, poly)) {
+            wrong++;
+        }
+    }
+    if (wrong == 0) {
+        runtest.pass("BoundaryIndex::within(point)");
+    } else {
+        runtest.fail("BoundaryIndex::within(point) - " + std::to_string(wrong) + " wrong");
+    }
+
+    wrong = 0;
+    for (int i = 0; i < 5000; i++) {
+        linestring_t line;
+        double x = coord(rng);
+        double y = coord(rng);
+        for (int j = 0; j < 4; j++) {
+            line.push_back(point_t(x + offset(rng), y + offset(rng)));
+        }
+        if (index.within(line) != boost::geometry::within(line, poly)) {
+            wrong++;
+        }
+    }
+    if (wrong == 0) {
+        runtest.pass("BoundaryIndex::within(linestring)");
+    } else {
+        runtest.fail("BoundaryIndex::within(linestring) - " + std::to_string(wrong) + " wrong");
+    }
+
+    // Changeset bounding boxes, including single points
+    wrong = 0;
+    for (int i = 0; i < 5000; i++) {
+        double x = coord(rng);
+        double y = coord(rng);
+        double width = (i % 10) ? std::abs(offset(rng)) : 0.0;
+        double height = (i % 10) ? std::abs(offset(rng)) : 0.0;
+        polygon_t bbox;
+        boost::geometry::append(bbox, point_t(x + width, y + height));
+        boost::geometry::append(bbox, point_t(x + width, y));
+        boost::geometry::append(bbox, point_t(x, y));
+        boost::geometry::append(bbox, point_t(x, y + height));
+        boost::geometry::append(bbox, point_t(x + width, y + height));
+        if (index.intersects(bbox) != boost::geometry::intersects(bbox, poly)) {
+            wrong++;
+        }
+    }
+    if (wrong == 0) {
+        runtest.pass("BoundaryIndex::intersects()");
+    } else {
+        runtest.fail("BoundaryIndex::intersects() - " + std::to_string(wrong) + " wrong");
+    }
+
+    // An empty boundary contains nothing
+    geoutil::BoundaryIndex empty;
+    if (empty.empty() && !empty.within(point_t(0, 0)) && !index.empty()) {
+        runtest.pass("BoundaryIndex::empty()");
+    } else {
+        runtest.fail("BoundaryIndex::empty()");
+    }
+
+    // A tiny grid still gives the same results
+    index.build(poly, 1);
+    wrong = 0;
+    for (size_t i = 0; i < points.size(); i += 10) {
+        if (index.within(points[i]) != boost::geometry::within(points[i], poly)) {
+            wrong++;
+        }
+    }
+    if (wrong == 0) {
+        runtest.pass("BoundaryIndex::build() - small grid");
+    } else {
+        runtest.fail("BoundaryIndex::build() - small grid");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
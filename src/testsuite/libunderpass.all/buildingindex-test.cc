@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/osmobjects.hh"
+#include "validate/buildingindex.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace buildingindex;
+
+// A square building, counter clockwise like a lot of OSM data
+polygon_t
+square(double x, double y, double size)
+{
+    polygon_t poly;
+    boost::geometry::read_wkt("POLYGON((" + std::to_string(x) + " " + std::to_string(y) + "," +
+                                  std::to_string(x + size) + " " + std::to_string(y) + "," +
+                                  std::to_string(x + size) + " " + std::to_string(y + size) + "," +
+                                  std::to_string(x) + " " + std::to_string(y + size) + "," +
+                                  std::to_string(x) + " " + std::to_string(y) + "))",
+                              poly);
+    return poly;
+}
+
+std::vector<long>
+ids(const std::vector<std::shared_ptr<const Building>> &buildings)
+{
+    std::vector<long> result;
+    for (const auto &building : buildings) {
+        result.push_back(building->id);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+osmobjects::OsmWay
+building(long id, int version, const polygon_t &poly)
+{
+    osmobjects::OsmWay way;
+    way.id = id;
+    way.version = version;
+    way.action = osmobjects::modify;
+    way.addTag("building", "yes");
+    for (size_t i = 0; i < poly.outer().size(); i++) {
+        way.refs.push_back(i + 1 == poly.outer().size() ? 1 : i + 1);
+    }
+    way.polygon = poly;
+    return way;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("buildingindex-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Random buildings, the candidates have to be the same as checking
+    // every envelope
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> coord(0, 0.1);
+    std::uniform_real_distribution<double> size(0.00005, 0.0005);
+    std::vector<polygon_t> polys;
+    BuildingIndex index;
+    for (long id = 1; id <= 20000; id++) {
+        polys.push_back(square(coord(rng), coord(rng), size(rng)));
+        index.load(id, 1, polys.back(), "");
+    }
+    if (index.size() == 0) {
+        runtest.pass("BuildingIndex::load()");
+    } else {
+        runtest.fail("BuildingIndex::load()");
+    }
+    index.seal();
+    if (index.size() == polys.size()) {
+        runtest.pass("BuildingIndex::seal()");
+    } else {
+        runtest.fail("BuildingIndex::seal()");
+    }
+
+    bool same = true;
+    for (int i = 0; i < 500; i++) {
+        polygon_t probe = square(coord(rng), coord(rng), size(rng));
+        boost::geometry::model::box<point_t> envelope;
+        boost::geometry::envelope(probe, envelope);
+        std::vector<long> expected;
+        for (size_t j = 0; j < polys.size(); j++) {
+            boost::geometry::model::box<point_t> other;
+            boost::geometry::envelope(polys[j], other);
+            if (boost::geometry::intersects(envelope, other)) {
+                expected.push_back(j + 1);
+            }
+        }
+        if (ids(index.candidates(probe)) != expected) {
+            same = false;
+        }
+    }
+    if (same) {
+        runtest.pass("BuildingIndex::candidates()");
+    } else {
+        runtest.fail("BuildingIndex::candidates()");
+    }
+
+    // Buildings are stored oriented for boost::geometry
+    auto found = index.candidates(polys[0]);
+    auto first = std::find_if(found.begin(), found.end(), [](const auto &b) { return b->id == 1; });
+    if (first != found.end() && boost::geometry::area((*first)->polygon) > 0) {
+        runtest.pass("BuildingIndex::load() - orientation");
+    } else {
+        runtest.fail("BuildingIndex::load() - orientation");
+    }
+
+    // Moving a building
+    polygon_t moved = square(0.5, 0.5, 0.0001);
+    index.update(building(1, 2, moved));
+    auto before = ids(index.candidates(polys[0]));
+    if (ids(index.candidates(moved)) == std::vector<long>{1} &&
+        !std::binary_search(before.begin(), before.end(), 1)) {
+        runtest.pass("BuildingIndex::update() - moved");
+    } else {
+        runtest.fail("BuildingIndex::update() - moved");
+    }
+
+    // An older version from a file processed out of order is ignored
+    index.update(building(1, 1, polys[0]));
+    if (ids(index.candidates(moved)) == std::vector<long>{1}) {
+        runtest.pass("BuildingIndex::update() - older version");
+    } else {
+        runtest.fail("BuildingIndex::update() - older version");
+    }
+
+    // A way that isn't a building anymore is dropped
+    auto way = building(1, 3, moved);
+    way.tags.clear();
+    index.update(way);
+    if (index.candidates(moved).empty() && index.size() == polys.size() - 1) {
+        runtest.pass("BuildingIndex::update() - not a building");
+    } else {
+        runtest.fail("BuildingIndex::update() - not a building");
+    }
+
+    // Deleted buildings
+    way = building(2, 2, polys[1]);
+    way.action = osmobjects::remove;
+    index.update(way);
+    index.erase(3, 1);
+    index.erase(4, 0);
+    auto left = ids(index.candidates(square(-1, -1, 2)));
+    if (!std::binary_search(left.begin(), left.end(), 2) && !std::binary_search(left.begin(), left.end(), 3) &&
+        std::binary_search(left.begin(), left.end(), 4)) {
+        runtest.pass("BuildingIndex::erase()");
+    } else {
+        runtest.fail("BuildingIndex::erase()");
+    }
+
+    // Older versions of deleted buildings, or of ways that are no
+    // longer buildings, don't come back
+    index.update(building(2, 1, polys[1]));
+    index.update(building(3, 0, polys[2]));
+    index.update(building(1, 2, moved));
+    left = ids(index.candidates(square(-1, -1, 2)));
+    if (!std::binary_search(left.begin(), left.end(), 1) && !std::binary_search(left.begin(), left.end(), 2) &&
+        !std::binary_search(left.begin(), left.end(), 3)) {
+        runtest.pass("BuildingIndex::update() - after erase()");
+    } else {
+        runtest.fail("BuildingIndex::update() - after erase()");
+    }
+
+    // Changes applied before the database is read win
+    BuildingIndex late;
+    late.update(building(7, 3, moved));
+    late.erase(9, 2);
+    late.load(9, 1, polys[8], "");
+    late.load(7, 2, polys[6], "");
+    late.load(8, 1, polys[7], "1");
+    late.seal();
+    found = late.candidates(moved);
+    if (late.size() == 2 && ids(found) == std::vector<long>{7} && ids(late.candidates(polys[7])) == std::vector<long>{8} &&
+        late.candidates(polys[7]).front()->layer == "1") {
+        runtest.pass("BuildingIndex::seal() - changes");
+    } else {
+        runtest.fail("BuildingIndex::seal() - changes");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -17,11 +17,14 @@
 //     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <atomic>
 #include <cmath>
 #include <dejagnu.h>
 #include <iostream>
+#include <map>
 #include <pqxx/pqxx>
 #include <string>
+#include <thread>
 
 #include "utils/geoutil.hh"
 #include "utils/log.hh"
@@ -255,7 +258,7 @@ main(int argc, char *argv[])
     boost::geometry::read_wkt(
         "MULTIPOLYGON(((0 0, 0 0.1, 0.1 0.1, 0.1 0, 0 0)))", null_island_poly);
 
-    testco.areaFilter(null_island_poly);
+    testco.areaFilter(geoutil::BoundaryIndex(null_island_poly));
 
     std::list<std::shared_ptr<osmobjects::OsmNode>> priority_nodes;
     for (const auto &change: testco.changes) {
@@ -276,7 +279,7 @@ main(int argc, char *argv[])
     testco.changes.clear();
     testco.nodecache.clear();
     testco.readChanges(test_data_dir + "/123.osc");
-    testco.areaFilter(single_node_poly);
+    testco.areaFilter(geoutil::BoundaryIndex(single_node_poly));
 
     priority_nodes.clear();
     for (const auto &change: testco.changes) {
@@ -291,6 +294,34 @@ main(int argc, char *argv[])
     COMPARE(priority_nodes.front()->id, 5776216755L,
             "ChangeSetFile::areaFilter(single_node_poly) - id");
 
+    // Same boundary, but filtered while parsing
+    size_t cached = testco.nodecache.size();
+    size_t parsed = 0;
+    for (const auto &change: testco.changes) {
+        parsed += change->nodes.size();
+    }
+    testco.changes.clear();
+    testco.nodecache.clear();
+    geoutil::BoundaryIndex single_node_boundary(single_node_poly);
+    testco.setParseFilter(single_node_boundary);
+    testco.readChanges(test_data_dir + "/123.osc");
+    priority_nodes.clear();
+    size_t dropped = 0;
+    for (const auto &change: testco.changes) {
+        for (const auto &node: change->nodes) {
+            priority_nodes.push_back(node);
+        }
+        dropped += change->dropped.size();
+    }
+    COMPARE(priority_nodes.size(), 1,
+            "ChangeSetFile::setParseFilter(single_node_poly) - size");
+    // The dropped nodes are kept aside for the shared node locations
+    COMPARE(dropped, parsed - 1,
+            "ChangeSetFile::setParseFilter(single_node_poly) - dropped");
+    COMPARE(testco.nodecache.size(), cached,
+            "ChangeSetFile::setParseFilter(single_node_poly) - node cache");
+    testco.clearParseFilter();
+
     // Test relations
     testco.changes.clear();
     testco.nodecache.clear();
@@ -340,6 +371,51 @@ main(int argc, char *argv[])
             "ChangeSetFile::readXML(xml) - relation member role");
     COMPARE(member.type, osmobjects::osmtype_t::way,
             "ChangeSetFile::readXML(xml) - relation member type");
+
+    // Tags are packed while parsing, and only decoded when used
+    osmobjects::Tags tags;
+    tags.append("building", "yes");
+    tags.append("name", "first");
+    tags.append("name", "second");
+    VERIFY(!tags.empty(), "Tags::empty() - packed");
+    int visited = 0;
+    tags.visit([&visited](const std::string &key, const std::string &value) {
+        visited++;
+    });
+    COMPARE(visited, 2, "Tags::visit() - packed");
+    COMPARE(tags.size(), 2, "Tags::size()");
+    COMPARE(tags.at("name"), "second", "Tags::at() - last value wins");
+    tags["amenity"] = "hospital";
+    tags.append("name", "third");
+    std::map<std::string, std::string> seen;
+    visited = 0;
+    tags.visit([&visited, &seen](const std::string &key, const std::string &value) {
+        visited++;
+        seen[key] = value;
+    });
+    VERIFY(visited == 3 && seen["name"] == "third", "Tags::visit() - after decoding");
+    COMPARE(tags.count("amenity"), 1, "Tags::operator[]()");
+    COMPARE(tags["name"], "third", "Tags::append() - after decoding");
+
+    // Several threads can read the same packed tags at once
+    osmobjects::Tags shared;
+    for (int i = 0; i < 1000; i++) {
+        shared.append("key" + std::to_string(i), std::to_string(i));
+    }
+    const osmobjects::Tags &reader = shared;
+    std::atomic<int> right{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&reader, &right] {
+            if (reader.size() == 1000 && reader.at("key42") == "42") {
+                right++;
+            }
+        });
+    }
+    for (auto it = std::begin(threads); it != std::end(threads); ++it) {
+        it->join();
+    }
+    COMPARE(right.load(), 8, "Tags - concurrent decode");
 };
 
 // local Variables:
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2024 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// Compare writing the raw nodes of OsmChange files as a batch of
+// upserts, and with COPY through a staging table. This needs a
+// database with the Underpass schema, pass its URL as the first
+// argument, and optionally the number of changed nodes per file as the
+// second. The nodes table is shadowed by a temporary copy, so the
+// real data isn't changed. This isn't run by the testsuite, run it by
+// hand.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "data/pq.hh"
+#include "data/copywriter.hh"
+#include "raw/queryraw.hh"
+
+using namespace queryraw;
+
+int
+main(int argc, char *argv[])
+{
+    std::string url = "localhost/underpass";
+    if (argc > 1) {
+        url = argv[1];
+    }
+    int batchsize = 20000;
+    if (argc > 2) {
+        batchsize = std::stoi(argv[2]);
+    }
+    auto db = std::make_shared<pq::Pq>();
+    if (!db->connect(url)) {
+        std::cerr << "Couldn't connect to " << url << std::endl;
+        return 1;
+    }
+    QueryRaw queryraw(db);
+
+    // A temporary table comes first in the search path, so the
+    // statements write to it instead of the real one
+    db->query("CREATE TEMP TABLE nodes (LIKE public.nodes INCLUDING ALL)");
+
+    // Each file creates new nodes, and modifies some of the ones
+    // created before, with a few tags
+    std::mt19937 rng(49);
+    std::uniform_real_distribution<double> lon(-180, 180);
+    std::uniform_real_distribution<double> lat(-85, 85);
+    const int batches = 20;
+    long nextid = 1;
+    std::vector<std::vector<osmobjects::OsmNode>> changes(batches * 2);
+    for (auto it = std::begin(changes); it != std::end(changes); ++it) {
+        std::uniform_int_distribution<long> ids(1, nextid - 1);
+        for (int i = 0; i < batchsize; i++) {
+            osmobjects::OsmNode node(lat(rng), lon(rng));
+            if (i % 4 == 0 && nextid > 1) {
+                node.id = ids(rng);
+                node.action = osmobjects::modify;
+                node.version = 2;
+            } else {
+                node.id = nextid++;
+                node.action = osmobjects::create;
+                node.version = 1;
+            }
+            node.user = "bench";
+            node.uid = 1;
+            node.changeset = 1;
+            if (i % 10 == 0) {
+                node.tags["amenity"] = "cafe";
+                node.tags["name"] = "Bench's \"cafe\"";
+            }
+            it->push_back(node);
+        }
+    }
+
+    // Alternate between the two, so both see the same table size
+    std::chrono::duration<double> building[2] = {}, writing[2] = {};
+    for (size_t i = 0; i < changes.size(); i++) {
+        int copy = i % 2;
+        auto start = std::chrono::steady_clock::now();
+        std::string query;
+        pq::CopyWriter writer;
+        for (auto it = std::begin(changes[i]); it != std::end(changes[i]); ++it) {
+            if (copy) {
+                queryraw.applyChange(*it, writer);
+            } else {
+                query += queryraw.applyChange(*it);
+            }
+        }
+        auto built = std::chrono::steady_clock::now();
+        if (copy) {
+            writer.flush(*db);
+        } else {
+            db->query(query);
+        }
+        building[copy] += built - start;
+        writing[copy] += std::chrono::steady_clock::now() - built;
+    }
+    for (int copy = 0; copy < 2; copy++) {
+        std::cout << (copy ? "COPY:    " : "Upserts: ") << writing[copy].count() * 1000
+                  << " ms writing, " << building[copy].count() * 1000 << " ms building "
+                  << batches * batchsize << " nodes" << std::endl;
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2024 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <dejagnu.h>
+#include <iostream>
+#include <string>
+
+#include "data/copywriter.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace pq;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("copywriter-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // The COPY text format only needs the separators escaped
+    if (CopyWriter::escape("a\tb\nc\\d'e\"f") == "a\\tb\\nc\\\\d'e\"f") {
+        runtest.pass("CopyWriter::escape()");
+    } else {
+        runtest.fail("CopyWriter::escape()");
+    }
+
+    // Array elements are always quoted
+    if (CopyWriter::array({"1", "a \"b\"", "c\\d"}) == "{\"1\",\"a \\\"b\\\"\",\"c\\\\d\"}" &&
+        CopyWriter::array({}) == "{}") {
+        runtest.pass("CopyWriter::array()");
+    } else {
+        runtest.fail("CopyWriter::array()");
+    }
+
+    // A table is only declared once
+    CopyWriter copy;
+    copy.stage("copy_test", "id int8, name text", {"SELECT 1"});
+    copy.stage("copy_test", "id int8", {});
+    copy.add("copy_test", {std::string("1"), std::nullopt});
+    copy.add("copy_test", {std::string("1"), std::string("b")});
+    if (copy.size() == 2 && !copy.empty()) {
+        runtest.pass("CopyWriter::add()");
+    } else {
+        runtest.fail("CopyWriter::add()");
+    }
+
+    copy.statement("DELETE FROM copy_test;");
+    copy.clear();
+    if (copy.empty()) {
+        runtest.pass("CopyWriter::clear()");
+    } else {
+        runtest.fail("CopyWriter::clear()");
+    }
+
+    if (CopyWriter::latest("copy_test", "id") ==
+        "(SELECT DISTINCT ON (id) * FROM copy_test ORDER BY id, seq DESC) AS s") {
+        runtest.pass("CopyWriter::latest()");
+    } else {
+        runtest.fail("CopyWriter::latest()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "utils/boundaryindex.hh"
+#include "utils/crossings.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace geoutil;
+
+// A random star shaped polygon around the origin, sometimes with a hole
+polygon_t
+randomPolygon(std::mt19937 &rng)
+{
+    std::uniform_int_distribution<int> sides(3, 300);
+    std::uniform_real_distribution<double> radius(1, 10);
+    polygon_t poly;
+    int count = sides(rng);
+    for (int i = 0; i <= count; i++) {
+        double angle = -2 * M_PI * (i % count) / count;
+        if (i == count) {
+            poly.outer().push_back(poly.outer().front());
+        } else {
+            double r = radius(rng);
+            poly.outer().push_back(point_t(r * std::cos(angle), r * std::sin(angle)));
+        }
+    }
+    if (rng() % 2) {
+        polygon_t::ring_type hole{{-0.3, -0.3}, {0.3, -0.3}, {0.3, 0.3}, {-0.3, 0.3}, {-0.3, -0.3}};
+        poly.inners().push_back(hole);
+    }
+    boost::geometry::correct(poly);
+    return poly;
+}
+
+// Random points, the vertices, and points on and near the edges
+std::vector<point_t>
+randomPoints(std::mt19937 &rng, const polygon_t &poly, size_t count)
+{
+    std::uniform_real_distribution<double> coord(-11, 11);
+    std::vector<point_t> points;
+    for (size_t i = 0; i < count; i++) {
+        points.push_back(point_t(coord(rng), coord(rng)));
+    }
+    const auto &ring = poly.outer();
+    for (size_t i = 0; i + 1 < ring.size(); i++) {
+        double x = (ring[i].get<0>() + ring[i + 1].get<0>()) / 2;
+        double y = (ring[i].get<1>() + ring[i + 1].get<1>()) / 2;
+        points.push_back(ring[i]);
+        points.push_back(point_t(x, y));
+        points.push_back(point_t(std::nextafter(x, 100.0), y));
+        points.push_back(point_t(x, ring[i].get<1>()));
+    }
+    std::shuffle(points.begin(), points.end(), rng);
+    return points;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("crossings-test.log");
+    dbglogfile.setVerbosity(3);
+
+    std::mt19937 rng(1234);
+    const crossings::kernel_t kernels[] = {crossings::scalar, crossings::sse4, crossings::avx2};
+    const char *names[] = {"scalar", "sse4", "avx2"};
+    std::vector<int> wrong(3, 0);
+    int batchwrong = 0;
+
+    for (int round = 0; round < 200; round++) {
+        polygon_t poly = randomPolygon(rng);
+        multipolygon_t mpoly;
+        mpoly.push_back(poly);
+        std::vector<point_t> points = randomPoints(rng, poly, 500);
+        std::vector<bool> expected;
+        for (auto it = std::begin(points); it != std::end(points); ++it) {
+            expected.push_back(boost::geometry::within(*it, mpoly));
+        }
+
+        // Test every point against every edge, starting from outside
+        std::vector<crossings::Edge> edges;
+        auto addRing = [&edges](const polygon_t::ring_type &ring) {
+            for (size_t i = 0; i + 1 < ring.size(); i++) {
+                edges.push_back(crossings::Edge{ring[i].get<0>(), ring[i].get<1>(),
+                                                ring[i + 1].get<0>(), ring[i + 1].get<1>()});
+            }
+        };
+        addRing(poly.outer());
+        for (auto it = std::begin(poly.inners()); it != std::end(poly.inners()); ++it) {
+            addRing(*it);
+        }
+        std::vector<uint32_t> index(edges.size());
+        for (uint32_t i = 0; i < index.size(); i++) {
+            index[i] = i;
+        }
+        std::vector<double> xs, ys;
+        for (auto it = std::begin(points); it != std::end(points); ++it) {
+            xs.push_back(it->get<0>());
+            ys.push_back(it->get<1>());
+        }
+        for (int k = 0; k < 3; k++) {
+            if (!crossings::supported(kernels[k])) {
+                continue;
+            }
+            // An odd count exercises the leftover points of the wide kernels
+            size_t count = points.size() - (round % 4);
+            std::vector<uint8_t> state(count);
+            crossings::count(kernels[k], -20.5, -17.25, edges.data(), index.data(), index.size(),
+                             xs.data(), ys.data(), count, state.data());
+            for (size_t i = 0; i < count; i++) {
+                // Points too close to an edge are left to boost::geometry
+                if (!(state[i] & crossings::unsure) && bool(state[i] & crossings::odd) != expected[i]) {
+                    wrong[k]++;
+                }
+            }
+        }
+
+        // Batches through the index have to match exactly
+        BoundaryIndex bindex(mpoly);
+        size_t first = 0;
+        std::uniform_int_distribution<size_t> batch(1, 64);
+        while (first < points.size()) {
+            size_t last = std::min(points.size(), first + batch(rng));
+            std::vector<point_t> part(points.begin() + first, points.begin() + last);
+            std::vector<bool> result = bindex.within(part);
+            for (size_t i = first; i < last; i++) {
+                if (result[i - first] != expected[i]) {
+                    batchwrong++;
+                }
+            }
+            first = last;
+        }
+    }
+
+    for (int k = 0; k < 3; k++) {
+        std::string name = std::string("crossings::count(") + names[k] + ")";
+        if (!crossings::supported(kernels[k])) {
+            runtest.untested(name + " - not supported by this CPU");
+        } else if (wrong[k] == 0) {
+            runtest.pass(name);
+        } else {
+            runtest.fail(name + " - " + std::to_string(wrong[k]) + " wrong");
+        }
+    }
+    if (batchwrong == 0) {
+        runtest.pass("BoundaryIndex::within(points)");
+    } else {
+        runtest.fail("BoundaryIndex::within(points) - " + std::to_string(batchwrong) + " wrong");
+    }
+    if (crossings::supported(crossings::best())) {
+        runtest.pass("crossings::best()");
+    } else {
+        runtest.fail("crossings::best()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
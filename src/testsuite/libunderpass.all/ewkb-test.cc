@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <boost/geometry.hpp>
+
+#include "utils/ewkb.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+// Decode the coordinates of a hex EWKB string, skipping the headers
+// and counts by their known sizes, to check they round trip exactly
+class Reader {
+  public:
+    Reader(const std::string &hex) : data(hex) {};
+    uint8_t byte(void) {
+        uint8_t val = std::stoi(data.substr(offset, 2), nullptr, 16);
+        offset += 2;
+        return val;
+    };
+    uint32_t uint32(void) {
+        uint32_t val = 0;
+        for (int i = 0; i < 4; i++) {
+            val |= uint32_t(byte()) << (8 * i);
+        }
+        return val;
+    };
+    double coordinate(void) {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= uint64_t(byte()) << (8 * i);
+        }
+        double val;
+        std::memcpy(&val, &bits, sizeof(val));
+        return val;
+    };
+    bool done(void) const { return offset == data.size(); };
+
+  private:
+    std::string data;
+    size_t offset = 0;
+};
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("ewkb-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // The same as ST_AsEWKB('SRID=4326;POINT(1 2)')
+    if (ewkb::hex(point_t(1, 2)) == "0101000020E6100000000000000000F03F0000000000000040") {
+        runtest.pass("ewkb::hex(point)");
+    } else {
+        runtest.fail("ewkb::hex(point)");
+    }
+
+    linestring_t line;
+    boost::geometry::read_wkt("LINESTRING(0 0,1 1)", line);
+    if (ewkb::hex(line) == "0102000020E610000002000000"
+                           "00000000000000000000000000000000"
+                           "000000000000F03F000000000000F03F") {
+        runtest.pass("ewkb::hex(linestring)");
+    } else {
+        runtest.fail("ewkb::hex(linestring)");
+    }
+
+    // Multi geometries only have an SRID at the top
+    multipolygon_t mpoly;
+    if (ewkb::hex(mpoly) == "0106000020E610000000000000") {
+        runtest.pass("ewkb::hex(multipolygon) - empty");
+    } else {
+        runtest.fail("ewkb::hex(multipolygon) - empty");
+    }
+    boost::geometry::read_wkt("MULTIPOLYGON(((0 0,0 1,1 1,0 0)),((2 2,2 3,3 3,2 2),(2.1 2.2,2.1 2.3,2.2 2.3,2.1 2.2)))", mpoly);
+    Reader reader(ewkb::hex(mpoly));
+    bool ok = reader.byte() == 1 && reader.uint32() == 0x20000006 && reader.uint32() == 4326 &&
+        reader.uint32() == 2;
+    ok = ok && reader.byte() == 1 && reader.uint32() == 3 && reader.uint32() == 1 && reader.uint32() == 4;
+    for (int i = 0; ok && i < 4; i++) {
+        ok = reader.coordinate() == mpoly[0].outer()[i].get<0>() &&
+            reader.coordinate() == mpoly[0].outer()[i].get<1>();
+    }
+    ok = ok && reader.byte() == 1 && reader.uint32() == 3 && reader.uint32() == 2 && reader.uint32() == 4;
+    for (int i = 0; ok && i < 4; i++) {
+        ok = reader.coordinate() == mpoly[1].outer()[i].get<0>() &&
+            reader.coordinate() == mpoly[1].outer()[i].get<1>();
+    }
+    ok = ok && reader.uint32() == 4;
+    for (int i = 0; ok && i < 4; i++) {
+        ok = reader.coordinate() == mpoly[1].inners()[0][i].get<0>() &&
+            reader.coordinate() == mpoly[1].inners()[0][i].get<1>();
+    }
+    if (ok && reader.done()) {
+        runtest.pass("ewkb::hex(multipolygon)");
+    } else {
+        runtest.fail("ewkb::hex(multipolygon)");
+    }
+
+    multilinestring_t mline;
+    boost::geometry::read_wkt("MULTILINESTRING((0 0,1 1),(2 2,3 3,4 4))", mline);
+    reader = Reader(ewkb::hex(mline));
+    ok = reader.byte() == 1 && reader.uint32() == 0x20000005 && reader.uint32() == 4326 &&
+        reader.uint32() == 2 && reader.byte() == 1 && reader.uint32() == 2 && reader.uint32() == 2;
+    for (int i = 0; ok && i < 4; i++) {
+        reader.coordinate();
+    }
+    ok = ok && reader.byte() == 1 && reader.uint32() == 2 && reader.uint32() == 3;
+    for (int i = 0; ok && i < 6; i++) {
+        ok = reader.coordinate() == i / 2 + 2;
+    }
+    if (ok && reader.done()) {
+        runtest.pass("ewkb::hex(multilinestring)");
+    } else {
+        runtest.fail("ewkb::hex(multilinestring)");
+    }
+
+    // Coordinates must come back exactly, which 12 digits of WKT didn't
+    std::mt19937_64 rng(99);
+    std::uniform_real_distribution<double> lon(-180, 180);
+    std::uniform_real_distribution<double> lat(-90, 90);
+    polygon_t poly;
+    for (int i = 0; i < 1000; i++) {
+        poly.outer().push_back(point_t(lon(rng), lat(rng)));
+    }
+    reader = Reader(ewkb::hex(poly));
+    ok = reader.byte() == 1 && reader.uint32() == 0x20000003 && reader.uint32() == 4326 &&
+        reader.uint32() == 1 && reader.uint32() == 1000;
+    for (auto it = std::begin(poly.outer()); ok && it != std::end(poly.outer()); ++it) {
+        ok = reader.coordinate() == it->get<0>() && reader.coordinate() == it->get<1>();
+    }
+    if (ok && reader.done()) {
+        runtest.pass("ewkb::hex(polygon) - exact coordinates");
+    } else {
+        runtest.fail("ewkb::hex(polygon) - exact coordinates");
+    }
+
+    // The binary encoding is the same bytes without the hex digits
+    std::string bytes = ewkb::binary(poly);
+    std::string hexdigits = ewkb::hex(poly);
+    ok = bytes.size() * 2 == hexdigits.size();
+    for (size_t i = 0; ok && i < bytes.size(); i++) {
+        ok = uint8_t(bytes[i]) == std::stoi(hexdigits.substr(2 * i, 2), nullptr, 16);
+    }
+    if (ok && ewkb::binary(point_t(1, 2)) == std::string("\x01\x01\x00\x00\x20\xE6\x10\x00\x00"
+                                                         "\x00\x00\x00\x00\x00\x00\xF0\x3F"
+                                                         "\x00\x00\x00\x00\x00\x00\x00\x40", 25)) {
+        runtest.pass("ewkb::binary()");
+    } else {
+        runtest.fail("ewkb::binary()");
+    }
+
+    if (ewkb::geometry(point_t(1, 2)) == "'0101000020E6100000000000000000F03F0000000000000040'::geometry") {
+        runtest.pass("ewkb::geometry()");
+    } else {
+        runtest.fail("ewkb::geometry()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
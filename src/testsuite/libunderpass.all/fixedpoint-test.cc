@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/fixedpoint.hh"
+#include "osm/osmobjects.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace osmobjects;
+
+typedef boost::geometry::model::d2::point_xy<double> xy_t;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("fixedpoint-test.log");
+    dbglogfile.setVerbosity(3);
+
+    if (sizeof(FixedPoint) * 2 == sizeof(xy_t)) {
+        runtest.pass("FixedPoint - size");
+    } else {
+        runtest.fail("FixedPoint - size");
+    }
+
+    // Coordinates as they appear in OSM data come back exactly
+    std::vector<std::string> coords = {"-122.4194155", "37.7749295", "179.9999999", "-180.0000000",
+                                       "-89.9999999", "0.0000001", "-0.0000001", "13.3888599"};
+    bool exact = true;
+    for (auto it = std::begin(coords); it != std::end(coords); ++it) {
+        double value = std::stod(*it);
+        FixedPoint point(value, -value);
+        if (point.get<0>() != value || point.y() != -value) {
+            std::cerr << *it << " came back as " << point.x() << std::endl;
+            exact = false;
+        }
+    }
+    if (exact) {
+        runtest.pass("FixedPoint - round trip");
+    } else {
+        runtest.fail("FixedPoint - round trip");
+    }
+
+    FixedPoint point;
+    point.set<0>(151.2092955);
+    point.y(-33.8688197);
+    if (point.fixedX() == 1512092955 && point.fixedY() == -338688197) {
+        runtest.pass("FixedPoint::set()");
+    } else {
+        runtest.fail("FixedPoint::set()");
+    }
+
+    // Values that don't fit are clamped instead of overflowing
+    if (FixedPoint::encode(1e12) == 1800000000 && FixedPoint::encode(-400.0) == -1800000000 &&
+        FixedPoint::encode(-INFINITY) == -1800000000 && FixedPoint::encode(NAN) == 0) {
+        runtest.pass("FixedPoint::encode() - range");
+    } else {
+        runtest.fail("FixedPoint::encode() - range");
+    }
+
+    // The boost::geometry algorithms give the same results as with doubles
+    std::string wkt = "POLYGON((-0.1275862 51.5072178,-0.1270000 51.5072178,-0.1270000 51.5075000,-0.1275862 51.5075000,-0.1275862 51.5072178))";
+    boost::geometry::model::polygon<FixedPoint> fixed;
+    boost::geometry::model::polygon<xy_t> full;
+    boost::geometry::read_wkt(wkt, fixed);
+    boost::geometry::read_wkt(wkt, full);
+    FixedPoint fcenter;
+    xy_t dcenter;
+    boost::geometry::centroid(fixed, fcenter);
+    boost::geometry::centroid(full, dcenter);
+    if (boost::geometry::area(fixed) == boost::geometry::area(full) &&
+        boost::geometry::perimeter(fixed) == boost::geometry::perimeter(full) &&
+        std::fabs(fcenter.x() - dcenter.x()) < 1e-7 && std::fabs(fcenter.y() - dcenter.y()) < 1e-7 &&
+        boost::geometry::within(FixedPoint(-0.1272, 51.5073), fixed) &&
+        !boost::geometry::within(FixedPoint(-0.1269, 51.5073), fixed)) {
+        runtest.pass("FixedPoint - boost::geometry");
+    } else {
+        runtest.fail("FixedPoint - boost::geometry");
+    }
+
+    std::stringstream out;
+    out << std::setprecision(12) << boost::geometry::wkt(fixed);
+    boost::geometry::model::polygon<FixedPoint> again;
+    boost::geometry::read_wkt(out.str(), again);
+    if (boost::geometry::equals(fixed, again)) {
+        runtest.pass("FixedPoint - WKT");
+    } else {
+        runtest.fail("FixedPoint - WKT");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -28,6 +28,7 @@
 #include "boost/date_time/gregorian/gregorian.hpp"
 
 #include "utils/geoutil.hh"
+#include "utils/boundaryindex.hh"
 using namespace geoutil;
 using namespace boost::posix_time;
 using namespace boost::gregorian;
@@ -54,6 +55,25 @@ main(int argc, char* argv[])
 
     std::string test_data_dir(DATADIR);
 
+    // Two overlapping features are dissolved into one valid polygon,
+    // so a point in the overlap is still inside the boundary
+    GeoUtil overlap;
+    multipolygon_t area;
+    boost::geometry::read_wkt("MULTIPOLYGON(((0 0,0 2,2 2,2 0,0 0)))", area);
+    overlap.addArea(area);
+    boost::geometry::read_wkt("MULTIPOLYGON(((1 1,1 3,3 3,3 1,1 1)))", area);
+    overlap.addArea(area);
+    geoutil::BoundaryIndex index(overlap.boundary);
+    point_t inside(1.5, 1.5);
+    if (overlap.boundary.size() == 1 && boost::geometry::is_valid(overlap.boundary)
+        && overlap.inPriorityArea(inside) && index.within(inside)
+        && overlap.inPriorityArea(point_t(0.5, 0.5)) && index.within(point_t(2.5, 2.5))
+        && !overlap.inPriorityArea(point_t(2.5, 0.5)) && !index.within(point_t(0.5, 2.5))) {
+        runtest.pass("GeoUtil::addArea() - overlapping features");
+    } else {
+        runtest.fail("GeoUtil::addArea() - overlapping features");
+    }
+
     if (!tgu.readFile("../xxx/priority.geojson")) {
         runtest.pass("Read file with bad relative path");
     } else {
@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <iostream>
+#include <string>
+
+#include "raw/geometrycache.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace queryraw;
+
+// A closed square with 5 points
+polygon_t
+square(double x)
+{
+    polygon_t polygon;
+    boost::geometry::read_wkt("POLYGON((" + std::to_string(x) + " 0,1 0,1 1,0 1," + std::to_string(x) + " 0))", polygon);
+    return polygon;
+}
+
+// The x of the first point, to tell cached polygons apart
+double
+firstX(const polygon_t &polygon)
+{
+    return polygon.outer().front().get<0>();
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("geometrycache-test.log");
+    dbglogfile.setVerbosity(3);
+
+    GeometryCache cache(17);
+    polygon_t polygon;
+    cache.insert(1, square(0.5), 2);
+    if (cache.get(1, polygon) && firstX(polygon) == 0.5 && !cache.get(2, polygon) && cache.points() == 5) {
+        runtest.pass("GeometryCache::get()");
+    } else {
+        runtest.fail("GeometryCache::get()");
+    }
+
+    // Files can be processed out of order, so old versions are ignored
+    cache.insert(1, square(0.25), 1);
+    cache.get(1, polygon);
+    if (firstX(polygon) == 0.5) {
+        cache.insert(1, square(0.25), 2);
+        cache.get(1, polygon);
+        if (firstX(polygon) == 0.25) {
+            runtest.pass("GeometryCache::insert() - version");
+        } else {
+            runtest.fail("GeometryCache::insert() - version");
+        }
+    } else {
+        runtest.fail("GeometryCache::insert() - version");
+    }
+
+    // Database results never replace what a change file put there
+    cache.insertIfAbsent(1, square(0.75), 3);
+    cache.insertIfAbsent(2, square(0.75), 3);
+    cache.get(1, polygon);
+    double first = firstX(polygon);
+    if (first == 0.25 && cache.get(2, polygon) && firstX(polygon) == 0.75) {
+        runtest.pass("GeometryCache::insertIfAbsent()");
+    } else {
+        runtest.fail("GeometryCache::insertIfAbsent()");
+    }
+
+    // An invalidated way can't be put back by a stale database result
+    cache.erase(2);
+    cache.insertIfAbsent(2, square(0.75), 3);
+    if (!cache.get(2, polygon)) {
+        cache.insert(2, square(0.125), 3);
+        if (cache.get(2, polygon) && firstX(polygon) == 0.125) {
+            runtest.pass("GeometryCache::erase()");
+        } else {
+            runtest.fail("GeometryCache::erase()");
+        }
+    } else {
+        runtest.fail("GeometryCache::erase()");
+    }
+
+    // Way 1 is used, so adding 3 and 4 evicts way 2
+    cache.get(1, polygon);
+    cache.insert(3, square(0.5), 1);
+    cache.insert(4, square(0.5), 1);
+    if (cache.points() <= cache.capacity() && cache.get(1, polygon) && !cache.get(2, polygon) &&
+        cache.get(3, polygon) && cache.get(4, polygon)) {
+        runtest.pass("GeometryCache::insert() - evict");
+    } else {
+        runtest.fail("GeometryCache::insert() - evict");
+    }
+
+    // A way bigger than the cache isn't kept, and doesn't flush it
+    polygon_t big;
+    for (int i = 0; i < 30; i++) {
+        big.outer().push_back(point_t(i, i));
+    }
+    cache.insert(5, big, 1);
+    if (!cache.get(5, polygon) && cache.get(1, polygon) && cache.get(4, polygon)) {
+        runtest.pass("GeometryCache::insert() - too big");
+    } else {
+        runtest.fail("GeometryCache::insert() - too big");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
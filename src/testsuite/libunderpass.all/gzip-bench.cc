@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// Compare inflating an in-memory gzip buffer through boost::iostreams,
+// which is how downloaded replication files used to be handled, with
+// gzip::inflate(). This isn't run by the testsuite, run it by hand.
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+
+#include "utils/gzip.hh"
+
+std::string
+streamInflate(const std::vector<unsigned char> &data)
+{
+    boost::iostreams::filtering_streambuf<boost::iostreams::input> inbuf;
+    inbuf.push(boost::iostreams::gzip_decompressor());
+    boost::iostreams::array_source arrs{reinterpret_cast<char const *>(data.data()), data.size()};
+    inbuf.push(arrs);
+    std::istream instream(&inbuf);
+    return std::string{std::istreambuf_iterator<char>(instream), {}};
+}
+
+template <typename F>
+void
+run(const std::string &name, size_t bytes, int loops, F func)
+{
+    size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; i++) {
+        total += func().size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << elapsed.count() / loops * 1000 << " ms, "
+              << (bytes * loops) / elapsed.count() / (1024 * 1024) << " MB/s ("
+              << total / loops << " bytes)" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    // Size of the uncompressed data in MB
+    size_t megs = 32;
+    if (argc > 1) {
+        megs = std::stoul(argv[1]);
+    }
+    int loops = 5;
+
+    std::string osmchangeFile(DATADIR);
+    osmchangeFile += "/testsuite/testdata/test_change.osc";
+    std::ifstream file(osmchangeFile);
+    std::string sample{std::istreambuf_iterator<char>(file), {}};
+    std::string xml;
+    xml.reserve(megs * 1024 * 1024 + sample.size());
+    while (xml.size() < megs * 1024 * 1024) {
+        xml += sample;
+    }
+    auto data = gzip::deflate(xml);
+    std::cout << "Inflating " << data.size() << " bytes into " << xml.size() << " bytes" << std::endl;
+
+    run("boost::iostreams", xml.size(), loops, [&]() { return streamInflate(data); });
+    run("gzip::inflate", xml.size(), loops, [&]() { return gzip::inflate(data); });
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <algorithm>
+#include <dejagnu.h>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils/gzip.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("gzip-test.log");
+    dbglogfile.setVerbosity(3);
+
+    std::string osmchangeFile(DATADIR);
+    osmchangeFile += "/testsuite/testdata/test_change.osc";
+    std::ifstream file(osmchangeFile);
+    std::string xml{std::istreambuf_iterator<char>(file), {}};
+
+    auto data = gzip::deflate(xml);
+    if (gzip::isGzip(data.data(), data.size()) && gzip::sizeHint(data.data(), data.size()) == xml.size()) {
+        runtest.pass("gzip::sizeHint()");
+    } else {
+        runtest.fail("gzip::sizeHint()");
+    }
+
+    if (gzip::inflate(data) == xml) {
+        runtest.pass("gzip::inflate() - single member");
+    } else {
+        runtest.fail("gzip::inflate() - single member");
+    }
+
+    // Two members, so the trailer only has the size of the second one
+    auto second = gzip::deflate("<!-- more -->");
+    auto both = data;
+    both.insert(both.end(), second.begin(), second.end());
+    if (gzip::inflate(both) == xml + "<!-- more -->") {
+        runtest.pass("gzip::inflate() - multiple members");
+    } else {
+        runtest.fail("gzip::inflate() - multiple members");
+    }
+
+    // A corrupt trailer can't ask for a huge buffer up front
+    auto huge = data;
+    std::fill(huge.end() - 4, huge.end(), 0xff);
+    if (gzip::sizeHint(huge.data(), huge.size()) <= huge.size() * 16) {
+        runtest.pass("gzip::sizeHint() - corrupt trailer");
+    } else {
+        runtest.fail("gzip::sizeHint() - corrupt trailer");
+    }
+
+    // Data that compresses better than that still comes out whole
+    std::string zeros(1024 * 1024, '0');
+    if (gzip::inflate(gzip::deflate(zeros)) == zeros) {
+        runtest.pass("gzip::inflate() - large ratio");
+    } else {
+        runtest.fail("gzip::inflate() - large ratio");
+    }
+
+    // Data that isn't compressed is passed through
+    std::vector<unsigned char> plain(xml.begin(), xml.end());
+    if (gzip::inflate(plain) == xml) {
+        runtest.pass("gzip::inflate() - not compressed");
+    } else {
+        runtest.fail("gzip::inflate() - not compressed");
+    }
+
+    // A truncated file must be an error, not a short result
+    auto truncated = data;
+    truncated.resize(data.size() / 2);
+    try {
+        gzip::inflate(truncated);
+        runtest.fail("gzip::inflate() - truncated");
+    } catch (std::exception &e) {
+        runtest.pass("gzip::inflate() - truncated");
+    }
+
+    auto corrupted = data;
+    corrupted[corrupted.size() / 2] ^= 0xff;
+    corrupted[corrupted.size() / 2 + 1] ^= 0xff;
+    try {
+        gzip::inflate(corrupted);
+        runtest.fail("gzip::inflate() - corrupted");
+    } catch (std::exception &e) {
+        runtest.pass("gzip::inflate() - corrupted");
+    }
+
+    // A directory can be opened, but has no size to read
+    try {
+        gzip::inflateFile(DATADIR);
+        runtest.fail("gzip::inflateFile() - not a file");
+    } catch (std::runtime_error &e) {
+        runtest.pass("gzip::inflateFile() - not a file");
+    } catch (std::exception &e) {
+        runtest.fail("gzip::inflateFile() - not a file");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
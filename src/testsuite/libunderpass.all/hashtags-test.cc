@@ -41,7 +41,7 @@ main(int argc, char *argv[])
     changesets::ChangeSet *change;
     changeset.readChanges(changesetFile);
     multipolygon_t polyEmpty;
-    changeset.areaFilter(polyEmpty);
+    changeset.areaFilter(geoutil::BoundaryIndex(polyEmpty));
     change = changeset.changes.front().get();
 
     // for (auto it = std::begin(change->hashtags); it != std::end(change->hashtags); ++it) {
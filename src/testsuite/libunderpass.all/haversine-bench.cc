@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// Compare how long the highway_km statistics take to compute with
+// boost::geometry and with the haversine kernels, on a synthetic
+// change file that is mostly new highways, like a mapathon produces.
+// This isn't run by the testsuite, run it by hand.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/osmobjects.hh"
+#include "utils/haversine.hh"
+
+using namespace geoutil;
+
+template <typename F>
+void
+run(const std::string &name, size_t count, F func)
+{
+    auto start = std::chrono::steady_clock::now();
+    double km = func();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << elapsed.count() * 1000 << " ms, "
+              << count / elapsed.count() << " segments/s (" << km << " km)" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    // Roads of 5 to 50 nodes, 10 to 100 meters apart, in a city
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> lon(36.7, 36.9);
+    std::uniform_real_distribution<double> lat(-1.4, -1.2);
+    std::uniform_real_distribution<double> step(0.0001, 0.0009);
+    std::uniform_real_distribution<double> turn(-0.5, 0.5);
+    std::uniform_int_distribution<int> nodes(5, 50);
+    std::vector<std::vector<point_t>> ways;
+    size_t segments = 0;
+    for (int i = 0; i < 200000; i++) {
+        std::vector<point_t> way(1, point_t(lon(rng), lat(rng)));
+        double heading = turn(rng) * 2 * M_PI;
+        int count = nodes(rng);
+        for (int j = 1; j < count; j++) {
+            heading += turn(rng);
+            double distance = step(rng);
+            way.push_back(point_t(way.back().get<0>() + distance * std::cos(heading),
+                                  way.back().get<1>() + distance * std::sin(heading)));
+        }
+        segments += count - 1;
+        ways.push_back(way);
+    }
+    std::cout << ways.size() << " ways, " << segments << " segments" << std::endl;
+
+    // What OsmChangeFile::collectStats() used to do for each way
+    run("boost::geometry::length", segments, [&]() {
+        double km = 0;
+        for (const auto &way : ways) {
+            boost::geometry::model::linestring<sphere_t> globe;
+            for (const auto &point : way) {
+                globe.push_back(sphere_t(point.get<0>(), point.get<1>()));
+            }
+            km += boost::geometry::length(globe, boost::geometry::strategy::distance::haversine<float>(6371.0));
+        }
+        return km;
+    });
+    for (auto kernel : {haversine::scalar, haversine::avx2}) {
+        if (!haversine::supported(kernel)) {
+            continue;
+        }
+        std::string name = kernel == haversine::avx2 ? "haversine::length(avx2)" : "haversine::length(scalar)";
+        run(name, segments, [&]() {
+            double km = 0;
+            std::vector<double> lons, lats;
+            for (const auto &way : ways) {
+                lons.clear();
+                lats.clear();
+                for (const auto &point : way) {
+                    lons.push_back(point.get<0>());
+                    lats.push_back(point.get<1>());
+                }
+                km += haversine::length(kernel, lons.data(), lats.data(), lons.size());
+            }
+            return km;
+        });
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
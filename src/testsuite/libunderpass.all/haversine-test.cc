@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/osmobjects.hh"
+#include "utils/haversine.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace geoutil;
+
+// The length boost::geometry computes for the same line
+double
+expected(const std::vector<double> &lons, const std::vector<double> &lats)
+{
+    boost::geometry::model::linestring<sphere_t> globe;
+    for (size_t i = 0; i < lons.size(); i++) {
+        globe.push_back(sphere_t(lons[i], lats[i]));
+    }
+    return boost::geometry::length(globe, boost::geometry::strategy::distance::haversine<double>(haversine::earth_radius));
+}
+
+bool
+close(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+// Check every kernel against boost::geometry on a set of lines
+bool
+check(const std::vector<std::vector<double>> &lons, const std::vector<std::vector<double>> &lats,
+      haversine::kernel_t kernel)
+{
+    for (size_t i = 0; i < lons.size(); i++) {
+        double length = haversine::length(kernel, lons[i].data(), lats[i].data(), lons[i].size());
+        double want = expected(lons[i], lats[i]);
+        if (!close(length, want)) {
+            std::cerr << "Line " << i << " is " << length << "km, not " << want << "km" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("haversine-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Short ways like highways, a few meters to a few hundred meters
+    // between nodes, anywhere on the planet
+    std::mt19937 rng(40);
+    std::uniform_real_distribution<double> lon(-180, 180);
+    std::uniform_real_distribution<double> lat(-89, 89);
+    std::uniform_real_distribution<double> step(-0.003, 0.003);
+    std::uniform_int_distribution<int> nodes(0, 60);
+    std::vector<std::vector<double>> lons, lats;
+    for (int i = 0; i < 2000; i++) {
+        std::vector<double> x(1, lon(rng));
+        std::vector<double> y(1, lat(rng));
+        int count = nodes(rng);
+        for (int j = 1; j < count; j++) {
+            x.push_back(x.back() + step(rng));
+            y.push_back(y.back() + step(rng));
+        }
+        if (count == 0) {
+            x.clear();
+            y.clear();
+        }
+        lons.push_back(x);
+        lats.push_back(y);
+    }
+
+    // Long segments, which don't use the series
+    std::vector<std::vector<double>> longlons, longlats;
+    longlons.push_back({-122.4, 2.35, 139.7, 151.2, -74.0, 18.4, -43.2});
+    longlats.push_back({37.8, 48.85, 35.7, -33.9, 40.7, -33.9, -22.9});
+    // Across the antimeridian, near the poles and nearly antipodal
+    longlons.push_back({179.9, -179.9, 179.95, -179.95, 0.0, 180.0, 0.0, 179.999});
+    longlats.push_back({-16.5, -16.6, 89.999, 89.998, 0.0, 0.0, 45.0, -44.999});
+    // Long and short segments mixed up in the same vector
+    longlons.push_back({10.0, 10.001, 10.002, 12.0, 12.001, 12.002, 15.0, 15.001, 15.002, 15.003});
+    longlats.push_back({50.0, 50.001, 50.002, 51.0, 51.0, 51.001, 40.0, 40.0, 40.001, 40.002});
+
+    for (auto kernel : {haversine::scalar, haversine::avx2}) {
+        std::string name = "haversine::length(" + std::to_string(kernel) + ")";
+        if (!haversine::supported(kernel)) {
+            runtest.untested(name);
+            continue;
+        }
+        if (check(lons, lats, kernel)) {
+            runtest.pass(name + " - short segments");
+        } else {
+            runtest.fail(name + " - short segments");
+        }
+        if (check(longlons, longlats, kernel)) {
+            runtest.pass(name + " - long segments");
+        } else {
+            runtest.fail(name + " - long segments");
+        }
+    }
+
+    // One kilometer along the equator, as close as the point type can
+    // store it
+    linestring_t line;
+    boost::geometry::read_wkt("LINESTRING(0 0,0.00449660802959 0,0.00899321605918 0)", line);
+    std::vector<double> xs, ys;
+    for (auto it = std::begin(line); it != std::end(line); ++it) {
+        xs.push_back(it->get<0>());
+        ys.push_back(it->get<1>());
+    }
+    if (close(haversine::length(line), expected(xs, ys)) && std::fabs(haversine::length(line) - 1.0) < 1e-5) {
+        runtest.pass("haversine::length(linestring_t)");
+    } else {
+        runtest.fail("haversine::length(linestring_t)");
+    }
+
+    linestring_t empty;
+    boost::geometry::read_wkt("LINESTRING(12 34)", line);
+    if (haversine::length(empty) == 0.0 && haversine::length(line) == 0.0) {
+        runtest.pass("haversine::length() - no segments");
+    } else {
+        runtest.fail("haversine::length() - no segments");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
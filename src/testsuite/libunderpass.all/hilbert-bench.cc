@@ -0,0 +1,135 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// Compare writing batches of node upserts in file order and in Hilbert
+// order. This needs a database with PostGIS, pass its URL as the first
+// argument, and optionally the number of nodes in the table as the
+// second. The table needs to be much larger than shared_buffers for
+// the difference to show. Only a temporary table is used. This isn't
+// run by the testsuite, run it by hand.
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "data/pq.hh"
+#include "utils/hilbert.hh"
+
+using namespace geoutil;
+
+// An upsert like the ones QueryRaw writes for nodes
+std::string
+upsert(long id, const point_t &point)
+{
+    std::string geom = "ST_SetSRID(ST_MakePoint(" + std::to_string(point.get<0>()) + "," +
+        std::to_string(point.get<1>()) + "),4326)";
+    return "INSERT INTO bench_nodes as r (osm_id, geom, version) VALUES(" + std::to_string(id) + "," +
+        geom + ",2) ON CONFLICT (osm_id) DO UPDATE SET geom = " + geom + ", version = 2;";
+}
+
+int
+main(int argc, char *argv[])
+{
+    std::string url = "localhost/underpass";
+    if (argc > 1) {
+        url = argv[1];
+    }
+    long count = 2000000;
+    if (argc > 2) {
+        count = std::stol(argv[2]);
+    }
+    pq::Pq db;
+    if (!db.connect(url)) {
+        std::cerr << "Couldn't connect to " << url << std::endl;
+        return 1;
+    }
+
+    // Nodes are spread over the planet, but the ID doesn't say where,
+    // like for nodes created over the years
+    std::mt19937 rng(46);
+    std::uniform_real_distribution<double> lon(-180, 180);
+    std::uniform_real_distribution<double> lat(-85, 85);
+    std::vector<point_t> nodes(count + 1);
+    db.query("CREATE TEMP TABLE bench_nodes (osm_id int8 PRIMARY KEY, geom geometry(Point,4326), version int)");
+    std::string values;
+    for (long id = 1; id <= count; id++) {
+        nodes[id] = point_t(lon(rng), lat(rng));
+        values += "(" + std::to_string(id) + ",ST_SetSRID(ST_MakePoint(" + std::to_string(nodes[id].get<0>()) +
+            "," + std::to_string(nodes[id].get<1>()) + "),4326),1),";
+        if (id % 10000 == 0 || id == count) {
+            values.pop_back();
+            db.query("INSERT INTO bench_nodes VALUES" + values);
+            values.clear();
+        }
+    }
+    db.query("CREATE INDEX bench_nodes_geom_idx ON bench_nodes USING gist(geom)");
+    db.query("ANALYZE bench_nodes");
+
+    // Batches of modified nodes, each one a small move from where it
+    // is, which is what an OsmChange file mostly is
+    std::uniform_int_distribution<long> ids(1, count);
+    std::uniform_real_distribution<double> move(-0.0005, 0.0005);
+    const int batches = 20;
+    const int batchsize = 5000;
+    std::vector<std::vector<std::pair<long, point_t>>> changes(batches * 2);
+    for (auto it = std::begin(changes); it != std::end(changes); ++it) {
+        for (int i = 0; i < batchsize; i++) {
+            long id = ids(rng);
+            point_t point(nodes[id].get<0>() + move(rng), nodes[id].get<1>() + move(rng));
+            it->push_back(std::make_pair(id, point));
+        }
+    }
+
+    // Alternate between the two, so both see the same cache state
+    std::chrono::duration<double> building[2] = {}, writing[2] = {};
+    for (size_t i = 0; i < changes.size(); i++) {
+        int sorted = i % 2;
+        auto start = std::chrono::steady_clock::now();
+        std::string query;
+        if (sorted) {
+            hilbert::SortedBatch batch;
+            for (auto it = std::begin(changes[i]); it != std::end(changes[i]); ++it) {
+                batch.add(it->first, hilbert::key(it->second), upsert(it->first, it->second));
+            }
+            batch.flush(query);
+        } else {
+            for (auto it = std::begin(changes[i]); it != std::end(changes[i]); ++it) {
+                query += upsert(it->first, it->second);
+            }
+        }
+        auto built = std::chrono::steady_clock::now();
+        db.query(query);
+        building[sorted] += built - start;
+        writing[sorted] += std::chrono::steady_clock::now() - built;
+    }
+    for (int sorted = 0; sorted < 2; sorted++) {
+        std::cout << (sorted ? "Hilbert order: " : "File order:    ") << writing[sorted].count() * 1000
+                  << " ms writing, " << building[sorted].count() * 1000 << " ms building "
+                  << batches * batchsize << " upserts" << std::endl;
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
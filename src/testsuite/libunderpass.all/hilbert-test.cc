@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "utils/hilbert.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace geoutil;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("hilbert-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // The curve starts and ends in the bottom corners, and anything
+    // off the planet is clamped to the edge
+    const double cell = 360.0 / (1 << hilbert::order);
+    const uint64_t last = hilbert::unknown - 1;
+    if (hilbert::key(-180, -90) == 0 && hilbert::key(180, -90) == last &&
+        hilbert::key(-200, -100) == 0 && hilbert::key(200, -100) == last) {
+        runtest.pass("hilbert::key() - corners");
+    } else {
+        runtest.fail("hilbert::key() - corners");
+    }
+
+    // Walking along the curve, each step moves to a neighbouring cell.
+    // Check a small corner of the grid, where every key is different.
+    const int side = 64;
+    std::set<uint64_t> keys;
+    std::vector<std::pair<int, int>> cells(side * side);
+    for (int x = 0; x < side; x++) {
+        for (int y = 0; y < side; y++) {
+            double lon = -180 + (x + 0.5) * cell;
+            double lat = -90 + (y + 0.5) * cell / 2;
+            uint64_t key = hilbert::key(lon, lat);
+            keys.insert(key);
+            if (key < cells.size()) {
+                cells[key] = std::make_pair(x, y);
+            }
+        }
+    }
+    bool adjacent = keys.size() == cells.size() && *keys.rbegin() == cells.size() - 1;
+    for (size_t i = 1; adjacent && i < cells.size(); i++) {
+        int dx = std::abs(cells[i].first - cells[i - 1].first);
+        int dy = std::abs(cells[i].second - cells[i - 1].second);
+        adjacent = dx + dy == 1;
+    }
+    if (adjacent) {
+        runtest.pass("hilbert::key() - adjacent cells");
+    } else {
+        runtest.fail("hilbert::key() - adjacent cells");
+    }
+
+    // Statements come out in curve order, and the ones for the same
+    // object stay together in the order they were added
+    hilbert::SortedBatch batch;
+    batch.add(1, 30, "a1;");
+    batch.add(2, 10, "b;");
+    batch.add(3, hilbert::unknown, "c;");
+    batch.add(1, 5, "a2;");
+    batch.add(4, 20, "");
+    batch.add(5, 20, "d;");
+    std::string query = "BEGIN;";
+    size_t size = batch.size();
+    batch.flush(query);
+    if (size == 5 && query == "BEGIN;b;d;a1;a2;c;" && batch.empty()) {
+        runtest.pass("SortedBatch::flush()");
+    } else {
+        runtest.fail("SortedBatch::flush()");
+    }
+
+    std::vector<point_t> points = {point_t(170, 80), point_t(-170, -80), point_t(10, 10), point_t(-170, -80)};
+    std::vector<int> ids = {0, 1, 2, 3};
+    hilbert::sort(ids, [&](int id) { return hilbert::key(points[id]); });
+    if (ids[0] == 1 && ids[1] == 3 && ids[2] == 2 && ids[3] == 0) {
+        runtest.pass("hilbert::sort()");
+    } else {
+        runtest.fail("hilbert::sort()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "osm/nodecache.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("nodecache-test.log");
+    dbglogfile.setVerbosity(3);
+
+    osmobjects::NodeCache cache;
+    point_t point;
+    if (cache.empty() && !cache.get(1, point) && cache.count(1) == 0) {
+        runtest.pass("NodeCache::get() - empty");
+    } else {
+        runtest.fail("NodeCache::get() - empty");
+    }
+
+    // Coordinates with 7 decimals must come back exactly as parsed
+    cache.insert(4259653411, point_t(std::stod("-1.3751891"), std::stod("50.9176152")));
+    cache.insert(-12, point_t(std::stod("179.9999999"), std::stod("-89.9999999")));
+    if (cache.get(4259653411, point) && point.get<0>() == std::stod("-1.3751891") &&
+        point.get<1>() == std::stod("50.9176152") && cache.get(-12, point) &&
+        point.get<0>() == std::stod("179.9999999") && point.get<1>() == std::stod("-89.9999999")) {
+        runtest.pass("NodeCache::get() - exact");
+    } else {
+        runtest.fail("NodeCache::get() - exact");
+    }
+
+    cache.insert(-12, point_t(1.5, 2.5));
+    if (cache.size() == 2 && cache.get(-12, point) && point.get<0>() == 1.5) {
+        runtest.pass("NodeCache::insert() - replace");
+    } else {
+        runtest.fail("NodeCache::insert() - replace");
+    }
+
+    // Grow well past the initial size, and compare with a std::map
+    std::map<long, point_t> expected;
+    for (long id = 1; id < 300000; id += 3) {
+        long x = (id * 7919) % 3600000000 - 1800000000;
+        long y = (id * 104729) % 1800000000 - 900000000;
+        point_t pt(x / 1e7, y / 1e7);
+        expected[id] = pt;
+        cache.insert(id, pt);
+    }
+    bool same = cache.size() == expected.size() + 2;
+    for (auto it = std::begin(expected); it != std::end(expected); ++it) {
+        if (!cache.get(it->first, point) || point.get<0>() != it->second.get<0>() ||
+            point.get<1>() != it->second.get<1>() || cache.count(it->first + 1)) {
+            same = false;
+        }
+    }
+    size_t visited = 0;
+    cache.forEach([&visited](int64_t id, const point_t &pt) {
+        visited++;
+    });
+    if (same && visited == cache.size()) {
+        runtest.pass("NodeCache::insert() - grow");
+    } else {
+        runtest.fail("NodeCache::insert() - grow");
+    }
+
+    cache.clear();
+    cache.reserve(10);
+    if (cache.size() == 0 && !cache.get(4259653411, point) && !cache.count(1)) {
+        runtest.pass("NodeCache::clear()");
+    } else {
+        runtest.fail("NodeCache::clear()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "raw/nodeindex.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace queryraw;
+
+// Check the index returns the location it was given
+bool
+hasLocation(NodeIndex &index, int64_t id, double x, double y)
+{
+    point_t point;
+    return index.get(id, point) && point.get<0>() == x && point.get<1>() == y;
+}
+
+void
+testLayout(NodeIndex::index_t layout, const std::string &name, const std::string &filespec)
+{
+    boost::filesystem::remove(filespec);
+    {
+        NodeIndex index;
+        if (index.open(filespec, layout) && index.getLayout() == layout) {
+            runtest.pass("NodeIndex::open() - " + name);
+        } else {
+            runtest.fail("NodeIndex::open() - " + name);
+            return;
+        }
+
+        point_t point;
+        // Added out of order, which a sparse index has to keep sorted
+        index.set(30, point_t(-77.0365298, 38.8976763), 1);
+        index.set(10, point_t(2.2944813, 48.8583701), 1);
+        index.set(20, point_t(-180.0, -90.0), 1);
+        if (hasLocation(index, 10, 2.2944813, 48.8583701) &&
+            hasLocation(index, 20, -180.0, -90.0) &&
+            hasLocation(index, 30, -77.0365298, 38.8976763) &&
+            !index.get(15, point) && !index.get(40, point) && !index.get(-1, point)) {
+            runtest.pass("NodeIndex::get() - " + name);
+        } else {
+            runtest.fail("NodeIndex::get() - " + name);
+        }
+
+        index.set(20, point_t(180.0, 90.0), 2);
+        index.erase(10, 2);
+        if (hasLocation(index, 20, 180.0, 90.0) && !index.get(10, point) &&
+            hasLocation(index, 30, -77.0365298, 38.8976763)) {
+            runtest.pass("NodeIndex::erase() - " + name);
+        } else {
+            runtest.fail("NodeIndex::erase() - " + name);
+        }
+
+        // Older versions, from files processed out of order, or from a
+        // database read that raced a change, don't replace newer ones
+        // or bring back a deleted node
+        if (!index.set(20, point_t(-180.0, -90.0), 1) && !index.set(10, point_t(1.0, 1.0), 1) &&
+            hasLocation(index, 20, 180.0, 90.0) && !index.get(10, point) &&
+            index.set(10, point_t(1.0, 1.0), 3) && hasLocation(index, 10, 1.0, 1.0)) {
+            runtest.pass("NodeIndex::set() - version " + name);
+        } else {
+            runtest.fail("NodeIndex::set() - version " + name);
+        }
+
+        // Nodes loaded in bulk in descending order, like the bootstrap
+        // reads them, with an older version of one already in the index
+        for (int64_t id = 1000; id > 100; id--) {
+            index.load(id, point_t(id / 100.0, 1.0), 1);
+        }
+        index.load(20, point_t(0.5, 0.5), 1);
+        index.load(500, point_t(0.5, 0.5), 2);
+        index.seal();
+        if (hasLocation(index, 101, 1.01, 1.0) && hasLocation(index, 1000, 10.0, 1.0) &&
+            hasLocation(index, 500, 0.5, 0.5) && hasLocation(index, 20, 180.0, 90.0) &&
+            !index.get(100, point)) {
+            runtest.pass("NodeIndex::load() - " + name);
+        } else {
+            runtest.fail("NodeIndex::load() - " + name);
+        }
+
+        // A node ID past the end of the file makes it grow
+        index.set(40000000, point_t(0.0, 0.0), 1);
+        if (hasLocation(index, 40000000, 0.0, 0.0) && hasLocation(index, 30, -77.0365298, 38.8976763)) {
+            runtest.pass("NodeIndex::set() - grow " + name);
+        } else {
+            runtest.fail("NodeIndex::set() - grow " + name);
+        }
+    }
+
+    // The layout of an existing file wins over the one asked for
+    NodeIndex index;
+    NodeIndex::index_t other = (layout == NodeIndex::dense) ? NodeIndex::sparse : NodeIndex::dense;
+    if (index.open(filespec, other) && index.getLayout() == layout &&
+        hasLocation(index, 20, 180.0, 90.0) && hasLocation(index, 40000000, 0.0, 0.0)) {
+        runtest.pass("NodeIndex::open() - reopen " + name);
+    } else {
+        runtest.fail("NodeIndex::open() - reopen " + name);
+    }
+    index.close();
+    boost::filesystem::remove(filespec);
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("nodeindex-test.log");
+    dbglogfile.setVerbosity(3);
+
+    std::string tmpdir = boost::filesystem::temp_directory_path().string();
+    testLayout(NodeIndex::dense, "dense", tmpdir + "/underpass-test-dense.idx");
+    testLayout(NodeIndex::sparse, "sparse", tmpdir + "/underpass-test-sparse.idx");
+
+    // Something that isn't an index is rejected
+    std::string junk = tmpdir + "/underpass-test-junk.idx";
+    {
+        std::ofstream file(junk);
+        file << std::string(8192, 'x');
+    }
+    NodeIndex index;
+    if (!index.open(junk)) {
+        runtest.pass("NodeIndex::open() - bad file");
+    } else {
+        runtest.fail("NodeIndex::open() - bad file");
+    }
+    boost::filesystem::remove(junk);
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -20,8 +20,12 @@
 #include "data/pq.hh"
 #include "utils/log.hh"
 #include <dejagnu.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
 
 TestState runtest;
 
@@ -102,6 +106,80 @@ main(int argc, char *argv[])
         runtest.fail("PQ::parseURL(user:pass@remote)");
         return 1;
     }
+
+    // Without a connection there is nothing to check out
+    try {
+        tp.checkout();
+        runtest.fail("Pq::checkout() - not connected");
+    } catch (const pqxx::broken_connection &) {
+        runtest.pass("Pq::checkout() - not connected");
+    }
+
+    if (!tp.isOpen()) {
+        runtest.pass("Pq::isOpen() - not connected");
+    } else {
+        runtest.fail("Pq::isOpen() - not connected");
+    }
+
+    // The rest needs a database
+    const std::string dbconn{getenv("UNDERPASS_TEST_DB_CONN")
+                                    ? getenv("UNDERPASS_TEST_DB_CONN")
+                                    : "user=underpass_test host=localhost password=underpass_test"};
+    pq::Pq pool;
+    if (!pool.connect(dbconn + " dbname=underpass_test", 2)) {
+        runtest.untested("Pq::checkout() - pool");
+        return 0;
+    }
+
+    // With both connections in use, a third checkout waits for one of
+    // them to come back
+    std::atomic<bool> done{false};
+    std::thread waiter;
+    bool waited = false;
+    size_t idle = 0;
+    {
+        auto second = pool.checkout();
+        {
+            auto first = pool.checkout();
+            waiter = std::thread([&pool, &done] {
+                auto third = pool.checkout();
+                done = true;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            waited = !done;
+        }
+        waiter.join();
+        idle = pool.idleConnections();
+    }
+    if (pool.poolSize() == 2 && waited && done && idle == 1 && pool.idleConnections() == 2) {
+        runtest.pass("Pq::checkout() - pool");
+    } else {
+        runtest.fail("Pq::checkout() - pool");
+    }
+
+    // A discarded connection is closed, and replaced when needed
+    {
+        auto conn = pool.checkout();
+        conn.discard();
+    }
+    idle = pool.idleConnections();
+    auto result = pool.query("SELECT 1");
+    if (idle == 1 && result.size() == 1 && pool.idleConnections() == 1) {
+        runtest.pass("Pq::Connection::discard()");
+    } else {
+        runtest.fail("Pq::Connection::discard()");
+    }
+
+    // Strings can be escaped while every pooled connection is in use
+    {
+        auto first = pool.checkout();
+        auto second = pool.checkout();
+        if (pool.isOpen() && !pool.escapedString("it's").empty()) {
+            runtest.pass("Pq::escapedString() - pool in use");
+        } else {
+            runtest.fail("Pq::escapedString() - pool in use");
+        }
+    }
 }
 
 // local Variables:
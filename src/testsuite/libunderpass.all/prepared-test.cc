@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <dejagnu.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "data/prepared.hh"
+#include "utils/ewkb.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace pq;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("prepared-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Executions of undeclared statements are dropped, and empty SQL
+    // isn't worth a round trip
+    PreparedBatch batch;
+    batch.prepare("prepared_test", "INSERT INTO prepared_test VALUES ($1, $2::geometry, $3::jsonb, $4) \
+ON CONFLICT (id) DO UPDATE SET geom = EXCLUDED.geom, tags = EXCLUDED.tags, name = EXCLUDED.name", {2, 3});
+    batch.add("prepared_test", {std::string("1"), ewkb::binary(point_t(1, 2)),
+                                PreparedBatch::jsonb("{\"name\": \"O'Brien\"}"), std::string("O'Brien")});
+    batch.add("prepared_none", {std::string("1")});
+    batch.statement("");
+    batch.add("prepared_test", {std::string("2"), ewkb::binary(point_t(3, 4)), std::nullopt, std::nullopt});
+    if (batch.size() == 2 && !batch.empty()) {
+        runtest.pass("PreparedBatch::add()");
+    } else {
+        runtest.fail("PreparedBatch::add()");
+    }
+
+    if (PreparedBatch::jsonb("{}") == std::string("\x01{}")) {
+        runtest.pass("PreparedBatch::jsonb()");
+    } else {
+        runtest.fail("PreparedBatch::jsonb()");
+    }
+
+    // The rest needs a database with PostGIS
+    const std::string dbconn{getenv("UNDERPASS_TEST_DB_CONN")
+                                    ? getenv("UNDERPASS_TEST_DB_CONN")
+                                    : "user=underpass_test host=localhost password=underpass_test"};
+    pq::Pq db;
+    if (!db.connect(dbconn + " dbname=underpass_test")) {
+        runtest.untested("PreparedBatch::flush()");
+        return 0;
+    }
+
+    // With a single connection in the pool the temporary table is
+    // visible to the batch
+    db.query("CREATE TEMP TABLE prepared_test (id int8 PRIMARY KEY, geom geometry, tags jsonb, name text)");
+    batch.flush(db);
+    auto result = db.query("SELECT ST_AsEWKT(geom), tags->>'name', name FROM prepared_test ORDER BY id");
+    if (result.size() == 2 && result[0][0].as<std::string>() == "SRID=4326;POINT(1 2)" &&
+        result[0][1].as<std::string>() == "O'Brien" && result[0][2].as<std::string>() == "O'Brien" &&
+        result[1][1].is_null() && result[1][2].is_null()) {
+        runtest.pass("PreparedBatch::flush()");
+    } else {
+        runtest.fail("PreparedBatch::flush()");
+    }
+
+    // The statements can be used again on the same connection
+    batch.clear();
+    batch.add("prepared_test", {std::string("2"), ewkb::binary(point_t(5, 6)), std::nullopt, std::string("moved")});
+    batch.statement("DELETE FROM prepared_test WHERE id = 1");
+    batch.flush(db);
+    result = db.query("SELECT id, name FROM prepared_test");
+    if (result.size() == 1 && result[0][1].as<std::string>() == "moved") {
+        runtest.pass("PreparedBatch::flush() - again");
+    } else {
+        runtest.fail("PreparedBatch::flush() - again");
+    }
+
+    // Another batch declaring the same statement uses the one the
+    // pooled connection already prepared
+    PreparedBatch other;
+    other.prepare("prepared_test", "INSERT INTO prepared_test VALUES ($1, $2::geometry, $3::jsonb, $4) \
+ON CONFLICT (id) DO UPDATE SET geom = EXCLUDED.geom, tags = EXCLUDED.tags, name = EXCLUDED.name", {2, 3});
+    other.add("prepared_test", {std::string("3"), ewkb::binary(point_t(7, 8)), std::nullopt, std::string("other")});
+    try {
+        other.flush(db);
+        result = db.query("SELECT id FROM prepared_test WHERE name = 'other'");
+        if (result.size() == 1) {
+            runtest.pass("PreparedBatch::flush() - another batch");
+        } else {
+            runtest.fail("PreparedBatch::flush() - another batch");
+        }
+    } catch (const std::exception &e) {
+        runtest.fail("PreparedBatch::flush() - another batch");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <dejagnu.h>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "osm/osmobjects.hh"
+#include "utils/quadkey.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace geoutil;
+
+// Decode a quadkey string like "213" into the stored key
+int64_t
+expected(const std::string &digits)
+{
+    int64_t key = 0;
+    for (auto digit: digits) {
+        key = (key << 2) | (digit - '0');
+    }
+    return key << (2 * (quadkey::maxzoom - digits.size()));
+}
+
+// True if one key is the key of a tile containing the other one
+bool
+ancestor(int64_t parent, int64_t child)
+{
+    for (unsigned int zoom = 0; zoom <= quadkey::maxzoom; zoom++) {
+        int64_t mask = (int64_t(1) << (2 * (quadkey::maxzoom - zoom))) - 1;
+        if ((child & ~mask) == parent && (parent & mask) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("quadkey-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Just south east of 0,0 is the first tile of the fourth quadrant,
+    // and the corners of the map are the first and last tiles
+    uint32_t x, y;
+    quadkey::tile(0.0001, -0.0001, x, y);
+    if (x == 32768 && y == 32768 &&
+        quadkey::key(point_t(0.0001, -0.0001)) == expected("3000000000000000") &&
+        quadkey::key(point_t(-180, 90)) == expected("0000000000000000") &&
+        quadkey::key(point_t(180, -90)) == expected("3333333333333333")) {
+        runtest.pass("quadkey::key() - point");
+    } else {
+        runtest.fail("quadkey::key() - point");
+    }
+
+    // The bounding box of Kathmandu only fits in a tile at zoom 8,
+    // the box across the equator and the prime meridian is the world
+    boost::geometry::model::box<point_t> city(point_t(85.27, 27.67), point_t(85.38, 27.75));
+    boost::geometry::model::box<point_t> world(point_t(-1, -1), point_t(1, 1));
+    int64_t citykey = quadkey::key(city);
+    if (citykey == expected("12313122") && quadkey::key(world) == 0) {
+        runtest.pass("quadkey::key() - box");
+    } else {
+        runtest.fail("quadkey::key() - box");
+    }
+
+    // The tile of a box always contains the tiles of its corners
+    bool contained = true;
+    for (double lon = 85.27; lon <= 85.38; lon += 0.01) {
+        for (double lat = 27.67; lat <= 27.75; lat += 0.01) {
+            contained &= ancestor(citykey, quadkey::key(point_t(lon, lat)));
+        }
+    }
+    if (contained) {
+        runtest.pass("quadkey::key() - containment");
+    } else {
+        runtest.fail("quadkey::key() - containment");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
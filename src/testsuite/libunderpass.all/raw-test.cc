@@ -81,7 +81,7 @@ bool processFile(const std::string &filename, std::shared_ptr<Pq> &db) {
     std::string destdir_base = DATADIR;
     multipolygon_t poly;
     osmchanges->readChanges(destdir_base + "/testsuite/testdata/raw/" + filename);
-    queryraw->buildGeometries(osmchanges, poly);
+    queryraw->buildGeometries(osmchanges, geoutil::BoundaryIndex(poly));
     std::string rawquery;
 
     for (auto it = std::begin(osmchanges->changes); it != std::end(osmchanges->changes); ++it) {
@@ -109,9 +109,9 @@ const std::map<long, std::string> expectedGeometries = {
     {101874, "POLYGON((21.726001473 4.62042952837,21.726086573 4.62042742837,21.726084973 4.62036492836,21.725999873 4.62036702836,21.726001473 4.62042952837))"},
     {101875, "POLYGON((21.726001473 4.62042952837,21.726086573 4.62042742837,21.726084973 4.62036492836,21.725999873 4.62036702836,21.726001473 4.62042952837))"},
     {101875-2, "POLYGON((21.72600148 4.62042953,21.726086573 4.62042742837,21.726084973 4.62036492836,21.725999873 4.62036702836,21.72600148 4.62042953))"},
-    {211766, "MULTIPOLYGON(((21.72600148 4.62042953,21.726086573 4.62042742837,21.726084973 4.62036492836,21.725999873 4.62036702836,21.72600148 4.62042953),(21.7260170728 4.62041343508,21.7260713875 4.62041326798,21.7260708846 4.62037684165,21.7260165699 4.62038035061,21.7260170728 4.62041343508)))"},
-    {211766-2, "MULTIPOLYGON(((21.72600148 4.62042953,21.726086573 4.62042742837,21.7260807753 4.62037032501,21.725999873 4.62036702836,21.72600148 4.62042953),(21.7260170728 4.62041343508,21.7260713875 4.62041326798,21.7260708846 4.62037684165,21.7260165699 4.62038035061,21.7260170728 4.62041343508)))"},
-    {211776, "MULTILINESTRING((21.726001473 4.62042952837,21.726086573 4.62042742837,21.726084973 4.62036492836,21.725999873 4.62036702836,21.726001473 4.62042952837))"}
+    {211766, "MULTIPOLYGON(((21.72600148 4.62042953,21.72608657299 4.62042742837,21.72608497299 4.62036492836,21.72599987299 4.62036702836,21.72600148 4.62042953),(21.726017072796814 4.620413435077737,21.726071387529366 4.620413267984446,21.72607088461518 4.620376841648422,21.726016569882624 4.620380350607476,21.726017072796814 4.620413435077737)))"},
+    {211766-2, "MULTIPOLYGON(((21.72600148 4.62042953,21.72608657299 4.62042742837,21.72608077526092 4.620370325010114,21.72599987299 4.62036702836,21.72600148 4.62042953),(21.726017072796814 4.620413435077737,21.726071387529366 4.620413267984446,21.72607088461518 4.620376841648422,21.726016569882624 4.620380350607476,21.726017072796814 4.620413435077737)))"},
+    {211776, "MULTILINESTRING((21.72600147299 4.62042952837,21.72608657299 4.62042742837,21.72608497299 4.62036492836,21.72599987299 4.62036702836,21.72600147299 4.62042952837))"}
 };
 
 std::string
@@ -145,18 +145,34 @@ main(int argc, char *argv[])
     test_planet.init_test_case(dbconn);
     auto db = std::make_shared<Pq>();
 
+    // Way members are found in the refs written by applyChange(),
+    // as well as in the ones written by osm2pgsql
+    {
+        QueryRaw queryraw(db);
+        osmobjects::OsmRelation relation;
+        relation.addMember(101875, osmobjects::way, "outer");
+        relation.addMember(101874, osmobjects::node, "");
+        relation.addMember(101876, osmobjects::way, "inner");
+        auto ways = QueryRaw::memberWays(queryraw.buildMembersJSON(relation.members));
+        auto osm2pgsql = QueryRaw::memberWays("[{\"ref\": 101875, \"role\": \"outer\", \"type\": \"w\"}]");
+        if (ways == std::vector<long>{101875, 101876} && osm2pgsql == std::vector<long>{101875}) {
+            runtest.pass("QueryRaw::memberWays()");
+        } else {
+            runtest.fail("QueryRaw::memberWays()");
+        }
+    }
+
     if (db->connect(dbconn + " dbname=underpass_test")) {
         auto queryraw = std::make_shared<QueryRaw>(db);
         std::map<long, std::shared_ptr<osmobjects::OsmWay>> waycache;
-        std::string waysIds;
+        std::vector<long> waysIds;
 
         processFile("raw-case-1.osc", db);
         processFile("raw-case-2.osc", db);
 
         for (auto const& x : expectedGeometries) {
-            waysIds += std::to_string(x.first) + ",";
+            waysIds.push_back(x.first);
         }
-        waysIds.erase(waysIds.size() - 1);
 
         queryraw->getWaysByIds(waysIds, waycache);
 
@@ -197,6 +213,16 @@ main(int argc, char *argv[])
             return 1;
         }
 
+        // The relation's members are loaded into the reference index
+        queryraw->loadRefIndexes(100);
+        std::vector<long> parents;
+        queryraw->wayrelations->lookup({101875, 101876}, parents);
+        if (parents == std::vector<long>{211766}) {
+            runtest.pass("QueryRaw::loadRefIndexes() - relation members");
+        } else {
+            runtest.fail("QueryRaw::loadRefIndexes() - relation members");
+        }
+
         // 1 modified Node, indirectly modify other existing Ways and 1 Relation
         processFile("raw-case-5.osc", db);
 
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "raw/refindex.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace queryraw;
+
+// Look up the parents of some children
+std::vector<long>
+parentsOf(const RefIndex &index, const std::vector<long> &children)
+{
+    std::vector<long> parents;
+    index.lookup(children, parents);
+    return parents;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("refindex-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Ways 100 and 200 share node 2, way 300 is closed
+    RefIndex index;
+    index.load(100, {1, 2, 3});
+    index.load(200, {2, 4});
+    index.load(300, {5, 6, 7, 5});
+    if (parentsOf(index, {2}).empty()) {
+        index.seal();
+        if (parentsOf(index, {2}) == std::vector<long>({100, 200}) &&
+            parentsOf(index, {5, 1}) == std::vector<long>({100, 300}) &&
+            parentsOf(index, {8}).empty() && index.size() == 8) {
+            runtest.pass("RefIndex::seal()");
+        } else {
+            runtest.fail("RefIndex::seal()");
+        }
+    } else {
+        runtest.fail("RefIndex::seal()");
+    }
+
+    // Way 100 no longer uses node 2, but now uses node 8
+    index.update(100, {1, 3, 8}, 2);
+    index.update(400, {2}, 1);
+    if (parentsOf(index, {2}) == std::vector<long>({200, 400}) &&
+        parentsOf(index, {8}) == std::vector<long>({100}) &&
+        parentsOf(index, {1, 3}) == std::vector<long>({100}) && index.changes() == 2) {
+        runtest.pass("RefIndex::update()");
+    } else {
+        runtest.fail("RefIndex::update()");
+    }
+
+    // Files can be processed out of order, so old versions are ignored
+    index.update(100, {2}, 1);
+    if (parentsOf(index, {2}) == std::vector<long>({200, 400})) {
+        runtest.pass("RefIndex::update() - version");
+    } else {
+        runtest.fail("RefIndex::update() - version");
+    }
+
+    index.erase(200, 2);
+    index.erase(300, 2);
+    if (parentsOf(index, {2, 4, 5}) == std::vector<long>({400})) {
+        runtest.pass("RefIndex::erase()");
+    } else {
+        runtest.fail("RefIndex::erase()");
+    }
+
+    // Merging the changes doesn't change any results
+    index.seal();
+    if (index.changes() == 0 && index.size() == 4 &&
+        parentsOf(index, {1, 2, 3, 4, 5, 8}) == std::vector<long>({100, 400})) {
+        runtest.pass("RefIndex::seal() - changes");
+    } else {
+        runtest.fail("RefIndex::seal() - changes");
+    }
+
+    // The versions are kept after a merge, so an old file processed
+    // late can't replace way 100 or bring back deleted way 200
+    index.update(100, {2}, 1);
+    index.update(200, {2, 4}, 1);
+    if (index.changes() == 0 && parentsOf(index, {2, 4}) == std::vector<long>({400})) {
+        runtest.pass("RefIndex::update() - version after seal()");
+    } else {
+        runtest.fail("RefIndex::update() - version after seal()");
+    }
+
+    // Results are appended, so a lookup can add to earlier ones
+    std::vector<long> parents = {50};
+    index.lookup({8, 8}, parents);
+    if (parents == std::vector<long>({50, 100})) {
+        runtest.pass("RefIndex::lookup() - append");
+    } else {
+        runtest.fail("RefIndex::lookup() - append");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/osmobjects.hh"
+#include "utils/regionindex.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace geoutil;
+
+geoutil::Region
+region(const std::string &name, const std::string &wkt)
+{
+    Region result;
+    result.name = name;
+    boost::geometry::read_wkt(wkt, result.boundary);
+    return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("regionindex-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Two overlapping regions, one of them with two parts, and an empty one
+    std::vector<Region> regions;
+    regions.push_back(region("west", "MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0)),((20 20,20 30,30 30,30 20,20 20)))"));
+    regions.push_back(region("east", "MULTIPOLYGON(((5 0,5 10,15 10,15 0,5 0)))"));
+    regions.push_back(Region{"nowhere", multipolygon_t()});
+
+    RegionIndex index(regions);
+    if (index.size() == 2 && index.name(0) == "west" && index.name(1) == "east") {
+        runtest.pass("RegionIndex::build()");
+    } else {
+        runtest.fail("RegionIndex::build()");
+    }
+
+    auto both = index.names(point_t(7, 5));
+    if (both.size() == 2 && both[0] == "west" && both[1] == "east") {
+        runtest.pass("RegionIndex::names() - overlap");
+    } else {
+        runtest.fail("RegionIndex::names() - overlap");
+    }
+
+    auto west = index.find(point_t(25, 25));
+    auto east = index.find(point_t(12, 5));
+    if (west.size() == 1 && west[0] == 0 && east.size() == 1 && east[0] == 1) {
+        runtest.pass("RegionIndex::find() - one region");
+    } else {
+        runtest.fail("RegionIndex::find() - one region");
+    }
+
+    if (index.find(point_t(17, 17)).empty() && index.find(point_t(-1, 5)).empty()) {
+        runtest.pass("RegionIndex::find() - no region");
+    } else {
+        runtest.fail("RegionIndex::find() - no region");
+    }
+
+    RegionIndex empty;
+    if (empty.empty() && empty.names(point_t(7, 5)).empty()) {
+        runtest.pass("RegionIndex - no regions");
+    } else {
+        runtest.fail("RegionIndex - no regions");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
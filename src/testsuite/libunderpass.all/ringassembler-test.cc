@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "raw/ringassembler.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace queryraw;
+
+// A closed ring around a center
+linestring_t
+circle(double x, double y, double radius, int points)
+{
+    linestring_t ring;
+    for (int i = 0; i <= points; i++) {
+        double angle = 2 * M_PI * (i % points) / points;
+        ring.push_back(point_t(x + radius * std::cos(angle), y + radius * std::sin(angle)));
+    }
+    return ring;
+}
+
+// Split a line into ways that share their end points, some of them
+// pointing the other way
+std::vector<linestring_t>
+split(const linestring_t &line, int parts, std::mt19937 &rng)
+{
+    std::vector<linestring_t> ways;
+    size_t step = (line.size() - 1) / parts;
+    for (int i = 0; i < parts; i++) {
+        size_t last = (i == parts - 1) ? line.size() - 1 : (i + 1) * step;
+        linestring_t way(line.begin() + i * step, line.begin() + last + 1);
+        if (rng() % 2) {
+            std::reverse(way.begin(), way.end());
+        }
+        ways.push_back(way);
+    }
+    return ways;
+}
+
+multipolygon_t
+expected(const std::vector<std::vector<linestring_t>> &polygons)
+{
+    multipolygon_t result;
+    for (auto it = std::begin(polygons); it != std::end(polygons); ++it) {
+        polygon_t poly;
+        poly.outer().assign(it->front().begin(), it->front().end());
+        for (auto rit = it->begin() + 1; rit != it->end(); ++rit) {
+            poly.inners().push_back(polygon_t::ring_type(rit->begin(), rit->end()));
+        }
+        result.push_back(poly);
+    }
+    boost::geometry::correct(result);
+    return result;
+}
+
+template <typename T>
+std::string
+toWkt(const T &geometry)
+{
+    std::stringstream ss;
+    ss << boost::geometry::wkt(geometry);
+    return ss.str();
+}
+
+bool
+sameArea(const multipolygon_t &a, const multipolygon_t &b)
+{
+    double x = boost::geometry::area(a);
+    double y = boost::geometry::area(b);
+    return std::abs(x - y) <= 1e-9 * std::abs(y);
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("ringassembler-test.log");
+    dbglogfile.setVerbosity(3);
+
+    std::mt19937 rng(7);
+
+    // An admin boundary, with the mainland and an island, an enclave
+    // cut out of the mainland, and an island in the enclave. The rings
+    // are split into many ways, in no particular order.
+    linestring_t mainland = circle(0, 0, 10, 20000);
+    linestring_t island = circle(15, 0, 1, 500);
+    linestring_t enclave = circle(3, 3, 2, 2000);
+    linestring_t lake = circle(3, 3, 0.5, 4);
+    std::vector<linestring_t> ways = split(mainland, 60, rng);
+    std::vector<linestring_t> more = split(island, 3, rng);
+    ways.insert(ways.end(), more.begin(), more.end());
+    more = split(enclave, 7, rng);
+    ways.insert(ways.end(), more.begin(), more.end());
+    ways.push_back(lake);
+    std::shuffle(ways.begin(), ways.end(), rng);
+
+    RingAssembler admin;
+    for (auto it = std::begin(ways); it != std::end(ways); ++it) {
+        admin.add(*it);
+    }
+    multipolygon_t result;
+    multipolygon_t wanted = expected({{mainland, enclave}, {island}, {lake}});
+    bool complete = admin.multipolygon(result);
+    boost::geometry::correct(result);
+    if (complete && result.size() == 3 && boost::geometry::is_valid(result) &&
+        sameArea(result, wanted) && boost::geometry::num_interior_rings(result) == 1 &&
+        boost::geometry::num_points(result) == boost::geometry::num_points(wanted)) {
+        runtest.pass("RingAssembler::multipolygon() - admin boundary");
+    } else {
+        runtest.fail("RingAssembler::multipolygon() - admin boundary");
+    }
+
+    // A forest with lots of clearings, each one a closed way
+    linestring_t forest = circle(0, 0, 5, 4000);
+    ways = split(forest, 10, rng);
+    std::vector<linestring_t> rings = {forest};
+    for (int x = -15; x < 15; x++) {
+        for (int y = -5; y < 5; y++) {
+            linestring_t clearing = {{x * 0.2, y * 0.2}, {x * 0.2 + 0.1, y * 0.2}, {x * 0.2 + 0.1, y * 0.2 + 0.1},
+                                     {x * 0.2, y * 0.2 + 0.1}, {x * 0.2, y * 0.2}};
+            ways.push_back(clearing);
+            rings.push_back(clearing);
+        }
+    }
+    std::shuffle(ways.begin(), ways.end(), rng);
+    RingAssembler landuse;
+    for (auto it = std::begin(ways); it != std::end(ways); ++it) {
+        landuse.add(*it);
+    }
+    wanted = expected({rings});
+    complete = landuse.multipolygon(result);
+    boost::geometry::correct(result);
+    if (complete && result.size() == 1 && result.front().inners().size() == 300 &&
+        boost::geometry::is_valid(result) && sameArea(result, wanted)) {
+        runtest.pass("RingAssembler::multipolygon() - landuse");
+    } else {
+        runtest.fail("RingAssembler::multipolygon() - landuse");
+    }
+
+    // Member ways stored as polygons, like the ones from ways_poly
+    RingAssembler closed;
+    polygon_t poly;
+    boost::geometry::read_wkt("POLYGON((0 0,0 4,4 4,4 0,0 0))", poly);
+    closed.add(poly);
+    boost::geometry::read_wkt("POLYGON((1 1,1 2,2 2,2 1,1 1))", poly);
+    closed.add(poly);
+    // Closed ways are kept as they are
+    if (closed.multipolygon(result) && result.size() == 1 && result.front().inners().size() == 1 &&
+        toWkt(result.front().inners().front()) == toWkt(poly.outer())) {
+        runtest.pass("RingAssembler::add(polygon)");
+    } else {
+        runtest.fail("RingAssembler::add(polygon)");
+    }
+
+    // A missing way leaves a ring open, which is left out
+    ways = split(mainland, 60, rng);
+    ways.erase(ways.begin() + 10);
+    ways.push_back(island);
+    RingAssembler broken;
+    for (auto it = std::begin(ways); it != std::end(ways); ++it) {
+        broken.add(*it);
+    }
+    wanted = expected({{island}});
+    complete = broken.multipolygon(result);
+    boost::geometry::correct(result);
+    if (!complete && result.size() == 1 && sameArea(result, wanted)) {
+        runtest.pass("RingAssembler::multipolygon() - open ring");
+    } else {
+        runtest.fail("RingAssembler::multipolygon() - open ring");
+    }
+
+    // A route split into ways is joined back into one line
+    linestring_t route;
+    for (int i = 0; i < 1000; i++) {
+        route.push_back(point_t(i * 0.01, std::sin(i * 0.01)));
+    }
+    ways = split(route, 20, rng);
+    std::shuffle(ways.begin(), ways.end(), rng);
+    RingAssembler lines;
+    for (auto it = std::begin(ways); it != std::end(ways); ++it) {
+        lines.add(*it);
+    }
+    multilinestring_t mline;
+    lines.multilinestring(mline);
+    if (mline.size() == 1 && mline.front().size() == route.size() &&
+        std::abs(boost::geometry::length(mline) - boost::geometry::length(route)) < 1e-9) {
+        runtest.pass("RingAssembler::multilinestring()");
+    } else {
+        runtest.fail("RingAssembler::multilinestring()");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
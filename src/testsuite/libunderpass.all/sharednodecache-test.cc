@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "raw/sharednodecache.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace queryraw;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("sharednodecache-test.log");
+    dbglogfile.setVerbosity(3);
+
+    SharedNodeCache cache(1000);
+    point_t point;
+    cache.insert(1, point_t(1.5, 2.5), 2);
+    if (cache.get(1, point) && point.get<0>() == 1.5 && !cache.get(2, point)) {
+        runtest.pass("SharedNodeCache::get()");
+    } else {
+        runtest.fail("SharedNodeCache::get()");
+    }
+
+    // Files can be processed out of order, so old versions are ignored
+    cache.insert(1, point_t(3.5, 4.5), 1);
+    cache.get(1, point);
+    if (point.get<0>() == 1.5) {
+        cache.insert(1, point_t(3.5, 4.5), 3);
+        cache.get(1, point);
+        if (point.get<0>() == 3.5) {
+            runtest.pass("SharedNodeCache::insert() - version");
+        } else {
+            runtest.fail("SharedNodeCache::insert() - version");
+        }
+    } else {
+        runtest.fail("SharedNodeCache::insert() - version");
+    }
+
+    // Database results never replace what a change file put there
+    cache.insertIfAbsent(1, point_t(5.5, 6.5), 4);
+    cache.insertIfAbsent(2, point_t(5.5, 6.5), 4);
+    cache.get(1, point);
+    double first = point.get<0>();
+    if (first == 3.5 && cache.get(2, point) && point.get<0>() == 5.5) {
+        runtest.pass("SharedNodeCache::insertIfAbsent()");
+    } else {
+        runtest.fail("SharedNodeCache::insertIfAbsent()");
+    }
+
+    cache.erase(2, 5);
+    if (!cache.get(2, point) && cache.size() == 1) {
+        runtest.pass("SharedNodeCache::erase()");
+    } else {
+        runtest.fail("SharedNodeCache::erase()");
+    }
+
+    // An older location, from a file processed out of order or read
+    // from the database before the delete, doesn't bring it back
+    cache.insert(2, point_t(7.5, 8.5), 4);
+    cache.insertIfAbsent(2, point_t(7.5, 8.5), 5);
+    cache.erase(3, 2);
+    cache.insertIfAbsent(3, point_t(7.5, 8.5), 1);
+    if (cache.size() == 1) {
+        cache.insert(2, point_t(9.5, 10.5), 6);
+        if (cache.size() == 2) {
+            runtest.pass("SharedNodeCache::erase() - version");
+        } else {
+            runtest.fail("SharedNodeCache::erase() - version");
+        }
+    } else {
+        runtest.fail("SharedNodeCache::erase() - version");
+    }
+
+    if (cache.hits() == 5 && cache.misses() == 2) {
+        runtest.pass("SharedNodeCache::hitRate()");
+    } else {
+        runtest.fail("SharedNodeCache::hitRate()");
+    }
+
+    // Fill it from several threads, it must never grow past its capacity,
+    // and nodes that keep getting used should stay in it
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, t]() {
+            point_t pt;
+            for (long id = 100; id < 20000; id++) {
+                cache.insert(id * 4 + t, point_t(0.1, 0.2), 1);
+                cache.get(1, pt);
+            }
+        });
+    }
+    for (auto it = std::begin(threads); it != std::end(threads); ++it) {
+        it->join();
+    }
+    if (cache.size() <= cache.capacity() && cache.get(1, point)) {
+        runtest.pass("SharedNodeCache::insert() - eviction");
+    } else {
+        runtest.fail("SharedNodeCache::insert() - eviction");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <dejagnu.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <boost/filesystem.hpp>
+
+#include "osm/changeset.hh"
+#include "osm/osmchange.hh"
+#include "osm/snapshot.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+class TestChangeset : public changesets::ChangeSetFile {};
+class TestOsmChange : public osmchange::OsmChangeFile {};
+
+// Compare two parsed OsmChange files object by object
+bool
+sameChanges(TestOsmChange &a, TestOsmChange &b)
+{
+    if (a.changes.size() != b.changes.size()) {
+        return false;
+    }
+    auto bit = std::begin(b.changes);
+    for (auto ait = std::begin(a.changes); ait != std::end(a.changes); ++ait, ++bit) {
+        osmchange::OsmChange *ca = ait->get();
+        osmchange::OsmChange *cb = bit->get();
+        if (ca->action != cb->action || ca->final_entry != cb->final_entry ||
+            ca->nodes.size() != cb->nodes.size() || ca->ways.size() != cb->ways.size() ||
+            ca->relations.size() != cb->relations.size()) {
+            return false;
+        }
+        auto nb = std::begin(cb->nodes);
+        for (auto na = std::begin(ca->nodes); na != std::end(ca->nodes); ++na, ++nb) {
+            if ((*na)->id != (*nb)->id || (*na)->version != (*nb)->version ||
+                (*na)->timestamp != (*nb)->timestamp || (*na)->user != (*nb)->user ||
+                (*na)->tags != (*nb)->tags ||
+                (*na)->point.get<0>() != (*nb)->point.get<0>() ||
+                (*na)->point.get<1>() != (*nb)->point.get<1>()) {
+                return false;
+            }
+        }
+        auto wb = std::begin(cb->ways);
+        for (auto wa = std::begin(ca->ways); wa != std::end(ca->ways); ++wa, ++wb) {
+            if ((*wa)->id != (*wb)->id || (*wa)->refs != (*wb)->refs || (*wa)->tags != (*wb)->tags) {
+                return false;
+            }
+        }
+        auto rb = std::begin(cb->relations);
+        for (auto ra = std::begin(ca->relations); ra != std::end(ca->relations); ++ra, ++rb) {
+            if ((*ra)->id != (*rb)->id || (*ra)->members.size() != (*rb)->members.size()) {
+                return false;
+            }
+            auto mb = std::begin((*rb)->members);
+            for (auto ma = std::begin((*ra)->members); ma != std::end((*ra)->members); ++ma, ++mb) {
+                if (ma->ref != mb->ref || ma->type != mb->type || ma->role != mb->role) {
+                    return false;
+                }
+            }
+        }
+    }
+    return a.nodecache.size() == b.nodecache.size();
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("snapshot-test.log");
+    dbglogfile.setVerbosity(3);
+
+    std::string tmpdir = boost::filesystem::temp_directory_path().string();
+
+    // OsmChange round trip
+    std::string osmchangeFile(DATADIR);
+    osmchangeFile += "/testsuite/testdata/test_change.osc";
+    TestOsmChange osmchange;
+    osmchange.readChanges(osmchangeFile);
+
+    std::string snapfile = snapshot::Snapshot::path(tmpdir + "/underpass-test.osc.gz");
+    snapshot::Snapshot snap;
+    snap.add(osmchange);
+    if (snap.write(snapfile)) {
+        runtest.pass("Snapshot::write(OsmChangeFile)");
+    } else {
+        runtest.fail("Snapshot::write(OsmChangeFile)");
+        return 1;
+    }
+
+    TestOsmChange restored;
+    snapshot::Snapshot reader;
+    if (reader.read(snapfile) && reader.restore(restored) && sameChanges(osmchange, restored)) {
+        runtest.pass("Snapshot::restore(OsmChangeFile)");
+    } else {
+        runtest.fail("Snapshot::restore(OsmChangeFile)");
+    }
+
+    // A damaged snapshot must be rejected
+    {
+        std::fstream file(snapfile, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(snapshot::SnapshotHeader) + 10);
+        file.put('\xff');
+    }
+    if (!reader.read(snapfile)) {
+        runtest.pass("Snapshot::read() - checksum");
+    } else {
+        runtest.fail("Snapshot::read() - checksum");
+    }
+
+    // So must one claiming a payload bigger than the file
+    {
+        std::fstream file(snapfile, std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t size = UINT64_MAX / 2;
+        file.seekp(offsetof(snapshot::SnapshotHeader, size));
+        file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    }
+    if (!reader.read(snapfile)) {
+        runtest.pass("Snapshot::read() - size");
+    } else {
+        runtest.fail("Snapshot::read() - size");
+    }
+    boost::filesystem::remove(snapfile);
+
+    // A changeset snapshot can't be restored as an OsmChange
+    std::string changesetFile(DATADIR);
+    changesetFile += "/testsuite/testdata/areafilter-test.osc";
+    TestChangeset changeset;
+    changeset.readChanges(changesetFile);
+
+    snapfile = snapshot::Snapshot::path(tmpdir + "/underpass-test.osm.gz");
+    snap.clear();
+    for (auto it = std::begin(changeset.changes); it != std::end(changeset.changes); ++it) {
+        snap.add(*it->get());
+    }
+    snap.write(snapfile);
+
+    TestOsmChange wrong;
+    if (reader.read(snapfile) && !reader.restore(wrong)) {
+        runtest.pass("Snapshot::restore() - type");
+    } else {
+        runtest.fail("Snapshot::restore() - type");
+    }
+
+    // Changeset round trip
+    TestChangeset restoredcs;
+    if (reader.read(snapfile) && reader.restore(restoredcs) &&
+        restoredcs.changes.size() == changeset.changes.size() &&
+        restoredcs.last_closed_at == changeset.last_closed_at &&
+        restoredcs.changes.front()->id == changeset.changes.front()->id &&
+        restoredcs.changes.front()->hashtags == changeset.changes.front()->hashtags &&
+        restoredcs.changes.front()->editor == changeset.changes.front()->editor &&
+        restoredcs.changes.front()->max_lon == changeset.changes.front()->max_lon) {
+        runtest.pass("Snapshot::restore(ChangeSetFile)");
+    } else {
+        runtest.fail("Snapshot::restore(ChangeSetFile)");
+    }
+    boost::filesystem::remove(snapfile);
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
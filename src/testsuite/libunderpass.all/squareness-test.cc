@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <dejagnu.h>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/geo.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("squareness-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // Building sized lines of every length, so both the vector and the
+    // scalar part of the kernel get used
+    std::mt19937 rng(41);
+    std::uniform_real_distribution<double> lon(-179, 179);
+    std::uniform_real_distribution<double> lat(-80, 80);
+    std::uniform_real_distribution<double> step(-0.0002, 0.0002);
+    bool same = true;
+    bool sized = true;
+    for (int i = 0; i < 5000; i++) {
+        size_t count = i % 20;
+        std::vector<double> lons(1, lon(rng));
+        std::vector<double> lats(1, lat(rng));
+        for (size_t j = 1; j < count; j++) {
+            lons.push_back(lons.back() + step(rng));
+            lats.push_back(lats.back() + step(rng));
+        }
+        lons.resize(count);
+        lats.resize(count);
+        std::vector<double> xs = lons;
+        std::vector<double> ys = lats;
+        for (size_t j = 0; j < count; j++) {
+            geo::Geo::epsg4326toEpsg3857(xs[j], ys[j]);
+        }
+        // One more than needed, which must be left alone
+        std::vector<double> cosines(count > 2 ? count - 1 : 1, 42.0);
+        geo::Geo::cornerCosines(xs.data(), ys.data(), count, cosines.data());
+        if (cosines.back() != 42.0) {
+            sized = false;
+        }
+        for (size_t j = 0; j + 2 < count; j++) {
+            double angle = geo::Geo::calculateAngle(lons[j], lats[j], lons[j + 1], lats[j + 1],
+                                                    lons[j + 2], lats[j + 2]);
+            if (acos(cosines[j]) * 180 / M_PI != angle) {
+                std::cerr << "Corner " << j << " of " << count << " is " << acos(cosines[j]) * 180 / M_PI
+                          << " not " << angle << std::endl;
+                same = false;
+            }
+        }
+    }
+    if (same) {
+        runtest.pass("Geo::cornerCosines() - same as calculateAngle()");
+    } else {
+        runtest.fail("Geo::cornerCosines() - same as calculateAngle()");
+    }
+    if (sized) {
+        runtest.pass("Geo::cornerCosines() - count");
+    } else {
+        runtest.fail("Geo::cornerCosines() - count");
+    }
+
+    // A square corner and a straight line
+    double xs[] = {0, 0, 10, 20};
+    double ys[] = {10, 0, 0, 0};
+    double cosines[2];
+    geo::Geo::cornerCosines(xs, ys, 4, cosines);
+    if (std::fabs(cosines[0]) < 1e-15 && cosines[1] == -1.0) {
+        runtest.pass("Geo::cornerCosines() - square");
+    } else {
+        runtest.fail("Geo::cornerCosines() - square");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -121,7 +121,7 @@ class TestStats {
                     change.readXML(input);
                 }
 
-                change.areaFilter(boundary);
+                change.areaFilter(geoutil::BoundaryIndex(boundary));
                 auto stats = change.collectStats(boundary);
                 jsonstr += statsToJSON(stats, osmchange->filespec);
 
@@ -138,7 +138,7 @@ class TestStats {
         getStatsFromFile(std::string filename) {
             osmchange::OsmChangeFile osmchanges;
             osmchanges.readChanges(filename);
-            osmchanges.areaFilter(boundary);
+            osmchanges.areaFilter(geoutil::BoundaryIndex(boundary));
             if (this->verbose) {
                 osmchanges.dump();
             }
@@ -228,6 +228,18 @@ test_semantic(std::shared_ptr<Validate> &plugin) {
 
     // Way - checkWay()
 
+    // A closed way with only 3 points
+    osmobjects::OsmWay sliver;
+    sliver.id = 1;
+    sliver.addTag("building", "yes");
+    sliver.setLinestring({point_t(21.726001473, 4.62042952837), point_t(21.726086573, 4.62042742837),
+                          point_t(21.726001473, 4.62042952837)});
+    if (plugin->checkWay(sliver, "building")->hasStatus(badgeom)) {
+        runtest.pass("Validate::checkWay(badgeom 3 points) [geometry building]");
+    } else {
+        runtest.fail("Validate::checkWay(badgeom 3 points) [geometry building]");
+    }
+
     auto way = readOsmWayFromFile("/testsuite/testdata/validation/building.osc");
 
     status = plugin->checkWay(way, "building");
@@ -402,6 +414,18 @@ test_geospatial(std::shared_ptr<Validate> &plugin)
         }
     }
 
+    // A closed way with only 3 points
+    osmobjects::OsmWay sliver;
+    sliver.id = 1;
+    sliver.addTag("building", "yes");
+    sliver.setLinestring({point_t(21.726001473, 4.62042952837), point_t(21.726086573, 4.62042742837),
+                          point_t(21.726001473, 4.62042952837)});
+    if (plugin->checkWay(sliver, "building")->hasStatus(badgeom)) {
+        runtest.pass("Validate::checkWay(badgeom 3 points) [geometry building]");
+    } else {
+        runtest.fail("Validate::checkWay(badgeom 3 points) [geometry building]");
+    }
+
     auto way = readOsmWayFromFile("/testsuite/testdata/validation/building.osc");
     auto way2 = readOsmWayFromFile("/testsuite/testdata/validation/building2.osc");
     auto way3 = readOsmWayFromFile("/testsuite/testdata/validation/rect-no-duplicate-building.osc");
@@ -437,10 +461,11 @@ test_geospatial(std::shared_ptr<Validate> &plugin)
     // }
 
     // Overlapping, duplicate
+    plugin->buildings = std::make_shared<buildingindex::BuildingIndex>();
     osmchange::OsmChangeFile osmfoverlapping;
     const multipolygon_t poly;
     filespec = DATADIR;
-    filespec += "/testdata/validation/rect-overlap-and-duplicate-building.osc";
+    filespec += "/testsuite/testdata/validation/rect-overlap-and-duplicate-building.osc";
     if (boost::filesystem::exists(filespec)) {
         osmfoverlapping.readChanges(filespec);
         osmfoverlapping.buildGeometriesFromNodeCache();
@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <atomic>
+#include <dejagnu.h>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "osm/osmobjects.hh"
+#include "osm/nodecache.hh"
+#include "utils/haversine.hh"
+#include "utils/log.hh"
+
+TestState runtest;
+
+using namespace logger;
+using namespace osmobjects;
+
+bool
+close(double a, double b)
+{
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+int
+main(int argc, char *argv[])
+{
+    logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
+    dbglogfile.setWriteDisk(true);
+    dbglogfile.setLogFilename("waymetrics-test.log");
+    dbglogfile.setVerbosity(3);
+
+    // A square building of about 111 meters on each side, on the equator
+    NodeCache cache;
+    cache.insert(1, point_t(0.0, 0.0));
+    cache.insert(2, point_t(0.001, 0.0));
+    cache.insert(3, point_t(0.001, 0.001));
+    cache.insert(4, point_t(0.0, 0.001));
+
+    OsmWay way(10);
+    for (long ref : {1, 2, 3, 4, 1}) {
+        way.addRef(ref);
+    }
+
+    // Building the geometry twice must not append the nodes twice
+    if (way.buildGeometry(cache) && way.buildGeometry(cache) &&
+        way.linestring().size() == 5 && way.polygon.outer().size() == 5) {
+        runtest.pass("OsmWay::buildGeometry()");
+    } else {
+        runtest.fail("OsmWay::buildGeometry()");
+    }
+
+    if (way.ring()) {
+        runtest.pass("OsmWay::ring()");
+    } else {
+        runtest.fail("OsmWay::ring()");
+    }
+
+    auto box = way.bbox();
+    if (box.min_corner().get<0>() == 0.0 && box.min_corner().get<1>() == 0.0 &&
+        box.max_corner().get<0>() == 0.001 && box.max_corner().get<1>() == 0.001) {
+        runtest.pass("OsmWay::bbox()");
+    } else {
+        runtest.fail("OsmWay::bbox()");
+    }
+
+    point_t center;
+    boost::geometry::centroid(way.linestring(), center);
+    if (boost::geometry::equals(way.centroid(), center)) {
+        runtest.pass("OsmWay::centroid()");
+    } else {
+        runtest.fail("OsmWay::centroid()");
+    }
+
+    double side = geoutil::haversine::length(way.linestring()) / 4;
+    if (close(way.length(), geoutil::haversine::length(way.linestring())) &&
+        std::fabs(side - 0.1112) < 0.0001 && way.getLength() == way.length()) {
+        runtest.pass("OsmWay::length()");
+    } else {
+        runtest.fail("OsmWay::length()");
+    }
+
+    if (std::fabs(way.area() - side * side) < 1e-6) {
+        runtest.pass("OsmWay::area()");
+    } else {
+        runtest.fail("OsmWay::area()");
+    }
+
+    // Moving a node changes the values once the geometry is rebuilt
+    double length = way.length();
+    cache.insert(3, point_t(0.002, 0.002));
+    if (way.length() == length && way.buildGeometry(cache) && way.length() > length &&
+        way.bbox().max_corner().get<0>() == 0.002) {
+        runtest.pass("OsmWay::buildGeometry() - clears the metrics");
+    } else {
+        runtest.fail("OsmWay::buildGeometry() - clears the metrics");
+    }
+
+    // The same after replacing the linestring
+    auto open = way.linestring();
+    open.pop_back();
+    way.setLinestring(open);
+    if (!way.ring() && way.area() == 0.0 && way.length() < length * 1.5) {
+        runtest.pass("OsmWay::setLinestring() - clears the metrics");
+    } else {
+        runtest.fail("OsmWay::setLinestring() - clears the metrics");
+    }
+
+    // A way with a missing node has an incomplete geometry
+    OsmWay partial(11);
+    for (long ref : {1, 2, 5}) {
+        partial.addRef(ref);
+    }
+    if (!partial.buildGeometry(cache) && partial.linestring().size() == 2 &&
+        partial.polygon.outer().empty() && !partial.ring()) {
+        runtest.pass("OsmWay::buildGeometry() - missing node");
+    } else {
+        runtest.fail("OsmWay::buildGeometry() - missing node");
+    }
+
+    OsmWay empty(12);
+    if (empty.length() == 0.0 && empty.area() == 0.0 && !empty.ring()) {
+        runtest.pass("OsmWay metrics - no geometry");
+    } else {
+        runtest.fail("OsmWay metrics - no geometry");
+    }
+
+    // Several threads can ask for the metrics of the same way at once
+    OsmWay shared(13);
+    linestring_t circle;
+    for (int i = 0; i <= 1000; i++) {
+        circle.push_back(point_t(std::cos(i * 2 * M_PI / 1000), std::sin(i * 2 * M_PI / 1000)));
+    }
+    circle.back() = circle.front();
+    shared.setLinestring(circle);
+    const OsmWay &reader = shared;
+    std::atomic<int> right{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&reader, &right] {
+            if (reader.ring() && reader.area() > 0.0 && reader.length() > 0.0 &&
+                reader.bbox().max_corner().get<0>() == 1.0) {
+                right++;
+            }
+        });
+    }
+    for (auto it = std::begin(threads); it != std::end(threads); ++it) {
+        it->join();
+    }
+    if (right.load() == 8) {
+        runtest.pass("OsmWay metrics - concurrent readers");
+    } else {
+        runtest.fail("OsmWay metrics - concurrent readers");
+    }
+}
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
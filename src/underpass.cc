@@ -114,6 +114,7 @@ main(int argc, char *argv[])
             ("logstdout,l", "Enable logging to stdout, default is log to underpass.log")
             ("changefile", opts::value<std::string>(), "Import change file")
             ("concurrency,c", opts::value<std::string>(), "Concurrency")
+            ("db-pool-size", opts::value<unsigned int>(), "Database connections per monitor (defaults to the concurrency)")
             ("changesets", "Changesets only")
             ("osmchanges", "OsmChanges only")
             ("debug,d", "Enable debug messages for developers")
@@ -121,6 +122,16 @@ main(int argc, char *argv[])
             ("disable-validation", "Disable validation")
             ("disable-raw", "Disable raw OSM data")
             ("norefs", "Disable refs (useful for non OSM data)")
+            ("snapshots", "Cache parsed replication files as binary snapshots in destdir_base")
+            ("early-filter", "Drop nodes outside the boundary while parsing OsmChange files")
+            ("ref-index", "Keep node to way and way to relation references in memory")
+            ("building-index", "Keep the buildings in memory to find overlaps and duplicates")
+            ("spatial-sort", "Write the rows of each file sorted by location")
+            ("copy", "Write the results with COPY through staging tables")
+            ("prepared", "Write each object with prepared statements")
+            ("node-index", opts::value<std::string>(), "Memory mapped file with the location of every node")
+            ("node-index-sparse", "Create a sparse node index, for small extracts")
+            ("node-index-pbf", opts::value<std::string>(), "OSM file to seed the node index from when bootstrapping")
             ("bootstrap", "Bootstrap data tables")
             ("silent", "Silent");
         // clang-format on
@@ -137,6 +148,39 @@ main(int argc, char *argv[])
     if (vm.count("norefs")) {
         config.norefs = true;
     }
+    if (vm.count("snapshots")) {
+        config.snapshots = true;
+    }
+    if (vm.count("early-filter")) {
+        config.early_filter = true;
+    }
+    if (vm.count("ref-index")) {
+        config.ref_index = true;
+    }
+    if (vm.count("building-index")) {
+        config.building_index = true;
+    }
+    if (vm.count("spatial-sort")) {
+        config.spatial_sort = true;
+    }
+    if (vm.count("copy")) {
+        config.copy = true;
+    }
+    if (vm.count("prepared")) {
+        config.prepared = true;
+    }
+    if (vm.count("db-pool-size")) {
+        config.db_pool_size = vm["db-pool-size"].as<unsigned int>();
+    }
+    if (vm.count("node-index")) {
+        config.node_index = vm["node-index"].as<std::string>();
+    }
+    if (vm.count("node-index-sparse")) {
+        config.node_index_sparse = true;
+    }
+    if (vm.count("node-index-pbf")) {
+        config.node_index_pbf = vm["node-index-pbf"].as<std::string>();
+    }
 
     // Logging
     logger::LogFile &dbglogfile = logger::LogFile::getDefaultInstance();
@@ -299,7 +343,7 @@ main(int argc, char *argv[])
             osmchange->destdir_base = config.destdir_base;
             osmchange->dump();
             osmChangeThread = std::thread(replicatorthreads::startMonitorChanges, std::ref(osmchange),
-                            std::ref(*osmboundary), config);
+                            std::ref(*osmboundary), std::ref(geou.regions), config);
         }
 
         // Changesets
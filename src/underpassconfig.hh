@@ -113,6 +113,36 @@ struct UnderpassConfig {
             if (yaml.contains_key("bootstrap_page_size")) {
                 bootstrap_page_size = std::stoul(yamlConfig.get_value("bootstrap_page_size"));
             }
+            if (yaml.contains_key("db_pool_size")) {
+                db_pool_size = std::stoul(yamlConfig.get_value("db_pool_size"));
+            }
+            if (yaml.contains_key("node_cache_size")) {
+                node_cache_size = std::stoul(yamlConfig.get_value("node_cache_size"));
+            }
+            if (yaml.contains_key("way_cache_size")) {
+                way_cache_size = std::stoul(yamlConfig.get_value("way_cache_size"));
+            }
+            if (yaml.contains_key("ref_index")) {
+                ref_index = (yamlConfig.get_value("ref_index") == "true");
+            }
+            if (yaml.contains_key("building_index")) {
+                building_index = (yamlConfig.get_value("building_index") == "true");
+            }
+            if (yaml.contains_key("spatial_sort")) {
+                spatial_sort = (yamlConfig.get_value("spatial_sort") == "true");
+            }
+            if (yaml.contains_key("copy")) {
+                copy = (yamlConfig.get_value("copy") == "true");
+            }
+            if (yaml.contains_key("prepared")) {
+                prepared = (yamlConfig.get_value("prepared") == "true");
+            }
+            if (yaml.contains_key("node_index")) {
+                node_index = yamlConfig.get_value("node_index");
+            }
+            if (yaml.contains_key("node_index_type")) {
+                node_index_sparse = (yamlConfig.get_value("node_index_type") == "sparse");
+            }
             if (yaml.contains_key("planet_servers")) {
                 std::vector<std::string> planet_servers_config = yamlConfig.get_values("planet_servers");
                 for (auto it = planet_servers_config.begin(); it != planet_servers_config.end(); ++it) {
@@ -159,6 +189,9 @@ struct UnderpassConfig {
     std::vector<PlanetServer> planet_servers;
     unsigned int concurrency = 1;
     unsigned int bootstrap_page_size = 100;
+    unsigned int db_pool_size = 0;                   ///< Database connections per monitor, 0 uses the concurrency
+    unsigned long node_cache_size = 1000000;         ///< Node locations shared by all threads, 0 disables it
+    unsigned long way_cache_size = 10000000;         ///< Points in the way geometries shared by all threads, 0 disables it
 
     frequency_t frequency = frequency_t::minutely;
     ptime start_time = not_a_date_time;              ///< Starting time for changesets and OSM changes import
@@ -169,6 +202,24 @@ struct UnderpassConfig {
     bool disable_raw = false;
     bool norefs = false;
     bool silent = false;
+    bool snapshots = false;                          ///< Cache parsed replication files as binary snapshots
+    bool early_filter = false;                       ///< Drop nodes outside the boundary while parsing
+    bool ref_index = false;                          ///< Keep node to way and way to relation references in memory
+    bool building_index = false;                     ///< Keep the buildings in memory to find overlaps and duplicates
+    bool spatial_sort = false;                       ///< Write the rows of each file in Hilbert order
+    bool copy = false;                               ///< Write the results with COPY through staging tables
+    bool prepared = false;                           ///< Write each object with prepared statements
+    std::string node_index;                          ///< File with the location of every node, empty disables it
+    bool node_index_sparse = false;                  ///< Use a sparse node index, for small extracts
+    std::string node_index_pbf;                      ///< OSM file to seed the node index from when bootstrapping
+
+    ///
+    /// \brief dbPoolSize returns the most database connections each monitor keeps open
+    ///
+    unsigned int dbPoolSize() const
+    {
+        return db_pool_size > 0 ? db_pool_size : concurrency;
+    }
 
     ///
     /// \brief getPlanetServer returns either the command line supplied planet server
@@ -0,0 +1,425 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <boost/geometry.hpp>
+
+#include "utils/boundaryindex.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+// Keep the grid from using too much memory on huge boundaries
+static const size_t max_cells = 1 << 22;
+
+namespace {
+
+/// Does the segment touch the rectangle, allowing a small margin
+bool
+segmentInRect(double x1, double y1, double x2, double y2,
+              double rx1, double ry1, double rx2, double ry2)
+{
+    // Liang-Barsky clipping
+    double t0 = 0.0, t1 = 1.0;
+    double dx = x2 - x1, dy = y2 - y1;
+    double p[4] = {-dx, dx, -dy, dy};
+    double q[4] = {x1 - rx1, rx2 - x1, y1 - ry1, ry2 - y1};
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) {
+                return false;
+            }
+            continue;
+        }
+        double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+        if (t0 > t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+void
+BoundaryIndex::span(double lo, double hi, double origin, double size, size_t count,
+                    size_t &first, size_t &last)
+{
+    double start = (lo - origin) / size;
+    double end = (hi - origin) / size;
+    // A value on a grid line touches the cells on both sides of it
+    long from = static_cast<long>(std::ceil(start)) - 1;
+    long to = static_cast<long>(std::floor(end));
+    first = std::clamp<long>(from, 0, count - 1);
+    last = std::clamp<long>(to, 0, count - 1);
+}
+
+const BoundaryIndex::Cell &
+BoundaryIndex::cell(double x, double y) const
+{
+    size_t col = std::min<size_t>((x - minx) / width, nx - 1);
+    size_t row = std::min<size_t>((y - miny) / height, ny - 1);
+    return cells[row * nx + col];
+}
+
+void
+BoundaryIndex::build(const multipolygon_t &poly, size_t cellcount)
+{
+    boundary = poly;
+    edges.clear();
+    cells.clear();
+    cell_edges.clear();
+    nx = ny = 0;
+    if (boundary.empty()) {
+        return;
+    }
+
+    auto addRing = [this](const polygon_t::ring_type &ring) {
+        for (size_t i = 0; i < ring.size(); i++) {
+            const point_t &a = ring[i];
+            const point_t &b = ring[(i + 1) % ring.size()];
+            if (a.get<0>() != b.get<0>() || a.get<1>() != b.get<1>()) {
+                edges.push_back(Edge{a.get<0>(), a.get<1>(), b.get<0>(), b.get<1>()});
+            }
+        }
+    };
+    for (auto it = std::begin(boundary); it != std::end(boundary); ++it) {
+        addRing(it->outer());
+        for (auto iit = std::begin(it->inners()); iit != std::end(it->inners()); ++iit) {
+            addRing(*iit);
+        }
+    }
+
+    boost::geometry::model::box<point_t> envelope;
+    boost::geometry::envelope(boundary, envelope);
+    minx = envelope.min_corner().get<0>();
+    miny = envelope.min_corner().get<1>();
+    maxx = envelope.max_corner().get<0>();
+    maxy = envelope.max_corner().get<1>();
+    if (edges.empty() || !(maxx > minx) || !(maxy > miny)) {
+        // Degenerate, everything goes to boost::geometry
+        return;
+    }
+
+    // Size the grid so cells are roughly square
+    if (cellcount == 0) {
+        cellcount = edges.size() * 4;
+    }
+    cellcount = std::clamp<size_t>(cellcount, 16, max_cells);
+    double aspect = (maxx - minx) / (maxy - miny);
+    nx = std::clamp<size_t>(std::lround(std::sqrt(cellcount * aspect)), 1, 4096);
+    ny = std::clamp<size_t>(cellcount / nx, 1, 4096);
+    width = (maxx - minx) / nx;
+    height = (maxy - miny) / ny;
+    cells.assign(nx * ny, Cell{outside, false, 0, 0, 0.0, 0.0});
+
+    // Assign edges to every cell they touch, in two passes so the
+    // lists can be packed in one array
+    double marginx = width * 1e-9;
+    double marginy = height * 1e-9;
+    auto forEachCell = [&](const Edge &edge, auto func) {
+        size_t c0, c1, r0, r1;
+        span(std::min(edge.x1, edge.x2), std::max(edge.x1, edge.x2), minx, width, nx, c0, c1);
+        span(std::min(edge.y1, edge.y2), std::max(edge.y1, edge.y2), miny, height, ny, r0, r1);
+        for (size_t r = r0; r <= r1; r++) {
+            for (size_t c = c0; c <= c1; c++) {
+                double x = minx + c * width;
+                double y = miny + r * height;
+                if (segmentInRect(edge.x1, edge.y1, edge.x2, edge.y2, x - marginx, y - marginy,
+                                  x + width + marginx, y + height + marginy)) {
+                    func(r * nx + c);
+                }
+            }
+        }
+    };
+    for (auto it = std::begin(edges); it != std::end(edges); ++it) {
+        forEachCell(*it, [this](size_t index) { cells[index].count++; });
+    }
+    uint32_t total = 0;
+    for (auto it = std::begin(cells); it != std::end(cells); ++it) {
+        it->first = total;
+        total += it->count;
+        it->count = 0;
+    }
+    cell_edges.resize(total);
+    for (uint32_t i = 0; i < edges.size(); i++) {
+        forEachCell(edges[i], [this, i](size_t index) {
+            Cell &cell = cells[index];
+            cell_edges[cell.first + cell.count++] = i;
+        });
+    }
+
+    // Find the side of each cell center by casting a ray along its row.
+    // Only the edges that cross the center line of a row are needed.
+    std::vector<std::vector<uint32_t>> rowedges(ny);
+    for (uint32_t i = 0; i < edges.size(); i++) {
+        const Edge &edge = edges[i];
+        double lo = (std::min(edge.y1, edge.y2) - miny) / height - 0.5;
+        double hi = (std::max(edge.y1, edge.y2) - miny) / height - 0.5;
+        long r0 = std::max<long>(std::ceil(lo), 0);
+        long r1 = std::min<long>(std::floor(hi), ny - 1);
+        for (long r = r0; r <= r1; r++) {
+            rowedges[r].push_back(i);
+        }
+    }
+    std::vector<double> crossings;
+    for (size_t r = 0; r < ny; r++) {
+        double y = miny + (r + 0.5) * height;
+        crossings.clear();
+        for (auto it = std::begin(rowedges[r]); it != std::end(rowedges[r]); ++it) {
+            const Edge &edge = edges[*it];
+            if ((edge.y1 > y) != (edge.y2 > y)) {
+                crossings.push_back(edge.x1 + (y - edge.y1) * (edge.x2 - edge.x1) / (edge.y2 - edge.y1));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        size_t passed = 0;
+        for (size_t c = 0; c < nx; c++) {
+            double x = minx + (c + 0.5) * width;
+            while (passed < crossings.size() && crossings[passed] < x) {
+                passed++;
+            }
+            Cell &cell = cells[r * nx + c];
+            bool in = passed % 2;
+            // A center too close to the boundary can't be trusted
+            bool close = (passed > 0 && x - crossings[passed - 1] < marginx * 1000) ||
+                (passed < crossings.size() && crossings[passed] - x < marginx * 1000);
+            if (cell.count == 0) {
+                cell.kind = in ? inside : outside;
+            } else if (close) {
+                cell.kind = unknown;
+            } else {
+                cell.kind = crossed;
+                cell.ref_inside = in;
+                cell.refx = x;
+                cell.refy = y;
+            }
+        }
+    }
+}
+
+BoundaryIndex::cell_t
+BoundaryIndex::locate(const Cell &cell, double x, double y) const
+{
+    uint8_t state;
+    crossings::count(crossings::scalar, cell.refx, cell.refy, edges.data(),
+                     cell_edges.data() + cell.first, cell.count, &x, &y, 1, &state);
+    if (state & crossings::unsure) {
+        return unknown;
+    }
+    return (cell.ref_inside != bool(state & crossings::odd)) ? inside : outside;
+}
+
+void
+BoundaryIndex::classify(const point_t *points, size_t count, cell_t *result) const
+{
+    // Most points are decided by their cell. The rest are collected
+    // while they land in the same crossed cell, which is common since
+    // the nodes of a way or a change are usually close together, so
+    // they can be tested together.
+    const Cell *current = nullptr;
+    std::vector<size_t> run;
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<uint8_t> state;
+    auto flush = [&]() {
+        if (run.empty()) {
+            return;
+        }
+        state.resize(run.size());
+        crossings::count(current->refx, current->refy, edges.data(), cell_edges.data() + current->first,
+                         current->count, xs.data(), ys.data(), run.size(), state.data());
+        for (size_t i = 0; i < run.size(); i++) {
+            if (state[i] & crossings::unsure) {
+                result[run[i]] = unknown;
+            } else {
+                bool in = current->ref_inside != bool(state[i] & crossings::odd);
+                result[run[i]] = in ? inside : outside;
+            }
+        }
+        run.clear();
+        xs.clear();
+        ys.clear();
+    };
+    for (size_t i = 0; i < count; i++) {
+        double x = points[i].get<0>();
+        double y = points[i].get<1>();
+        if (!inEnvelope(x, y)) {
+            result[i] = outside;
+            continue;
+        }
+        const Cell &found = cell(x, y);
+        result[i] = found.kind;
+        if (found.kind == crossed) {
+            if (&found != current) {
+                flush();
+                current = &found;
+            }
+            run.push_back(i);
+            xs.push_back(x);
+            ys.push_back(y);
+        }
+    }
+    flush();
+}
+
+bool
+BoundaryIndex::within(const point_t &point) const
+{
+    if (nx == 0) {
+        return boost::geometry::within(point, boundary);
+    }
+    double x = point.get<0>();
+    double y = point.get<1>();
+    if (!inEnvelope(x, y)) {
+        return false;
+    }
+    const Cell &found = cell(x, y);
+    cell_t kind = found.kind;
+    if (kind == crossed) {
+        kind = locate(found, x, y);
+    }
+    if (kind == unknown) {
+        return boost::geometry::within(point, boundary);
+    }
+    return kind == inside;
+}
+
+std::vector<bool>
+BoundaryIndex::within(const std::vector<point_t> &points) const
+{
+    std::vector<bool> result(points.size(), false);
+    if (nx == 0) {
+        for (size_t i = 0; i < points.size(); i++) {
+            result[i] = boost::geometry::within(points[i], boundary);
+        }
+        return result;
+    }
+    std::vector<cell_t> kinds(points.size());
+    classify(points.data(), points.size(), kinds.data());
+    for (size_t i = 0; i < points.size(); i++) {
+        if (kinds[i] == unknown) {
+            result[i] = boost::geometry::within(points[i], boundary);
+        } else {
+            result[i] = kinds[i] == inside;
+        }
+    }
+    return result;
+}
+
+bool
+BoundaryIndex::within(const linestring_t &line) const
+{
+    if (nx == 0 || line.size() < 2) {
+        return boost::geometry::within(line, boundary);
+    }
+    // Any point outside means it's not within
+    std::vector<cell_t> kinds(line.size());
+    classify(&line[0], line.size(), kinds.data());
+    bool sure = true;
+    for (size_t i = 0; i < line.size(); i++) {
+        if (kinds[i] == outside) {
+            return false;
+        }
+        // Inside, but the segments may still cross the boundary
+        if (kinds[i] == unknown || cell(line[i].get<0>(), line[i].get<1>()).kind != inside) {
+            sure = false;
+        }
+    }
+    // It's within if every segment only touches inside cells
+    for (size_t i = 1; sure && i < line.size(); i++) {
+        size_t c0, c1, r0, r1;
+        span(std::min(line[i - 1].get<0>(), line[i].get<0>()), std::max(line[i - 1].get<0>(), line[i].get<0>()),
+             minx, width, nx, c0, c1);
+        span(std::min(line[i - 1].get<1>(), line[i].get<1>()), std::max(line[i - 1].get<1>(), line[i].get<1>()),
+             miny, height, ny, r0, r1);
+        for (size_t r = r0; sure && r <= r1; r++) {
+            for (size_t c = c0; sure && c <= c1; c++) {
+                sure = cells[r * nx + c].kind == inside;
+            }
+        }
+    }
+    if (sure) {
+        return true;
+    }
+    return boost::geometry::within(line, boundary);
+}
+
+bool
+BoundaryIndex::intersects(const polygon_t &poly) const
+{
+    if (nx == 0 || poly.outer().empty()) {
+        return boost::geometry::intersects(poly, boundary);
+    }
+    boost::geometry::model::box<point_t> envelope;
+    boost::geometry::envelope(poly, envelope);
+    double x0 = envelope.min_corner().get<0>();
+    double y0 = envelope.min_corner().get<1>();
+    double x1 = envelope.max_corner().get<0>();
+    double y1 = envelope.max_corner().get<1>();
+    if (x1 < minx || x0 > maxx || y1 < miny || y0 > maxy) {
+        return false;
+    }
+    // Any corner inside means they intersect
+    for (auto it = std::begin(poly.outer()); it != std::end(poly.outer()); ++it) {
+        if (inEnvelope(it->get<0>(), it->get<1>()) && cell(it->get<0>(), it->get<1>()).kind == inside) {
+            return true;
+        }
+    }
+    // A rectangle, like a changeset bounding box, covers every cell it
+    // touches, so it intersects if any of them is inside
+    bool rectangle = boost::geometry::num_points(poly) <= 5 && poly.inners().empty() &&
+        boost::geometry::area(envelope) == std::abs(boost::geometry::area(poly));
+    size_t c0, c1, r0, r1;
+    span(x0, x1, minx, width, nx, c0, c1);
+    span(y0, y1, miny, height, ny, r0, r1);
+    bool all_outside = true;
+    for (size_t r = r0; r <= r1; r++) {
+        for (size_t c = c0; c <= c1; c++) {
+            cell_t kind = cells[r * nx + c].kind;
+            if (kind == inside && rectangle) {
+                return true;
+            }
+            all_outside = all_outside && kind == outside;
+        }
+    }
+    if (all_outside) {
+        return false;
+    }
+    return boost::geometry::intersects(poly, boundary);
+}
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
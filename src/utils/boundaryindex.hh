@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __BOUNDARYINDEX_HH__
+#define __BOUNDARYINDEX_HH__
+
+/// \file boundaryindex.hh
+/// \brief A prepared priority boundary for fast point in polygon tests
+///
+/// Every node, way, and changeset is tested against the priority
+/// boundary, and boost::geometry::within() walks every edge of the
+/// multipolygon for each test. Country boundaries have tens of
+/// thousands of edges. This lays a uniform grid over the boundary
+/// once, and classifies each cell as inside, outside, or crossed by
+/// the boundary. Most points land in a cell that is entirely inside
+/// or outside, which answers the test with one lookup. For a crossed
+/// cell, the point is tested against only the edges in that cell,
+/// starting from a reference point in the cell whose side is already
+/// known. Anything too close to an edge to be sure of falls back to
+/// boost::geometry, so for a valid multipolygon the results are the
+/// same as within(). The crossings of every ring are counted, so where
+/// the polygons of an invalid one overlap, the overlap is outside.
+/// GeoUtil merges overlapping features, so the priority boundary is
+/// valid. In a batch, consecutive points in the same crossed cell are
+/// tested together with the vectorized kernels in crossings.hh.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstdint>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "utils/crossings.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \class BoundaryIndex
+/// \brief A multipolygon with a grid index for containment tests
+class BoundaryIndex {
+  public:
+    BoundaryIndex(void) {};
+    /// Build the index for a boundary
+    explicit BoundaryIndex(const multipolygon_t &poly) { build(poly); };
+
+    /// Build the index, with about this many cells. With no cell count
+    /// there are a few cells for every edge.
+    void build(const multipolygon_t &poly, size_t cellcount = 0);
+
+    /// The boundary has no polygons
+    bool empty(void) const { return boundary.empty(); };
+    /// The boundary this index was built from
+    const multipolygon_t &polygon(void) const { return boundary; };
+
+    /// The same as boost::geometry::within(point, polygon()), if the
+    /// boundary is valid
+    bool within(const point_t &point) const;
+    /// The same as within() for every point in a batch, in the same order
+    std::vector<bool> within(const std::vector<point_t> &points) const;
+    /// The same as boost::geometry::within(line, polygon()), if the
+    /// boundary is valid
+    bool within(const linestring_t &line) const;
+    /// The same as boost::geometry::intersects(poly, polygon()), if the
+    /// boundary is valid
+    bool intersects(const polygon_t &poly) const;
+
+  private:
+    typedef enum : uint8_t { outside, inside, crossed, unknown } cell_t;
+
+    typedef crossings::Edge Edge;
+    struct Cell {
+        cell_t kind;
+        bool ref_inside;      ///< The side of the reference point
+        uint32_t first;       ///< The first edge in cell_edges
+        uint32_t count;       ///< The number of edges in this cell
+        double refx, refy;    ///< A point not on the boundary
+    };
+
+    /// The range of columns or rows a closed interval touches
+    static void span(double lo, double hi, double origin, double size, size_t count,
+                     size_t &first, size_t &last);
+    const Cell &cell(double x, double y) const;
+    bool inEnvelope(double x, double y) const {
+        return x >= minx && x <= maxx && y >= miny && y <= maxy;
+    };
+    /// Test a point against the edges of a crossed cell. Returns
+    /// unknown when it's too close to an edge to be sure.
+    cell_t locate(const Cell &cell, double x, double y) const;
+    /// Find the side of a batch of points without falling back to
+    /// boost::geometry, so the result may be unknown
+    void classify(const point_t *points, size_t count, cell_t *result) const;
+
+    multipolygon_t boundary;
+    std::vector<Edge> edges;
+    std::vector<Cell> cells;
+    std::vector<uint32_t> cell_edges;  ///< Edge indexes, grouped by cell
+    double minx = 0, miny = 0, maxx = 0, maxy = 0;
+    double width = 0, height = 0;  ///< The size of a cell
+    size_t nx = 0, ny = 0;         ///< The number of columns and rows
+};
+
+} // namespace geoutil
+
+#endif // EOF __BOUNDARYINDEX_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
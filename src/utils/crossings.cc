@@ -0,0 +1,269 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CROSSINGS_X86 1
+#include <immintrin.h>
+#endif
+
+#include "utils/crossings.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace crossings
+namespace crossings {
+
+// Results closer to zero than this fraction of the terms are treated
+// as zero, so rounding can't put a point on the wrong side of an edge
+static const double tolerance = 1e-9;
+
+int
+side(double ax, double ay, double bx, double by, double cx, double cy)
+{
+    double left = (bx - ax) * (cy - ay);
+    double right = (by - ay) * (cx - ax);
+    double det = left - right;
+    if (std::abs(det) <= tolerance * (std::abs(left) + std::abs(right))) {
+        return 0;
+    }
+    return (det > 0) ? 1 : -1;
+}
+
+namespace {
+
+// The segments cross when the ends of each one are on opposite sides
+// of the other. When they only touch, or it's too close to tell, the
+// point is marked unsure.
+void
+countScalar(double refx, double refy, const Edge *edges, const uint32_t *index,
+            size_t nedges, const double *xs, const double *ys, size_t npoints,
+            uint8_t *state)
+{
+    for (size_t i = 0; i < npoints; i++) {
+        uint8_t result = 0;
+        for (size_t j = 0; j < nedges; j++) {
+            const Edge &e = edges[index[j]];
+            int a = side(refx, refy, xs[i], ys[i], e.x1, e.y1);
+            int b = side(refx, refy, xs[i], ys[i], e.x2, e.y2);
+            int c = side(e.x1, e.y1, e.x2, e.y2, refx, refy);
+            int d = side(e.x1, e.y1, e.x2, e.y2, xs[i], ys[i]);
+            int ab = a * b;
+            int cd = c * d;
+            if (ab < 0 && cd < 0) {
+                result ^= odd;
+            } else if (ab <= 0 && cd <= 0) {
+                result |= unsure;
+            }
+        }
+        state[i] = result;
+    }
+}
+
+#ifdef CROSSINGS_X86
+
+// The same as side(), for four points at once. Returns 1.0, -1.0,
+// or 0.0 in each lane.
+__attribute__((target("avx2"))) inline __m256d
+sideAvx2(__m256d left, __m256d right)
+{
+    const __m256d abs = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    __m256d det = _mm256_sub_pd(left, right);
+    __m256d limit = _mm256_mul_pd(_mm256_set1_pd(tolerance),
+                                  _mm256_add_pd(_mm256_and_pd(left, abs), _mm256_and_pd(right, abs)));
+    __m256d neg = _mm256_cmp_pd(det, _mm256_sub_pd(_mm256_setzero_pd(), limit), _CMP_LT_OQ);
+    __m256d pos = _mm256_cmp_pd(det, limit, _CMP_GT_OQ);
+    __m256d result = _mm256_blendv_pd(_mm256_setzero_pd(), _mm256_set1_pd(-1.0), neg);
+    return _mm256_blendv_pd(result, _mm256_set1_pd(1.0), pos);
+}
+
+__attribute__((target("avx2"))) void
+countAvx2(double refx, double refy, const Edge *edges, const uint32_t *index,
+          size_t nedges, const double *xs, const double *ys, size_t npoints,
+          uint8_t *state)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d rx = _mm256_set1_pd(refx);
+    const __m256d ry = _mm256_set1_pd(refy);
+    size_t i = 0;
+    for (; i + 4 <= npoints; i += 4) {
+        __m256d px = _mm256_loadu_pd(xs + i);
+        __m256d py = _mm256_loadu_pd(ys + i);
+        __m256d dx = _mm256_sub_pd(px, rx);
+        __m256d dy = _mm256_sub_pd(py, ry);
+        __m256d crossed = zero;
+        __m256d close = zero;
+        for (size_t j = 0; j < nedges; j++) {
+            const Edge &e = edges[index[j]];
+            // The ends of the edge against the segment
+            __m256d a = sideAvx2(_mm256_mul_pd(dx, _mm256_set1_pd(e.y1 - refy)),
+                                 _mm256_mul_pd(dy, _mm256_set1_pd(e.x1 - refx)));
+            __m256d b = sideAvx2(_mm256_mul_pd(dx, _mm256_set1_pd(e.y2 - refy)),
+                                 _mm256_mul_pd(dy, _mm256_set1_pd(e.x2 - refx)));
+            // The ends of the segment against the edge
+            double c = side(e.x1, e.y1, e.x2, e.y2, refx, refy);
+            __m256d d = sideAvx2(_mm256_mul_pd(_mm256_set1_pd(e.x2 - e.x1),
+                                               _mm256_sub_pd(py, _mm256_set1_pd(e.y1))),
+                                 _mm256_mul_pd(_mm256_set1_pd(e.y2 - e.y1),
+                                               _mm256_sub_pd(px, _mm256_set1_pd(e.x1))));
+            __m256d ab = _mm256_mul_pd(a, b);
+            __m256d cd = _mm256_mul_pd(_mm256_set1_pd(c), d);
+            __m256d cross = _mm256_and_pd(_mm256_cmp_pd(ab, zero, _CMP_LT_OQ),
+                                          _mm256_cmp_pd(cd, zero, _CMP_LT_OQ));
+            __m256d touch = _mm256_and_pd(_mm256_cmp_pd(ab, zero, _CMP_LE_OQ),
+                                          _mm256_cmp_pd(cd, zero, _CMP_LE_OQ));
+            crossed = _mm256_xor_pd(crossed, cross);
+            close = _mm256_or_pd(close, _mm256_andnot_pd(cross, touch));
+        }
+        int oddmask = _mm256_movemask_pd(crossed);
+        int closemask = _mm256_movemask_pd(close);
+        for (int k = 0; k < 4; k++) {
+            state[i + k] = ((oddmask >> k) & 1) ? odd : 0;
+            if ((closemask >> k) & 1) {
+                state[i + k] |= unsure;
+            }
+        }
+    }
+    // Mixing AVX and SSE code is slow until the upper halves are cleared
+    _mm256_zeroupper();
+    countScalar(refx, refy, edges, index, nedges, xs + i, ys + i, npoints - i, state + i);
+}
+
+// The same as sideAvx2(), for two points at once
+__attribute__((target("sse4.1"))) inline __m128d
+sideSse4(__m128d left, __m128d right)
+{
+    const __m128d abs = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    __m128d det = _mm_sub_pd(left, right);
+    __m128d limit = _mm_mul_pd(_mm_set1_pd(tolerance),
+                               _mm_add_pd(_mm_and_pd(left, abs), _mm_and_pd(right, abs)));
+    __m128d neg = _mm_cmplt_pd(det, _mm_sub_pd(_mm_setzero_pd(), limit));
+    __m128d pos = _mm_cmpgt_pd(det, limit);
+    __m128d result = _mm_blendv_pd(_mm_setzero_pd(), _mm_set1_pd(-1.0), neg);
+    return _mm_blendv_pd(result, _mm_set1_pd(1.0), pos);
+}
+
+__attribute__((target("sse4.1"))) void
+countSse4(double refx, double refy, const Edge *edges, const uint32_t *index,
+          size_t nedges, const double *xs, const double *ys, size_t npoints,
+          uint8_t *state)
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d rx = _mm_set1_pd(refx);
+    const __m128d ry = _mm_set1_pd(refy);
+    size_t i = 0;
+    for (; i + 2 <= npoints; i += 2) {
+        __m128d px = _mm_loadu_pd(xs + i);
+        __m128d py = _mm_loadu_pd(ys + i);
+        __m128d dx = _mm_sub_pd(px, rx);
+        __m128d dy = _mm_sub_pd(py, ry);
+        __m128d crossed = zero;
+        __m128d close = zero;
+        for (size_t j = 0; j < nedges; j++) {
+            const Edge &e = edges[index[j]];
+            __m128d a = sideSse4(_mm_mul_pd(dx, _mm_set1_pd(e.y1 - refy)),
+                                 _mm_mul_pd(dy, _mm_set1_pd(e.x1 - refx)));
+            __m128d b = sideSse4(_mm_mul_pd(dx, _mm_set1_pd(e.y2 - refy)),
+                                 _mm_mul_pd(dy, _mm_set1_pd(e.x2 - refx)));
+            double c = side(e.x1, e.y1, e.x2, e.y2, refx, refy);
+            __m128d d = sideSse4(_mm_mul_pd(_mm_set1_pd(e.x2 - e.x1), _mm_sub_pd(py, _mm_set1_pd(e.y1))),
+                                 _mm_mul_pd(_mm_set1_pd(e.y2 - e.y1), _mm_sub_pd(px, _mm_set1_pd(e.x1))));
+            __m128d ab = _mm_mul_pd(a, b);
+            __m128d cd = _mm_mul_pd(_mm_set1_pd(c), d);
+            __m128d cross = _mm_and_pd(_mm_cmplt_pd(ab, zero), _mm_cmplt_pd(cd, zero));
+            __m128d touch = _mm_and_pd(_mm_cmple_pd(ab, zero), _mm_cmple_pd(cd, zero));
+            crossed = _mm_xor_pd(crossed, cross);
+            close = _mm_or_pd(close, _mm_andnot_pd(cross, touch));
+        }
+        int oddmask = _mm_movemask_pd(crossed);
+        int closemask = _mm_movemask_pd(close);
+        for (int k = 0; k < 2; k++) {
+            state[i + k] = ((oddmask >> k) & 1) ? odd : 0;
+            if ((closemask >> k) & 1) {
+                state[i + k] |= unsure;
+            }
+        }
+    }
+    countScalar(refx, refy, edges, index, nedges, xs + i, ys + i, npoints - i, state + i);
+}
+
+#endif // CROSSINGS_X86
+
+} // anonymous namespace
+
+bool
+supported(kernel_t kernel)
+{
+    switch (kernel) {
+    case scalar:
+        return true;
+#ifdef CROSSINGS_X86
+    case sse4:
+        return __builtin_cpu_supports("sse4.1");
+    case avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+kernel_t
+best(void)
+{
+    static const kernel_t kernel = supported(avx2) ? avx2 : (supported(sse4) ? sse4 : scalar);
+    return kernel;
+}
+
+void
+count(kernel_t kernel, double refx, double refy, const Edge *edges,
+      const uint32_t *index, size_t nedges, const double *xs,
+      const double *ys, size_t npoints, uint8_t *state)
+{
+    switch (kernel) {
+#ifdef CROSSINGS_X86
+    case avx2:
+        countAvx2(refx, refy, edges, index, nedges, xs, ys, npoints, state);
+        break;
+    case sse4:
+        countSse4(refx, refy, edges, index, nedges, xs, ys, npoints, state);
+        break;
+#endif
+    default:
+        countScalar(refx, refy, edges, index, nedges, xs, ys, npoints, state);
+        break;
+    }
+}
+
+} // namespace crossings
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
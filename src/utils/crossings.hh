@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __CROSSINGS_HH__
+#define __CROSSINGS_HH__
+
+/// \file crossings.hh
+/// \brief Batched crossing number tests for points against boundary edges
+///
+/// A point is inside a polygon when a segment from a point with a known
+/// side crosses the boundary an even number of times, or changes side
+/// when it's odd. The filters test thousands of nodes for each change
+/// file, and millions when bootstrapping, so this tests a whole batch
+/// of points against the same edges at once. There are AVX2 and SSE4.1
+/// kernels that test several points per instruction, and a scalar one
+/// for everything else. The best kernel is picked at runtime, so the
+/// binary still works on older CPUs.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace crossings
+namespace crossings {
+
+/// An edge of a boundary ring
+struct Edge {
+    double x1, y1, x2, y2;
+};
+
+/// The implementations of the kernel
+typedef enum { scalar, sse4, avx2 } kernel_t;
+
+/// The bits set in the state of each point
+enum : uint8_t {
+    odd = 1,    ///< The segment crosses an odd number of edges
+    unsure = 2  ///< The segment is too close to an edge to be sure
+};
+
+/// The fastest kernel this CPU supports
+kernel_t best(void);
+
+/// Whether this CPU can run a kernel
+bool supported(kernel_t kernel);
+
+/// Which side of A-B point C is on. Returns 0 when it's too close
+/// to tell.
+int side(double ax, double ay, double bx, double by, double cx, double cy);
+
+/// Count how many of the edges the segment from the reference point
+/// to each point crosses. The edges are edges[index[0]] to
+/// edges[index[nedges - 1]], and the points are in xs and ys. The
+/// result for each point is stored in state.
+void count(kernel_t kernel, double refx, double refy, const Edge *edges,
+           const uint32_t *index, size_t nedges, const double *xs,
+           const double *ys, size_t npoints, uint8_t *state);
+
+/// The same, with the best kernel for this CPU
+inline void
+count(double refx, double refy, const Edge *edges, const uint32_t *index,
+      size_t nedges, const double *xs, const double *ys, size_t npoints,
+      uint8_t *state)
+{
+    count(best(), refx, refy, edges, index, nedges, xs, ys, npoints, state);
+}
+
+} // namespace crossings
+
+} // namespace geoutil
+
+#endif // EOF __CROSSINGS_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
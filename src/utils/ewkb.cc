@@ -0,0 +1,224 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstring>
+
+#include "utils/ewkb.hh"
+
+/// \namespace ewkb
+namespace ewkb {
+
+namespace {
+
+// The geometry types, and the flag that says an SRID follows
+enum : uint32_t {
+    point = 1,
+    linestring = 2,
+    polygon = 3,
+    multilinestring = 5,
+    multipolygon = 6,
+    has_srid = 0x20000000
+};
+
+/// Appends little endian values to a string, as hex digits or as
+/// raw bytes
+class Writer {
+  public:
+    /// Reserve space for a geometry with this many points and parts
+    Writer(size_t points, size_t parts, bool raw)
+        : raw(raw) { out.reserve((raw ? 1 : 2) * (9 + points * 16 + parts * 9)); };
+
+    void byte(uint8_t val) {
+        static const char digits[] = "0123456789ABCDEF";
+        if (raw) {
+            out.push_back(val);
+            return;
+        }
+        out.push_back(digits[val >> 4]);
+        out.push_back(digits[val & 0xf]);
+    };
+    void uint32(uint32_t val) {
+        for (int i = 0; i < 4; i++) {
+            byte(val >> (8 * i));
+        }
+    };
+    void coordinate(double val) {
+        uint64_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            byte(bits >> (8 * i));
+        }
+    };
+    /// The byte order, the type, and the SRID when there is one
+    void header(uint32_t type, uint32_t srid) {
+        byte(1);
+        if (srid) {
+            uint32(type | has_srid);
+            uint32(srid);
+        } else {
+            uint32(type);
+        }
+    };
+    template <typename T> void points(const T &range) {
+        uint32(range.size());
+        for (auto it = std::begin(range); it != std::end(range); ++it) {
+            coordinate(it->template get<0>());
+            coordinate(it->template get<1>());
+        }
+    };
+    void rings(const polygon_t &poly) {
+        uint32(1 + poly.inners().size());
+        points(poly.outer());
+        for (auto it = std::begin(poly.inners()); it != std::end(poly.inners()); ++it) {
+            points(*it);
+        }
+    };
+
+    bool raw;
+    std::string out;
+};
+
+std::string
+encode(const point_t &pt, uint32_t srid, bool raw)
+{
+    Writer writer(1, 0, raw);
+    writer.header(point, srid);
+    writer.coordinate(pt.get<0>());
+    writer.coordinate(pt.get<1>());
+    return std::move(writer.out);
+}
+
+std::string
+encode(const linestring_t &line, uint32_t srid, bool raw)
+{
+    Writer writer(line.size(), 1, raw);
+    writer.header(linestring, srid);
+    writer.points(line);
+    return std::move(writer.out);
+}
+
+std::string
+encode(const polygon_t &poly, uint32_t srid, bool raw)
+{
+    Writer writer(boost::geometry::num_points(poly), 2 + poly.inners().size(), raw);
+    writer.header(polygon, srid);
+    writer.rings(poly);
+    return std::move(writer.out);
+}
+
+std::string
+encode(const multilinestring_t &lines, uint32_t srid, bool raw)
+{
+    Writer writer(boost::geometry::num_points(lines), 1 + 2 * lines.size(), raw);
+    writer.header(multilinestring, srid);
+    writer.uint32(lines.size());
+    for (auto it = std::begin(lines); it != std::end(lines); ++it) {
+        writer.header(linestring, 0);
+        writer.points(*it);
+    }
+    return std::move(writer.out);
+}
+
+std::string
+encode(const multipolygon_t &polys, uint32_t srid, bool raw)
+{
+    Writer writer(boost::geometry::num_points(polys), 1 + 2 * polys.size() + boost::geometry::num_interior_rings(polys), raw);
+    writer.header(multipolygon, srid);
+    writer.uint32(polys.size());
+    for (auto it = std::begin(polys); it != std::end(polys); ++it) {
+        writer.header(polygon, 0);
+        writer.rings(*it);
+    }
+    return std::move(writer.out);
+}
+
+} // anonymous namespace
+
+std::string
+hex(const point_t &pt, uint32_t srid)
+{
+    return encode(pt, srid, false);
+}
+
+std::string
+hex(const linestring_t &line, uint32_t srid)
+{
+    return encode(line, srid, false);
+}
+
+std::string
+hex(const polygon_t &poly, uint32_t srid)
+{
+    return encode(poly, srid, false);
+}
+
+std::string
+hex(const multilinestring_t &lines, uint32_t srid)
+{
+    return encode(lines, srid, false);
+}
+
+std::string
+hex(const multipolygon_t &polys, uint32_t srid)
+{
+    return encode(polys, srid, false);
+}
+
+std::string
+binary(const point_t &pt, uint32_t srid)
+{
+    return encode(pt, srid, true);
+}
+
+std::string
+binary(const linestring_t &line, uint32_t srid)
+{
+    return encode(line, srid, true);
+}
+
+std::string
+binary(const polygon_t &poly, uint32_t srid)
+{
+    return encode(poly, srid, true);
+}
+
+std::string
+binary(const multilinestring_t &lines, uint32_t srid)
+{
+    return encode(lines, srid, true);
+}
+
+std::string
+binary(const multipolygon_t &polys, uint32_t srid)
+{
+    return encode(polys, srid, true);
+}
+
+} // namespace ewkb
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __EWKB_HH__
+#define __EWKB_HH__
+
+/// \file ewkb.hh
+/// \brief Encode geometries as hex EWKB for database writes
+///
+/// Geometries used to be printed as WKT with 12 significant digits and
+/// wrapped in ST_GeomFromText(), so every insert formatted each
+/// coordinate through a stringstream and Postgres then had to parse
+/// the text back. Hex EWKB is the format PostGIS itself uses for
+/// geometry literals. It copies the bits of each double, so encoding
+/// is just a table lookup per byte, the server only has to decode hex,
+/// and the stored coordinates are exactly the ones in memory. With
+/// prepared statements the raw bytes can be sent as a binary
+/// parameter, so there isn't even hex to decode.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstdint>
+#include <string>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace ewkb
+namespace ewkb {
+
+/// The SRID of all the geometries in the database
+const uint32_t wgs84 = 4326;
+
+/// Encode a point as hex EWKB
+std::string hex(const point_t &point, uint32_t srid = wgs84);
+/// Encode a linestring as hex EWKB
+std::string hex(const linestring_t &line, uint32_t srid = wgs84);
+/// Encode a polygon as hex EWKB
+std::string hex(const polygon_t &poly, uint32_t srid = wgs84);
+/// Encode a multilinestring as hex EWKB
+std::string hex(const multilinestring_t &lines, uint32_t srid = wgs84);
+/// Encode a multipolygon as hex EWKB
+std::string hex(const multipolygon_t &polys, uint32_t srid = wgs84);
+
+/// Encode a point as EWKB, for a binary query parameter
+std::string binary(const point_t &point, uint32_t srid = wgs84);
+/// Encode a linestring as EWKB, for a binary query parameter
+std::string binary(const linestring_t &line, uint32_t srid = wgs84);
+/// Encode a polygon as EWKB, for a binary query parameter
+std::string binary(const polygon_t &poly, uint32_t srid = wgs84);
+/// Encode a multilinestring as EWKB, for a binary query parameter
+std::string binary(const multilinestring_t &lines, uint32_t srid = wgs84);
+/// Encode a multipolygon as EWKB, for a binary query parameter
+std::string binary(const multipolygon_t &polys, uint32_t srid = wgs84);
+
+/// A geometry literal to use in a query instead of ST_GeomFromText()
+template <typename T>
+std::string
+geometry(const T &geom, uint32_t srid = wgs84)
+{
+    return "'" + hex(geom, srid) + "'::geometry";
+}
+
+} // namespace ewkb
+
+#endif // EOF __EWKB_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -18,6 +18,12 @@
 //
 #include <cmath>
 #include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_X86 1
+#include <immintrin.h>
+#endif
+
 #include <utils/geo.hh>
 
 /// \namespace geo
@@ -30,23 +36,79 @@ void Geo::epsg4326toEpsg3857(double& x, double& y) {
   y = (y * 20037508.34) / 180;
 }
 
-double Geo::calculateAngle(double x1, double y1, double x2, double y2, double x3, double y3) {
-    Geo::epsg4326toEpsg3857(x1, y1);
-    Geo::epsg4326toEpsg3857(x2, y2);
-    Geo::epsg4326toEpsg3857(x3, y3);
+namespace {
+
+/// The cosine of the corner at b, between a and c
+inline double
+cornerCosine(double x1, double y1, double x2, double y2, double x3, double y3)
+{
     double ba0 = x1 - x2;
     double ba1 = y1 - y2;
     double bc0 = x3 - x2;
     double bc1 = y3 - y2;
     double dot_p = ba0 * bc0 + ba1 * bc1;
-    double cosine_angle = dot_p / (
-        std::pow((ba0 * ba0 + ba1 * ba1) , 0.5) *
-        std::pow((bc0 * bc0 + bc1 * bc1) , 0.5)
-    );
+    return dot_p / (std::sqrt(ba0 * ba0 + ba1 * ba1) * std::sqrt(bc0 * bc0 + bc1 * bc1));
+}
+
+void
+cornerCosinesScalar(const double *xs, const double *ys, size_t first, size_t count, double *cosines)
+{
+    for (size_t i = first; i + 2 < count; i++) {
+        cosines[i] = cornerCosine(xs[i], ys[i], xs[i + 1], ys[i + 1], xs[i + 2], ys[i + 2]);
+    }
+}
+
+#ifdef GEO_X86
+
+// The same operations in the same order as cornerCosine(), four
+// corners at a time, so the results are identical
+__attribute__((target("avx2"))) void
+cornerCosinesAvx2(const double *xs, const double *ys, size_t count, double *cosines)
+{
+    size_t i = 0;
+    for (; i + 6 <= count; i += 4) {
+        __m256d bx = _mm256_loadu_pd(xs + i + 1);
+        __m256d by = _mm256_loadu_pd(ys + i + 1);
+        __m256d ba0 = _mm256_sub_pd(_mm256_loadu_pd(xs + i), bx);
+        __m256d ba1 = _mm256_sub_pd(_mm256_loadu_pd(ys + i), by);
+        __m256d bc0 = _mm256_sub_pd(_mm256_loadu_pd(xs + i + 2), bx);
+        __m256d bc1 = _mm256_sub_pd(_mm256_loadu_pd(ys + i + 2), by);
+        __m256d dot = _mm256_add_pd(_mm256_mul_pd(ba0, bc0), _mm256_mul_pd(ba1, bc1));
+        __m256d ba = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(ba0, ba0), _mm256_mul_pd(ba1, ba1)));
+        __m256d bc = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(bc0, bc0), _mm256_mul_pd(bc1, bc1)));
+        _mm256_storeu_pd(cosines + i, _mm256_div_pd(dot, _mm256_mul_pd(ba, bc)));
+    }
+    // Mixing AVX and SSE code is slow until the upper halves are cleared
+    _mm256_zeroupper();
+    cornerCosinesScalar(xs, ys, i, count, cosines);
+}
+
+#endif // GEO_X86
+
+} // anonymous namespace
+
+double Geo::calculateAngle(double x1, double y1, double x2, double y2, double x3, double y3) {
+    Geo::epsg4326toEpsg3857(x1, y1);
+    Geo::epsg4326toEpsg3857(x2, y2);
+    Geo::epsg4326toEpsg3857(x3, y3);
+    double cosine_angle = cornerCosine(x1, y1, x2, y2, x3, y3);
     double angle = acos(cosine_angle);
     return angle * 180 / M_PI;
 }
 
+void
+Geo::cornerCosines(const double *xs, const double *ys, size_t count, double *cosines)
+{
+#ifdef GEO_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        cornerCosinesAvx2(xs, ys, count, cosines);
+        return;
+    }
+#endif
+    cornerCosinesScalar(xs, ys, 0, count, cosines);
+}
+
 } // EOF geo
 
 // local Variables:
@@ -29,6 +29,8 @@
 # include "unconfig.h"
 #endif
 
+#include <cstddef>
+
 /// \namespace geo
 namespace geo {
 
@@ -41,6 +43,13 @@ public:
     Geo(void) {};
     static void epsg4326toEpsg3857(double& x, double& y);
     static double calculateAngle(double x1, double y1, double x2, double y2, double x3, double y3);
+    /// Calculate the cosine of the corner at every point of a line
+    /// that is already in EPSG:3857, so a ring only gets projected
+    /// once. cosines[i] is the corner at i + 1, between the points
+    /// i, i + 1 and i + 2, so there are count - 2 of them. This is
+    /// what calculateAngle() computes before acos(), so comparing the
+    /// cosines against the cosine of a limit avoids acos() entirely.
+    static void cornerCosines(const double *xs, const double *ys, size_t count, double *cosines);
 };
 
 }
@@ -79,17 +79,51 @@ GeoUtil::readFile(const std::string &filespec)
     if (layer != 0) {
         for (auto &feature : layer) {
             const OGRGeometry *geom = feature->GetGeometryRef();
-            const OGRMultiPolygon *mp = geom->toMultiPolygon();
+            if (geom == 0) {
+                continue;
+            }
             char *wkt = NULL;
-            int bar = mp->exportToWkt(&wkt);
-            boost::geometry::read_wkt(wkt, boundary);
+            geom->exportToWkt(&wkt);
+            if (wkt == NULL) {
+                continue;
+            }
+            // Features may be polygons or multipolygons
+            multipolygon_t area;
+            if (std::strncmp(wkt, "POLYGON", 7) == 0) {
+                polygon_t poly;
+                boost::geometry::read_wkt(wkt, poly);
+                area.push_back(poly);
+            } else {
+                boost::geometry::read_wkt(wkt, area);
+            }
             CPLFree(wkt);
+            boost::geometry::correct(area);
+            addArea(area);
+            int field = feature->GetFieldIndex("name");
+            if (field >= 0) {
+                std::string name = feature->GetFieldAsString(field);
+                if (!name.empty()) {
+                    regions.push_back(Region{name, area});
+                }
+            }
         }
+        log_debug("Loaded %1% named regions", regions.size());
     }
 
     return true;
 }
 
+void
+GeoUtil::addArea(const multipolygon_t &area)
+{
+    // Appending the polygons would leave overlapping features in the
+    // multipolygon, which makes it invalid, and within() then treats
+    // the overlap as outside. Dissolve them instead.
+    multipolygon_t merged;
+    boost::geometry::union_(boundary, area, merged);
+    boundary = std::move(merged);
+}
+
 /// Read an EWKT string as the boundary, instead of a file.
 bool
 GeoUtil::readPoly(const std::string &wkt)
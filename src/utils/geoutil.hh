@@ -48,6 +48,7 @@
 
 #include "stats/querystats.hh"
 #include "osm/osmobjects.hh"
+#include "utils/regionindex.hh"
 
 /// \namespace geoutil
 namespace geoutil {
@@ -71,8 +72,14 @@ public:
     /// country a change was made in, or filtering out part of the
     /// planet to reduce data size. Since this uses GDAL, any
     /// multi-polygon file of any supported format can be used.
+    /// The boundary is the union of all the features, and the ones
+    /// with a "name" property are also loaded as named regions.
     bool readFile(const std::string &filespec);
 
+    /// Add an area to the boundary, merging it with any features
+    /// it overlaps so the boundary stays a valid multipolygon.
+    void addArea(const multipolygon_t &area);
+
     /// Read an EWKT string as the boundary, instead of a file.
     bool readPoly(const std::string &poly);
 
@@ -102,6 +109,7 @@ public:
     };
     // private:
     multipolygon_t boundary; ///< The boundary multipolygon
+    std::vector<Region> regions; ///< The named regions in the boundary
 };
     
 }       // EOF geoutil
@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#include "utils/gzip.hh"
+
+/// \namespace gzip
+namespace gzip {
+
+// OsmChange files compress about 10 to 1, so a trailer claiming much
+// more than this is corrupt, or the output grows to it as it's inflated
+static const size_t max_ratio = 16;
+
+bool
+isGzip(const unsigned char *data, size_t size)
+{
+    return size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
+
+size_t
+sizeHint(const unsigned char *data, size_t size)
+{
+    // A gzip member is at least a 10 byte header and an 8 byte trailer
+    if (size < 18) {
+        return 0;
+    }
+    const unsigned char *isize = data + size - 4;
+    size_t hint = static_cast<size_t>(isize[0]) | static_cast<size_t>(isize[1]) << 8 |
+        static_cast<size_t>(isize[2]) << 16 | static_cast<size_t>(isize[3]) << 24;
+    // The trailer isn't checked until the end, so a corrupt file could
+    // ask for 4G up front
+    return std::min(hint, size * max_ratio);
+}
+
+std::string
+inflate(const unsigned char *data, size_t size)
+{
+    if (!isGzip(data, size)) {
+        return std::string(reinterpret_cast<const char *>(data), size);
+    }
+
+    // The trailer is wrong for files of 4G or more, and for files with
+    // several members, in which case guess from the compressed size.
+    // Either way the buffer grows if it turns out to be too small.
+    std::string out;
+    size_t hint = sizeHint(data, size);
+    if (hint < size) {
+        hint = size * 4;
+    }
+    out.resize(hint);
+    size_t used = 0;
+
+#ifdef HAVE_LIBDEFLATE
+    struct libdeflate_decompressor *decompressor = libdeflate_alloc_decompressor();
+    if (decompressor == nullptr) {
+        throw std::runtime_error("couldn't allocate a gzip decompressor");
+    }
+    size_t offset = 0;
+    while (offset < size && isGzip(data + offset, size - offset)) {
+        size_t in_bytes = 0;
+        size_t out_bytes = 0;
+        auto result = libdeflate_gzip_decompress_ex(decompressor, data + offset, size - offset,
+                                                    out.data() + used, out.size() - used,
+                                                    &in_bytes, &out_bytes);
+        if (result == LIBDEFLATE_INSUFFICIENT_SPACE) {
+            out.resize(out.size() * 2);
+            continue;
+        }
+        if (result != LIBDEFLATE_SUCCESS) {
+            libdeflate_free_decompressor(decompressor);
+            throw std::runtime_error("gzip data is corrupted");
+        }
+        offset += in_bytes;
+        used += out_bytes;
+    }
+    libdeflate_free_decompressor(decompressor);
+#else
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    // Adding 16 to the window bits makes zlib expect a gzip header
+    if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("couldn't allocate a gzip decompressor");
+    }
+    strm.next_in = const_cast<Bytef *>(data);
+    // zlib counts in 32 bits, so feed larger buffers in pieces
+    size_t pending = size;
+    while (true) {
+        if (strm.avail_in == 0 && pending > 0) {
+            strm.avail_in = std::min(pending, static_cast<size_t>(UINT_MAX));
+            pending -= strm.avail_in;
+        }
+        if (used == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        uInt avail = std::min(out.size() - used, static_cast<size_t>(UINT_MAX));
+        strm.next_out = reinterpret_cast<Bytef *>(out.data() + used);
+        strm.avail_out = avail;
+        int ret = ::inflate(&strm, Z_NO_FLUSH);
+        used += avail - strm.avail_out;
+        if (ret == Z_STREAM_END) {
+            // Concatenated members get inflated one after the other,
+            // anything else after the end is ignored like gzip does.
+            size_t left = strm.avail_in + pending;
+            if (left > 0 && isGzip(strm.next_in, left)) {
+                inflateReset(&strm);
+                continue;
+            }
+            break;
+        }
+        if (ret == Z_BUF_ERROR && strm.avail_out > 0) {
+            inflateEnd(&strm);
+            throw std::runtime_error("gzip data is truncated");
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            inflateEnd(&strm);
+            throw std::runtime_error("gzip data is corrupted");
+        }
+    }
+    inflateEnd(&strm);
+#endif
+
+    out.resize(used);
+    return out;
+}
+
+std::string
+inflate(const std::vector<unsigned char> &data)
+{
+    return inflate(data.data(), data.size());
+}
+
+std::string
+inflateFile(const std::string &filespec)
+{
+    // A directory opens fine, but seeking to its end gives a bogus size
+    if (!std::filesystem::is_regular_file(filespec)) {
+        throw std::runtime_error(filespec + " is not a file");
+    }
+    std::ifstream file(filespec, std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("couldn't open " + filespec);
+    }
+    file.seekg(0, std::ios_base::end);
+    std::streamoff size = file.tellg();
+    if (size < 0) {
+        throw std::runtime_error("couldn't get the size of " + filespec);
+    }
+    std::vector<unsigned char> data(size);
+    file.seekg(0, std::ios_base::beg);
+    if (!file.read(reinterpret_cast<char *>(data.data()), data.size())) {
+        throw std::runtime_error("couldn't read " + filespec);
+    }
+    return inflate(data);
+}
+
+std::vector<unsigned char>
+deflate(const std::string &data)
+{
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("couldn't initialize zlib");
+    }
+    std::vector<unsigned char> out(deflateBound(&strm, data.size()) + 32);
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = data.size();
+    strm.next_out = out.data();
+    strm.avail_out = out.size();
+    int ret = ::deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+    if (ret != Z_STREAM_END) {
+        throw std::runtime_error("couldn't compress the data");
+    }
+    return out;
+}
+
+} // namespace gzip
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
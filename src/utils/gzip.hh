@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __GZIP_HH__
+#define __GZIP_HH__
+
+/// \file gzip.hh
+/// \brief Inflate gzip compressed data held in memory
+///
+/// Replication files are downloaded into memory as a whole, so there
+/// is no need to push them through a chain of stream buffers to
+/// uncompress them. These functions inflate a complete buffer in one
+/// call into an output string that is sized up front from the ISIZE
+/// field in the gzip trailer. When libdeflate is available it is used
+/// instead of zlib, as it is much faster for whole buffers.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <string>
+#include <vector>
+
+/// \namespace gzip
+namespace gzip {
+
+/// Return true if the buffer starts with the gzip magic number
+bool isGzip(const unsigned char *data, size_t size);
+
+/// Return the uncompressed size stored in the gzip trailer, capped at
+/// 16 times the compressed size. This is only a hint, as it's modulo
+/// 2^32, only covers the last member, and isn't checked.
+size_t sizeHint(const unsigned char *data, size_t size);
+
+/// Inflate a complete gzip buffer, which may hold several members.
+/// Data that isn't compressed is returned unchanged. Throws
+/// std::runtime_error if the data is corrupted.
+std::string inflate(const unsigned char *data, size_t size);
+
+/// Inflate a complete gzip buffer
+std::string inflate(const std::vector<unsigned char> &data);
+
+/// Read a gzip file from disk and inflate it. Throws
+/// std::runtime_error if the file can't be read.
+std::string inflateFile(const std::string &filespec);
+
+/// Compress a buffer into a single gzip member. Throws
+/// std::runtime_error if zlib fails.
+std::vector<unsigned char> deflate(const std::string &data);
+
+} // namespace gzip
+
+#endif // EOF __GZIP_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,267 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVERSINE_X86 1
+#include <immintrin.h>
+#endif
+
+#include "utils/haversine.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace haversine
+namespace haversine {
+
+namespace {
+
+// Below this half chord, about 127km, the series for asin() is exact
+// to double precision with five terms
+const double short_segment = 0.01;
+
+/// The angle between two unit vectors, given half the chord between
+/// them, which is what the haversine formula calls sqrt(a)
+inline double
+arc(double half)
+{
+    if (half < short_segment) {
+        double h2 = half * half;
+        return half + half * h2 * (1.0 / 6 + h2 * (3.0 / 40 + h2 * (5.0 / 112 + h2 * (35.0 / 1152))));
+    }
+    return std::asin(std::min(half, 1.0));
+}
+
+/// Convert the points to unit vectors
+void
+vectors(const double *lons, const double *lats, size_t count, double *x, double *y, double *z)
+{
+    const double radians = M_PI / 180.0;
+    for (size_t i = 0; i < count; i++) {
+        double lat = lats[i] * radians;
+        double lon = lons[i] * radians;
+        double coslat = std::cos(lat);
+        x[i] = coslat * std::cos(lon);
+        y[i] = coslat * std::sin(lon);
+        z[i] = std::sin(lat);
+    }
+}
+
+/// Half the chord of a segment
+inline double
+halfChord(const double *x, const double *y, const double *z, size_t i)
+{
+    double dx = x[i + 1] - x[i];
+    double dy = y[i + 1] - y[i];
+    double dz = z[i + 1] - z[i];
+    return std::sqrt(dx * dx + dy * dy + dz * dz) * 0.5;
+}
+
+double
+sumScalar(const double *x, const double *y, const double *z, size_t first, size_t count)
+{
+    double sum = 0.0;
+    for (size_t i = first; i + 1 < count; i++) {
+        sum += arc(halfChord(x, y, z, i));
+    }
+    return sum;
+}
+
+#ifdef HAVERSINE_X86
+
+/// Sine and cosine of four angles in [-pi, pi]. The angle is reduced
+/// to [-pi/4, pi/4] by a multiple of pi/2, then the polynomials are
+/// the ones from Cephes, which are good to an ulp or two.
+__attribute__((target("avx2"))) inline void
+sincosAvx2(__m256d angle, __m256d &sin, __m256d &cos)
+{
+    __m256d quadrant = _mm256_round_pd(_mm256_mul_pd(angle, _mm256_set1_pd(M_2_PI)),
+                                       _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    // pi/2 in two parts, so the reduction is exact
+    __m256d r = _mm256_sub_pd(angle, _mm256_mul_pd(quadrant, _mm256_set1_pd(1.57079632673412561417e+00)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(quadrant, _mm256_set1_pd(6.07710050650619224932e-11)));
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(1.58962301576546568060e-10);
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-2.50507477628578072866e-8));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(2.75573136213857245213e-6));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-1.98412698295895385996e-4));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(8.33333333332211858878e-3));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(-1.66666666666666307295e-1));
+    __m256d s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), ps));
+
+    __m256d pc = _mm256_set1_pd(-1.13585365213876817300e-11);
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(2.08757008419747316778e-9));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(-2.75573141792967388112e-7));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(2.48015872888517045348e-5));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(-1.38888888888730564116e-3));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(4.16666666666665929218e-2));
+    __m256d c = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(z, _mm256_set1_pd(0.5))),
+                              _mm256_mul_pd(_mm256_mul_pd(z, z), pc));
+
+    // Odd quadrants swap sine and cosine, quadrants 1 and 2 flip the
+    // sign of the cosine, and 2 and 3 flip the sign of the sine
+    __m256i q = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(quadrant));
+    __m256d swap = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(1)),
+                                                          _mm256_set1_epi64x(1)));
+    __m256d sinsign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(q, _mm256_set1_epi64x(2)), 62));
+    __m256d cossign = _mm256_castsi256_pd(_mm256_slli_epi64(
+        _mm256_and_si256(_mm256_add_epi64(q, _mm256_set1_epi64x(1)), _mm256_set1_epi64x(2)), 62));
+    sin = _mm256_xor_pd(_mm256_blendv_pd(s, c, swap), sinsign);
+    cos = _mm256_xor_pd(_mm256_blendv_pd(c, s, swap), cossign);
+}
+
+__attribute__((target("avx2"))) void
+vectorsAvx2(const double *lons, const double *lats, size_t count, double *x, double *y, double *z)
+{
+    const __m256d radians = _mm256_set1_pd(M_PI / 180.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d sinlat, coslat, sinlon, coslon;
+        sincosAvx2(_mm256_mul_pd(_mm256_loadu_pd(lats + i), radians), sinlat, coslat);
+        sincosAvx2(_mm256_mul_pd(_mm256_loadu_pd(lons + i), radians), sinlon, coslon);
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(coslat, coslon));
+        _mm256_storeu_pd(y + i, _mm256_mul_pd(coslat, sinlon));
+        _mm256_storeu_pd(z + i, sinlat);
+    }
+    _mm256_zeroupper();
+    vectors(lons + i, lats + i, count - i, x + i, y + i, z + i);
+}
+
+__attribute__((target("avx2"))) double
+sumAvx2(const double *x, const double *y, const double *z, size_t count)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d limit = _mm256_set1_pd(short_segment);
+    __m256d sum = _mm256_setzero_pd();
+    double extra = 0.0;
+    size_t i = 0;
+    for (; i + 4 < count; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i + 1), _mm256_loadu_pd(x + i));
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i + 1), _mm256_loadu_pd(y + i));
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i + 1), _mm256_loadu_pd(z + i));
+        __m256d chord = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                      _mm256_mul_pd(dz, dz));
+        __m256d h = _mm256_mul_pd(_mm256_sqrt_pd(chord), half);
+        if (_mm256_movemask_pd(_mm256_cmp_pd(h, limit, _CMP_GE_OQ)) != 0) {
+            // A long segment, do these four the slow way
+            double lanes[4];
+            _mm256_storeu_pd(lanes, h);
+            for (int k = 0; k < 4; k++) {
+                extra += arc(lanes[k]);
+            }
+            continue;
+        }
+        __m256d h2 = _mm256_mul_pd(h, h);
+        __m256d series = _mm256_add_pd(_mm256_set1_pd(5.0 / 112), _mm256_mul_pd(h2, _mm256_set1_pd(35.0 / 1152)));
+        series = _mm256_add_pd(_mm256_set1_pd(3.0 / 40), _mm256_mul_pd(h2, series));
+        series = _mm256_add_pd(_mm256_set1_pd(1.0 / 6), _mm256_mul_pd(h2, series));
+        sum = _mm256_add_pd(sum, _mm256_add_pd(h, _mm256_mul_pd(_mm256_mul_pd(h, h2), series)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    // Mixing AVX and SSE code is slow until the upper halves are cleared
+    _mm256_zeroupper();
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + extra + sumScalar(x, y, z, i, count);
+}
+
+#endif // HAVERSINE_X86
+
+} // anonymous namespace
+
+bool
+supported(kernel_t kernel)
+{
+    switch (kernel) {
+    case scalar:
+        return true;
+#ifdef HAVERSINE_X86
+    case avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+kernel_t
+best(void)
+{
+    static const kernel_t kernel = supported(avx2) ? avx2 : scalar;
+    return kernel;
+}
+
+double
+length(kernel_t kernel, const double *lons, const double *lats, size_t count)
+{
+    if (count < 2) {
+        return 0.0;
+    }
+    std::vector<double> xyz(count * 3);
+    double *x = xyz.data();
+    double *y = x + count;
+    double *z = y + count;
+    double sum;
+#ifdef HAVERSINE_X86
+    if (kernel == avx2) {
+        vectorsAvx2(lons, lats, count, x, y, z);
+        sum = sumAvx2(x, y, z, count);
+    } else {
+        vectors(lons, lats, count, x, y, z);
+        sum = sumScalar(x, y, z, 0, count);
+    }
+#else
+    vectors(lons, lats, count, x, y, z);
+    sum = sumScalar(x, y, z, 0, count);
+#endif
+    return 2.0 * earth_radius * sum;
+}
+
+double
+length(const linestring_t &line)
+{
+    std::vector<double> lons;
+    std::vector<double> lats;
+    lons.reserve(line.size());
+    lats.reserve(line.size());
+    for (auto it = std::begin(line); it != std::end(line); ++it) {
+        lons.push_back(it->get<0>());
+        lats.push_back(it->get<1>());
+    }
+    return length(lons.data(), lats.data(), lons.size());
+}
+
+} // namespace haversine
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
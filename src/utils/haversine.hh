@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __HAVERSINE_HH__
+#define __HAVERSINE_HH__
+
+/// \file haversine.hh
+/// \brief Great circle lengths of lines for the statistics
+///
+/// The highway and waterway statistics add up the length of every
+/// created way. This converts each point to a unit vector once, so
+/// the trig functions run once per point instead of several times per
+/// segment. Each segment is then just the chord between two vectors,
+/// and the arc is computed with a short series when the segment is
+/// short, which is almost always the case for OSM ways. The AVX2
+/// kernel does four points or segments at once, with its own sine and
+/// cosine. The result is the same as the haversine formula in double
+/// precision.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstddef>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace haversine
+namespace haversine {
+
+/// The mean radius of the earth in kilometers
+const double earth_radius = 6371.0;
+
+/// The implementations of the kernel
+typedef enum { scalar, avx2 } kernel_t;
+
+/// The fastest kernel this CPU supports
+kernel_t best(void);
+
+/// Whether this CPU can run a kernel
+bool supported(kernel_t kernel);
+
+/// The length in kilometers of a line whose longitudes and latitudes
+/// in degrees are in two arrays
+double length(kernel_t kernel, const double *lons, const double *lats, size_t count);
+
+/// The same, with the best kernel for this CPU
+inline double
+length(const double *lons, const double *lats, size_t count)
+{
+    return length(best(), lons, lats, count);
+}
+
+/// The length of a linestring in kilometers
+double length(const linestring_t &line);
+
+} // namespace haversine
+
+} // namespace geoutil
+
+#endif // EOF __HAVERSINE_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
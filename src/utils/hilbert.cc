@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "utils/hilbert.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace hilbert
+namespace hilbert {
+
+namespace {
+
+/// Map a coordinate to a grid cell, clamping anything out of range
+uint32_t
+cell(double value, double min, double max)
+{
+    const double size = double(uint32_t(1) << order);
+    double pos = std::floor((value - min) / (max - min) * size);
+    if (!(pos >= 0.0)) {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::min(pos, size - 1));
+}
+
+} // namespace
+
+uint64_t
+key(double lon, double lat)
+{
+    const uint32_t n = uint32_t(1) << order;
+    uint32_t x = cell(lon, -180.0, 180.0);
+    uint32_t y = cell(lat, -90.0, 90.0);
+    uint64_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += uint64_t(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void
+SortedBatch::add(int64_t id, uint64_t key, std::string statement)
+{
+    if (statement.empty()) {
+        return;
+    }
+    auto found = keys.emplace(id, key);
+    entries.push_back(Entry{found.first->second, entries.size(), std::move(statement)});
+}
+
+void
+SortedBatch::flush(std::string &query)
+{
+    std::sort(std::begin(entries), std::end(entries), [](const Entry &a, const Entry &b) {
+        return a.key < b.key || (a.key == b.key && a.sequence < b.sequence);
+    });
+    size_t length = query.size();
+    for (auto it = std::begin(entries); it != std::end(entries); ++it) {
+        length += it->statement.size();
+    }
+    query.reserve(length);
+    for (auto it = std::begin(entries); it != std::end(entries); ++it) {
+        query += it->statement;
+    }
+    entries.clear();
+    keys.clear();
+}
+
+} // namespace hilbert
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __HILBERT_HH__
+#define __HILBERT_HH__
+
+/// \file hilbert.hh
+/// \brief Sort database writes along a Hilbert curve
+///
+/// The raw data and validation rows are written in the order they're
+/// in the change file, which is by changeset, so consecutive upserts
+/// land all over the B-tree and GiST indexes of a large database.
+/// Sorting a batch by the position of each object along a Hilbert
+/// curve over the planet keeps nearby objects together, so each batch
+/// touches far fewer index pages.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace hilbert
+namespace hilbert {
+
+/// The curve covers a grid of 2^order cells on each side, which is
+/// about 600 meters at the equator
+const unsigned int order = 16;
+
+/// The key for objects without a location, which sort after all others
+const uint64_t unknown = uint64_t(1) << (2 * order);
+
+/// The position of a location along the Hilbert curve
+uint64_t key(double lon, double lat);
+inline uint64_t
+key(const point_t &point)
+{
+    return key(point.get<0>(), point.get<1>());
+}
+
+/// Stable sort a vector by the Hilbert key of each item, the location
+/// function returns the key of an item
+template <typename T, typename F>
+void
+sort(std::vector<T> &items, F location)
+{
+    std::vector<std::pair<uint64_t, size_t>> keys;
+    keys.reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        keys.push_back(std::make_pair(location(items[i]), i));
+    }
+    std::sort(std::begin(keys), std::end(keys));
+    std::vector<T> sorted;
+    sorted.reserve(items.size());
+    for (auto it = std::begin(keys); it != std::end(keys); ++it) {
+        sorted.push_back(std::move(items[it->second]));
+    }
+    items.swap(sorted);
+}
+
+/// \class SortedBatch
+/// \brief Collect SQL statements and write them in Hilbert order
+///
+/// An object can be in a change file more than once. Its statements
+/// are not guarded the same way, the way_refs are simply replaced, so
+/// they all use the key of the first one and keep their order.
+class SortedBatch {
+  public:
+    SortedBatch(void) {};
+
+    /// Add the statements for an object
+    void add(int64_t id, uint64_t key, std::string statement);
+
+    /// There are no statements
+    bool empty(void) const { return entries.empty(); };
+    /// The number of statements
+    size_t size(void) const { return entries.size(); };
+
+    /// Append all the statements in order to a query, and empty the batch
+    void flush(std::string &query);
+
+  private:
+    struct Entry {
+        uint64_t key;
+        size_t sequence;      ///< The order statements were added in
+        std::string statement;
+    };
+    std::vector<Entry> entries;
+    std::unordered_map<int64_t, uint64_t> keys; ///< The key of each object
+};
+
+} // namespace hilbert
+
+} // namespace geoutil
+
+#endif // EOF __HILBERT_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
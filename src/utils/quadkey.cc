@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "utils/quadkey.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace quadkey
+namespace quadkey {
+
+namespace {
+
+/// Clamp a position on the tile grid to a valid column or row
+uint32_t
+clamp(double pos)
+{
+    const double size = double(uint32_t(1) << maxzoom);
+    if (!(pos >= 0.0)) {
+        return 0;
+    }
+    return static_cast<uint32_t>(std::min(std::floor(pos), size - 1));
+}
+
+} // namespace
+
+void
+tile(double lon, double lat, uint32_t &x, uint32_t &y)
+{
+    const double size = double(uint32_t(1) << maxzoom);
+    // Web mercator stops at about 85.0511 degrees
+    lat = std::max(-85.0511287798, std::min(85.0511287798, lat));
+    double sinlat = std::sin(lat * M_PI / 180.0);
+    x = clamp((lon + 180.0) / 360.0 * size);
+    y = clamp((0.5 - std::log((1.0 + sinlat) / (1.0 - sinlat)) / (4.0 * M_PI)) * size);
+}
+
+int64_t
+key(double minlon, double minlat, double maxlon, double maxlat)
+{
+    // The row numbers go down from the north
+    uint32_t x0, y0, x1, y1;
+    tile(minlon, maxlat, x0, y0);
+    tile(maxlon, minlat, x1, y1);
+    // Go up until both corners are in the same tile
+    unsigned int zoom = maxzoom;
+    while (x0 != x1 || y0 != y1) {
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 >>= 1;
+        y1 >>= 1;
+        zoom--;
+    }
+    // Interleave the bits like the digits of a quadkey, then pad it
+    // to the deepest zoom level
+    int64_t result = 0;
+    for (int bit = zoom - 1; bit >= 0; bit--) {
+        int64_t digit = ((x0 >> bit) & 1) | (((y0 >> bit) & 1) << 1);
+        result = (result << 2) | digit;
+    }
+    return result << (2 * (maxzoom - zoom));
+}
+
+} // namespace quadkey
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __QUADKEY_HH__
+#define __QUADKEY_HH__
+
+/// \file quadkey.hh
+/// \brief Spatial cell keys stored with each feature
+///
+/// Area queries test every row of a table against the area with
+/// ST_Intersects(). To prune most rows with a B-tree range scan first,
+/// each feature is stored with the quadkey of the smallest web mercator
+/// tile, up to zoom level 16, that contains its bounding box. The key
+/// is the quadkey as an integer, with the digits of the lower zoom
+/// levels padded with zeros, so every tile covers one contiguous range
+/// of keys, and the tiles above it each have a single key. An area
+/// covered by a few tiles then only has to look at the keys in their
+/// ranges, and at the keys of their parents for the larger features.
+/// The same keys are computed by quadkeyQueryFilter() in
+/// python/dbapi/api/filters.py, and by setup/db/raw.lua.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <cstdint>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \namespace quadkey
+namespace quadkey {
+
+/// The deepest zoom level, tiles are about 600 meters at the equator
+const unsigned int maxzoom = 16;
+
+/// The tile column and row of a location at the deepest zoom level
+void tile(double lon, double lat, uint32_t &x, uint32_t &y);
+
+/// The key of the smallest tile containing a bounding box
+int64_t key(double minlon, double minlat, double maxlon, double maxlat);
+/// The key of the tile containing a point
+inline int64_t
+key(const point_t &point)
+{
+    return key(point.get<0>(), point.get<1>(), point.get<0>(), point.get<1>());
+}
+/// The key of the smallest tile containing a bounding box
+inline int64_t
+key(const boost::geometry::model::box<point_t> &box)
+{
+    return key(box.min_corner().get<0>(), box.min_corner().get<1>(),
+               box.max_corner().get<0>(), box.max_corner().get<1>());
+}
+
+} // namespace quadkey
+
+} // namespace geoutil
+
+#endif // EOF __QUADKEY_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
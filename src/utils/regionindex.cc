@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <string>
+#include <vector>
+#include <boost/geometry.hpp>
+
+#include "utils/regionindex.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+void
+RegionIndex::build(const std::vector<Region> &regions)
+{
+    entries.clear();
+    entries.reserve(regions.size());
+    for (auto it = std::begin(regions); it != std::end(regions); ++it) {
+        if (it->boundary.empty()) {
+            continue;
+        }
+        entries.emplace_back();
+        Entry &entry = entries.back();
+        entry.name = it->name;
+        boost::geometry::envelope(it->boundary, entry.envelope);
+        entry.index.build(it->boundary);
+    }
+}
+
+std::vector<size_t>
+RegionIndex::find(const point_t &point) const
+{
+    std::vector<size_t> result;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry &entry = entries[i];
+        if (boost::geometry::covered_by(point, entry.envelope) && entry.index.within(point)) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string>
+RegionIndex::names(const point_t &point) const
+{
+    std::vector<std::string> result;
+    auto found = find(point);
+    for (auto it = std::begin(found); it != std::end(found); ++it) {
+        result.push_back(entries[*it].name);
+    }
+    return result;
+}
+
+} // namespace geoutil
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
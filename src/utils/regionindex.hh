@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef __REGIONINDEX_HH__
+#define __REGIONINDEX_HH__
+
+/// \file regionindex.hh
+/// \brief Assign objects to named priority regions
+///
+/// A single boundary file can contain several named regions, so one
+/// instance can process the data for all of them instead of running
+/// one instance per region, each downloading and parsing the same
+/// files. The union of the regions is still used as the priority
+/// boundary to filter the data. For the objects that are kept, this
+/// finds which of the regions they're in, so the statistics and the
+/// validation results can be tagged with the region names. Regions
+/// may overlap, so an object can be in more than one of them.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <string>
+#include <vector>
+
+#include "osm/osmobjects.hh"
+#include "utils/boundaryindex.hh"
+
+/// \namespace geoutil
+namespace geoutil {
+
+/// \struct Region
+/// \brief A named area from the boundary file
+struct Region {
+    std::string name;        ///< The name of the feature
+    multipolygon_t boundary; ///< The area of the region
+};
+
+/// \class RegionIndex
+/// \brief The prepared boundaries of all the named regions
+///
+/// Each region gets its own BoundaryIndex. There are usually only a
+/// handful of regions, so the envelopes are checked one after the
+/// other before testing the point against a region.
+class RegionIndex {
+  public:
+    RegionIndex(void) {};
+    explicit RegionIndex(const std::vector<Region> &regions) { build(regions); };
+
+    /// Prepare the boundaries of all the regions
+    void build(const std::vector<Region> &regions);
+
+    /// There are no named regions
+    bool empty(void) const { return entries.empty(); };
+    /// The number of regions
+    size_t size(void) const { return entries.size(); };
+    /// The name of a region
+    const std::string &name(size_t index) const { return entries[index].name; };
+
+    /// The indexes of the regions a point is in, in the order of the file
+    std::vector<size_t> find(const point_t &point) const;
+    /// The names of the regions a point is in, in the order of the file
+    std::vector<std::string> names(const point_t &point) const;
+
+  private:
+    struct Entry {
+        std::string name;
+        boost::geometry::model::box<point_t> envelope;
+        BoundaryIndex index;
+    };
+    std::vector<Entry> entries;
+};
+
+} // namespace geoutil
+
+#endif // EOF __REGIONINDEX_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
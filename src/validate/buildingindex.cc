@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <mutex>
+
+#include "validate/buildingindex.hh"
+
+/// \namespace buildingindex
+namespace buildingindex {
+
+std::shared_ptr<const Building>
+BuildingIndex::make(long id, int version, const polygon_t &polygon, const std::string &layer)
+{
+    if (polygon.outer().size() < 4) {
+        return nullptr;
+    }
+    auto building = std::make_shared<Building>();
+    building->id = id;
+    building->version = version;
+    building->layer = layer;
+    building->polygon = polygon;
+    // The overlap and intersection tests expect the orientation
+    // boost::geometry uses, which isn't always what the data has
+    boost::geometry::correct(building->polygon);
+    boost::geometry::envelope(building->polygon, building->envelope);
+    return building;
+}
+
+void
+BuildingIndex::load(long id, int version, const polygon_t &polygon, const std::string &layer)
+{
+    auto building = make(id, version, polygon, layer);
+    if (building) {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        pending.push_back(building);
+    }
+}
+
+void
+BuildingIndex::seal(void)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (pending.empty()) {
+        return;
+    }
+    // Changes applied before the database was read win
+    std::vector<value_t> values;
+    values.reserve(rtree.size() + pending.size());
+    for (auto it = std::begin(pending); it != std::end(pending); ++it) {
+        if (stale((*it)->id, (*it)->version)) {
+            continue;
+        }
+        if (buildings.emplace((*it)->id, *it).second) {
+            values.push_back(value_t((*it)->envelope, (*it)->id));
+        }
+    }
+    pending.clear();
+    pending.shrink_to_fit();
+    // The packing algorithm builds a much better tree than inserting
+    // one by one, so rebuild it with everything
+    for (auto it = rtree.begin(); it != rtree.end(); ++it) {
+        values.push_back(*it);
+    }
+    rtree = rtree_t(values.begin(), values.end());
+}
+
+void
+BuildingIndex::replace(const std::shared_ptr<const Building> &building)
+{
+    auto it = buildings.find(building->id);
+    if (it != buildings.end()) {
+        rtree.remove(value_t(it->second->envelope, building->id));
+    }
+    removed.erase(building->id);
+    buildings[building->id] = building;
+    rtree.insert(value_t(building->envelope, building->id));
+}
+
+void
+BuildingIndex::remove(long id, int version)
+{
+    auto it = buildings.find(id);
+    if (it != buildings.end()) {
+        rtree.remove(value_t(it->second->envelope, id));
+        buildings.erase(it);
+    }
+    removed[id] = version;
+}
+
+bool
+BuildingIndex::stale(long id, int version) const
+{
+    auto it = buildings.find(id);
+    if (it != buildings.end() && it->second->version > version) {
+        return true;
+    }
+    auto dropped = removed.find(id);
+    return dropped != removed.end() && dropped->second > version;
+}
+
+void
+BuildingIndex::update(const osmobjects::OsmWay &way)
+{
+    if (way.action == osmobjects::remove) {
+        erase(way.id, way.version);
+        return;
+    }
+    std::shared_ptr<const Building> building;
+    if (way.tags.count("building") && way.refs.size() > 3 && way.refs.front() == way.refs.back()) {
+        auto layer = way.tags.find("layer");
+        building = make(way.id, way.version, way.polygon, layer == way.tags.end() ? "" : layer->second);
+    }
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (stale(way.id, way.version)) {
+        return;
+    }
+    if (building) {
+        replace(building);
+    } else {
+        remove(way.id, way.version);
+    }
+}
+
+void
+BuildingIndex::erase(long id, int version)
+{
+    std::unique_lock<std::shared_mutex> guard(lock);
+    if (!stale(id, version)) {
+        remove(id, version);
+    }
+}
+
+std::vector<std::shared_ptr<const Building>>
+BuildingIndex::candidates(const polygon_t &polygon) const
+{
+    if (polygon.outer().empty()) {
+        return std::vector<std::shared_ptr<const Building>>();
+    }
+    boost::geometry::model::box<point_t> envelope;
+    boost::geometry::envelope(polygon, envelope);
+    return candidates(envelope);
+}
+
+std::vector<std::shared_ptr<const Building>>
+BuildingIndex::candidates(const boost::geometry::model::box<point_t> &envelope) const
+{
+    std::vector<std::shared_ptr<const Building>> result;
+    std::vector<value_t> hits;
+    std::shared_lock<std::shared_mutex> guard(lock);
+    rtree.query(boost::geometry::index::intersects(envelope), std::back_inserter(hits));
+    result.reserve(hits.size());
+    for (auto it = std::begin(hits); it != std::end(hits); ++it) {
+        result.push_back(buildings.at(it->second));
+    }
+    return result;
+}
+
+size_t
+BuildingIndex::size(void) const
+{
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return buildings.size();
+}
+
+} // namespace buildingindex
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2023 Humanitarian OpenStreetMap Team
+//
+// This file is part of Underpass.
+//
+//     Underpass is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Underpass is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Underpass.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#ifndef __BUILDINGINDEX_HH__
+#define __BUILDINGINDEX_HH__
+
+/// \file buildingindex.hh
+/// \brief A spatial index of the buildings in the priority area
+///
+/// Finding overlapping and duplicate buildings needs the buildings
+/// around the one being validated. This keeps the polygon of every
+/// building in an R-tree of their envelopes, so a check only looks at
+/// the few buildings whose envelope intersects the new one. It's
+/// loaded once from the ways_poly table, and then kept current by the
+/// changes as they get validated.
+
+// This is generated by autoconf
+#ifdef HAVE_CONFIG_H
+#include "unconfig.h"
+#endif
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "osm/osmobjects.hh"
+
+/// \namespace buildingindex
+namespace buildingindex {
+
+/// \struct Building
+/// \brief What the geospatial checks need to know about a building
+struct Building {
+    long id = 0;                                            ///< The OSM ID of the way
+    int version = 0;                                        ///< The version of the way
+    std::string layer;                                      ///< The value of the layer tag, if any
+    polygon_t polygon;                                      ///< The geometry, oriented for boost::geometry
+    boost::geometry::model::box<point_t> envelope;          ///< The bounding box of the polygon
+};
+
+/// \class BuildingIndex
+/// \brief Find the buildings near a polygon
+///
+/// Buildings are shared, so a query returns them without copying the
+/// polygons. Queries can run in parallel with each other, while
+/// changes take an exclusive lock.
+class BuildingIndex {
+  public:
+    BuildingIndex(void) {};
+
+    /// Queue a building read from the database. They can be queried
+    /// once seal() is called.
+    void load(long id, int version, const polygon_t &polygon, const std::string &layer);
+    /// Bulk load everything queued by load() into the R-tree
+    void seal(void);
+
+    /// Add, replace or drop a building from a change file. A way that
+    /// is no longer a closed building is dropped, and a building is
+    /// never replaced by an older version, as files may be processed
+    /// out of order.
+    void update(const osmobjects::OsmWay &way);
+    /// Drop a deleted building. The version is kept, so an older
+    /// version of it is never added back.
+    void erase(long id, int version);
+
+    /// The buildings whose envelope intersects the envelope of a polygon
+    std::vector<std::shared_ptr<const Building>> candidates(const polygon_t &polygon) const;
+    /// The buildings whose envelope intersects a bounding box
+    std::vector<std::shared_ptr<const Building>> candidates(const boost::geometry::model::box<point_t> &envelope) const;
+
+    /// The number of buildings in the index
+    size_t size(void) const;
+
+  private:
+    typedef std::pair<boost::geometry::model::box<point_t>, long> value_t;
+    typedef boost::geometry::index::rtree<value_t, boost::geometry::index::rstar<16>> rtree_t;
+
+    /// Make a building, or nothing if the polygon is empty
+    static std::shared_ptr<const Building> make(long id, int version, const polygon_t &polygon,
+                                                const std::string &layer);
+    /// Replace a building without taking the lock
+    void replace(const std::shared_ptr<const Building> &building);
+    /// Drop a building without taking the lock, and remember the
+    /// version that dropped it
+    void remove(long id, int version);
+    /// True if a newer version of the way was already seen
+    bool stale(long id, int version) const;
+
+    rtree_t rtree;
+    std::unordered_map<long, std::shared_ptr<const Building>> buildings;
+    /// The versions of the ways that were deleted or are no longer
+    /// buildings, so an older version processed late can't add them back
+    std::unordered_map<long, int> removed;
+    std::vector<std::shared_ptr<const Building>> pending;   ///< Buildings queued by load()
+
+    mutable std::shared_mutex lock;
+};
+
+} // namespace buildingindex
+
+#endif // EOF __BUILDINGINDEX_HH__
+
+// local Variables:
+// mode: C++
+// indent-tabs-mode: nil
+// End:
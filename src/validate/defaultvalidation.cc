@@ -69,9 +69,9 @@ DefaultValidation::checkWay(const osmobjects::OsmWay &way, const std::string &ty
     }
     yaml::Yaml tests = yamls[type];
     semantic::Semantic::checkWay(way, type, tests, status);
-    geospatial::Geospatial::checkWay(way, type, tests, status);
-    if (way.linestring.size() > 2) {
-        boost::geometry::centroid(way.linestring, status->center);
+    geospatial::Geospatial::checkWay(way, type, tests, status, buildings.get());
+    if (way.linestring().size() > 2) {
+        status->center = way.centroid();
     }
     status->source = type;
     return status;
@@ -20,6 +20,7 @@
 #ifndef __GEOSPATIAL_H__
 #define __GEOSPATIAL_H__
 
+#include <deque>
 #include <memory>
 #include <string>
 
@@ -36,8 +37,8 @@ using namespace logger;
 
 // This plugin checks for geospatial issues
 // [*] Bad geometry
-// [ ] Overlapping
-// [ ] Duplicates
+// [*] Overlapping
+// [*] Duplicates
 // [ ] Un-connected
 
 namespace geospatial {
@@ -49,7 +50,7 @@ Geospatial::Geospatial() {}
 // This checks a way. A way should always have some tags. Often a polygon
 // with no tags is a building.
 std::shared_ptr<ValidateStatus>
-Geospatial::checkWay(const osmobjects::OsmWay &way, const std::string &type, yaml::Yaml &tests, std::shared_ptr<ValidateStatus> &status)
+Geospatial::checkWay(const osmobjects::OsmWay &way, const std::string &type, yaml::Yaml &tests, std::shared_ptr<ValidateStatus> &status, const buildingindex::BuildingIndex *buildings)
 {
     if (way.action == osmobjects::remove) {
         return status;
@@ -57,20 +58,22 @@ Geospatial::checkWay(const osmobjects::OsmWay &way, const std::string &type, yam
 
     auto config = tests.get("config");
     bool check_badgeom = config.get_value("badgeom") == "yes";
-    // bool check_overlapping = config.get_value("overlapping") == "yes";
-    // bool check_duplicate = config.get_value("duplicate") == "yes";
+    bool check_overlapping = config.get_value("overlapping") == "yes";
+    bool check_duplicate = config.get_value("duplicate") == "yes";
 
     if (way.tags.count(type)) {
         if (check_badgeom) {
             auto badgeom_minangle = config.get_value("badgeom_minangle");
             auto badgeom_maxangle = config.get_value("badgeom_maxangle");
-            if (!way.linestring.empty() && boost::geometry::equals(way.linestring.back(), way.linestring.front())) {
+            // Not way.ring(), which needs 4 points, as a closed way
+            // with 3 is a bad geometry too
+            if (!way.linestring().empty() && boost::geometry::equals(way.linestring().back(), way.linestring().front())) {
                 if (badgeom_minangle != "" && badgeom_maxangle != "") {
-                    if (unsquared(way.linestring, std::stod(badgeom_minangle), std::stod(badgeom_maxangle))) {
+                    if (unsquared(way.linestring(), std::stod(badgeom_minangle), std::stod(badgeom_maxangle))) {
                         status->status.insert(badgeom);
                     }
                 } else {
-                    if (unsquared(way.linestring)) {
+                    if (unsquared(way.linestring())) {
                         status->status.insert(badgeom);
                     }
                 }
@@ -78,36 +81,37 @@ Geospatial::checkWay(const osmobjects::OsmWay &way, const std::string &type, yam
 
         }
 
-        // if (check_overlapping) {
-            // auto allWays = context.getOverlappingWays();
-            // if (overlaps(allWays, way)) {
-            //     status->status.insert(overlapping);
-            // }
-        // }
-
-        // if (check_duplicate) {
-            // auto allWays = context.getOverlappingWays();
-            // if (overlaps(allWays, way)) {
-            //     status->status.insert(overlapping);
-            // }
-        // }
+        // These need the buildings around this one
+        if (buildings) {
+            if (check_overlapping && overlaps(*buildings, way)) {
+                status->status.insert(overlapping);
+            }
+            if (check_duplicate && duplicate(*buildings, way)) {
+                status->status.insert(valerror_t::duplicate);
+            }
+        }
     }
 
     return status;
 }
 
 bool
-Geospatial::overlaps(const std::list<std::shared_ptr<osmobjects::OsmWay>> &allways, osmobjects::OsmWay &way) {
+Geospatial::overlaps(const buildingindex::BuildingIndex &buildings, const osmobjects::OsmWay &way) {
 #ifdef TIMING_DEBUG_X
     boost::timer::auto_cpu_timer timer("validate::overlaps: took %w seconds\n");
 #endif
-    if (way.numPoints() <= 1) {
+    if (way.polygon.outer().size() < 4) {
         return false;
     }
-    for (auto nit = std::begin(allways); nit != std::end(allways); ++nit) {
-        osmobjects::OsmWay *oldway = nit->get();
-        if (boost::geometry::overlaps(oldway->polygon, way.polygon)) {
-            if (way.getTagValue("layer") == oldway->getTagValue("layer") && way.id != oldway->id) {
+    polygon_t polygon = way.polygon;
+    boost::geometry::correct(polygon);
+    auto tag = way.tags.find("layer");
+    std::string layer = tag == way.tags.end() ? "" : tag->second;
+    auto nearby = buildings.candidates(way.bbox());
+    for (auto nit = std::begin(nearby); nit != std::end(nearby); ++nit) {
+        const buildingindex::Building *oldway = nit->get();
+        if (way.id != oldway->id && layer == oldway->layer) {
+            if (boost::geometry::overlaps(oldway->polygon, polygon)) {
                 log_error("Building %1% overlaps with %2%", way.id, oldway->id);
                 return true;
             }
@@ -117,27 +121,36 @@ Geospatial::overlaps(const std::list<std::shared_ptr<osmobjects::OsmWay>> &allwa
 }
 
 bool
-Geospatial::duplicate(const std::list<std::shared_ptr<osmobjects::OsmWay>> &allways, osmobjects::OsmWay &way) {
+Geospatial::duplicate(const buildingindex::BuildingIndex &buildings, const osmobjects::OsmWay &way) {
 #ifdef TIMING_DEBUG_X
     boost::timer::auto_cpu_timer timer("validate::duplicate: took %w seconds\n");
 #endif
-    if (way.numPoints() <= 1) {
+    if (way.polygon.outer().size() < 4) {
         return false;
     }
-    for (auto nit = std::begin(allways); nit != std::end(allways); ++nit) {
-        osmobjects::OsmWay *oldway = nit->get();
-        std::deque<polygon> output;
-        bg::intersection(oldway->polygon, way.polygon, output);
+    polygon_t polygon = way.polygon;
+    boost::geometry::correct(polygon);
+    double wayarea = bg::area(polygon);
+    if (wayarea <= 0) {
+        return false;
+    }
+    auto tag = way.tags.find("layer");
+    std::string layer = tag == way.tags.end() ? "" : tag->second;
+    auto nearby = buildings.candidates(way.bbox());
+    for (auto nit = std::begin(nearby); nit != std::end(nearby); ++nit) {
+        const buildingindex::Building *oldway = nit->get();
+        if (way.id == oldway->id || layer != oldway->layer) {
+            continue;
+        }
+        std::deque<polygon_t> output;
+        bg::intersection(oldway->polygon, polygon, output);
         double iarea = 0;
         for (auto& p : output)
             iarea += bg::area(p);
-        double wayarea = bg::area(way.polygon);
         double iareapercent = (iarea * 100) / wayarea;
         if (iareapercent >= 80) {
-            if (way.getTagValue("layer") == oldway->getTagValue("layer") && way.id != oldway->id) {
-                log_error("Building %1% duplicate %2%", way.id, oldway->id);
-                return true;
-            }
+            log_error("Building %1% duplicate %2%", way.id, oldway->id);
+            return true;
         }
     }
     return false;
@@ -150,33 +163,54 @@ Geospatial::unsquared(
     double max_angle
 ) {
     const int num_points =  boost::geometry::num_points(way);
-    double last_angle = -1;
-    double max_angle_diff = 0;
+    if (num_points < 3) {
+        return false;
+    }
+    // Project each point once. The corners are taken around the ring,
+    // the last one being at the first point, so the first two points
+    // are repeated at the end instead of the closing point.
+    std::vector<double> xs(num_points + 1);
+    std::vector<double> ys(num_points + 1);
+    for (int i = 0; i < num_points - 1; i++) {
+        xs[i] = boost::geometry::get<0>(way[i]);
+        ys[i] = boost::geometry::get<1>(way[i]);
+        geo::Geo::epsg4326toEpsg3857(xs[i], ys[i]);
+    }
+    xs[num_points - 1] = xs[0];
+    ys[num_points - 1] = ys[0];
+    xs[num_points] = xs[1];
+    ys[num_points] = ys[1];
+    std::vector<double> cosines(num_points - 1);
+    geo::Geo::cornerCosines(xs.data(), ys.data(), xs.size(), cosines.data());
+
+    // The angle is outside the limits when its cosine is, acos() is
+    // decreasing. A cosine outside [-1, 1] is a NaN angle, which never
+    // counts, and an angle is never more than 180 degrees.
+    const double radians = M_PI / 180;
+    const double cos_min = std::cos(min_angle * radians);
+    const double cos_max = std::cos(max_angle * radians);
+    const double cos_straight = std::cos(179 * radians);
     bool unsquared = false;
-    for(int i = 0; i < num_points - 1; i++) {
-        // Three points
-        int a,b,c;
-        if (i < num_points - 3) {
-            a = i;
-            b = i + 1;
-            c = i + 2;
-        } else if (i == num_points - 3) {
-            a = i;
-            b = i + 1;
-            c = 0;
-        } else {
-            a = i;
-            b = 0;
-            c = 1;
+    for (auto cosine : cosines) {
+        if (cosine >= -1 && cosine <= 1 &&
+            (cosine < cos_max || cosine > cos_min) &&
+            cosine > cos_straight) {
+            unsquared = true;
+            break;
         }
-        double x1 = boost::geometry::get<0>(way[a]);
-        double y1 = boost::geometry::get<1>(way[a]);
-        double x2 = boost::geometry::get<0>(way[b]);
-        double y2 = boost::geometry::get<1>(way[b]);
-        double x3 = boost::geometry::get<0>(way[c]);
-        double y3 = boost::geometry::get<1>(way[c]);
-
-        double angle = geo::Geo::calculateAngle(x1,y1,x2,y2,x3,y3);
+    }
+    if (!unsquared) {
+        return false;
+    }
+    if (num_points <= 5) {
+        return true;
+    }
+
+    // Only nearly regular shapes need the angles themselves
+    double last_angle = -1;
+    double max_angle_diff = 0;
+    for (auto cosine : cosines) {
+        double angle = acos(cosine) * 180 / M_PI;
         if (last_angle != -1) {
             double diff = abs(angle - last_angle);
             if (diff > max_angle_diff) {
@@ -184,18 +218,8 @@ Geospatial::unsquared(
             }
         }
         last_angle = angle;
-
-        if (
-            (angle > max_angle || angle < min_angle) &&
-            (angle < 179 || angle > 181)
-        ) {
-            unsquared = true;
-        }
     }
-    if (unsquared && !(num_points > 5 && max_angle_diff < 3)) {
-        return true;
-    }
-    return false;
+    return !(max_angle_diff < 3);
 };
 
 }; // namespace geospatial
@@ -55,6 +55,8 @@ using namespace boost::gregorian;
 #include "validate/queryvalidate.hh"
 #include "validate/validate.hh"
 #include "data/pq.hh"
+#include "utils/ewkb.hh"
+#include "utils/quadkey.hh"
 using namespace pq;
 
 using namespace logger;
@@ -139,14 +141,24 @@ QueryValidate::applyChange(const ValidateStatus &validation, const valerror_t &s
     std::string format;
     std::string query;
 
+    // The regions are only there when the boundary has named regions
+    std::string regions;
+    for (const auto &region: std::as_const(validation.regions)) {
+        regions += "'" + dbconn->escapedString(region) + "',";
+    }
+    if (!regions.empty()) {
+        regions.pop_back();
+    }
+
     if (validation.values.size() > 0) {
-        query = "INSERT INTO validation as v (osm_id, changeset, uid, type, status, values, timestamp, location, source, version) VALUES(";
-        format = "%d, %d, %g, \'%s\', \'%s\', ARRAY[%s], \'%s\', ST_GeomFromText(\'%s\', 4326), \'%s\', %s) ";
+        query = "INSERT INTO validation as v (osm_id, changeset, uid, type, status, values, timestamp, location, source, version, quadkey%s) VALUES(";
+        format = "%d, %d, %g, \'%s\', \'%s\', ARRAY[%s], \'%s\', %s, \'%s\', %s, %d%s) ";
     } else {
-        query = "INSERT INTO validation as v (osm_id, changeset, uid, type, status, timestamp, location, source, version) VALUES(";
-        format = "%d, %d, %g, \'%s\', \'%s\', \'%s\', ST_GeomFromText(\'%s\', 4326), \'%s\', %s) ";
+        query = "INSERT INTO validation as v (osm_id, changeset, uid, type, status, timestamp, location, source, version, quadkey%s) VALUES(";
+        format = "%d, %d, %g, \'%s\', \'%s\', \'%s\', %s, \'%s\', %s, %d%s) ";
     }
-    format += "ON CONFLICT (osm_id, status, source) DO UPDATE SET version = %d,  timestamp = \'%s\' WHERE v.version < %d;";
+    query = boost::str(boost::format(query) % (regions.empty() ? "" : ", regions"));
+    format += "ON CONFLICT (osm_id, status, source) DO UPDATE SET version = %d,  timestamp = \'%s\'%s WHERE v.version < %d;";
     boost::format fmt(format);
     fmt % validation.osm_id;
     fmt % validation.changeset;
@@ -165,33 +177,163 @@ QueryValidate::applyChange(const ValidateStatus &validation, const valerror_t &s
     }
     fmt % to_simple_string(validation.timestamp);
 
-    std::stringstream ss;
-    ss << std::setprecision(12) << boost::geometry::wkt(validation.center);
-    std::string center = ss.str();
-    fmt % center;
+    fmt % ewkb::geometry(validation.center);
 
     fmt % validation.source;
     fmt % validation.version;
+    fmt % geoutil::quadkey::key(validation.center);
+    fmt % (regions.empty() ? "" : ", ARRAY[" + regions + "]");
 
     // ON CONFLICT
     fmt % validation.version;
     fmt % to_simple_string(validation.timestamp);
+    fmt % (regions.empty() ? "" : ", regions = EXCLUDED.regions");
     fmt % validation.version;
     query += fmt.str();
 
     return query;
 }
 
+namespace {
+
+const std::string validationConflict = " ON CONFLICT (osm_id, status, source) DO UPDATE SET \
+version = EXCLUDED.version, timestamp = EXCLUDED.timestamp, regions = coalesce(EXCLUDED.regions, v.regions) \
+WHERE v.version < EXCLUDED.version";
+
+// The staging table for the COPY writer
+const std::string validationStaging = "copy_validation";
+const std::string validationColumns = "osm_id int8, changeset int8, uid int8, type objtype, status status, \
+values text[], timestamp timestamptz, location geometry, source text, version int8, quadkey int8, regions text[]";
+const std::vector<std::string> validationMerge = {
+    "INSERT INTO validation AS v (osm_id, changeset, uid, type, status, values, timestamp, location, source, version, quadkey, regions) \
+SELECT osm_id, changeset, uid, type, status, values, timestamp, location, source, version, quadkey, regions FROM " +
+        CopyWriter::latest(validationStaging, "osm_id, status, source") + " ORDER BY s.quadkey" + validationConflict
+};
+
+// The prepared statements, the location is sent as binary EWKB
+const std::string validationUpsert = "validation";
+const std::string validationUpsertSQL = "INSERT INTO validation AS v \
+(osm_id, changeset, uid, type, status, values, timestamp, location, source, version, quadkey, regions) \
+VALUES ($1, $2, $3, $4::objtype, $5::status, $6::text[], $7, $8::geometry, $9, $10, $11, $12::text[])" + validationConflict;
+const std::string removalsDelete = "validation_delete_removed";
+const std::string removalsDeleteSQL = "DELETE FROM validation WHERE osm_id = ANY($1::int8[])";
+const std::string statusDelete = "validation_delete";
+const std::string statusDeleteSQL = "DELETE FROM validation WHERE osm_id = $1 AND status = $2::status";
+const std::string sourceDelete = "validation_delete_source";
+const std::string sourceDeleteSQL = "DELETE FROM validation WHERE osm_id = $1 AND status = $2::status AND source = $3";
+
+} // namespace
+
+void
+QueryValidate::applyChange(const ValidateStatus &validation, const valerror_t &status, CopyWriter &copy) const
+{
+    copy.stage(validationStaging, validationColumns, validationMerge);
+    copy.add(validationStaging, {
+        std::to_string(validation.osm_id),
+        std::to_string(validation.changeset),
+        std::to_string(validation.uid),
+        objtypes[validation.objtype],
+        status_list[status],
+        validation.values.size() > 0 ?
+            std::optional<std::string>(CopyWriter::array({validation.values.begin(), validation.values.end()})) : std::nullopt,
+        to_simple_string(validation.timestamp),
+        ewkb::hex(validation.center),
+        validation.source,
+        std::to_string(validation.version),
+        std::to_string(geoutil::quadkey::key(validation.center)),
+        validation.regions.size() > 0 ? std::optional<std::string>(CopyWriter::array(validation.regions)) : std::nullopt
+    });
+}
+
+void
+QueryValidate::applyChange(const ValidateStatus &validation, const valerror_t &status, PreparedBatch &batch) const
+{
+    batch.prepare(validationUpsert, validationUpsertSQL, {8});
+    batch.add(validationUpsert, {
+        std::to_string(validation.osm_id),
+        std::to_string(validation.changeset),
+        std::to_string(validation.uid),
+        objtypes[validation.objtype],
+        status_list[status],
+        validation.values.size() > 0 ?
+            std::optional<std::string>(CopyWriter::array({validation.values.begin(), validation.values.end()})) : std::nullopt,
+        to_simple_string(validation.timestamp),
+        ewkb::binary(validation.center),
+        validation.source,
+        std::to_string(validation.version),
+        std::to_string(geoutil::quadkey::key(validation.center)),
+        validation.regions.size() > 0 ? std::optional<std::string>(CopyWriter::array(validation.regions)) : std::nullopt
+    });
+}
+
+void
+QueryValidate::updateValidation(std::shared_ptr<std::vector<long>> removals, PreparedBatch &batch) const
+{
+    if (removals->size() > 0) {
+        std::string ids = "{";
+        for (const auto &osm_id : *removals) {
+            ids += std::to_string(osm_id) + ",";
+        }
+        ids.back() = '}';
+        batch.prepare(removalsDelete, removalsDeleteSQL);
+        batch.add(removalsDelete, {ids});
+    }
+}
+
+void
+QueryValidate::updateValidation(long osm_id, const valerror_t &status, const std::string &source, PreparedBatch &batch) const
+{
+    batch.prepare(sourceDelete, sourceDeleteSQL);
+    batch.add(sourceDelete, {std::to_string(osm_id), status_list[status], source});
+}
+
+void
+QueryValidate::updateValidation(long osm_id, const valerror_t &status, PreparedBatch &batch) const
+{
+    batch.prepare(statusDelete, statusDeleteSQL);
+    batch.add(statusDelete, {std::to_string(osm_id), status_list[status]});
+}
+
+void
+QueryValidate::write(const ValidateStatus &validation, const valerror_t &status,
+                     std::string &task_query, CopyWriter *copy, PreparedBatch *batch) const
+{
+    if (copy) {
+        applyChange(validation, status, *copy);
+    } else if (batch) {
+        applyChange(validation, status, *batch);
+    } else {
+        task_query += applyChange(validation, status);
+    }
+}
+
+void
+QueryValidate::remove(long osm_id, const valerror_t &status, const std::string &source,
+                      std::string &task_query, PreparedBatch *batch) const
+{
+    if (batch && source.empty()) {
+        updateValidation(osm_id, status, *batch);
+    } else if (batch) {
+        updateValidation(osm_id, status, source, *batch);
+    } else if (source.empty()) {
+        task_query += updateValidation(osm_id, status);
+    } else {
+        task_query += updateValidation(osm_id, status, source);
+    }
+}
+
 
 void
 QueryValidate::ways(
     std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval,
-    std::string &task_query
+    std::string &task_query,
+    CopyWriter *copy,
+    PreparedBatch *batch
 ) {
     for (auto it = wayval->begin(); it != wayval->end(); ++it) {
         if (it->get()->status.size() > 0) {
             for (auto status_it = it->get()->status.begin(); status_it != it->get()->status.end(); ++status_it) {
-                task_query += applyChange(*it->get(), *status_it);
+                write(*it->get(), *status_it, task_query, copy, batch);
             }
         }
     }
@@ -201,24 +343,26 @@ void
 QueryValidate::ways(
     std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval,
     std::string &task_query,
-    std::shared_ptr<std::vector<long>> validation_removals
+    std::shared_ptr<std::vector<long>> validation_removals,
+    CopyWriter *copy,
+    PreparedBatch *batch
 ) {
     for (auto it = wayval->begin(); it != wayval->end(); ++it) {
         if (it->get()->status.size() > 0) {
             for (auto status_it = it->get()->status.begin(); status_it != it->get()->status.end(); ++status_it) {
-                task_query += applyChange(*it->get(), *status_it);
+                write(*it->get(), *status_it, task_query, copy, batch);
             }
             if (!it->get()->hasStatus(overlapping)) {
-                task_query += updateValidation(it->get()->osm_id, overlapping, "building");
+                remove(it->get()->osm_id, overlapping, "building", task_query, batch);
             }
             if (!it->get()->hasStatus(duplicate)) {
-                task_query += updateValidation(it->get()->osm_id, duplicate, "building");
+                remove(it->get()->osm_id, duplicate, "building", task_query, batch);
             }
             if (!it->get()->hasStatus(badgeom)) {
-                task_query += updateValidation(it->get()->osm_id, badgeom, "building");
+                remove(it->get()->osm_id, badgeom, "building", task_query, batch);
             }
             if (!it->get()->hasStatus(badvalue)) {
-                task_query += updateValidation(it->get()->osm_id, badvalue);
+                remove(it->get()->osm_id, badvalue, "", task_query, batch);
             }
         } else {
             validation_removals->push_back(it->get()->osm_id);
@@ -229,12 +373,14 @@ QueryValidate::ways(
 void
 QueryValidate::nodes(
     std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval,
-    std::string &task_query
+    std::string &task_query,
+    CopyWriter *copy,
+    PreparedBatch *batch
 ) {
     for (auto it = nodeval->begin(); it != nodeval->end(); ++it) {
         if (it->get()->status.size() > 0) {
             for (auto status_it = it->get()->status.begin(); status_it != it->get()->status.end(); ++status_it) {
-                task_query += applyChange(*it->get(), *status_it);
+                write(*it->get(), *status_it, task_query, copy, batch);
             }
         }
     }
@@ -244,15 +390,17 @@ void
 QueryValidate::nodes(
     std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval,
     std::string &task_query,
-    std::shared_ptr<std::vector<long>> validation_removals
+    std::shared_ptr<std::vector<long>> validation_removals,
+    CopyWriter *copy,
+    PreparedBatch *batch
 ) {
     for (auto it = nodeval->begin(); it != nodeval->end(); ++it) {
         if (it->get()->status.size() > 0) {
             for (auto status_it = it->get()->status.begin(); status_it != it->get()->status.end(); ++status_it) {
-                task_query += applyChange(*it->get(), *status_it);
+                write(*it->get(), *status_it, task_query, copy, batch);
             }
             if (!it->get()->hasStatus(badvalue)) {
-                task_query += updateValidation(it->get()->osm_id, badvalue);
+                remove(it->get()->osm_id, badvalue, "", task_query, batch);
             }
         } else {
             validation_removals->push_back(it->get()->osm_id);
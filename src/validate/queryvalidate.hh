@@ -49,6 +49,8 @@ using namespace boost::gregorian;
 #include "osm/osmchange.hh"
 
 #include "data/pq.hh"
+#include "data/copywriter.hh"
+#include "data/prepared.hh"
 
 using namespace pq;
 
@@ -75,18 +77,35 @@ class QueryValidate  {
 
     /// Apply data validation to the database
     std::string applyChange(const ValidateStatus &validation, const valerror_t &status) const;
+    /// Stage data validation for a COPY writer
+    void applyChange(const ValidateStatus &validation, const valerror_t &status, pq::CopyWriter &copy) const;
+    /// Add the prepared statement for data validation to a batch
+    void applyChange(const ValidateStatus &validation, const valerror_t &status, pq::PreparedBatch &batch) const;
     /// Update the validation table, delete any feature that has been fixed.
     std::string updateValidation(std::shared_ptr<std::vector<long>> removals);
     std::string updateValidation(long osm_id, const valerror_t &status, const std::string &source) const;
     std::string updateValidation(long osm_id, const valerror_t &status) const;
-    void ways(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval, std::string &task_query);
-    void nodes(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval, std::string &task_query);
+    void updateValidation(std::shared_ptr<std::vector<long>> removals, pq::PreparedBatch &batch) const;
+    void updateValidation(long osm_id, const valerror_t &status, const std::string &source, pq::PreparedBatch &batch) const;
+    void updateValidation(long osm_id, const valerror_t &status, pq::PreparedBatch &batch) const;
+    /// With a COPY writer, the results are staged and only the deletes are added to the query.
+    /// With a batch of prepared statements, everything goes in the batch.
+    void ways(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval, std::string &task_query, pq::CopyWriter *copy = nullptr, pq::PreparedBatch *batch = nullptr);
+    void nodes(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval, std::string &task_query, pq::CopyWriter *copy = nullptr, pq::PreparedBatch *batch = nullptr);
     void rels(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> relval, std::string &task_query);
-    void ways(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval, std::string &task_query, std::shared_ptr<std::vector<long>> validation_removals);
-    void nodes(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval, std::string &task_query, std::shared_ptr<std::vector<long>> validation_removals);
+    void ways(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> wayval, std::string &task_query, std::shared_ptr<std::vector<long>> validation_removals, pq::CopyWriter *copy = nullptr, pq::PreparedBatch *batch = nullptr);
+    void nodes(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> nodeval, std::string &task_query, std::shared_ptr<std::vector<long>> validation_removals, pq::CopyWriter *copy = nullptr, pq::PreparedBatch *batch = nullptr);
     void rels(std::shared_ptr<std::vector<std::shared_ptr<ValidateStatus>>> relval, std::string &task_query, std::shared_ptr<std::vector<long>> validation_removals);
     // Database connection, used for escape strings
     std::shared_ptr<Pq> dbconn;
+
+  private:
+    /// Write a validation result to whichever output is in use
+    void write(const ValidateStatus &validation, const valerror_t &status,
+               std::string &task_query, pq::CopyWriter *copy, pq::PreparedBatch *batch) const;
+    /// Delete a validation result that was fixed, from any source when it's empty
+    void remove(long osm_id, const valerror_t &status, const std::string &source,
+                std::string &task_query, pq::PreparedBatch *batch) const;
   };
 
 } // namespace queryvalidate
@@ -52,6 +52,7 @@ using namespace boost::gregorian;
 #include "utils/yaml.hh"
 #include "utils/log.hh"
 #include "utils/geo.hh"
+#include "validate/buildingindex.hh"
 
 using namespace logger;
 
@@ -170,6 +171,7 @@ class ValidateStatus {
     ptime timestamp;        ///< The timestamp when this validation was performed
     point_t center;        ///< The centroid of the building polygon
     std::unordered_set<std::string> values; ///< The found bad tag values
+    std::vector<std::string> regions; ///< The named regions this feature is in
     std::string source; //< The source of the validation status
 };
 
@@ -205,6 +207,10 @@ class BOOST_SYMBOL_VISIBLE Validate {
     virtual std::shared_ptr<ValidateStatus> checkWay(const osmobjects::OsmWay &way, const std::string &type) = 0;
 
     yaml::Yaml &operator[](const std::string &key) { return yamls[key]; };
+
+    /// The buildings for the overlapping and duplicate checks, which
+    /// are skipped when this isn't set
+    std::shared_ptr<buildingindex::BuildingIndex> buildings;
     
     void dump(void) {
         for (auto it = std::begin(yamls); it != std::end(yamls); ++it) {